@@ -265,6 +265,10 @@ struct io_uring_probe {
 
 #endif /* IOSQE_FIXED_FILE */
 
+#if !HAVE_DECL_IORING_OP_UNLINKAT
+#define IORING_OP_UNLINKAT 36
+#endif
+
 #ifndef IORING_REGISTER_CLONE_BUFFERS
 # define IORING_REGISTER_CLONE_BUFFERS	30
 #endif
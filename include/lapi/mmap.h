@@ -87,6 +87,14 @@
 # define MADV_PAGEOUT	21
 #endif
 
+#ifndef MADV_POPULATE_READ
+# define MADV_POPULATE_READ	22
+#endif
+
+#ifndef MADV_POPULATE_WRITE
+# define MADV_POPULATE_WRITE	23
+#endif
+
 #ifndef MAP_DROPPABLE
 # define MAP_DROPPABLE 0x08
 #endif
@@ -6,6 +6,10 @@
 #ifndef LAPI_NUMAIF_H__
 #define LAPI_NUMAIF_H__
 
+#ifndef MPOL_PREFERRED
+# define MPOL_PREFERRED	1
+#endif
+
 #ifndef MPOL_LOCAL
 # define MPOL_LOCAL	4
 #endif
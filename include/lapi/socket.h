@@ -26,6 +26,10 @@
 # define SO_BUSY_POLL	46
 #endif
 
+#ifndef SO_INCOMING_CPU
+# define SO_INCOMING_CPU	49
+#endif
+
 #ifndef SO_ATTACH_BPF
 # define SO_ATTACH_BPF  50
 #endif
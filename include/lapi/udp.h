@@ -15,6 +15,14 @@
 # define UDPLITE_RECV_CSCOV   11 /* receiver partial coverage (threshold ) */
 #endif
 
+#ifndef UDP_SEGMENT
+# define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+# define UDP_GRO 104
+#endif
+
 #ifndef UDP_ENCAP
 # define UDP_ENCAP 100
 #endif
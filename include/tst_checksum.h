@@ -8,9 +8,31 @@
 #include <stdint.h>
 #include <stddef.h>
 
+enum tst_crc32c_impl {
+	/* Byte at a time table lookup */
+	TST_CRC32C_BYTE,
+	/* Eight bytes at a time table lookup */
+	TST_CRC32C_SLICE8,
+	/* SSE4.2 crc32 on x86_64, CRC extension on arm64 */
+	TST_CRC32C_HW,
+};
+
 /*
- * Generates CRC32c checksum.
+ * Generates CRC32c checksum, uses the CPU crc32 instructions when available.
  */
 uint32_t tst_crc32c(uint8_t *buf, size_t buf_len);
 
+/*
+ * Returns non-zero if the implementation can be used on this machine.
+ */
+int tst_crc32c_impl_supported(enum tst_crc32c_impl impl);
+
+/*
+ * Generates CRC32c checksum with a particular implementation, meant for
+ * testing and benchmarking. Exits the test with TCONF if the implementation
+ * is not supported.
+ */
+uint32_t tst_crc32c_with(enum tst_crc32c_impl impl, uint8_t *buf,
+			 size_t buf_len);
+
 #endif
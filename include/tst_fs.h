@@ -42,7 +42,13 @@
 
 enum tst_fill_access_pattern {
 	TST_FILL_BLOCKS,
-	TST_FILL_RANDOM
+	TST_FILL_RANDOM,
+	/*
+	 * Preallocates and writes large chunks from several processes in
+	 * parallel, then tops up the remaining space as TST_FILL_RANDOM.
+	 * Requires .forks_child in the test.
+	 */
+	TST_FILL_PARALLEL
 };
 
 enum {
@@ -54,11 +54,39 @@
  *
  * For a usage example see testcases/cve/cve-2016-7117.c or just run
  * 'git grep tst_fuzzy_sync.h'
+ *
+ * Races with more than two participants can add up to TST_FZSYNC_MAX_EXTRA
+ * threads synchronised with thread A by setting pair.extra and starting them
+ * with tst_fzsync_pair_reset_x(). Each extra thread uses the *_x() variants
+ * of the functions above on its own struct tst_fzsync_extra:
+ *
+ * while (tst_fzsync_run_x(x)) {
+ *	tst_fzsync_start_race_x(x);
+ *	// Do something which can race with both A and B
+ *	tst_fzsync_end_race_x(x);
+ * }
+ *
+ * To use more cores several independent pairs can run at once with
+ * tst_fzsync_multi_run(), which starts thread A for each pair and pins the
+ * threads of each pair to CPUs chosen by topology.
+ *
+ * Tests that can detect when the race window was hit should report it with
+ * tst_fzsync_pair_hit(). The random delays are then drawn preferably from the
+ * part of the delay range that produced hits so far. Races without a side
+ * effect visible from user space can count an overlap of the race regions,
+ * see tst_fzsync_pair_overlap(), as a hit.
+ *
+ * If LTP_FZSYNC_PROFILE is set to a directory, the timing statistics and the
+ * hit histogram are stored there in tst_fzsync_pair_cleanup() and loaded in
+ * tst_fzsync_pair_reset() on the next run of the same test on the same kernel
+ * and CPU, which shortens the sampling period considerably.
  */
 
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <time.h>
 #include "tst_atomic.h"
@@ -72,6 +100,12 @@
 /* how much of exec time is sampling allowed to take */
 #define SAMPLING_SLICE 0.5f
 
+/* number of delay range slices the race hits are accounted in */
+#define TST_FZSYNC_BINS 32
+
+/* maximal number of threads racing with thread A in addition to thread B */
+#define TST_FZSYNC_MAX_EXTRA 4
+
 /** Some statistics for a variable */
 struct tst_fzsync_stat {
 	float avg;
@@ -79,6 +113,24 @@ struct tst_fzsync_stat {
 	float dev_ratio;
 };
 
+struct tst_fzsync_pair;
+
+/**
+ * struct tst_fzsync_extra - Additional thread racing with thread A.
+ * @pair: Fuzzy sync pair the thread belongs to.
+ * @a_cntr: Internal; Thread A atomic counter used by fzsync_pair_wait().
+ * @x_cntr: Internal; Our atomic counter used by fzsync_pair_wait().
+ * @delay: Internal; Number of spins to delay this thread.
+ * @thread: Internal; The thread or 0.
+ */
+struct tst_fzsync_extra {
+	struct tst_fzsync_pair *pair;
+	tst_atomic_t a_cntr;
+	tst_atomic_t x_cntr;
+	int delay;
+	pthread_t thread;
+};
+
 /**
  * struct tst_fzsync_pair - The state of a two way synchronisation or race.
  * @avg_alpha: Rate at which old diff samples are forgotten (default 0.25).
@@ -111,6 +163,20 @@ struct tst_fzsync_stat {
  * @thread_b: Internal; The second thread or 0.
  * @yield_in_wait: Yield CPU while waiting, set automatically on single-core
  *     machines.
+ * @delay_bin: Internal; Delay range slice used in the current iteration or -1
+ *     if no random delay was applied.
+ * @hits: Internal; Number of hits reported by tst_fzsync_pair_hit().
+ * @bin_hits: Internal; Histogram of hits over the delay range slices.
+ * @bin_total: Internal; Sum of the bin_hits histogram.
+ * @profile_dirty: Internal; Profile should be saved on cleanup.
+ * @multi: Internal; Pair is run by tst_fzsync_multi_run(), which saves the
+ *     profile once for all pairs.
+ * @extra: Number of extra threads started by tst_fzsync_pair_reset_x()
+ *     (default 0).
+ * @x: Internal; State of the extra threads.
+ * @nr_cpus: Internal; Number of valid entries in cpus, zero if not pinned.
+ * @cpus: Internal; CPUs for thread A, thread B and the extra threads.
+ * @rand: Internal; State of the random number generator.
  *
  * This contains all the necessary state for approximately synchronising two
  * sections of code in different threads.
@@ -149,8 +215,58 @@ struct tst_fzsync_pair {
 	pthread_t thread_b;
 	bool yield_in_wait;
 
+	int delay_bin;
+	unsigned int hits;
+	unsigned int bin_hits[TST_FZSYNC_BINS];
+	unsigned int bin_total;
+	bool profile_dirty;
+	bool multi;
+
+	int extra;
+	struct tst_fzsync_extra x[TST_FZSYNC_MAX_EXTRA];
+	int nr_cpus;
+	int cpus[2 + TST_FZSYNC_MAX_EXTRA];
+	unsigned short rand[3];
 };
 
+/*
+ * Loads timing statistics and hit histogram from $LTP_FZSYNC_PROFILE, returns
+ * non-zero if a matching profile was found.
+ */
+int tst_fzsync_profile_load(struct tst_fzsync_pair *pair);
+
+/* Stores the pair statistics into $LTP_FZSYNC_PROFILE if set. */
+void tst_fzsync_profile_save(struct tst_fzsync_pair *pair);
+
+/* Pins a thread to a CPU, thread 0 is the calling thread. */
+void tst_fzsync_pin_thread(pthread_t thread, int cpu);
+
+/**
+ * tst_fzsync_multi_count() - Number of pairs worth running in parallel.
+ * @extra: Number of extra threads per pair.
+ *
+ * Return: Number of available CPUs divided by the number of threads in a
+ * pair, at least one.
+ */
+unsigned int tst_fzsync_multi_count(int extra);
+
+/**
+ * tst_fzsync_multi_run() - Run several races in parallel.
+ * @pairs: Array of fuzzy sync pairs initialized by tst_fzsync_pair_init().
+ * @nr_pairs: Number of pairs in the array.
+ * @run_a: Thread A function, gets pointer to its pair as a parameter.
+ *
+ * Assigns CPUs to each pair, trying to cover SMT siblings, cores in the same
+ * package and cores in different packages, then runs thread A of each pair in
+ * a separate thread and waits for them to finish. The run_a function is
+ * expected to call tst_fzsync_pair_reset() or tst_fzsync_pair_reset_x(),
+ * which pins the threads of the pair. Per pair iteration and hit counts are
+ * printed at the end. The pairs share one profile, which is merged from all
+ * of them and saved after they finish.
+ */
+void tst_fzsync_multi_run(struct tst_fzsync_pair *pairs, unsigned int nr_pairs,
+			  void *(*run_a)(void *));
+
 #define CHK(param, low, hi, def) do {					      \
 	pair->param = (pair->param ? pair->param : def);		      \
 	if (pair->param < low)						      \
@@ -171,6 +287,7 @@ static inline void tst_fzsync_pair_init(struct tst_fzsync_pair *pair)
 	CHK(min_samples, 20, INT_MAX, 1024);
 	CHK(max_dev_ratio, 0, 1, 0.1);
 	CHK(exec_loops, 20, INT_MAX, 3000000);
+	CHK(extra, 0, TST_FZSYNC_MAX_EXTRA, 0);
 
 	if (tst_ncpus_available() <= 1)
 		pair->yield_in_wait = 1;
@@ -185,6 +302,8 @@ static inline void tst_fzsync_pair_init(struct tst_fzsync_pair *pair)
  */
 static inline void tst_fzsync_pair_cleanup(struct tst_fzsync_pair *pair)
 {
+	int i;
+
 	if (pair->thread_b) {
 		/* Revoke thread B if parent hits accidental break */
 		if (!pair->exit)
@@ -192,6 +311,21 @@ static inline void tst_fzsync_pair_cleanup(struct tst_fzsync_pair *pair)
 		SAFE_PTHREAD_JOIN(pair->thread_b, NULL);
 		pair->thread_b = 0;
 	}
+
+	for (i = 0; i < pair->extra; i++) {
+		if (!pair->x[i].thread)
+			continue;
+
+		if (!pair->exit)
+			tst_atomic_store(1, &pair->exit);
+		SAFE_PTHREAD_JOIN(pair->x[i].thread, NULL);
+		pair->x[i].thread = 0;
+	}
+
+	if (pair->profile_dirty && !pair->multi) {
+		tst_fzsync_profile_save(pair);
+		pair->profile_dirty = 0;
+	}
 }
 
 /**
@@ -217,10 +351,15 @@ static inline void tst_init_stat(struct tst_fzsync_stat *s)
  * you can pass NULL to run_b and handle starting and stopping thread B
  * yourself. You may need to place tst_fzsync_pair in some shared memory as
  * well.
+ *
+ * Thread B gets pointer to the pair as a parameter.
  */
 static inline void tst_fzsync_pair_reset(struct tst_fzsync_pair *pair,
 				  void *(*run_b)(void *))
 {
+	struct timespec now;
+	int i;
+
 	tst_fzsync_pair_cleanup(pair);
 
 	tst_init_stat(&pair->diff_ss);
@@ -231,18 +370,71 @@ static inline void tst_fzsync_pair_reset(struct tst_fzsync_pair *pair,
 	pair->delay = 0;
 	pair->delay_bias = 0;
 	pair->sampling = pair->min_samples;
+	pair->delay_bin = -1;
+	pair->hits = 0;
+	memset(pair->bin_hits, 0, sizeof(pair->bin_hits));
+	pair->bin_total = 0;
+	pair->profile_dirty = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pair->rand[0] = now.tv_nsec;
+	pair->rand[1] = now.tv_nsec >> 16;
+	pair->rand[2] = (uintptr_t)pair >> 4;
+
+	/* Statistics are close to converged, just verify them */
+	if (tst_fzsync_profile_load(pair))
+		pair->sampling = MAX(pair->min_samples / 16, 20);
 
 	pair->exec_loop = 0;
 
 	pair->a_cntr = 0;
 	pair->b_cntr = 0;
 	pair->exit = 0;
-	if (run_b)
-		SAFE_PTHREAD_CREATE(&pair->thread_b, 0, run_b, 0);
+
+	for (i = 0; i < pair->extra; i++) {
+		pair->x[i].pair = pair;
+		pair->x[i].a_cntr = 0;
+		pair->x[i].x_cntr = 0;
+		pair->x[i].delay = 0;
+	}
+
+	if (pair->nr_cpus)
+		tst_fzsync_pin_thread(0, pair->cpus[0]);
+
+	if (run_b) {
+		SAFE_PTHREAD_CREATE(&pair->thread_b, 0, run_b, pair);
+		if (pair->nr_cpus > 1)
+			tst_fzsync_pin_thread(pair->thread_b, pair->cpus[1]);
+	}
 
 	pair->exec_time_start = (float)tst_remaining_runtime();
 }
 
+/**
+ * tst_fzsync_pair_reset_x() - Reset fzsync and start the extra threads.
+ * @pair: Fuzzy sync pair.
+ * @run_b: Thread B function pointer.
+ * @run_x: Extra thread function pointer, gets pointer to its
+ *     struct tst_fzsync_extra as a parameter.
+ *
+ * Same as tst_fzsync_pair_reset() but also starts pair->extra threads
+ * running run_x.
+ */
+static inline void tst_fzsync_pair_reset_x(struct tst_fzsync_pair *pair,
+					   void *(*run_b)(void *),
+					   void *(*run_x)(void *))
+{
+	int i;
+
+	tst_fzsync_pair_reset(pair, run_b);
+
+	for (i = 0; i < pair->extra; i++) {
+		SAFE_PTHREAD_CREATE(&pair->x[i].thread, 0, run_x, &pair->x[i]);
+		if (pair->nr_cpus > 2 + i)
+			tst_fzsync_pin_thread(pair->x[i].thread, pair->cpus[2 + i]);
+	}
+}
+
 /**
  * tst_fzsync_stat_info() - Print stat.
  * @stat: Stat to print.
@@ -263,8 +455,8 @@ static inline void tst_fzsync_stat_info(struct tst_fzsync_stat stat,
  */
 static inline void tst_fzsync_pair_info(struct tst_fzsync_pair *pair)
 {
-	tst_res(TINFO, "loop = %d, delay_bias = %d",
-		pair->exec_loop, pair->delay_bias);
+	tst_res(TINFO, "loop = %d, delay_bias = %d, hits = %u",
+		pair->exec_loop, pair->delay_bias, pair->hits);
 	tst_fzsync_stat_info(pair->diff_ss, "ns", "start_a - start_b");
 	tst_fzsync_stat_info(pair->diff_sa, "ns", "end_a - start_a");
 	tst_fzsync_stat_info(pair->diff_sb, "ns", "end_b - start_b");
@@ -331,6 +523,28 @@ static inline void tst_upd_diff_stat(struct tst_fzsync_stat *s,
 	tst_upd_stat(s, alpha, tst_timespec_diff_ns(t1, t2));
 }
 
+/**
+ * tst_fzsync_delay_pos() - Pick a random position in the delay range.
+ * @pair: Fuzzy sync pair.
+ *
+ * Return: Position in range [0, 1), weighted by the hit histogram.
+ */
+static inline float tst_fzsync_delay_pos(struct tst_fzsync_pair *pair)
+{
+	float r = erand48(pair->rand) * (pair->bin_total + TST_FZSYNC_BINS);
+	int bin;
+
+	for (bin = 0; bin < TST_FZSYNC_BINS - 1; bin++) {
+		r -= pair->bin_hits[bin] + 1;
+		if (r < 0)
+			break;
+	}
+
+	pair->delay_bin = bin;
+
+	return (bin + erand48(pair->rand)) / TST_FZSYNC_BINS;
+}
+
 /**
  * tst_fzsync_pair_update() - Calculate various statistics and the delay.
  * @pair: Fuzzy sync pair.
@@ -390,7 +604,11 @@ static inline void tst_upd_diff_stat(struct tst_fzsync_stat *s,
  * The delay range is chosen so that any point in Syscall A could be
  * synchronised with any point in Syscall B using a value from the
  * range. Because the delay range may be too large for a linear search, we use
- * an evenly distributed random function to pick a value from it.
+ * a random function to pick a value from it. The range is split into
+ * TST_FZSYNC_BINS slices, each slice is picked with probability proportional
+ * to the number of hits reported in it plus one, so the distribution is even
+ * until tst_fzsync_pair_hit() is called and then concentrates on the slices
+ * that hit the race while still exploring the rest of the range.
  *
  * The delay range goes from positive to negative. A negative delay will delay
  * thread A and a positive one will delay thread B. The range is bounded by
@@ -418,6 +636,10 @@ static inline void tst_upd_diff_stat(struct tst_fzsync_stat *s,
  * period is ended. On all further iterations a random delay is calculated and
  * applied, but the averages are not updated.
  *
+ * Extra threads are synchronised with the start of thread A and each of them
+ * gets a random delay from range of the same length, so that its race
+ * region can be aligned with any point of Syscall A.
+ *
  * [1] This assumes there is always a significant difference. The algorithm
  * may fail to introduce a delay (when one is needed) in situations where
  * Syscall A and B finish at approximately the same time.
@@ -427,9 +649,13 @@ static inline void tst_fzsync_pair_update(struct tst_fzsync_pair *pair)
 	float alpha = pair->avg_alpha;
 	float per_spin_time, time_delay;
 	float max_dev = pair->max_dev_ratio;
-	int over_max_dev;
+	int over_max_dev, i;
 
 	pair->delay = pair->delay_bias;
+	pair->delay_bin = -1;
+
+	for (i = 0; i < pair->extra; i++)
+		pair->x[i].delay = 0;
 
 	over_max_dev = pair->diff_ss.dev_ratio > max_dev
 		|| pair->diff_sa.dev_ratio > max_dev
@@ -450,13 +676,21 @@ static inline void tst_fzsync_pair_update(struct tst_fzsync_pair *pair)
 		if (pair->sampling > 0 && --pair->sampling == 0) {
 			tst_res(TINFO, "Minimum sampling period ended");
 			tst_fzsync_pair_info(pair);
+			pair->profile_dirty = 1;
 		}
 	} else if (fabsf(pair->diff_ab.avg) >= 1) {
 		per_spin_time = fabsf(pair->diff_ab.avg) / MAX(pair->spins_avg.avg, 1.0f);
-		time_delay = drand48() * (pair->diff_sa.avg + pair->diff_sb.avg)
+		time_delay = tst_fzsync_delay_pos(pair)
+			* (pair->diff_sa.avg + pair->diff_sb.avg)
 			- pair->diff_sb.avg;
 		pair->delay += (int)(1.1 * time_delay / per_spin_time);
 
+		for (i = 0; i < pair->extra; i++) {
+			time_delay = erand48(pair->rand)
+				* (pair->diff_sa.avg + pair->diff_sb.avg);
+			pair->x[i].delay = (int)(1.1 * time_delay / per_spin_time);
+		}
+
 		if (!pair->sampling) {
 			tst_res(TINFO,
 				"Reached deviation ratios < %.2f, introducing randomness",
@@ -566,8 +800,15 @@ static inline void tst_fzsync_pair_wait(int *our_cntr,
  */
 static inline void tst_fzsync_wait_a(struct tst_fzsync_pair *pair)
 {
+	int i;
+
 	tst_fzsync_pair_wait(&pair->a_cntr, &pair->b_cntr,
 			     NULL, &pair->exit, pair->yield_in_wait);
+
+	for (i = 0; i < pair->extra; i++) {
+		tst_fzsync_pair_wait(&pair->x[i].a_cntr, &pair->x[i].x_cntr,
+				     NULL, &pair->exit, pair->yield_in_wait);
+	}
 }
 
 /**
@@ -674,9 +915,16 @@ static inline void tst_fzsync_start_race_a(struct tst_fzsync_pair *pair)
  */
 static inline void tst_fzsync_end_race_a(struct tst_fzsync_pair *pair)
 {
+	int i;
+
 	tst_fzsync_time(&pair->a_end);
 	tst_fzsync_pair_wait(&pair->a_cntr, &pair->b_cntr,
 			     &pair->spins, &pair->exit, pair->yield_in_wait);
+
+	for (i = 0; i < pair->extra; i++) {
+		tst_fzsync_pair_wait(&pair->x[i].a_cntr, &pair->x[i].x_cntr,
+				     NULL, &pair->exit, pair->yield_in_wait);
+	}
 }
 
 /**
@@ -714,6 +962,60 @@ static inline void tst_fzsync_end_race_b(struct tst_fzsync_pair *pair)
 			     &pair->spins, &pair->exit, pair->yield_in_wait);
 }
 
+/**
+ * tst_fzsync_wait_x() - Wait in an extra thread.
+ * @x: Extra thread state.
+ */
+static inline void tst_fzsync_wait_x(struct tst_fzsync_extra *x)
+{
+	tst_fzsync_pair_wait(&x->x_cntr, &x->a_cntr,
+			     NULL, &x->pair->exit, x->pair->yield_in_wait);
+}
+
+/**
+ * tst_fzsync_run_x() - Decide whether to continue running an extra thread.
+ * @x: Extra thread state.
+ *
+ * Return: Non-zero to continue, 0 to stop.
+ */
+static inline int tst_fzsync_run_x(struct tst_fzsync_extra *x)
+{
+	tst_fzsync_wait_x(x);
+	return !tst_atomic_load(&x->pair->exit);
+}
+
+/**
+ * tst_fzsync_start_race_x() - Mark the start of a race region in an extra
+ * thread.
+ * @x: Extra thread state.
+ */
+static inline void tst_fzsync_start_race_x(struct tst_fzsync_extra *x)
+{
+	volatile int delay;
+
+	tst_fzsync_wait_x(x);
+
+	delay = x->delay;
+	if (x->pair->yield_in_wait) {
+		while (delay > 0) {
+			sched_yield();
+			delay--;
+		}
+	} else {
+		while (delay > 0)
+			delay--;
+	}
+}
+
+/**
+ * tst_fzsync_end_race_x() - Mark the end of a race region in an extra thread.
+ * @x: Extra thread state.
+ */
+static inline void tst_fzsync_end_race_x(struct tst_fzsync_extra *x)
+{
+	tst_fzsync_wait_x(x);
+}
+
 /**
  * tst_fzsync_pair_add_bias() - Add some amount to the delay bias.
  * @pair: Fuzzy sync pair.
@@ -743,4 +1045,41 @@ static inline void tst_fzsync_pair_add_bias(struct tst_fzsync_pair *pair, int ch
 		pair->delay_bias += change;
 }
 
+/**
+ * tst_fzsync_pair_hit() - Report that the race window was hit.
+ * @pair: Fuzzy sync pair.
+ *
+ * Call this from thread A after tst_fzsync_end_race_a() when the test
+ * detected that the current iteration hit the race. The delay used in the
+ * iteration is accounted in the hit histogram, which is used to pick the
+ * following delays and is stored in the profile.
+ */
+static inline void tst_fzsync_pair_hit(struct tst_fzsync_pair *pair)
+{
+	pair->hits++;
+
+	if (pair->delay_bin < 0)
+		return;
+
+	pair->bin_hits[pair->delay_bin]++;
+	pair->bin_total++;
+	pair->profile_dirty = 1;
+}
+
+/**
+ * tst_fzsync_pair_overlap() - Check whether the race regions overlapped.
+ * @pair: Fuzzy sync pair.
+ *
+ * Call this from thread A after tst_fzsync_end_race_a(). It is meant as a hit
+ * criterion for races that leave no trace observable from user space.
+ *
+ * Return: Non-zero if the race regions of thread A and B overlapped in the
+ * current iteration.
+ */
+static inline int tst_fzsync_pair_overlap(struct tst_fzsync_pair *pair)
+{
+	return tst_timespec_lt(pair->b_start, pair->a_end) &&
+	       tst_timespec_lt(pair->a_start, pair->b_end);
+}
+
 #endif /* TST_FUZZY_SYNC_H__ */
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/**
+ * DOC: Log-linear histogram buckets
+ *
+ * Bucket mapping for HDR style histograms with constant memory. Values below
+ * 2^sub_bits have their own bucket, larger values are split into 2^sub_bits
+ * buckets per power of two, so a bucket spans less than 1/2^sub_bits of the
+ * values counted in it.
+ *
+ * The counters are left to the users, which differ in the counter types and
+ * in how the histograms are shared between threads or processes.
+ */
+
+#ifndef TST_HDR_HIST_H__
+#define TST_HDR_HIST_H__
+
+#include <stdint.h>
+
+/*
+ * Number of buckets for values below 2^max_bits, larger values have to be
+ * clamped to the last bucket by the caller. Use max_bits 64 to cover all
+ * uint64_t values.
+ */
+#define TST_HDR_BUCKETS(sub_bits, max_bits) \
+	(((max_bits) - (sub_bits) + 1) << (sub_bits))
+
+static inline unsigned int tst_hdr_bucket(uint64_t val, unsigned int sub_bits)
+{
+	uint64_t sub = 1ULL << sub_bits;
+	unsigned int e;
+
+	if (val < sub)
+		return val;
+
+	e = 63 - __builtin_clzll(val);
+
+	return ((e - sub_bits + 1) << sub_bits) +
+		((val >> (e - sub_bits)) & (sub - 1));
+}
+
+/* The lowest value counted in the bucket */
+static inline uint64_t tst_hdr_bucket_low(unsigned int b, unsigned int sub_bits)
+{
+	unsigned int sub = 1U << sub_bits;
+
+	if (b < sub)
+		return b;
+
+	return (uint64_t)(sub + b % sub) << (b / sub - 1);
+}
+
+/* The highest value counted in the bucket */
+static inline uint64_t tst_hdr_bucket_high(unsigned int b, unsigned int sub_bits)
+{
+	unsigned int sub = 1U << sub_bits;
+
+	if (b < sub)
+		return b;
+
+	return tst_hdr_bucket_low(b, sub_bits) + (1ULL << (b / sub - 1)) - 1;
+}
+
+#endif /* TST_HDR_HIST_H__ */
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/**
+ * DOC: Memory counters sampler
+ *
+ * When struct tst_test.memstat is set the test library forks a sampler
+ * process before the test starts. It reads the selected /proc/vmstat,
+ * /proc/meminfo and /proc/zoneinfo counters at a fixed interval into a
+ * preallocated ring in shared memory until the test exits. The test can
+ * query the current values and rates while it runs and the recorded time
+ * series is printed when the test fails or breaks.
+ *
+ * Counters are named with the source file prefix:
+ *
+ * - "vmstat:<name>" e.g. "vmstat:pswpout" or "vmstat:thp_fault_alloc"
+ * - "meminfo:<name>" e.g. "meminfo:SwapFree", the value is in kB
+ * - "zoneinfo:<zone>:<name>" e.g. "zoneinfo:Normal:nr_free_pages", summed
+ *   over all NUMA nodes, zone "*" sums all zones
+ *
+ * Example::
+ *
+ *   static struct tst_test test = {
+ *           ...
+ *           .memstat = &(const struct tst_memstat_conf) {
+ *                   .counters = (const char *const []) {
+ *                           "vmstat:pswpout",
+ *                           "meminfo:SwapFree",
+ *                           NULL
+ *                   },
+ *           },
+ *   };
+ *
+ *   tst_res(TINFO, "Swapping out %.0f pages/s",
+ *           tst_memstat_rate("vmstat:pswpout", 1000));
+ */
+
+#ifndef TST_MEMSTAT_H__
+#define TST_MEMSTAT_H__
+
+/**
+ * struct tst_memstat_conf - Memory counters sampler configuration.
+ *
+ * @counters: A NULL terminated array of counter names.
+ * @interval_ms: Sampling interval, defaults to 100ms.
+ * @samples: Number of samples kept in the ring, defaults to 1024.
+ */
+struct tst_memstat_conf {
+	const char *const *counters;
+	unsigned int interval_ms;
+	unsigned int samples;
+};
+
+/*
+ * Starts and stops the sampler process, called by the test library.
+ */
+void tst_memstat_start(const struct tst_memstat_conf *conf);
+void tst_memstat_stop(void);
+
+/**
+ * tst_memstat_value() - Returns the last sampled value of a counter.
+ *
+ * @counter: Counter name as listed in the configuration.
+ *
+ * Return: The counter value or -1 if the counter is not provided by the
+ *         kernel.
+ */
+long long tst_memstat_value(const char *counter);
+
+/**
+ * tst_memstat_rate() - Returns the average rate of a counter change.
+ *
+ * @counter: Counter name as listed in the configuration.
+ * @window_ms: Time window ending at the last sample, zero for the whole
+ *             recorded time series.
+ *
+ * Return: Change of the counter per second, the window is shortened to the
+ *         oldest sample in the ring. Zero if there are less than two samples
+ *         or if the counter is not provided by the kernel.
+ */
+double tst_memstat_rate(const char *counter, unsigned int window_ms);
+
+/**
+ * tst_memstat_dump() - Prints the recorded time series.
+ *
+ * @count: Maximal number of the most recent samples to print.
+ *
+ * Each line has the time since the sampler start, vmstat counters are
+ * printed as differences from the previous sample, meminfo and zoneinfo
+ * counters as values.
+ */
+void tst_memstat_dump(unsigned int count);
+
+#endif /* TST_MEMSTAT_H__ */
@@ -13,9 +13,13 @@
  * that a vulnerable kernel will leak a block of memory that was full of
  * zeroes by chance.
  *
- * The function keeps a safety margin to avoid invoking OOM killer and
- * respects the limitations of available address space. (Less than 3GB can be
- * polluted on a 32bit system regardless of available physical RAM.)
+ * The function keeps a safety margin to avoid invoking OOM killer.
+ *
+ * The memory is filled by one child process per CPU, on NUMA systems each
+ * node gets a share proportional to its free memory which is filled from
+ * the node CPUs. Each child stops at its first failed mapping, so the
+ * address space limit (less than 3GB on a 32bit system) applies to each
+ * child's share rather than to the total.
  */
 void tst_pollute_memory(size_t maxsize, int fillchar);
 
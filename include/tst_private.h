@@ -10,6 +10,7 @@
 #ifndef TST_PRIVATE_H_
 #define TST_PRIVATE_H_
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <netdb.h>
 #include "tst_defaults.h"
@@ -59,4 +60,17 @@ bool tst_check_cmd(const char *cmd, const int brk_nosupp);
  */
 const char **tst_get_supported_fs_types(const char *const *skiplist);
 
+/*
+ * Removes the content of a directory in parallel, batching unlinkat() via
+ * io_uring when available. The directory itself is removed when rm_path is
+ * set. Returns -1 and sets errmsg on failure, does not call tst_brk().
+ */
+int tst_purge_dir_fast(const char *path, int rm_path, char **errmsg);
+
+/*
+ * Renames the directory aside and removes it with tst_purge_dir_fast() in a
+ * detached process, so that the caller does not wait for the removal.
+ */
+int tst_purge_dir_async(const char *path, char **errmsg);
+
 #endif
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/**
+ * DOC: Pressure stall and memory cgroup event triggers
+ *
+ * Allows tests to block until memory pressure builds up or until a memory
+ * cgroup event such as oom_kill is counted instead of polling /proc/meminfo
+ * or cgroup files in sleep loops. The time from arming the trigger to the
+ * event is measured as well.
+ *
+ * PSI triggers are armed on /proc/pressure/<resource> or, if a cgroup is
+ * passed, on the cgroup <resource>.pressure file. Events are watched on the
+ * cgroup v2 memory.events file.
+ */
+
+#ifndef TST_PSI_H__
+#define TST_PSI_H__
+
+#include <sys/types.h>
+#include <time.h>
+#include "tst_cgroup.h"
+
+struct tst_psi_event {
+	int fd;
+	/* memory.events key, NULL for PSI triggers */
+	const char *key;
+	long long count;
+	struct timespec start;
+	/* Time to the event in microseconds, set by tst_psi_wait() */
+	long long time_us;
+};
+
+#define TST_PSI_EVENT_INIT {.fd = -1}
+
+/**
+ * tst_psi_arm() - Arms a PSI trigger.
+ *
+ * @ev: Event to initialize.
+ * @cg: CGroup to watch, NULL for system wide pressure.
+ * @resource: "memory", "io" or "cpu".
+ * @full: Trigger on the full instead of some stall.
+ * @stall_us: Stall time in the window which fires the trigger.
+ * @window_us: Window size, between 500ms and 10s. Without CAP_SYS_RESOURCE
+ *             the window has to be a multiple of 2s.
+ *
+ * Return: Zero on success, -1 if PSI is not supported. Other errors are
+ * fatal.
+ */
+int tst_psi_arm(struct tst_psi_event *ev, const struct tst_cg_group *cg,
+		const char *resource, int full, unsigned int stall_us,
+		unsigned int window_us);
+
+/**
+ * tst_psi_arm_events() - Starts watching a memory.events counter.
+ *
+ * @ev: Event to initialize.
+ * @cg: CGroup to watch, the memory controller has to be on cgroup v2.
+ * @key: Counter name e.g. "oom_kill", "high" or "max".
+ *
+ * Return: Zero on success, -1 if memory.events is not available. Other
+ * errors are fatal.
+ */
+int tst_psi_arm_events(struct tst_psi_event *ev, const struct tst_cg_group *cg,
+		       const char *key);
+
+/**
+ * tst_psi_wait() - Waits for an armed event.
+ *
+ * @ev: Armed event.
+ * @timeout_ms: Timeout in milliseconds, negative value means no timeout.
+ *
+ * On success ev->time_us is set to the time since the event was armed or
+ * since the previous event was reported. PSI triggers fire at most once
+ * per window while the stall persists.
+ *
+ * Return: 1 if the event fired, 0 on timeout.
+ */
+int tst_psi_wait(struct tst_psi_event *ev, int timeout_ms);
+
+/**
+ * tst_psi_wait_pid() - Waits for an armed event or a child exit.
+ *
+ * @ev: Armed event.
+ * @pid: Child that is expected to cause the event, it is not reaped.
+ * @timeout_ms: Timeout in milliseconds, negative value means no timeout.
+ *
+ * Same as tst_psi_wait() but also returns when the child exits first.
+ *
+ * Return: 1 if the event fired, 0 on timeout or if the child exited.
+ */
+int tst_psi_wait_pid(struct tst_psi_event *ev, pid_t pid, int timeout_ms);
+
+/**
+ * tst_psi_disarm() - Closes the event file descriptor.
+ *
+ * @ev: Event, may be disarmed already.
+ */
+void tst_psi_disarm(struct tst_psi_event *ev);
+
+#endif /* TST_PSI_H__ */
@@ -45,6 +45,7 @@
 #include "tst_security.h"
 #include "tst_taint.h"
 #include "tst_memutils.h"
+#include "tst_memstat.h"
 #include "tst_arch.h"
 #include "tst_fd.h"
 #include "tst_tmpdir.h"
@@ -241,6 +242,12 @@ struct tst_tag {
 
 extern unsigned int tst_variant;
 
+/*
+ * Index of the currently executed test, i.e. the parameter passed to the
+ * tst_test.test() function, -1 for tst_test.test_all().
+ */
+extern int tst_tcase;
+
 #define TST_UNLIMITED_TIMEOUT (-1)
 
 /**
@@ -548,6 +555,10 @@ struct tst_fs {
  *
  * @needs_cgroup_nsdelegate: If set test the will run only if cgroup2 is mounted
  *                           with nsdelegate option.
+ *
+ * @memstat: If set the library samples the selected vmstat, meminfo and
+ *           zoneinfo counters in the background while the test runs. See
+ *           struct tst_memstat_conf and tst_memstat_rate() for details.
  */
 
  struct tst_test {
@@ -639,6 +650,8 @@ struct tst_fs {
 	const char *const *needs_cgroup_ctrls;
 
 	unsigned int needs_cgroup_nsdelegate:1;
+
+	const struct tst_memstat_conf *memstat;
 };
 
 /**
@@ -22,11 +22,16 @@ tst_checkpoint
 tst_checkpoint_parent
 tst_checkpoint_wait_timeout
 tst_checkpoint_wake_timeout
+tst_crc32c01
 tst_device
 tst_expiration_timer
 tst_filesystems01
-tst_fuzzy_sync0[1-3]
+tst_fill_fs01
+tst_fuzzy_sync0[1-4]
 tst_needs_cmds0[1-36-8]
+tst_memstat01
+tst_psi01
+tst_psi02
 tst_res_hexd
 tst_safe_sscanf
 tst_strstatus}"
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Checks that all CRC32c implementations agree on buffers of various lengths
+ * and alignments and measures their throughput.
+ *
+ * Buffer size for the benchmark can be set with -s (default 64M).
+ */
+
+#include "tst_test.h"
+#include "tst_timer.h"
+#include "tst_checksum.h"
+
+#define CHECK_SIZE (3 * 8192 * 2 + 64)
+
+static const char *const impl_names[] = {
+	[TST_CRC32C_BYTE] = "byte",
+	[TST_CRC32C_SLICE8] = "slice-by-8",
+	[TST_CRC32C_HW] = "hardware",
+};
+
+static const size_t check_lens[] = {
+	0, 1, 7, 8, 9, 63, 255, 256, 767, 768, 769, 4096, 3 * 8192 - 1,
+	3 * 8192, 3 * 8192 + 777, 2 * 3 * 8192,
+};
+
+static char *str_size;
+static long long bench_size = 64 * 1024 * 1024;
+static uint8_t *buf;
+
+static void setup(void)
+{
+	size_t i, size;
+
+	if (tst_parse_filesize(str_size, &bench_size, 1, LONG_MAX))
+		tst_brk(TBROK, "Invalid buffer size '%s'", str_size);
+
+	size = MAX((size_t)bench_size, (size_t)CHECK_SIZE + 8);
+	buf = SAFE_MALLOC(size);
+
+	srand(0);
+	for (i = 0; i < size; i++)
+		buf[i] = rand();
+}
+
+static void cleanup(void)
+{
+	free(buf);
+}
+
+static int check_impl(enum tst_crc32c_impl impl)
+{
+	uint8_t vector[] = "123456789";
+	size_t i, off;
+	uint32_t exp, crc;
+
+	crc = tst_crc32c_with(impl, vector, 9);
+	if (crc != 0xe3069283) {
+		tst_res(TFAIL, "%s: crc32c(\"123456789\") = %08x, expected e3069283",
+			impl_names[impl], crc);
+		return 1;
+	}
+
+	for (off = 0; off < 8; off++) {
+		for (i = 0; i < ARRAY_SIZE(check_lens); i++) {
+			exp = tst_crc32c_with(TST_CRC32C_BYTE, buf + off, check_lens[i]);
+			crc = tst_crc32c_with(impl, buf + off, check_lens[i]);
+
+			if (crc != exp) {
+				tst_res(TFAIL, "%s: offset %zu length %zu crc %08x, expected %08x",
+					impl_names[impl], off, check_lens[i], crc, exp);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void bench_impl(enum tst_crc32c_impl impl)
+{
+	unsigned int iters = 0;
+	long long us;
+
+	tst_timer_start(CLOCK_MONOTONIC);
+
+	do {
+		tst_crc32c_with(impl, buf, bench_size);
+		iters++;
+		tst_timer_stop();
+	} while (tst_timer_elapsed_ms() < 500);
+
+	us = tst_timer_elapsed_us();
+
+	tst_res(TINFO, "%-10s %8.1f MB/s", impl_names[impl],
+		(double)bench_size * iters / us);
+}
+
+static void run(void)
+{
+	enum tst_crc32c_impl impl;
+	int fail = 0;
+
+	for (impl = TST_CRC32C_BYTE; impl <= TST_CRC32C_HW; impl++) {
+		if (!tst_crc32c_impl_supported(impl)) {
+			tst_res(TINFO, "%s implementation not supported",
+				impl_names[impl]);
+			continue;
+		}
+
+		fail |= check_impl(impl);
+		bench_impl(impl);
+	}
+
+	if (tst_crc32c(buf, CHECK_SIZE) !=
+	    tst_crc32c_with(TST_CRC32C_BYTE, buf, CHECK_SIZE)) {
+		tst_res(TFAIL, "tst_crc32c() differs from byte implementation");
+		fail = 1;
+	}
+
+	if (!fail)
+		tst_res(TPASS, "All CRC32c implementations agree");
+}
+
+static struct tst_test test = {
+	.setup = setup,
+	.cleanup = cleanup,
+	.test_all = run,
+	.options = (struct tst_option[]) {
+		{"s:", &str_size, "Benchmark buffer size (default 64M)"},
+		{}
+	},
+};
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Checks that TST_FILL_PARALLEL fills the filesystem, i.e. that the top-up
+ * after the parallel workers leaves less than a few blocks free and that a
+ * following write fails with ENOSPC.
+ */
+
+#include <sys/statvfs.h>
+#include "tst_test.h"
+
+#define MNTPOINT "mntpoint"
+#define MAX_FREE_BLOCKS 64
+
+static void run(void)
+{
+	struct statvfs fi;
+	char buf[4096] = {};
+	int i, fd;
+
+	tst_fill_fs(MNTPOINT, 1, TST_FILL_PARALLEL);
+
+	SAFE_STATVFS(MNTPOINT, &fi);
+
+	if (fi.f_bavail <= MAX_FREE_BLOCKS) {
+		tst_res(TPASS, "%lu blocks available after fill",
+			(unsigned long)fi.f_bavail);
+	} else {
+		tst_res(TFAIL, "%lu blocks available after fill",
+			(unsigned long)fi.f_bavail);
+	}
+
+	fd = SAFE_OPEN(MNTPOINT "/extra", O_WRONLY | O_CREAT, 0600);
+
+	/* The few blocks left over may still be written */
+	for (i = 0; i < MAX_FREE_BLOCKS + 1; i++) {
+		TEST(write(fd, buf, sizeof(buf)));
+		if (TST_RET < 0)
+			break;
+	}
+
+	if (TST_RET < 0 && TST_ERR == ENOSPC)
+		tst_res(TPASS, "write() failed with ENOSPC");
+	else if (TST_RET < 0)
+		tst_res(TFAIL | TTERRNO, "write() failed unexpectedly");
+	else
+		tst_res(TFAIL, "write() did not fail with ENOSPC");
+
+	SAFE_CLOSE(fd);
+
+	tst_purge_dir(MNTPOINT);
+}
+
+static struct tst_test test = {
+	.test_all = run,
+	.needs_root = 1,
+	.forks_child = 1,
+	.mount_device = 1,
+	.mntpoint = MNTPOINT,
+};
@@ -197,12 +197,14 @@ static void run(unsigned int i)
 		delay(a.return_t);
 		tst_fzsync_end_race_a(&pair);
 
-		if (cs == 1 && ct == 2)
+		if (cs == 1 && ct == 2) {
 			too_early++;
-		else if (cs == 3 && ct == 4)
+		} else if (cs == 3 && ct == 4) {
 			too_late++;
-		else
+		} else {
 			critical++;
+			tst_fzsync_pair_hit(&pair);
+		}
 
 		r = tst_atomic_add_return(-4, &H);
 		if (r)
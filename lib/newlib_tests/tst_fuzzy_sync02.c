@@ -158,7 +158,7 @@ static void run(unsigned int i)
 {
 	const struct window a = to_abs(races[i].a);
 	const struct window ad = to_abs(races[i].ad);
-	int critical = 0;
+	int critical = 0, hits = 0;
 	int now, fin;
 
 	tst_fzsync_pair_reset(&pair, NULL);
@@ -185,6 +185,11 @@ static void run(unsigned int i)
 		}
 		tst_fzsync_end_race_a(&pair);
 
+		if (critical > hits) {
+			hits = critical;
+			tst_fzsync_pair_hit(&pair);
+		}
+
 		if (fin == ad.return_t)
 			tst_fzsync_pair_add_bias(&pair, 1);
 
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+/*
+ * Test three way races and several pairs running in parallel.
+ *
+ * Each pair consists of thread A, thread B and one extra thread. Each thread
+ * increments the pair counter when it enters its critical section and
+ * decrements it when it leaves. Thread A checks the counter at the end of its
+ * critical section, the race is hit when all three critical sections
+ * overlap. The critical sections are placed so that they only overlap when
+ * the right delays are introduced.
+ */
+
+#include "tst_test.h"
+#include "tst_fuzzy_sync.h"
+
+#define TIME_SCALE(x) ((x) * (x) * (x))
+
+struct window {
+	const int critical_s;
+	const int critical_t;
+	const int return_t;
+};
+
+static const struct window a = { 2, 1, 0 };
+static const struct window b = { 0, 1, 2 };
+static const struct window x = { 1, 1, 1 };
+
+static struct tst_fzsync_pair *pairs;
+static tst_atomic_t *counters;
+static unsigned int nr_pairs;
+
+static void delay(const int t)
+{
+	int k = TIME_SCALE(t);
+
+	while (k--)
+		sched_yield();
+}
+
+static tst_atomic_t *pair_counter(struct tst_fzsync_pair *pair)
+{
+	return &counters[pair - pairs];
+}
+
+static void race(const struct window *w, tst_atomic_t *h)
+{
+	delay(w->critical_s);
+	tst_atomic_add_return(1, h);
+	delay(w->critical_t);
+	tst_atomic_add_return(-1, h);
+	delay(w->return_t);
+}
+
+static void *worker_b(void *v)
+{
+	struct tst_fzsync_pair *pair = v;
+	tst_atomic_t *h = pair_counter(pair);
+
+	while (tst_fzsync_run_b(pair)) {
+		tst_fzsync_start_race_b(pair);
+		race(&b, h);
+		tst_fzsync_end_race_b(pair);
+	}
+
+	return NULL;
+}
+
+static void *worker_x(void *v)
+{
+	struct tst_fzsync_extra *ex = v;
+	tst_atomic_t *h = pair_counter(ex->pair);
+
+	while (tst_fzsync_run_x(ex)) {
+		tst_fzsync_start_race_x(ex);
+		race(&x, h);
+		tst_fzsync_end_race_x(ex);
+	}
+
+	return NULL;
+}
+
+static void *run_a(void *v)
+{
+	struct tst_fzsync_pair *pair = v;
+	tst_atomic_t *h = pair_counter(pair);
+	int critical = 0;
+
+	tst_fzsync_pair_reset_x(pair, worker_b, worker_x);
+
+	while (tst_fzsync_run_a(pair)) {
+		tst_fzsync_start_race_a(pair);
+		delay(a.critical_s);
+		tst_atomic_add_return(1, h);
+		delay(a.critical_t);
+
+		if (tst_atomic_load(h) == 3) {
+			critical++;
+			tst_fzsync_pair_hit(pair);
+		}
+
+		tst_atomic_add_return(-1, h);
+		delay(a.return_t);
+		tst_fzsync_end_race_a(pair);
+
+		if (critical > 100) {
+			tst_fzsync_pair_cleanup(pair);
+			tst_atomic_store(0, &pair->exit);
+			break;
+		}
+	}
+
+	/* See tst_fuzzy_sync01.c for why exit is not a failure */
+	if (pair->exit) {
+		tst_res(TCONF, "Pair %li may not be able to generate a valid result",
+			pair - pairs);
+		return NULL;
+	}
+
+	tst_res(critical > 50 ? TPASS : TFAIL, "Pair %li | =:%-4d",
+		pair - pairs, critical);
+
+	return NULL;
+}
+
+static void setup(void)
+{
+	unsigned int i;
+
+	nr_pairs = tst_fzsync_multi_count(1);
+	pairs = SAFE_CALLOC(nr_pairs, sizeof(*pairs));
+	counters = SAFE_CALLOC(nr_pairs, sizeof(*counters));
+
+	tst_res(TINFO, "Running %u pairs", nr_pairs);
+
+	for (i = 0; i < nr_pairs; i++) {
+		pairs[i].extra = 1;
+		tst_fzsync_pair_init(&pairs[i]);
+	}
+}
+
+static void cleanup(void)
+{
+	unsigned int i;
+
+	if (!pairs)
+		return;
+
+	for (i = 0; i < nr_pairs; i++)
+		tst_fzsync_pair_cleanup(&pairs[i]);
+
+	free(pairs);
+	free(counters);
+}
+
+static void run(void)
+{
+	tst_fzsync_multi_run(pairs, nr_pairs, run_a);
+}
+
+static struct tst_test test = {
+	.test_all = run,
+	.setup = setup,
+	.cleanup = cleanup,
+	.runtime = 150,
+};
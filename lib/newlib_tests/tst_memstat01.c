@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Checks that the memory counters sampler records page faults caused by the
+ * test and that unknown counters are reported as not available.
+ */
+
+#include "tst_test.h"
+
+#define BUF_SIZE (64 * 1024 * 1024)
+
+static void run(void)
+{
+	char *buf;
+	long long free_pages;
+	double rate;
+
+	buf = SAFE_MMAP(NULL, BUF_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	memset(buf, 1, BUF_SIZE);
+	usleep(300000);
+	SAFE_MUNMAP(buf, BUF_SIZE);
+
+	rate = tst_memstat_rate("vmstat:pgfault", 1000);
+	if (rate > 0)
+		tst_res(TPASS, "pgfault rate %.0f/s", rate);
+	else
+		tst_res(TFAIL, "pgfault rate %.0f/s", rate);
+
+	free_pages = tst_memstat_value("zoneinfo:*:nr_free_pages");
+	if (free_pages > 0)
+		tst_res(TPASS, "nr_free_pages %lli", free_pages);
+	else
+		tst_res(TFAIL, "nr_free_pages %lli", free_pages);
+
+	TST_EXP_EQ_LI(tst_memstat_value("vmstat:no_such_counter"), -1);
+	TST_EXP_EXPR(tst_memstat_value("meminfo:MemFree") > 0);
+
+	tst_memstat_dump(5);
+}
+
+static struct tst_test test = {
+	.test_all = run,
+	.memstat = &(const struct tst_memstat_conf) {
+		.interval_ms = 50,
+		.counters = (const char *const []) {
+			"vmstat:pgfault",
+			"vmstat:no_such_counter",
+			"meminfo:MemFree",
+			"zoneinfo:*:nr_free_pages",
+			NULL
+		},
+	},
+};
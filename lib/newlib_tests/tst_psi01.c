@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Checks that tst_psi_wait() honours the timeout and that tst_psi_wait_pid()
+ * returns early once the child exits, the system should be idle.
+ */
+
+#include <stdlib.h>
+#include "tst_test.h"
+#include "tst_timer.h"
+#include "tst_psi.h"
+
+static struct tst_psi_event ev = TST_PSI_EVENT_INIT;
+
+static void setup(void)
+{
+	if (tst_psi_arm(&ev, NULL, "memory", 1, 500000, 2000000))
+		tst_brk(TCONF, "Memory PSI triggers are not supported");
+}
+
+static void cleanup(void)
+{
+	tst_psi_disarm(&ev);
+}
+
+static void run(void)
+{
+	long long ms;
+	pid_t pid;
+	int ret;
+
+	tst_timer_start(CLOCK_MONOTONIC);
+	ret = tst_psi_wait(&ev, 300);
+	tst_timer_stop();
+	ms = tst_timer_elapsed_ms();
+
+	if (ret || ms < 300)
+		tst_res(TFAIL, "tst_psi_wait() returned %i after %lli ms", ret, ms);
+	else
+		tst_res(TPASS, "tst_psi_wait() timed out after %lli ms", ms);
+
+	pid = SAFE_FORK();
+	if (!pid) {
+		usleep(100000);
+		exit(0);
+	}
+
+	tst_timer_start(CLOCK_MONOTONIC);
+	ret = tst_psi_wait_pid(&ev, pid, 10000);
+	tst_timer_stop();
+	ms = tst_timer_elapsed_ms();
+	SAFE_WAITPID(pid, NULL, 0);
+
+	if (ret || ms >= 10000)
+		tst_res(TFAIL, "tst_psi_wait_pid() returned %i after %lli ms", ret, ms);
+	else
+		tst_res(TPASS, "tst_psi_wait_pid() returned on exit after %lli ms", ms);
+}
+
+static struct tst_test test = {
+	.setup = setup,
+	.cleanup = cleanup,
+	.test_all = run,
+	.forks_child = 1,
+	.needs_root = 1,
+};
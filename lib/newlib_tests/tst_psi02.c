@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Checks that memory.events triggers fire on a real event: a child in the
+ * test cgroup allocates past memory.max, which has to be counted as "max"
+ * and end with an OOM kill counted as "oom_kill".
+ */
+
+#include <stdlib.h>
+#include "tst_test.h"
+#include "tst_psi.h"
+
+#define MEM_MAX (32 * 1024 * 1024)
+#define CHUNK (1024 * 1024)
+
+static struct tst_psi_event max_ev = TST_PSI_EVENT_INIT;
+static struct tst_psi_event oom_ev = TST_PSI_EVENT_INIT;
+
+static void setup(void)
+{
+	SAFE_CG_PRINTF(tst_cg, "memory.max", "%d", MEM_MAX);
+
+	if (SAFE_CG_HAS(tst_cg, "memory.swap.max"))
+		SAFE_CG_PRINT(tst_cg, "memory.swap.max", "0");
+}
+
+static void cleanup(void)
+{
+	tst_psi_disarm(&max_ev);
+	tst_psi_disarm(&oom_ev);
+}
+
+static void alloc_past_max(void)
+{
+	char *buf;
+	int i;
+
+	SAFE_CG_PRINTF(tst_cg, "cgroup.procs", "%d", getpid());
+
+	for (i = 0; i < 4 * MEM_MAX / CHUNK; i++) {
+		buf = SAFE_MMAP(NULL, CHUNK, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		memset(buf, 1, CHUNK);
+	}
+
+	exit(0);
+}
+
+static void run(void)
+{
+	pid_t pid;
+	int status;
+
+	if (tst_psi_arm_events(&max_ev, tst_cg, "max") ||
+	    tst_psi_arm_events(&oom_ev, tst_cg, "oom_kill"))
+		tst_brk(TCONF, "memory.events is not available");
+
+	pid = SAFE_FORK();
+	if (!pid)
+		alloc_past_max();
+
+	if (tst_psi_wait_pid(&max_ev, pid, 10000))
+		tst_res(TPASS, "max event after %lli ms", max_ev.time_us / 1000);
+	else
+		tst_res(TFAIL, "max event did not fire");
+
+	if (tst_psi_wait(&oom_ev, 10000))
+		tst_res(TPASS, "oom_kill event after %lli ms", oom_ev.time_us / 1000);
+	else
+		tst_res(TFAIL, "oom_kill event did not fire");
+
+	SAFE_WAITPID(pid, &status, 0);
+
+	if (WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL)
+		tst_res(TPASS, "Child was OOM killed");
+	else
+		tst_res(TFAIL, "Child %s", tst_strstatus(status));
+
+	tst_psi_disarm(&max_ev);
+	tst_psi_disarm(&oom_ev);
+}
+
+static struct tst_test test = {
+	.setup = setup,
+	.cleanup = cleanup,
+	.test_all = run,
+	.forks_child = 1,
+	.needs_root = 1,
+	.needs_cgroup_ver = TST_CG_V2,
+	.needs_cgroup_ctrls = (const char *const []){ "memory", NULL },
+};
@@ -1,8 +1,30 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 /* Copyright (c) 2018 Oracle and/or its affiliates. All Rights Reserved. */
 
+/*
+ * CRC32c is computed with the crc32 instructions on x86_64 (SSE4.2) and
+ * arm64 (CRC extension) when the CPU supports them and with slice-by-8
+ * tables otherwise.
+ *
+ * A single crc32 instruction stream is bound by the instruction latency,
+ * the hardware implementation therefore checksums three adjacent blocks in
+ * parallel and then combines the partial checksums. Shifting a checksum over
+ * a block of zeroes is a linear operation which is precomputed into tables
+ * for the two block sizes used, see crc32c_zeros().
+ */
+
+#include <string.h>
+
+#ifdef __aarch64__
+# include <sys/auxv.h>
+#endif
+
+#define TST_NO_DEFAULT_MAIN
+#include "tst_test.h"
 #include "tst_checksum.h"
 
+#define CRC32C_POLY 0x82f63b78
+
 static const uint32_t crc32c_table[] = {
 	0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4,
 	0xc79a971f, 0x35f1141c, 0x26a1e7e8, 0xd4ca64eb,
@@ -70,12 +92,298 @@ static const uint32_t crc32c_table[] = {
 	0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351,
 };
 
+/* crc32c_slice[0] is a copy of crc32c_table */
+static uint32_t crc32c_slice[8][256];
+
+static uint32_t crc32c_byte(uint32_t crc, const uint8_t *buf, size_t len)
+{
+	while (len--)
+		crc = crc32c_table[(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+static uint32_t crc32c_slice8(uint32_t crc, const uint8_t *buf, size_t len)
+{
+	uint32_t hi;
+
+	while (len && ((uintptr_t)buf & 7)) {
+		crc = crc32c_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+
+	for (; len >= 8; buf += 8, len -= 8) {
+		crc ^= buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+		hi = buf[4] | buf[5] << 8 | buf[6] << 16 | (uint32_t)buf[7] << 24;
+
+		crc = crc32c_slice[7][crc & 0xff] ^
+		      crc32c_slice[6][(crc >> 8) & 0xff] ^
+		      crc32c_slice[5][(crc >> 16) & 0xff] ^
+		      crc32c_slice[4][crc >> 24] ^
+		      crc32c_slice[3][hi & 0xff] ^
+		      crc32c_slice[2][(hi >> 8) & 0xff] ^
+		      crc32c_slice[1][(hi >> 16) & 0xff] ^
+		      crc32c_slice[0][hi >> 24];
+	}
+
+	return crc32c_byte(crc, buf, len);
+}
+
+#if defined(__x86_64__)
+# define CRC32C_HW
+# define CRC32C_TARGET __attribute__((target("sse4.2")))
+
+CRC32C_TARGET
+static inline uint32_t crc32c_u8(uint32_t crc, uint8_t val)
+{
+	return __builtin_ia32_crc32qi(crc, val);
+}
+
+CRC32C_TARGET
+static inline uint32_t crc32c_u64(uint32_t crc, const uint8_t *buf)
+{
+	uint64_t val;
+
+	memcpy(&val, buf, sizeof(val));
+
+	return __builtin_ia32_crc32di(crc, val);
+}
+
+static int crc32c_hw_detect(void)
+{
+	__builtin_cpu_init();
+
+	return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(__aarch64__)
+# define CRC32C_HW
+# define CRC32C_TARGET __attribute__((target("+crc")))
+
+# ifndef HWCAP_CRC32
+#  define HWCAP_CRC32 (1 << 7)
+# endif
+
+CRC32C_TARGET
+static inline uint32_t crc32c_u8(uint32_t crc, uint8_t val)
+{
+	__asm__("crc32cb %w0, %w0, %w1" : "+r" (crc) : "r" (val));
+
+	return crc;
+}
+
+CRC32C_TARGET
+static inline uint32_t crc32c_u64(uint32_t crc, const uint8_t *buf)
+{
+	uint64_t val;
+
+	memcpy(&val, buf, sizeof(val));
+	__asm__("crc32cx %w0, %w0, %x1" : "+r" (crc) : "r" (val));
+
+	return crc;
+}
+
+static int crc32c_hw_detect(void)
+{
+#ifdef HAVE_GETAUXVAL
+	return !!(getauxval(AT_HWCAP) & HWCAP_CRC32);
+#else
+	return 0;
+#endif
+}
+#endif
+
+#ifdef CRC32C_HW
+
+#define CRC32C_LONG 8192
+#define CRC32C_SHORT 256
+
+static uint32_t crc32c_long[4][256];
+static uint32_t crc32c_short[4][256];
+static int crc32c_hw_supported;
+
+/*
+ * Multiplies a and b modulo the CRC polynomial, the polynomials are stored
+ * in the reflected bit order, i.e. x^0 is the most significant bit.
+ */
+static uint32_t multmodp(uint32_t a, uint32_t b)
+{
+	uint32_t m = 1U << 31, p = 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if (!(a & (m - 1)))
+				break;
+		}
+
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+	}
+
+	return p;
+}
+
+/* Returns x^(8 * len) modulo the CRC polynomial */
+static uint32_t x8nmodp(size_t len)
+{
+	uint32_t xp = 1U << 31, x2n = 1U << 30;
+	unsigned int k;
+
+	/* x^(2^3) */
+	for (k = 0; k < 3; k++)
+		x2n = multmodp(x2n, x2n);
+
+	for (; len; len >>= 1) {
+		if (len & 1)
+			xp = multmodp(x2n, xp);
+
+		x2n = multmodp(x2n, x2n);
+	}
+
+	return xp;
+}
+
+/*
+ * Fills in tables that shift a checksum over len zero bytes, the shift is a
+ * multiplication by x^(8 * len) so it can be split per checksum byte.
+ */
+static void crc32c_zeros(uint32_t table[4][256], size_t len)
+{
+	uint32_t op = x8nmodp(len);
+	unsigned int i, n;
+
+	for (n = 0; n < 256; n++) {
+		for (i = 0; i < 4; i++)
+			table[i][n] = multmodp(op, n << (8 * i));
+	}
+}
+
+static inline uint32_t crc32c_shift(uint32_t table[4][256], uint32_t crc)
+{
+	return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+	       table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+CRC32C_TARGET
+static uint32_t crc32c_hw_3way(uint32_t crc, const uint8_t **bufp,
+			       size_t *lenp, size_t block,
+			       uint32_t shift[4][256])
+{
+	const uint8_t *buf = *bufp, *end;
+	size_t len = *lenp;
+	uint32_t crc1, crc2;
+
+	for (; len >= 3 * block; len -= 3 * block) {
+		crc1 = crc2 = 0;
+		end = buf + block;
+
+		do {
+			crc = crc32c_u64(crc, buf);
+			crc1 = crc32c_u64(crc1, buf + block);
+			crc2 = crc32c_u64(crc2, buf + 2 * block);
+			buf += 8;
+		} while (buf < end);
+
+		crc = crc32c_shift(shift, crc) ^ crc1;
+		crc = crc32c_shift(shift, crc) ^ crc2;
+		buf += 2 * block;
+	}
+
+	*bufp = buf;
+	*lenp = len;
+
+	return crc;
+}
+
+CRC32C_TARGET
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *buf, size_t len)
+{
+	while (len && ((uintptr_t)buf & 7)) {
+		crc = crc32c_u8(crc, *buf++);
+		len--;
+	}
+
+	crc = crc32c_hw_3way(crc, &buf, &len, CRC32C_LONG, crc32c_long);
+	crc = crc32c_hw_3way(crc, &buf, &len, CRC32C_SHORT, crc32c_short);
+
+	for (; len >= 8; buf += 8, len -= 8)
+		crc = crc32c_u64(crc, buf);
+
+	while (len--)
+		crc = crc32c_u8(crc, *buf++);
+
+	return crc;
+}
+#endif /* CRC32C_HW */
+
+static uint32_t (*crc32c_fn)(uint32_t crc, const uint8_t *buf, size_t len);
+
+__attribute__((constructor))
+static void crc32c_init(void)
+{
+	unsigned int i, k;
+
+	for (i = 0; i < 256; i++)
+		crc32c_slice[0][i] = crc32c_table[i];
+
+	for (k = 1; k < 8; k++) {
+		for (i = 0; i < 256; i++) {
+			crc32c_slice[k][i] = (crc32c_slice[k - 1][i] >> 8) ^
+				crc32c_table[crc32c_slice[k - 1][i] & 0xff];
+		}
+	}
+
+	crc32c_fn = crc32c_slice8;
+
+#ifdef CRC32C_HW
+	if (!crc32c_hw_detect())
+		return;
+
+	crc32c_zeros(crc32c_long, CRC32C_LONG);
+	crc32c_zeros(crc32c_short, CRC32C_SHORT);
+	crc32c_hw_supported = 1;
+	crc32c_fn = crc32c_hw;
+#endif
+}
+
 uint32_t tst_crc32c(uint8_t *buf, size_t buf_len)
 {
-	uint32_t crc = 0xffffffff;
+	return ~crc32c_fn(0xffffffff, buf, buf_len);
+}
+
+int tst_crc32c_impl_supported(enum tst_crc32c_impl impl)
+{
+	switch (impl) {
+	case TST_CRC32C_BYTE:
+	case TST_CRC32C_SLICE8:
+		return 1;
+	case TST_CRC32C_HW:
+#ifdef CRC32C_HW
+		return crc32c_hw_supported;
+#else
+		return 0;
+#endif
+	}
 
-	while (buf_len--)
-		crc = crc32c_table[(crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
+	return 0;
+}
+
+uint32_t tst_crc32c_with(enum tst_crc32c_impl impl, uint8_t *buf,
+			 size_t buf_len)
+{
+	switch (impl) {
+	case TST_CRC32C_BYTE:
+		return ~crc32c_byte(0xffffffff, buf, buf_len);
+	case TST_CRC32C_SLICE8:
+		return ~crc32c_slice8(0xffffffff, buf, buf_len);
+	case TST_CRC32C_HW:
+#ifdef CRC32C_HW
+		if (crc32c_hw_supported)
+			return ~crc32c_hw(0xffffffff, buf, buf_len);
+#endif
+	break;
+	}
 
-	return ~crc;
+	tst_brk(TCONF, "CRC32c implementation %i not supported", impl);
+	return 0;
 }
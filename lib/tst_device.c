@@ -8,6 +8,7 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/mount.h>
+#include <sys/file.h>
 #include <mntent.h>
 #include <errno.h>
 #include <unistd.h>
@@ -37,6 +38,7 @@
 
 static char dev_path[PATH_MAX];
 static int device_acquired;
+static int pool_fd = -1;
 static unsigned long prev_dev_sec_write;
 
 static const char * const dev_loop_variants[] = {
@@ -399,6 +401,56 @@ const char *tst_acquire_loop_device(unsigned int size, const char *filename)
 	return dev_path;
 }
 
+/*
+ * LTP_DEV_POOL is a comma separated list of pre-attached devices shared by
+ * concurrently running tests. A device is owned by the test for as long as it
+ * holds an exclusive flock() on the device node.
+ */
+static const char *acquire_pool_device(unsigned int size)
+{
+	const char *pool = getenv("LTP_DEV_POOL");
+	char *devs, *dev, *saveptr = NULL;
+	const char *ret = NULL;
+	int fd;
+
+	if (!pool)
+		return NULL;
+
+	devs = strdup(pool);
+	if (!devs)
+		return NULL;
+
+	for (dev = strtok_r(devs, ", ", &saveptr); dev;
+	     dev = strtok_r(NULL, ", ", &saveptr)) {
+		uint64_t dev_size = tst_get_device_size(dev);
+
+		if (dev_size == (uint64_t)-1 || dev_size < size)
+			continue;
+
+		fd = open(dev, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		if (flock(fd, LOCK_EX | LOCK_NB)) {
+			close(fd);
+			continue;
+		}
+
+		tst_resm(TINFO, "Using pool device '%s'", dev);
+		strncpy(dev_path, dev, sizeof(dev_path) - 1);
+		pool_fd = fd;
+		ret = dev_path;
+		break;
+	}
+
+	if (!ret)
+		tst_resm(TINFO, "No free device in $LTP_DEV_POOL");
+
+	free(devs);
+
+	return ret;
+}
+
 const char *tst_acquire_device__(unsigned int size)
 {
 	const char *dev;
@@ -421,6 +473,11 @@ const char *tst_acquire_device__(unsigned int size)
 				ltp_dev_size, acq_dev_size);
 	}
 
+	dev = acquire_pool_device(acq_dev_size);
+
+	if (dev)
+		return dev;
+
 	dev = tst_acquire_loop_device(acq_dev_size, DEV_FILE);
 
 	if (dev)
@@ -433,7 +490,7 @@ const char *tst_acquire_device_(void (cleanup_fn)(void), unsigned int size)
 {
 	const char *device;
 
-	if (device_acquired) {
+	if (device_acquired || pool_fd >= 0) {
 		tst_brkm(TBROK, cleanup_fn, "Device already acquired");
 		return NULL;
 	}
@@ -458,6 +515,12 @@ int tst_release_device(const char *dev)
 {
 	int ret;
 
+	if (pool_fd >= 0) {
+		close(pool_fd);
+		pool_fd = -1;
+		return 0;
+	}
+
 	if (!device_acquired)
 		return 0;
 
@@ -3,21 +3,31 @@
  * Copyright (c) 2017 Cyril Hrubis <chrubis@suse.cz>
  */
 
+#define _GNU_SOURCE
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <sys/statvfs.h>
 #include <sys/uio.h>
+#include <sys/wait.h>
 
 #define TST_NO_DEFAULT_MAIN
 #include "tst_test.h"
 #include "lapi/fcntl.h"
+#include "tst_cpu.h"
 #include "tst_fs.h"
 #include "tst_rand_data.h"
 #include "tst_safe_file_at.h"
 
-static void fill_random(const char *path, int verbose)
+#define PFILL_CHUNK (64 * 1024 * 1024)
+#define PFILL_BUF (1024 * 1024)
+#define PFILL_MAX_WORKERS 16
+
+/* Returns the number of bytes written */
+static unsigned long long fill_random(const char *path, int verbose)
 {
+	unsigned long long total = 0;
 	int i = 0;
 	char file[PATH_MAX];
 	size_t len;
@@ -41,7 +51,7 @@ static void fill_random(const char *path, int verbose)
 				tst_brk(TBROK | TERRNO, "open()");
 
 			tst_res(TINFO | TERRNO, "open()");
-			return;
+			return total;
 		}
 
 		while (len) {
@@ -61,10 +71,11 @@ static void fill_random(const char *path, int verbose)
 					tst_brk(TBROK | TERRNO, "write()");
 
 				tst_res(TINFO | TERRNO, "write()");
-				return;
+				return total;
 			}
 
 			len -= ret;
+			total += ret;
 		}
 
 		SAFE_CLOSE(fd);
@@ -133,6 +144,169 @@ static void fill_flat_vec(const char *path, int verbose)
 	SAFE_CLOSE(fd);
 }
 
+/*
+ * Writes len bytes at off, returns -1 and sets errno on failure. The number
+ * of bytes written is stored into written in both cases.
+ */
+static int pfill_write(int fd, const char *buf, off_t off, size_t len,
+		       size_t *written)
+{
+	ssize_t ret;
+	int flags;
+
+	*written = 0;
+
+	while (len) {
+		ret = pwrite(fd, buf, MIN(len, (size_t)PFILL_BUF), off);
+
+		if (ret < 0) {
+			flags = SAFE_FCNTL(fd, F_GETFL);
+
+			/* O_DIRECT alignment is not satisfied, go buffered */
+			if (errno == EINVAL && (flags & O_DIRECT)) {
+				SAFE_FCNTL(fd, F_SETFL, flags & ~O_DIRECT);
+				continue;
+			}
+
+			return -1;
+		}
+
+		off += ret;
+		len -= ret;
+		*written += ret;
+	}
+
+	return 0;
+}
+
+/*
+ * The file size limit (EFBIG) or the quota (EDQUOT) end the worker the same
+ * way a full filesystem does.
+ */
+static int pfill_full(int err)
+{
+	return err == ENOSPC || err == EDQUOT || err == EFBIG;
+}
+
+/*
+ * Preallocates the file in large chunks and overwrites each chunk with data,
+ * the chunk size is halved whenever it does not fit until it drops below the
+ * filesystem block size. Runs in a child process, returns the number of bytes written.
+ */
+static off_t pfill_worker(const char *path, int id, const char *buf,
+			  size_t bsize, int verbose)
+{
+	char file[PATH_MAX];
+	size_t chunk = PFILL_CHUNK, written;
+	int fd, falloc = 1;
+	off_t off = 0;
+
+	snprintf(file, sizeof(file), "%s/pfill%i", path, id);
+
+	fd = open(file, O_WRONLY | O_CREAT | O_DIRECT, 0600);
+	if (fd == -1 && errno == EINVAL)
+		fd = open(file, O_WRONLY | O_CREAT, 0600);
+
+	if (fd == -1) {
+		if (!pfill_full(errno))
+			tst_brk(TBROK | TERRNO, "open(%s)", file);
+
+		return 0;
+	}
+
+	while (chunk >= bsize) {
+		if (falloc && fallocate(fd, 0, off, chunk)) {
+			if (errno == EOPNOTSUPP) {
+				falloc = 0;
+				continue;
+			}
+
+			if (!pfill_full(errno))
+				tst_brk(TBROK | TERRNO, "fallocate(%s)", file);
+
+			chunk /= 2;
+			continue;
+		}
+
+		if (pfill_write(fd, buf, off, chunk, &written)) {
+			if (!pfill_full(errno))
+				tst_brk(TBROK | TERRNO, "pwrite(%s)", file);
+
+			chunk /= 2;
+		}
+
+		off += written;
+	}
+
+	if (verbose)
+		tst_res(TINFO, "Written %lliMB into %s", (long long)off >> 20, file);
+
+	SAFE_CLOSE(fd);
+
+	return off;
+}
+
+static void fill_parallel(const char *path, int verbose)
+{
+	unsigned int i, workers = MIN(tst_ncpus_available(), PFILL_MAX_WORKERS);
+	unsigned long long total = 0;
+	struct timespec start, end;
+	struct statvfs fi;
+	pid_t pids[PFILL_MAX_WORKERS];
+	int status, res[2];
+	off_t written;
+	size_t off;
+	double secs;
+	char *buf;
+
+	SAFE_STATVFS(path, &fi);
+
+	buf = SAFE_MMAP(NULL, PFILL_BUF, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	for (off = 0; off < PFILL_BUF; off += tst_rand_data_len)
+		memcpy(buf + off, tst_rand_data, MIN(tst_rand_data_len, PFILL_BUF - off));
+
+	SAFE_PIPE(res);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < workers; i++) {
+		pids[i] = SAFE_FORK();
+
+		if (!pids[i]) {
+			SAFE_CLOSE(res[0]);
+			written = pfill_worker(path, i, buf, fi.f_bsize, verbose);
+			SAFE_WRITE(SAFE_WRITE_ALL, res[1], &written, sizeof(written));
+			_exit(0);
+		}
+	}
+
+	SAFE_CLOSE(res[1]);
+
+	while (SAFE_READ(0, res[0], &written, sizeof(written)) == sizeof(written))
+		total += written;
+
+	SAFE_CLOSE(res[0]);
+
+	for (i = 0; i < workers; i++) {
+		SAFE_WAITPID(pids[i], &status, 0);
+
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			tst_brk(TBROK, "Fill worker %s", tst_strstatus(status));
+	}
+
+	/* Top up whatever the workers could not allocate in whole blocks */
+	total += fill_random(path, verbose);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	tst_res(TINFO, "Filled %lluMB with %u processes in %.2fs (%.2f MB/s)",
+		total >> 20, workers, secs, total / secs / (1 << 20));
+
+	SAFE_MUNMAP(buf, PFILL_BUF);
+}
+
 void tst_fill_fs(const char *path, int verbose, enum tst_fill_access_pattern pattern)
 {
 
@@ -140,6 +314,9 @@ void tst_fill_fs(const char *path, int verbose, enum tst_fill_access_pattern pat
 	case TST_FILL_BLOCKS:
 		return fill_flat_vec(path, verbose);
 	case TST_FILL_RANDOM:
-		return fill_random(path, verbose);
+		fill_random(path, verbose);
+		return;
+	case TST_FILL_PARALLEL:
+		return fill_parallel(path, verbose);
 	}
 }
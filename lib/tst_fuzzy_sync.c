@@ -0,0 +1,482 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Persistent fuzzy sync profiles. The timing statistics depend on the kernel
+ * and on the CPU, so the profile records both and is ignored when either of
+ * them changes.
+ *
+ * CPU placement for pairs running in parallel. The race windows depend on
+ * whether the threads share a core, a cache or a memory controller, so the
+ * pairs are spread over the SMT sibling, same package and cross package
+ * placements available on the machine.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#define TST_NO_DEFAULT_MAIN
+#include "tst_test.h"
+#include "tst_fuzzy_sync.h"
+
+extern const char *TCID;
+
+static const char *profile_dir(void)
+{
+	const char *dir = getenv("LTP_FZSYNC_PROFILE");
+
+	if (!dir || !dir[0])
+		return NULL;
+
+	return dir;
+}
+
+static int profile_path(char *buf, size_t size, const char *dir)
+{
+	int ret;
+
+	ret = snprintf(buf, size, "%s/%s_v%u_t%i.fzsync",
+		       dir, TCID ? TCID : "unknown", tst_variant, tst_tcase);
+
+	return ret < 0 || (size_t)ret >= size;
+}
+
+static void platform_id(char *kernel, size_t kernel_size,
+			char *cpu, size_t cpu_size)
+{
+	struct utsname uts;
+	char line[256];
+	FILE *f;
+
+	uname(&uts);
+	snprintf(kernel, kernel_size, "%s", uts.release);
+	snprintf(cpu, cpu_size, "%s", uts.machine);
+
+	f = fopen("/proc/cpuinfo", "r");
+	if (!f)
+		return;
+
+	while (fgets(line, sizeof(line), f)) {
+		char *val = strchr(line, ':');
+
+		if (!val || strncmp(line, "model name", 10))
+			continue;
+
+		val += 1 + strspn(val + 1, " \t");
+		val[strcspn(val, "\n")] = 0;
+		snprintf(cpu, cpu_size, "%s", val);
+		break;
+	}
+
+	fclose(f);
+}
+
+static int read_stat(FILE *f, const char *name, struct tst_fzsync_stat *s)
+{
+	char key[32];
+
+	if (fscanf(f, "%31s %f %f %f", key, &s->avg, &s->avg_dev,
+		   &s->dev_ratio) != 4)
+		return 1;
+
+	return strcmp(key, name);
+}
+
+static void write_stat(FILE *f, const char *name, struct tst_fzsync_stat *s)
+{
+	fprintf(f, "%s %f %f %f\n", name, s->avg, s->avg_dev, s->dev_ratio);
+}
+
+/*
+ * Returns 1 if the profile matches the platform, 0 if it's stale and -1 if
+ * it can't be opened.
+ */
+static int read_profile(const char *path, struct tst_fzsync_pair *pair)
+{
+	char kernel[128], cpu[128], line[256], key[32];
+	struct tst_fzsync_pair p = {};
+	unsigned int i;
+	FILE *f;
+	int ret = 0;
+
+	f = fopen(path, "r");
+	if (!f) {
+		if (errno != ENOENT)
+			tst_res(TINFO | TERRNO, "Can't open fzsync profile '%s'", path);
+		return -1;
+	}
+
+	platform_id(kernel, sizeof(kernel), cpu, sizeof(cpu));
+
+	if (!fgets(line, sizeof(line), f) || strncmp(line, "kernel ", 7) ||
+	    strcmp(strtok(line + 7, "\n") ?: "", kernel))
+		goto out;
+
+	if (!fgets(line, sizeof(line), f) || strncmp(line, "cpu ", 4) ||
+	    strcmp(strtok(line + 4, "\n") ?: "", cpu))
+		goto out;
+
+	if (fscanf(f, " delay_bias %i", &p.delay_bias) != 1 ||
+	    read_stat(f, "diff_ss", &p.diff_ss) ||
+	    read_stat(f, "diff_sa", &p.diff_sa) ||
+	    read_stat(f, "diff_sb", &p.diff_sb) ||
+	    read_stat(f, "diff_ab", &p.diff_ab) ||
+	    read_stat(f, "spins", &p.spins_avg) ||
+	    fscanf(f, "%31s", key) != 1 || strcmp(key, "hits"))
+		goto out;
+
+	for (i = 0; i < TST_FZSYNC_BINS; i++) {
+		if (fscanf(f, "%u", &p.bin_hits[i]) != 1)
+			goto out;
+
+		p.bin_total += p.bin_hits[i];
+	}
+
+	pair->delay_bias = p.delay_bias;
+	pair->diff_ss = p.diff_ss;
+	pair->diff_sa = p.diff_sa;
+	pair->diff_sb = p.diff_sb;
+	pair->diff_ab = p.diff_ab;
+	pair->spins_avg = p.spins_avg;
+	pair->bin_total = p.bin_total;
+	memcpy(pair->bin_hits, p.bin_hits, sizeof(pair->bin_hits));
+	ret = 1;
+out:
+	fclose(f);
+	return ret;
+}
+
+int tst_fzsync_profile_load(struct tst_fzsync_pair *pair)
+{
+	const char *dir = profile_dir();
+	char path[PATH_MAX];
+	int ret;
+
+	if (!dir || profile_path(path, sizeof(path), dir))
+		return 0;
+
+	ret = read_profile(path, pair);
+
+	if (!ret)
+		tst_res(TINFO, "Ignoring stale fzsync profile '%s'", path);
+
+	if (ret > 0) {
+		tst_res(TINFO, "Loaded fzsync profile '%s' (%u hits)",
+			path, pair->bin_total);
+	}
+
+	return ret > 0;
+}
+
+void tst_fzsync_profile_save(struct tst_fzsync_pair *pair)
+{
+	const char *dir = profile_dir();
+	char path[PATH_MAX], tmp_path[PATH_MAX + 16], kernel[128], cpu[128];
+	unsigned int i;
+	FILE *f;
+
+	if (!dir || profile_path(path, sizeof(path), dir))
+		return;
+
+	/* Profile is written by rename so parallel runs never see partial file */
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%i", path, getpid());
+
+	f = fopen(tmp_path, "w");
+	if (!f) {
+		tst_res(TINFO | TERRNO, "Can't create fzsync profile '%s'", tmp_path);
+		return;
+	}
+
+	platform_id(kernel, sizeof(kernel), cpu, sizeof(cpu));
+
+	fprintf(f, "kernel %s\ncpu %s\ndelay_bias %i\n",
+		kernel, cpu, pair->delay_bias);
+	write_stat(f, "diff_ss", &pair->diff_ss);
+	write_stat(f, "diff_sa", &pair->diff_sa);
+	write_stat(f, "diff_sb", &pair->diff_sb);
+	write_stat(f, "diff_ab", &pair->diff_ab);
+	write_stat(f, "spins", &pair->spins_avg);
+	fprintf(f, "hits");
+
+	for (i = 0; i < TST_FZSYNC_BINS; i++)
+		fprintf(f, " %u", pair->bin_hits[i]);
+
+	fprintf(f, "\n");
+
+	if (fclose(f) || rename(tmp_path, path)) {
+		tst_res(TINFO | TERRNO, "Can't store fzsync profile '%s'", path);
+		unlink(tmp_path);
+	}
+}
+
+static void add_stat(struct tst_fzsync_stat *sum,
+		     const struct tst_fzsync_stat *s, unsigned int n)
+{
+	sum->avg += s->avg / n;
+	sum->avg_dev += s->avg_dev / n;
+	sum->dev_ratio += s->dev_ratio / n;
+}
+
+/*
+ * All pairs started from the same profile, the merged one has the average
+ * timing statistics and the hits recorded by all of them added to it.
+ */
+static void save_multi_profile(struct tst_fzsync_pair *pairs,
+			       unsigned int nr_pairs)
+{
+	const char *dir = profile_dir();
+	struct tst_fzsync_pair base = {}, merged = {};
+	char path[PATH_MAX];
+	unsigned int i, j, n = 0;
+	int bias = 0;
+
+	for (i = 0; i < nr_pairs; i++)
+		n += pairs[i].profile_dirty;
+
+	if (!n || !dir || profile_path(path, sizeof(path), dir))
+		return;
+
+	if (read_profile(path, &base) <= 0)
+		memset(&base, 0, sizeof(base));
+
+	memcpy(merged.bin_hits, base.bin_hits, sizeof(merged.bin_hits));
+
+	for (i = 0; i < nr_pairs; i++) {
+		struct tst_fzsync_pair *p = &pairs[i];
+
+		if (!p->profile_dirty)
+			continue;
+
+		add_stat(&merged.diff_ss, &p->diff_ss, n);
+		add_stat(&merged.diff_sa, &p->diff_sa, n);
+		add_stat(&merged.diff_sb, &p->diff_sb, n);
+		add_stat(&merged.diff_ab, &p->diff_ab, n);
+		add_stat(&merged.spins_avg, &p->spins_avg, n);
+		bias += p->delay_bias;
+
+		for (j = 0; j < TST_FZSYNC_BINS; j++) {
+			if (p->bin_hits[j] > base.bin_hits[j])
+				merged.bin_hits[j] += p->bin_hits[j] - base.bin_hits[j];
+		}
+
+		p->profile_dirty = 0;
+	}
+
+	merged.delay_bias = bias / (int)n;
+
+	tst_fzsync_profile_save(&merged);
+}
+
+void tst_fzsync_pin_thread(pthread_t thread, int cpu)
+{
+	cpu_set_t mask;
+	int ret;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+
+	if (!thread)
+		ret = sched_setaffinity(0, sizeof(mask), &mask) ? errno : 0;
+	else
+		ret = pthread_setaffinity_np(thread, sizeof(mask), &mask);
+
+	if (ret) {
+		tst_brk(TBROK, "Failed to pin thread to CPU %i: %s",
+			cpu, tst_strerrno(ret));
+	}
+}
+
+unsigned int tst_fzsync_multi_count(int extra)
+{
+	long cpus = tst_ncpus_available() / (2 + extra);
+
+	return cpus > 1 ? cpus : 1;
+}
+
+enum placement {
+	PLACE_SIBLING,
+	PLACE_PACKAGE,
+	PLACE_CROSS,
+	PLACE_CNT,
+	PLACE_ANY = PLACE_CNT,
+};
+
+static const char *const placement_names[] = {
+	[PLACE_SIBLING] = "SMT siblings",
+	[PLACE_PACKAGE] = "same package",
+	[PLACE_CROSS] = "cross package",
+	[PLACE_ANY] = "unpinned",
+};
+
+struct cpu_topo {
+	int cpu;
+	int package;
+	int core;
+	int used;
+};
+
+static int read_topo(int cpu, const char *name, int def)
+{
+	char path[128];
+	int val;
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%i/topology/%s", cpu, name);
+
+	if (FILE_SCANF(path, "%i", &val))
+		return def;
+
+	return val;
+}
+
+static int get_topo(struct cpu_topo **topo)
+{
+	cpu_set_t mask;
+	int cpu, cnt = 0;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		tst_brk(TBROK | TERRNO, "sched_getaffinity()");
+
+	*topo = SAFE_CALLOC(CPU_COUNT(&mask), sizeof(**topo));
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &mask))
+			continue;
+
+		(*topo)[cnt].cpu = cpu;
+		(*topo)[cnt].package = read_topo(cpu, "physical_package_id", 0);
+		(*topo)[cnt].core = read_topo(cpu, "core_id", cpu);
+		cnt++;
+	}
+
+	return cnt;
+}
+
+static int matches(struct cpu_topo *a, struct cpu_topo *b, enum placement p)
+{
+	switch (p) {
+	case PLACE_SIBLING:
+		return a->package == b->package && a->core == b->core;
+	case PLACE_PACKAGE:
+		return a->package == b->package && a->core != b->core;
+	case PLACE_CROSS:
+		return a->package != b->package;
+	default:
+		return 1;
+	}
+}
+
+static int pick_cpu(struct cpu_topo *topo, int cnt, int leader,
+		    enum placement p)
+{
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		if (!topo[i].used && matches(&topo[leader], &topo[i], p))
+			return i;
+	}
+
+	return -1;
+}
+
+static enum placement place_pair(struct tst_fzsync_pair *pair,
+				 struct cpu_topo *topo, int cnt,
+				 unsigned int idx)
+{
+	enum placement p = PLACE_ANY;
+	int i, k, leader, cpu = -1;
+
+	pair->nr_cpus = 0;
+
+	leader = pick_cpu(topo, cnt, 0, PLACE_ANY);
+	if (leader < 0)
+		return PLACE_ANY;
+
+	topo[leader].used = 1;
+
+	/* Rotate the preferred placement so that all of them are covered */
+	for (k = 0; k < PLACE_CNT; k++) {
+		p = (idx + k) % PLACE_CNT;
+		cpu = pick_cpu(topo, cnt, leader, p);
+		if (cpu >= 0)
+			break;
+	}
+
+	if (cpu < 0) {
+		topo[leader].used = 0;
+		return PLACE_ANY;
+	}
+
+	pair->cpus[pair->nr_cpus++] = topo[leader].cpu;
+	pair->cpus[pair->nr_cpus++] = topo[cpu].cpu;
+	topo[cpu].used = 1;
+
+	for (i = 0; i < pair->extra; i++) {
+		cpu = pick_cpu(topo, cnt, leader, p);
+		if (cpu < 0)
+			cpu = pick_cpu(topo, cnt, leader, PLACE_ANY);
+		if (cpu < 0)
+			break;
+
+		pair->cpus[pair->nr_cpus++] = topo[cpu].cpu;
+		topo[cpu].used = 1;
+	}
+
+	return p;
+}
+
+void tst_fzsync_multi_run(struct tst_fzsync_pair *pairs, unsigned int nr_pairs,
+			  void *(*run_a)(void *))
+{
+	enum placement *place = SAFE_CALLOC(nr_pairs, sizeof(*place));
+	pthread_t *threads = SAFE_CALLOC(nr_pairs, sizeof(*threads));
+	struct cpu_topo *topo;
+	unsigned int i, hits = 0;
+	int cnt, j;
+
+	cnt = get_topo(&topo);
+
+	for (i = 0; i < nr_pairs; i++) {
+		place[i] = place_pair(&pairs[i], topo, cnt, i);
+		pairs[i].multi = 1;
+	}
+
+	for (i = 0; i < nr_pairs; i++)
+		SAFE_PTHREAD_CREATE(&threads[i], NULL, run_a, &pairs[i]);
+
+	for (i = 0; i < nr_pairs; i++)
+		SAFE_PTHREAD_JOIN(threads[i], NULL);
+
+	save_multi_profile(pairs, nr_pairs);
+
+	for (i = 0; i < nr_pairs; i++) {
+		char cpus[64] = "";
+		size_t len = 0;
+
+		for (j = 0; j < pairs[i].nr_cpus && len < sizeof(cpus); j++) {
+			len += snprintf(cpus + len, sizeof(cpus) - len, "%s%i",
+					j ? "," : " ", pairs[i].cpus[j]);
+		}
+
+		tst_res(TINFO, "Pair %u (%s%s): loops = %d, hits = %u",
+			i, placement_names[place[i]], cpus,
+			pairs[i].exec_loop, pairs[i].hits);
+
+		hits += pairs[i].hits;
+	}
+
+	tst_res(TINFO, "%u pairs hit the race %u times in total", nr_pairs, hits);
+
+	free(topo);
+	free(threads);
+	free(place);
+}
@@ -5,8 +5,12 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/utsname.h>
 
 #define TST_NO_DEFAULT_MAIN
@@ -187,12 +191,22 @@ static void kconfig_module_check(struct tst_kconfig_var *var)
 	}
 }
 
-static inline int kconfig_parse_line(const char *line,
-                                     struct tst_kconfig_var *vars,
-                                     unsigned int vars_len)
+struct kconfig_line {
+	const char *id;
+	unsigned int id_len;
+	const char *val;
+	unsigned int val_len;
+	char choice;
+};
+
+/*
+ * Splits a config line into variable name and value, returns 1 if the line
+ * sets or unsets a config variable.
+ */
+static int kconfig_lex_line(const char *line, struct kconfig_line *res)
 {
-	unsigned int i, var_len = 0;
-	const char *var;
+	unsigned int var_len = 0, val_len = 0;
+	const char *var, *val;
 	int is_not_set = 0;
 
 	while (isspace(*line))
@@ -224,63 +238,462 @@ static inline int kconfig_parse_line(const char *line,
 	}
 
 out:
+	res->id = var;
+	res->id_len = var_len;
+
+	if (is_not_set) {
+		res->choice = 'n';
+		return 1;
+	}
+
+	val = var + var_len;
+
+	while (isspace(*val))
+		val++;
+
+	if (*val != '=')
+		return 0;
+
+	val++;
+
+	while (isspace(*val))
+		val++;
+
+	while (val[val_len] && !isspace(val[val_len]))
+		val_len++;
+
+	res->val = val;
+	res->val_len = val_len;
+	res->choice = 'v';
+
+	if (val_len == 1 && (val[0] == 'y' || val[0] == 'm'))
+		res->choice = val[0];
+
+	return 1;
+}
+
+static void kconfig_set_var(struct tst_kconfig_var *var, char choice,
+			    const char *val, unsigned int val_len)
+{
+	var->choice = choice;
+
+	switch (choice) {
+	case 'y':
+		kconfig_runtime_check(var);
+	break;
+	case 'm':
+		kconfig_runtime_check(var);
+		kconfig_module_check(var);
+	break;
+	case 'v':
+		var->val = strndup(val, val_len);
+	break;
+	}
+}
+
+static inline int kconfig_parse_line(const char *line,
+                                     struct tst_kconfig_var *vars,
+                                     unsigned int vars_len)
+{
+	struct kconfig_line res;
+	unsigned int i;
+
+	if (!kconfig_lex_line(line, &res))
+		return 0;
 
 	for (i = 0; i < vars_len; i++) {
-		const char *val;
-		unsigned int val_len = 0;
+		if (vars[i].id_len != res.id_len)
+			continue;
 
-		if (vars[i].id_len != var_len)
+		if (strncmp(vars[i].id, res.id, res.id_len))
 			continue;
 
-		if (strncmp(vars[i].id, var, var_len))
+		kconfig_set_var(&vars[i], res.choice, res.val, res.val_len);
+
+		return res.choice != 'v';
+	}
+
+	return 0;
+}
+
+/*
+ * Parsed kernel config index, a hash table with open addressing followed by
+ * a string table. The index is stored in the tmpdir root under a name derived
+ * from the kernel build and the config file identity, so that all the tests
+ * in a testrun parse the config only once.
+ */
+#define KCONFIG_IDX_MAGIC "LTPKCFG1"
+
+struct kconfig_idx_ent {
+	/* Zero for an empty slot */
+	uint32_t id_off;
+	uint32_t val_off;
+	uint32_t id_len;
+	char choice;
+	char pad[3];
+};
+
+struct kconfig_idx {
+	char magic[8];
+	uint32_t size;
+	uint32_t slots;
+	uint32_t key_off;
+	uint32_t pad;
+	struct kconfig_idx_ent ents[];
+};
+
+static const struct kconfig_idx *kconfig_idx;
+
+static uint32_t kconfig_hash(const char *str, unsigned int len)
+{
+	uint32_t hash = 2166136261u;
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)str[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Returns the entry for the id or the empty slot where it belongs, NULL if
+ * the table is full.
+ */
+static const struct kconfig_idx_ent *kconfig_idx_find(
+	const struct kconfig_idx *idx, const char *id, unsigned int id_len,
+	const struct kconfig_idx_ent *ents)
+{
+	uint32_t i = kconfig_hash(id, id_len) & (idx->slots - 1);
+	const char *base = (const char *)idx;
+	uint32_t probes;
+
+	for (probes = 0; probes < idx->slots; probes++) {
+		const struct kconfig_idx_ent *ent = &ents[i];
+
+		if (!ent->id_off)
+			return ent;
+
+		if (ent->id_len == id_len &&
+		    !memcmp(base + ent->id_off, id, id_len))
+			return ent;
+
+		i = (i + 1) & (idx->slots - 1);
+	}
+
+	return NULL;
+}
+
+/* String at off has to be zero terminated before the end offset */
+static int kconfig_idx_str_valid(const char *base, uint32_t off,
+				 uint32_t len, size_t start, size_t end)
+{
+	if (off < start || off >= end || len > end - off - 1)
+		return 0;
+
+	return !base[off + len];
+}
+
+/*
+ * The index file may be stale or corrupted, every offset is checked so that
+ * lookups never read past the mapping and never loop forever.
+ */
+static int kconfig_idx_valid(const struct kconfig_idx *idx, size_t size,
+			     const char *key)
+{
+	const char *base = (const char *)idx;
+	size_t key_len = strlen(key) + 1;
+	size_t strs_off;
+	uint32_t i, empty = 0;
+
+	if (size < sizeof(*idx) || memcmp(idx->magic, KCONFIG_IDX_MAGIC, 8))
+		return 0;
+
+	if (idx->size != size || !idx->slots ||
+	    (idx->slots & (idx->slots - 1)) ||
+	    idx->slots > (size - sizeof(*idx)) / sizeof(struct kconfig_idx_ent))
+		return 0;
+
+	strs_off = sizeof(*idx) + idx->slots * sizeof(struct kconfig_idx_ent);
+
+	if (idx->key_off < strs_off || idx->key_off > size - key_len ||
+	    memcmp(base + idx->key_off, key, key_len))
+		return 0;
+
+	for (i = 0; i < idx->slots; i++) {
+		const struct kconfig_idx_ent *ent = &idx->ents[i];
+
+		if (!ent->id_off) {
+			empty++;
 			continue;
+		}
 
-		if (is_not_set) {
-			vars[i].choice = 'n';
-			return 1;
+		if (!kconfig_idx_str_valid(base, ent->id_off, ent->id_len,
+					   strs_off, idx->key_off))
+			return 0;
+
+		switch (ent->choice) {
+		case 'y':
+		case 'm':
+		case 'n':
+		break;
+		case 'v':
+			if (ent->val_off < strs_off || ent->val_off >= idx->key_off ||
+			    !memchr(base + ent->val_off, 0,
+				    idx->key_off - ent->val_off))
+				return 0;
+		break;
+		default:
+			return 0;
 		}
+	}
 
-		val = var + var_len;
+	return empty > 0;
+}
 
-		while (isspace(*val))
-			val++;
+/*
+ * The index is stored in the shared tmpdir root, only a regular file that
+ * was created by us and is not writable by others is trusted.
+ */
+static const struct kconfig_idx *kconfig_idx_load(const char *path,
+						  const char *key)
+{
+	struct stat st;
+	void *map;
+	int fd;
 
-		if (*val != '=')
-			return 0;
+	fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
 
-		val++;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) || !st.st_size ||
+	    st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		close(fd);
+		return NULL;
+	}
 
-		while (isspace(*val))
-			val++;
-
-		while (!isspace(val[val_len]))
-			val_len++;
-
-		if (val_len == 1) {
-			switch (val[0]) {
-			case 'y':
-				vars[i].choice = 'y';
-				kconfig_runtime_check(&vars[i]);
-				return 1;
-			case 'm':
-				vars[i].choice = 'm';
-				kconfig_runtime_check(&vars[i]);
-				kconfig_module_check(&vars[i]);
-				return 1;
-			}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return NULL;
+
+	if (!kconfig_idx_valid(map, st.st_size, key)) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	return map;
+}
+
+static const struct kconfig_idx *kconfig_idx_build(const char *key)
+{
+	struct kconfig_line *lines = NULL;
+	struct kconfig_idx *idx;
+	size_t lines_cnt = 0, lines_size = 0, size, i;
+	size_t str_size = 0, strs_size = 0;
+	char *buf = NULL, *strs = NULL, *pos;
+	size_t buf_size = 0;
+	uint32_t slots = 16;
+	FILE *fp;
+
+	fp = open_kconfig();
+	if (!fp)
+		return NULL;
+
+	/*
+	 * The lexer returns pointers into the line buffer, the lines are
+	 * concatenated into strs to keep them around.
+	 */
+	while (getline(&buf, &buf_size, fp) > 0) {
+		struct kconfig_line res;
+		size_t len = strlen(buf) + 1;
+
+		if (!kconfig_lex_line(buf, &res))
+			continue;
+
+		if (str_size + len > strs_size) {
+			strs_size = MAX(2 * strs_size, str_size + len + 4096);
+			strs = SAFE_REALLOC(strs, strs_size);
+		}
+
+		memcpy(strs + str_size, buf, len);
+
+		if (lines_cnt >= lines_size) {
+			lines_size = lines_size ? 2 * lines_size : 1024;
+			lines = SAFE_REALLOC(lines, lines_size * sizeof(*lines));
 		}
 
-		vars[i].choice = 'v';
-		vars[i].val = strndup(val, val_len);
+		/* Store offsets, strs may move on realloc */
+		res.id = (const char *)(uintptr_t)(str_size + (res.id - buf));
+		if (res.choice == 'v')
+			res.val = (const char *)(uintptr_t)(str_size + (res.val - buf));
+		lines[lines_cnt++] = res;
+		str_size += len;
 	}
 
-	return 0;
+	free(buf);
+	close_kconfig(fp);
+
+	while (slots < lines_cnt + lines_cnt / 2)
+		slots *= 2;
+
+	size = sizeof(*idx) + slots * sizeof(struct kconfig_idx_ent);
+	for (i = 0; i < lines_cnt; i++)
+		size += lines[i].id_len + lines[i].val_len + 2;
+	size += strlen(key) + 1;
+
+	idx = SAFE_MALLOC(size);
+	memset(idx, 0, sizeof(*idx) + slots * sizeof(struct kconfig_idx_ent));
+	memcpy(idx->magic, KCONFIG_IDX_MAGIC, 8);
+	idx->size = size;
+	idx->slots = slots;
+
+	pos = (char *)&idx->ents[slots];
+
+	for (i = 0; i < lines_cnt; i++) {
+		const char *id = strs + (uintptr_t)lines[i].id;
+		struct kconfig_idx_ent *ent;
+
+		ent = (struct kconfig_idx_ent *)kconfig_idx_find(idx, id,
+			lines[i].id_len, idx->ents);
+
+		/* The first occurence wins, same as when parsing the file */
+		if (!ent || ent->id_off)
+			continue;
+
+		ent->id_off = pos - (char *)idx;
+		ent->id_len = lines[i].id_len;
+		ent->choice = lines[i].choice;
+		memcpy(pos, id, lines[i].id_len);
+		pos += lines[i].id_len + 1;
+
+		if (lines[i].choice == 'v') {
+			ent->val_off = pos - (char *)idx;
+			memcpy(pos, strs + (uintptr_t)lines[i].val,
+			       lines[i].val_len);
+			pos += lines[i].val_len + 1;
+		}
+	}
+
+	idx->key_off = pos - (char *)idx;
+	strcpy(pos, key);
+	pos += strlen(key) + 1;
+	idx->size = pos - (char *)idx;
+
+	free(lines);
+	free(strs);
+
+	return idx;
+}
+
+static void kconfig_idx_store(const struct kconfig_idx *idx, const char *path)
+{
+	char tmp_path[PATH_MAX + 16];
+	int fd;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%i", path, getpid());
+
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		tst_res(TDEBUG | TERRNO, "Failed to create '%s'", tmp_path);
+		return;
+	}
+
+	if (write(fd, idx, idx->size) != (ssize_t)idx->size ||
+	    close(fd) || rename(tmp_path, path)) {
+		tst_res(TDEBUG | TERRNO, "Failed to store '%s'", path);
+		unlink(tmp_path);
+	}
+}
+
+static int kconfig_idx_disabled(void)
+{
+	const char *cache = getenv("LTP_KCONFIG_CACHE");
+
+	return cache && !strcmp(cache, "0");
+}
+
+/*
+ * Returns the kernel config index, loads it from the tmpdir root or parses
+ * the config and stores the index there. Returns NULL when caching is
+ * disabled.
+ */
+static const struct kconfig_idx *kconfig_index(void)
+{
+	char path_buf[1024], idx_path[PATH_MAX], key[2048];
+	const char *path;
+	struct utsname un;
+	struct stat st;
+
+	if (kconfig_idx)
+		return kconfig_idx;
+
+	if (kconfig_idx_disabled())
+		return NULL;
+
+	path = kconfig_path(path_buf, sizeof(path_buf));
+	if (!path)
+		tst_brk(TBROK, "Cannot parse kernel .config");
+
+	if (stat(path, &st))
+		tst_brk(TBROK | TERRNO, "stat(%s)", path);
+
+	uname(&un);
+
+	snprintf(key, sizeof(key), "%s %s %s %llu %llu %lld.%09ld",
+		 un.release, un.version, path,
+		 (unsigned long long)st.st_dev, (unsigned long long)st.st_ino,
+		 (long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+
+	snprintf(idx_path, sizeof(idx_path), "%s/ltp-kconfig-%08x.idx",
+		 tst_get_tmpdir_root(), kconfig_hash(key, strlen(key)));
+
+	kconfig_idx = kconfig_idx_load(idx_path, key);
+	if (kconfig_idx) {
+		tst_res(TINFO, "Using kernel config '%s' index '%s'",
+			path, idx_path);
+		return kconfig_idx;
+	}
+
+	kconfig_idx = kconfig_idx_build(key);
+	if (kconfig_idx)
+		kconfig_idx_store(kconfig_idx, idx_path);
+
+	return kconfig_idx;
+}
+
+static void kconfig_idx_read(const struct kconfig_idx *idx,
+			     struct tst_kconfig_var vars[], size_t vars_len)
+{
+	const char *base = (const char *)idx;
+	size_t i;
+
+	for (i = 0; i < vars_len; i++) {
+		const struct kconfig_idx_ent *ent;
+		const char *val;
+
+		ent = kconfig_idx_find(idx, vars[i].id, vars[i].id_len,
+				       idx->ents);
+		if (!ent || !ent->id_off)
+			continue;
+
+		val = ent->choice == 'v' ? base + ent->val_off : NULL;
+		kconfig_set_var(&vars[i], ent->choice, val, val ? strlen(val) : 0);
+	}
 }
 
 void tst_kconfig_read(struct tst_kconfig_var vars[], size_t vars_len)
 {
 	char line[128];
 	unsigned int vars_found = 0;
+	const struct kconfig_idx *idx = kconfig_index();
+
+	if (idx) {
+		kconfig_idx_read(idx, vars, vars_len);
+		return;
+	}
 
 	FILE *fp = open_kconfig();
 	if (!fp)
@@ -0,0 +1,419 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#define TST_NO_DEFAULT_MAIN
+#include "tst_test.h"
+#include "tst_timer.h"
+#include "tst_memstat.h"
+
+#define DEF_INTERVAL_MS 100
+#define DEF_SAMPLES 1024
+#define READ_BUF_SIZE (512 * 1024)
+
+enum memstat_src {
+	SRC_VMSTAT,
+	SRC_MEMINFO,
+	SRC_ZONEINFO,
+	SRC_CNT,
+};
+
+static const char *const src_paths[SRC_CNT] = {
+	[SRC_VMSTAT] = "/proc/vmstat",
+	[SRC_MEMINFO] = "/proc/meminfo",
+	[SRC_ZONEINFO] = "/proc/zoneinfo",
+};
+
+struct counter {
+	const char *name;
+	enum memstat_src src;
+	char zone[32];
+	const char *key;
+};
+
+/*
+ * Sample i is stored at data[(i % slots) * (ncounters + 1)], the first value
+ * is the time since the sampler start in microseconds followed by the
+ * counter values.
+ */
+struct ring {
+	tst_atomic_t head;
+	unsigned int slots;
+	unsigned int ncounters;
+	long long data[];
+};
+
+static struct counter *counters;
+static unsigned int ncounters;
+static struct ring *ring;
+static int src_fds[SRC_CNT] = {-1, -1, -1};
+static char *read_buf;
+static struct timespec start_time;
+static pid_t sampler_pid;
+static pid_t owner_pid;
+
+static void parse_counter(struct counter *c, const char *name)
+{
+	const char *key;
+	size_t len;
+
+	c->name = name;
+
+	if (!strncmp(name, "vmstat:", 7)) {
+		c->src = SRC_VMSTAT;
+		c->key = name + 7;
+		return;
+	}
+
+	if (!strncmp(name, "meminfo:", 8)) {
+		c->src = SRC_MEMINFO;
+		c->key = name + 8;
+		return;
+	}
+
+	if (!strncmp(name, "zoneinfo:", 9)) {
+		key = strchr(name + 9, ':');
+		len = key ? (size_t)(key - name - 9) : 0;
+
+		if (!len || len >= sizeof(c->zone))
+			tst_brk(TBROK, "Invalid zoneinfo counter '%s'", name);
+
+		c->src = SRC_ZONEINFO;
+		memcpy(c->zone, name + 9, len);
+		c->zone[len] = 0;
+		c->key = key + 1;
+		return;
+	}
+
+	tst_brk(TBROK, "Invalid memory counter '%s'", name);
+}
+
+static long long *sample_ptr(unsigned int i)
+{
+	return ring->data + (size_t)(i % ring->slots) * (ring->ncounters + 1);
+}
+
+static size_t read_src(enum memstat_src src)
+{
+	size_t len = 0;
+	ssize_t ret;
+
+	do {
+		ret = pread(src_fds[src], read_buf + len,
+			    READ_BUF_SIZE - 1 - len, len);
+		if (ret < 0)
+			return 0;
+
+		len += ret;
+	} while (ret && len < READ_BUF_SIZE - 1);
+
+	read_buf[len] = 0;
+
+	return len;
+}
+
+static void store_value(long long *vals, enum memstat_src src,
+			const char *zone, const char *key, size_t key_len,
+			long long val)
+{
+	unsigned int i;
+
+	for (i = 0; i < ncounters; i++) {
+		struct counter *c = &counters[i];
+
+		if (c->src != src || strlen(c->key) != key_len ||
+		    strncmp(c->key, key, key_len))
+			continue;
+
+		if (src != SRC_ZONEINFO) {
+			vals[i] = val;
+			continue;
+		}
+
+		if (strcmp(c->zone, "*") && strcmp(c->zone, zone))
+			continue;
+
+		vals[i] = vals[i] < 0 ? val : vals[i] + val;
+	}
+}
+
+static void parse_src(enum memstat_src src, long long *vals)
+{
+	char zone[32] = "";
+	char *line, *next, *key, *end;
+	size_t key_len;
+	long long val;
+
+	for (line = read_buf; *line; line = next) {
+		next = strchrnul(line, '\n');
+		if (*next)
+			*next++ = 0;
+
+		if (src == SRC_ZONEINFO &&
+		    sscanf(line, "Node %*d, zone %31s", zone) == 1)
+			continue;
+
+		key = line + strspn(line, " ");
+		key_len = strcspn(key, src == SRC_MEMINFO ? ":" : " ");
+
+		if (!key_len || !key[key_len])
+			continue;
+
+		val = strtoll(key + key_len + 1, &end, 10);
+		if (end == key + key_len + 1)
+			continue;
+
+		store_value(vals, src, zone, key, key_len, val);
+	}
+}
+
+static void take_sample(unsigned int i)
+{
+	long long *sample = sample_ptr(i);
+	struct timespec now;
+	unsigned int j;
+	int src;
+
+	for (j = 0; j < ncounters; j++)
+		sample[j + 1] = -1;
+
+	for (src = 0; src < SRC_CNT; src++) {
+		if (src_fds[src] < 0 || !read_src(src))
+			continue;
+
+		parse_src(src, sample + 1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	sample[0] = tst_timespec_diff_us(now, start_time);
+}
+
+static void sampler_loop(unsigned int interval_ms)
+{
+	struct timespec next = start_time, now;
+	unsigned int i = 1;
+
+	prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+	if (getppid() != owner_pid)
+		_exit(0);
+
+	for (;;) {
+		next = tst_timespec_add_us(next, interval_ms * 1000LL);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		/* Skip the missed samples instead of catching up */
+		if (tst_timespec_lt(next, now))
+			next = now;
+
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		take_sample(i);
+		tst_atomic_store(++i, &ring->head);
+	}
+}
+
+void tst_memstat_start(const struct tst_memstat_conf *conf)
+{
+	unsigned int i, slots, interval_ms;
+	size_t size;
+	long long *sample;
+	int src;
+
+	for (ncounters = 0; conf->counters && conf->counters[ncounters]; )
+		ncounters++;
+
+	if (!ncounters)
+		tst_brk(TBROK, "No memory counters to sample");
+
+	slots = conf->samples ? conf->samples : DEF_SAMPLES;
+	interval_ms = conf->interval_ms ? conf->interval_ms : DEF_INTERVAL_MS;
+
+	if (slots < 2)
+		tst_brk(TBROK, "Memory sampler needs at least 2 samples");
+
+	counters = SAFE_MALLOC(ncounters * sizeof(*counters));
+	for (i = 0; i < ncounters; i++) {
+		parse_counter(&counters[i], conf->counters[i]);
+
+		src = counters[i].src;
+		if (src_fds[src] < 0)
+			src_fds[src] = SAFE_OPEN(src_paths[src], O_RDONLY | O_CLOEXEC);
+	}
+
+	read_buf = SAFE_MALLOC(READ_BUF_SIZE);
+
+	size = sizeof(*ring) + (size_t)slots * (ncounters + 1) * sizeof(long long);
+	ring = SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ring->slots = slots;
+	ring->ncounters = ncounters;
+
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+	take_sample(0);
+	tst_atomic_store(1, &ring->head);
+
+	sample = sample_ptr(0);
+	for (i = 0; i < ncounters; i++) {
+		if (sample[i + 1] < 0) {
+			tst_res(TINFO, "Memory counter '%s' not available",
+				counters[i].name);
+		}
+	}
+
+	owner_pid = getpid();
+
+	tst_flush();
+
+	sampler_pid = fork();
+	if (sampler_pid < 0)
+		tst_brk(TBROK | TERRNO, "fork()");
+
+	if (!sampler_pid)
+		sampler_loop(interval_ms);
+
+	tst_res(TINFO, "Sampling %u memory counters every %ums",
+		ncounters, interval_ms);
+}
+
+void tst_memstat_stop(void)
+{
+	if (!sampler_pid || getpid() != owner_pid)
+		return;
+
+	kill(sampler_pid, SIGKILL);
+	SAFE_WAITPID(sampler_pid, NULL, 0);
+	sampler_pid = 0;
+}
+
+static unsigned int find_counter(const char *counter)
+{
+	unsigned int i;
+
+	if (!ring)
+		tst_brk(TBROK, "Memory sampler not enabled in tst_test.memstat");
+
+	for (i = 0; i < ncounters; i++) {
+		if (!strcmp(counters[i].name, counter))
+			return i + 1;
+	}
+
+	tst_brk(TBROK, "Memory counter '%s' is not sampled", counter);
+	return 0;
+}
+
+/*
+ * The slot following the last sample may be overwritten at any time, the
+ * oldest usable sample is the one after it.
+ */
+static unsigned int oldest_sample(unsigned int head)
+{
+	return head >= ring->slots ? head - ring->slots + 1 : 0;
+}
+
+long long tst_memstat_value(const char *counter)
+{
+	unsigned int idx = find_counter(counter);
+	unsigned int head = tst_atomic_load(&ring->head);
+
+	return sample_ptr(head - 1)[idx];
+}
+
+double tst_memstat_rate(const char *counter, unsigned int window_ms)
+{
+	unsigned int idx = find_counter(counter);
+	unsigned int head = tst_atomic_load(&ring->head);
+	unsigned int oldest = oldest_sample(head);
+	unsigned int first = head - 1;
+	long long *last = sample_ptr(head - 1);
+	long long *s;
+
+	while (first > oldest) {
+		s = sample_ptr(first - 1);
+
+		if (window_ms && last[0] - s[0] > window_ms * 1000LL)
+			break;
+
+		first--;
+	}
+
+	s = sample_ptr(first);
+
+	if (first == head - 1 || s[idx] < 0 || last[idx] < 0)
+		return 0;
+
+	return (double)(last[idx] - s[idx]) * 1000000 / (last[0] - s[0]);
+}
+
+static void append(char *line, size_t size, size_t *len, const char *fmt, ...)
+{
+	va_list va;
+	int ret;
+
+	if (*len >= size)
+		return;
+
+	va_start(va, fmt);
+	ret = vsnprintf(line + *len, size - *len, fmt, va);
+	va_end(va);
+
+	if (ret > 0)
+		*len += ret;
+}
+
+void tst_memstat_dump(unsigned int count)
+{
+	unsigned int head, first, i, j;
+	long long *s, *prev, val;
+	char line[1024];
+	size_t len = 0;
+
+	if (!ring)
+		return;
+
+	head = tst_atomic_load(&ring->head);
+	first = oldest_sample(head);
+
+	if (head - first > count)
+		first = head - count;
+
+	append(line, sizeof(line), &len, "%8s", "time_ms");
+	for (i = 0; i < ncounters; i++)
+		append(line, sizeof(line), &len, " %s", counters[i].name);
+
+	tst_res(TINFO, "Memory counters, last %u samples:", head - first);
+	tst_res(TINFO, "%s", line);
+
+	for (i = first; i < head; i++) {
+		s = sample_ptr(i);
+		prev = sample_ptr(i - 1);
+
+		len = 0;
+		append(line, sizeof(line), &len, "%8lli", s[0] / 1000);
+
+		for (j = 1; j <= ncounters; j++) {
+			val = s[j];
+
+			if (counters[j - 1].src == SRC_VMSTAT && i > first &&
+			    val >= 0 && prev[j] >= 0)
+				val -= prev[j];
+
+			append(line, sizeof(line), &len, " %*lli",
+			       (int)strlen(counters[j - 1].name), val);
+		}
+
+		tst_res(TINFO, "%s", line);
+	}
+}
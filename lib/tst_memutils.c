@@ -4,10 +4,15 @@
  * Copyright (c) Linux Test Project, 2021-2023
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <unistd.h>
 #include <limits.h>
+#include <sched.h>
+#include <dirent.h>
+#include <time.h>
 #include <sys/sysinfo.h>
+#include <sys/wait.h>
 #include <stdlib.h>
 
 #define TST_NO_DEFAULT_MAIN
@@ -15,17 +20,194 @@
 #include "tst_memutils.h"
 #include "tst_capability.h"
 #include "tst_safe_stdio.h"
+#include "lapi/mmap.h"
+#include "lapi/numaif.h"
 #include "lapi/syscalls.h"
 
 #define BLOCKSIZE (16 * 1024 * 1024)
+#define NODE_PATH "/sys/devices/system/node"
+#define THP_SIZE_PATH "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size"
+
+struct pollute_node {
+	/* NUMA node id, -1 if the memory is not split into nodes */
+	int id;
+	unsigned int ncpus;
+	cpu_set_t cpus;
+	unsigned long long free;
+	size_t share;
+};
+
+static unsigned int parse_cpulist(const char *str, cpu_set_t *set)
+{
+	unsigned long first, last;
+	unsigned int cnt = 0;
+	char *end;
+
+	CPU_ZERO(set);
+
+	while (*str) {
+		first = last = strtoul(str, &end, 10);
+		if (end == str)
+			break;
+
+		if (*end == '-')
+			last = strtoul(end + 1, &end, 10);
+
+		for (; first <= last && first < CPU_SETSIZE; first++) {
+			CPU_SET(first, set);
+			cnt++;
+		}
+
+		if (*end != ',')
+			break;
+
+		str = end + 1;
+	}
+
+	return cnt;
+}
+
+/*
+ * Returns the list of NUMA nodes with their free memory and the CPUs we are
+ * allowed to run on, a single pseudo node is returned on non-NUMA systems.
+ */
+static unsigned int pollute_get_nodes(struct pollute_node **nodes_ret)
+{
+	struct pollute_node *nodes = NULL, *node;
+	unsigned int cnt = 0;
+	struct dirent *ent;
+	char path[PATH_MAX], cpulist[4096];
+	cpu_set_t allowed;
+	DIR *dir;
+	int id;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))
+		tst_brk(TBROK | TERRNO, "sched_getaffinity()");
+
+	dir = opendir(NODE_PATH);
+
+	while (dir && (ent = readdir(dir))) {
+		if (sscanf(ent->d_name, "node%d", &id) != 1)
+			continue;
+
+		nodes = SAFE_REALLOC(nodes, (cnt + 1) * sizeof(*nodes));
+		node = &nodes[cnt++];
+		memset(node, 0, sizeof(*node));
+		node->id = id;
+
+		snprintf(path, sizeof(path), NODE_PATH "/node%d/cpulist", id);
+		if (!FILE_SCANF(path, "%4095s", cpulist)) {
+			parse_cpulist(cpulist, &node->cpus);
+			CPU_AND(&node->cpus, &node->cpus, &allowed);
+			node->ncpus = CPU_COUNT(&node->cpus);
+		}
+
+		snprintf(path, sizeof(path), NODE_PATH "/node%d/meminfo", id);
+		if (!FILE_LINES_SCANF(path, "Node %*d MemFree: %llu", &node->free))
+			node->free *= 1024;
+	}
+
+	if (dir)
+		closedir(dir);
+
+	if (cnt <= 1) {
+		nodes = SAFE_REALLOC(nodes, sizeof(*nodes));
+		memset(nodes, 0, sizeof(*nodes));
+		nodes->id = -1;
+		nodes->cpus = allowed;
+		nodes->ncpus = CPU_COUNT(&allowed);
+		nodes->free = 1;
+		cnt = 1;
+	}
+
+	*nodes_ret = nodes;
+
+	return cnt;
+}
+
+static void pollute_mbind(void *addr, size_t len, int node)
+{
+	unsigned long mask[node / (8 * sizeof(long)) + 1];
+
+	memset(mask, 0, sizeof(mask));
+	mask[node / (8 * sizeof(long))] = 1UL << (node % (8 * sizeof(long)));
+
+	/* Preferred policy falls back to other nodes, failure is harmless */
+	syscall(__NR_mbind, addr, len, MPOL_PREFERRED, mask,
+		8 * sizeof(mask) + 1, 0);
+}
+
+/*
+ * Fills size bytes with fillchar in blocks aligned to align, returns the
+ * number of bytes polluted. Runs in a child process.
+ */
+static size_t pollute_worker(struct pollute_node *node, size_t size,
+			     size_t blocksize, size_t align, int fillchar)
+{
+	size_t len, done = 0, page = getpagesize();
+	int populate = 1;
+	char *map, *ptr;
+
+	if (node->ncpus)
+		sched_setaffinity(0, sizeof(node->cpus), &node->cpus);
+
+	while (size - done >= page) {
+		len = MIN(blocksize, size - done) & ~(page - 1);
+
+		map = mmap(NULL, len + align, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (map == MAP_FAILED)
+			break;
+
+		ptr = map;
+
+		if (align) {
+			ptr = (char *)(((uintptr_t)map + align - 1) & ~(align - 1));
+
+			if (ptr != map)
+				munmap(map, ptr - map);
+
+			munmap(ptr + len, map + align - ptr);
+		}
+
+		if (node->id >= 0)
+			pollute_mbind(ptr, len, node->id);
+
+		/*
+		 * Faulting the pages in the kernel is faster than faulting
+		 * them one by one from memset(). Fresh pages are zeroed so
+		 * zero filled pollution does not need the memset().
+		 */
+		if (populate && madvise(ptr, len, MADV_POPULATE_WRITE)) {
+			if (errno != EINVAL)
+				break;
+
+			populate = 0;
+		}
+
+		if (fillchar || !populate)
+			memset(ptr, fillchar, len);
+
+		done += len;
+	}
+
+	return done;
+}
 
 void tst_pollute_memory(size_t maxsize, int fillchar)
 {
-	size_t i, map_count = 0, safety = 0, blocksize = BLOCKSIZE;
-	unsigned long long freeram;
+	size_t safety = 0, blocksize = BLOCKSIZE, align = 0, share;
+	size_t res, polluted = 0, page = getpagesize();
+	unsigned long long freeram, node_free = 0;
+	unsigned int i, j, node_cnt, workers, worker_cnt = 0;
+	struct pollute_node *nodes;
+	struct timespec start, end;
 	size_t min_free;
-	void **map_blocks;
 	struct sysinfo info;
+	int done[2], release[2];
+	pid_t *pids;
+	double secs;
 
 	SAFE_FILE_SCANF("/proc/sys/vm/min_free_kbytes", "%zi", &min_free);
 	min_free *= 1024;
@@ -59,30 +241,98 @@ void tst_pollute_memory(size_t maxsize, int fillchar)
 	if (freeram - safety < maxsize / info.mem_unit)
 		maxsize = (freeram - safety) * info.mem_unit;
 
+	/* Align the blocks so that they can be backed by transparent huge pages */
+	if (!FILE_SCANF(THP_SIZE_PATH, "%zu", &align) && align > page) {
+		blocksize = (blocksize + align - 1) / align * align;
+	} else {
+		align = 0;
+	}
+
 	blocksize = MIN(maxsize, blocksize);
-	map_count = maxsize / blocksize;
-	map_blocks = SAFE_MALLOC(map_count * sizeof(void *));
+	if (blocksize < align)
+		align = 0;
+
+	node_cnt = pollute_get_nodes(&nodes);
+
+	for (i = 0; i < node_cnt; i++)
+		node_free += nodes[i].free;
+
+	if (!node_free) {
+		free(nodes);
+		return;
+	}
+
+	pids = SAFE_MALLOC(sizeof(*pids) * CPU_SETSIZE * node_cnt);
+	SAFE_PIPE(done);
+	SAFE_PIPE(release);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
 
 	/*
-	 * Keep allocating until the first failure. The address space may be
-	 * too fragmented or just smaller than maxsize.
+	 * Each node gets a share of maxsize proportional to its free memory,
+	 * the share is split between processes running on the node CPUs so
+	 * that the pages are allocated and written locally.
 	 */
-	for (i = 0; i < map_count; i++) {
-		map_blocks[i] = mmap(NULL, blocksize, PROT_READ | PROT_WRITE,
-			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	for (i = 0; i < node_cnt; i++) {
+		share = (double)maxsize * nodes[i].free / node_free;
+		workers = MAX(1U, MIN(nodes[i].ncpus, share / blocksize));
 
-		if (map_blocks[i] == MAP_FAILED) {
-			map_count = i;
-			break;
-		}
+		if (share < page)
+			continue;
+
+		for (j = 0; j < workers; j++) {
+			pids[worker_cnt] = fork();
+
+			if (pids[worker_cnt] < 0)
+				tst_brk(TBROK | TERRNO, "fork()");
+
+			if (!pids[worker_cnt]) {
+				close(done[0]);
+				close(release[1]);
+
+				res = pollute_worker(&nodes[i], share / workers,
+						     blocksize, align, fillchar);
+
+				/* Keep the memory until all workers are done */
+				if (write(done[1], &res, sizeof(res)) != sizeof(res))
+					_exit(1);
 
-		memset(map_blocks[i], fillchar, blocksize);
+				close(done[1]);
+
+				/* Returns 0 once the parent closes the pipe */
+				if (read(release[0], &res, 1))
+					_exit(1);
+
+				_exit(0);
+			}
+
+			worker_cnt++;
+		}
 	}
 
-	for (i = 0; i < map_count; i++)
-		SAFE_MUNMAP(map_blocks[i], blocksize);
+	SAFE_CLOSE(done[1]);
+	SAFE_CLOSE(release[0]);
+
+	/* Returns 0 once all workers reported or died */
+	while (SAFE_READ(0, done[0], &res, sizeof(res)) == sizeof(res))
+		polluted += res;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	SAFE_CLOSE(release[1]);
+	SAFE_CLOSE(done[0]);
+
+	for (i = 0; i < worker_cnt; i++)
+		SAFE_WAITPID(pids[i], NULL, 0);
+
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	tst_res(TINFO, "Polluted %zuMB with %u processes on %u node(s) in %.2fs (%.2f GB/s)",
+		polluted >> 20, worker_cnt, nodes[0].id < 0 ? 1 : node_cnt,
+		secs, polluted / secs / (1 << 30));
 
-	free(map_blocks);
+	free(pids);
+	free(nodes);
 }
 
 long long tst_available_mem(void)
@@ -15,12 +15,306 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
 #include "test.h"
 #include "tso_priv.h"
 #include "tst_mkfs.h"
 #include "tst_device.h"
+#include "lapi/seek.h"
+
+#ifndef BLKZEROOUT
+# define BLKZEROOUT _IO(0x12, 127)
+#endif
 
 #define OPTS_MAX 32
+#define CACHE_CHUNK (1024 * 1024)
+
+static uint64_t fnv1a(uint64_t hash, const char *str)
+{
+	while (*str) {
+		hash ^= (unsigned char)*str++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static int get_dev_bytes(int dev_fd, uint64_t *size)
+{
+	if (ioctl(dev_fd, BLKGETSIZE64, size))
+		return 1;
+
+	return 0;
+}
+
+/*
+ * The cached images are keyed by the filesystem type, device size, mkfs
+ * options and the mkfs binary size and mtime so that an mkfs update
+ * invalidates the cache.
+ */
+static int mkfs_cache_path(char *path, size_t path_len, const char *dev,
+			   const char *mkfs, const char *fs_opts,
+			   const char *extra_opts)
+{
+	const char *cache_dir = getenv("LTP_MKFS_CACHE");
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	char mkfs_path[PATH_MAX];
+	char key[PATH_MAX + 64];
+	uint64_t dev_size;
+	struct stat st;
+	int dev_fd, ret;
+
+	if (!cache_dir)
+		return 1;
+
+	if (tst_get_path(mkfs, mkfs_path, sizeof(mkfs_path)))
+		return 1;
+
+	if (stat(mkfs_path, &st))
+		return 1;
+
+	dev_fd = open(dev, O_RDONLY);
+	if (dev_fd < 0)
+		return 1;
+
+	ret = get_dev_bytes(dev_fd, &dev_size);
+	close(dev_fd);
+
+	if (ret)
+		return 1;
+
+	snprintf(key, sizeof(key), "%s %lli %lli", mkfs_path,
+		 (long long)st.st_size, (long long)st.st_mtime);
+
+	hash = fnv1a(hash, key);
+	hash = fnv1a(hash, "|");
+	hash = fnv1a(hash, fs_opts);
+	hash = fnv1a(hash, "|");
+	hash = fnv1a(hash, extra_opts);
+
+	snprintf(path, path_len, "%s/%s-%"PRIu64"-%016"PRIx64".img",
+		 cache_dir, mkfs, dev_size, hash);
+
+	return 0;
+}
+
+static int copy_range(int src_fd, int dst_fd, off_t off, off_t len, char *buf)
+{
+	ssize_t rd, wr, pos;
+
+	while (len > 0) {
+		rd = pread(src_fd, buf, MIN(len, CACHE_CHUNK), off);
+		if (rd <= 0)
+			return 1;
+
+		for (pos = 0; pos < rd; pos += wr) {
+			wr = pwrite(dst_fd, buf + pos, rd - pos, off + pos);
+			if (wr <= 0)
+				return 1;
+		}
+
+		off += rd;
+		len -= rd;
+	}
+
+	return 0;
+}
+
+static int zero_range(int dev_fd, off_t off, off_t len, char *buf)
+{
+	uint64_t range[2] = {off, len};
+	ssize_t wr;
+
+	if (!ioctl(dev_fd, BLKZEROOUT, range))
+		return 0;
+
+	memset(buf, 0, CACHE_CHUNK);
+
+	while (len > 0) {
+		wr = pwrite(dev_fd, buf, MIN(len, CACHE_CHUNK), off);
+		if (wr <= 0)
+			return 1;
+
+		off += wr;
+		len -= wr;
+	}
+
+	return 0;
+}
+
+/*
+ * Writes the data extents from the sparse image into the device and zeroes
+ * the rest, which is usually much faster than running mkfs.
+ */
+static int mkfs_cache_restore(const char *dev, const char *path)
+{
+	int img_fd, dev_fd = -1, ret = 1;
+	off_t off = 0, data, hole, size;
+	uint64_t dev_size;
+	char *buf = NULL;
+
+	img_fd = open(path, O_RDONLY);
+	if (img_fd < 0)
+		return 1;
+
+	dev_fd = open(dev, O_WRONLY);
+	if (dev_fd < 0)
+		goto out;
+
+	size = lseek(img_fd, 0, SEEK_END);
+
+	if (get_dev_bytes(dev_fd, &dev_size) || (uint64_t)size != dev_size)
+		goto out;
+
+	buf = malloc(CACHE_CHUNK);
+	if (!buf)
+		goto out;
+
+	while (off < size) {
+		data = lseek(img_fd, off, SEEK_DATA);
+		if (data < 0) {
+			if (errno != ENXIO)
+				goto out;
+			data = size;
+		}
+
+		if (data > off && zero_range(dev_fd, off, data - off, buf))
+			goto out;
+
+		if (data >= size)
+			break;
+
+		hole = lseek(img_fd, data, SEEK_HOLE);
+		if (hole < 0)
+			goto out;
+
+		if (copy_range(img_fd, dev_fd, data, hole - data, buf))
+			goto out;
+
+		off = hole;
+	}
+
+	ret = fsync(dev_fd);
+out:
+	free(buf);
+
+	if (dev_fd >= 0)
+		close(dev_fd);
+
+	close(img_fd);
+
+	return ret;
+}
+
+/*
+ * Restored images share the filesystem UUID with the cached image, which
+ * breaks when more devices restored from the same image are used at once,
+ * e.g. xfs refuses to mount a duplicate UUID and btrfs device scan mixes the
+ * filesystems up. Generate a new identity for the filesystem types that care.
+ */
+static int mkfs_cache_new_uuid(void (cleanup_fn)(void), const char *dev,
+			       const char *fs_type)
+{
+	const char *argv[6] = {};
+
+	if (!strncmp(fs_type, "ext", 3)) {
+		argv[0] = "tune2fs";
+		argv[1] = "-f";
+		argv[2] = "-U";
+		argv[3] = "random";
+		argv[4] = dev;
+	} else if (!strcmp(fs_type, "xfs")) {
+		argv[0] = "xfs_admin";
+		argv[1] = "-U";
+		argv[2] = "generate";
+		argv[3] = dev;
+	} else if (!strcmp(fs_type, "btrfs")) {
+		argv[0] = "btrfstune";
+		argv[1] = "-f";
+		argv[2] = "-u";
+		argv[3] = dev;
+	} else {
+		return 0;
+	}
+
+	return tst_cmd(cleanup_fn, argv, "/dev/null", "/dev/null",
+		       TST_CMD_PASS_RETVAL);
+}
+
+static int is_zero(const char *buf, size_t len)
+{
+	return !buf[0] && !memcmp(buf, buf + 1, len - 1);
+}
+
+/*
+ * Copies the freshly formatted device into a sparse image, the image is
+ * created under a temporary name and renamed so that concurrently running
+ * tests never see a partially written image.
+ */
+static void mkfs_cache_store(const char *file, const int lineno,
+			     const char *dev, const char *path)
+{
+	char tmp_path[PATH_MAX + 16];
+	int dev_fd, img_fd = -1, ret = 1;
+	uint64_t size, off;
+	ssize_t len;
+	char *buf = NULL;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%i", path, getpid());
+
+	dev_fd = open(dev, O_RDONLY);
+	if (dev_fd < 0)
+		goto out;
+
+	if (get_dev_bytes(dev_fd, &size))
+		goto out;
+
+	img_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (img_fd < 0)
+		goto out;
+
+	buf = malloc(CACHE_CHUNK);
+	if (!buf)
+		goto out;
+
+	for (off = 0; off < size; off += len) {
+		len = pread(dev_fd, buf, MIN(size - off, CACHE_CHUNK), off);
+		if (len <= 0)
+			goto out;
+
+		if (is_zero(buf, len))
+			continue;
+
+		if (pwrite(img_fd, buf, len, off) != len)
+			goto out;
+	}
+
+	if (ftruncate(img_fd, size) || fsync(img_fd))
+		goto out;
+
+	ret = rename(tmp_path, path);
+out:
+	if (ret) {
+		tst_resm_(file, lineno, TINFO | TERRNO,
+			  "Failed to store mkfs image into '%s'", path);
+		unlink(tmp_path);
+	}
+
+	free(buf);
+
+	if (img_fd >= 0)
+		close(img_fd);
+
+	if (dev_fd >= 0)
+		close(dev_fd);
+}
 
 void tst_mkfs_(const char *file, const int lineno, void (cleanup_fn)(void),
 	       const char *dev, const char *fs_type,
@@ -31,6 +325,8 @@ void tst_mkfs_(const char *file, const int lineno, void (cleanup_fn)(void),
 	const char *argv[OPTS_MAX] = {mkfs};
 	char fs_opts_str[1024] = "";
 	char extra_opts_str[1024] = "";
+	char cache_path[PATH_MAX];
+	int cache;
 
 	if (!dev) {
 		tst_brkm_(file, lineno, TBROK, cleanup_fn,
@@ -91,6 +387,17 @@ void tst_mkfs_(const char *file, const int lineno, void (cleanup_fn)(void),
 
 	argv[pos] = NULL;
 
+	cache = !mkfs_cache_path(cache_path, sizeof(cache_path), dev, mkfs,
+				 fs_opts_str, extra_opts_str);
+
+	if (cache && !mkfs_cache_restore(dev, cache_path) &&
+	    !mkfs_cache_new_uuid(cleanup_fn, dev, fs_type)) {
+		tst_resm_(file, lineno, TINFO,
+			"Restored %s with %s opts='%s' extra opts='%s' from '%s'",
+			dev, fs_type, fs_opts_str, extra_opts_str, cache_path);
+		return;
+	}
+
 	if (tst_clear_device(dev)) {
 		tst_brkm_(file, lineno, TBROK, cleanup_fn,
 			"tst_clear_device() failed");
@@ -115,7 +422,11 @@ void tst_mkfs_(const char *file, const int lineno, void (cleanup_fn)(void),
 			"Consider disabling background probing services.");
 		tst_brkm_(file, lineno, TBROK, cleanup_fn,
 			"%s failed with exit code %i", mkfs, ret);
+		return;
 	}
+
+	if (cache)
+		mkfs_cache_store(file, lineno, dev, cache_path);
 }
 
 const char *tst_dev_fs_type(void)
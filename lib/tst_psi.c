@@ -0,0 +1,239 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define TST_NO_DEFAULT_MAIN
+#include "tst_test.h"
+#include "tst_timer.h"
+#include "tst_psi.h"
+#include "lapi/syscalls.h"
+
+static int open_cg_file(const struct tst_cg_group *cg, const char *file_name,
+			int flags)
+{
+	int dir_fd = tst_cg_group_unified_dir_fd(cg);
+	int fd;
+
+	if (dir_fd < 0)
+		return -1;
+
+	fd = openat(dir_fd, file_name, flags);
+	if (fd < 0 && errno != ENOENT)
+		tst_brk(TBROK | TERRNO, "openat(%s)", file_name);
+
+	return fd;
+}
+
+int tst_psi_arm(struct tst_psi_event *ev, const struct tst_cg_group *cg,
+		const char *resource, int full, unsigned int stall_us,
+		unsigned int window_us)
+{
+	char path[PATH_MAX];
+	char trig[64];
+	int flags = O_RDWR | O_NONBLOCK | O_CLOEXEC;
+	int len;
+
+	ev->fd = -1;
+	ev->key = NULL;
+	ev->count = 0;
+	ev->time_us = 0;
+
+	if (cg) {
+		snprintf(path, sizeof(path), "%s.pressure", resource);
+		ev->fd = open_cg_file(cg, path, flags);
+	} else {
+		snprintf(path, sizeof(path), "/proc/pressure/%s", resource);
+		ev->fd = open(path, flags);
+		if (ev->fd < 0 && errno != ENOENT && errno != EOPNOTSUPP)
+			tst_brk(TBROK | TERRNO, "open(%s)", path);
+	}
+
+	if (ev->fd < 0)
+		return -1;
+
+	len = snprintf(trig, sizeof(trig), "%s %u %u", full ? "full" : "some",
+		       stall_us, window_us);
+
+	/* Kernel rejects the trigger with EOPNOTSUPP when PSI is disabled */
+	if (write(ev->fd, trig, len + 1) < 0) {
+		if (errno != EOPNOTSUPP)
+			tst_brk(TBROK | TERRNO, "write(%s, '%s')", path, trig);
+
+		tst_psi_disarm(ev);
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ev->start);
+
+	return 0;
+}
+
+static long long read_event_count(struct tst_psi_event *ev)
+{
+	char buf[1024], *line;
+	size_t key_len = strlen(ev->key);
+	ssize_t len;
+
+	len = pread(ev->fd, buf, sizeof(buf) - 1, 0);
+	if (len < 0)
+		tst_brk(TBROK | TERRNO, "pread(memory.events)");
+
+	buf[len] = 0;
+
+	for (line = buf; line && *line; line = strchr(line, '\n')) {
+		if (*line == '\n')
+			line++;
+
+		if (!strncmp(line, ev->key, key_len) && line[key_len] == ' ')
+			return atoll(line + key_len + 1);
+	}
+
+	tst_brk(TBROK, "No '%s' in memory.events", ev->key);
+	return -1;
+}
+
+int tst_psi_arm_events(struct tst_psi_event *ev, const struct tst_cg_group *cg,
+		       const char *key)
+{
+	ev->key = key;
+	ev->time_us = 0;
+	ev->fd = open_cg_file(cg, "memory.events", O_RDONLY | O_CLOEXEC);
+
+	if (ev->fd < 0)
+		return -1;
+
+	/* Reading the file also arms the kernfs notification */
+	ev->count = read_event_count(ev);
+	clock_gettime(CLOCK_MONOTONIC, &ev->start);
+
+	return 0;
+}
+
+static void event_fired(struct tst_psi_event *ev)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ev->time_us = tst_timespec_diff_us(now, ev->start);
+	ev->start = now;
+}
+
+static int check_event(struct tst_psi_event *ev, short revents)
+{
+	long long count;
+
+	if (revents & (POLLNVAL | POLLHUP) ||
+	    (!ev->key && revents & POLLERR))
+		tst_brk(TBROK, "PSI trigger poll() revents %x", revents);
+
+	if (!(revents & POLLPRI))
+		return 0;
+
+	if (!ev->key)
+		return 1;
+
+	/* Any counter in memory.events may have changed */
+	count = read_event_count(ev);
+	if (count == ev->count)
+		return 0;
+
+	ev->count = count;
+	return 1;
+}
+
+static int pid_exited(pid_t pid)
+{
+	siginfo_t info = {};
+
+	if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT))
+		tst_brk(TBROK | TERRNO, "waitid(%i)", pid);
+
+	return info.si_pid == pid;
+}
+
+static int do_wait(struct tst_psi_event *ev, pid_t pid, int timeout_ms)
+{
+	struct pollfd fds[2] = {{.fd = ev->fd, .events = POLLPRI}};
+	struct timespec start, now;
+	int nfds = 1, pidfd = -1, poll_ms, ret;
+	long long elapsed = 0;
+
+	if (ev->fd < 0)
+		tst_brk(TBROK, "Waiting on a disarmed PSI event");
+
+	if (pid > 0) {
+		/* Raw syscall so that old kernels fall back to waitid() */
+		pidfd = syscall(__NR_pidfd_open, pid, 0);
+		if (pidfd >= 0) {
+			fds[1].fd = pidfd;
+			fds[1].events = POLLIN;
+			nfds = 2;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (;;) {
+		poll_ms = timeout_ms < 0 ? -1 : timeout_ms - elapsed;
+
+		if (pid > 0 && pidfd < 0 && (poll_ms < 0 || poll_ms > 100))
+			poll_ms = 100;
+
+		ret = poll(fds, nfds, poll_ms);
+		if (ret < 0 && errno != EINTR)
+			tst_brk(TBROK | TERRNO, "poll()");
+
+		if (ret > 0 && check_event(ev, fds[0].revents)) {
+			event_fired(ev);
+			ret = 1;
+			break;
+		}
+
+		if (pid > 0 && (pidfd >= 0 ? fds[1].revents : pid_exited(pid))) {
+			ret = 0;
+			break;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = tst_timespec_diff_ms(now, start);
+
+		if (timeout_ms >= 0 && elapsed >= timeout_ms) {
+			ret = 0;
+			break;
+		}
+	}
+
+	if (pidfd >= 0)
+		SAFE_CLOSE(pidfd);
+
+	return ret;
+}
+
+int tst_psi_wait(struct tst_psi_event *ev, int timeout_ms)
+{
+	return do_wait(ev, 0, timeout_ms);
+}
+
+int tst_psi_wait_pid(struct tst_psi_event *ev, pid_t pid, int timeout_ms)
+{
+	return do_wait(ev, pid, timeout_ms);
+}
+
+void tst_psi_disarm(struct tst_psi_event *ev)
+{
+	if (ev->fd >= 0)
+		SAFE_CLOSE(ev->fd);
+
+	ev->fd = -1;
+}
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Bounded multi-producer single-consumer queue, each slot carries a sequence
+ * number. A free slot for position pos has seq == pos, producers claim the
+ * slot by advancing the head with compare and exchange and commit it by
+ * setting seq to pos + 1. The consumer reads committed slots and releases
+ * them for the next lap by setting seq to pos + slots.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tst_res_flags.h"
+#include "tst_res_ring.h"
+
+void tst_res_ring_init(struct tst_res_ring *ring, unsigned int slots)
+{
+	unsigned int i;
+
+	memset(ring, 0, tst_res_ring_size(slots));
+
+	ring->slots = slots;
+
+	for (i = 0; i < slots; i++)
+		ring->recs[i].seq = i;
+}
+
+static void copy_str(char *dst, const char *src, size_t size)
+{
+	size_t len;
+
+	if (!src) {
+		dst[0] = 0;
+		return;
+	}
+
+	len = strlen(src);
+
+	if (len >= size)
+		len = size - 1;
+
+	memcpy(dst, src, len);
+	dst[len] = 0;
+}
+
+static const char *basename_of(const char *path)
+{
+	const char *base = strrchr(path, '/');
+
+	return base ? base + 1 : path;
+}
+
+void tst_res_ring_push(struct tst_res_ring *ring, const char *file,
+		       int lineno, int ttype, int err,
+		       unsigned int variant, int tcase,
+		       const char *fs_type, const char *msg)
+{
+	struct tst_res_rec *rec;
+	struct timespec ts;
+	uint32_t pos, seq;
+
+	pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+	for (;;) {
+		rec = &ring->recs[pos % ring->slots];
+		seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+
+		int32_t diff = (int32_t)(seq - pos);
+
+		if (!diff) {
+			if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1,
+							1, __ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			__atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+			return;
+		} else {
+			pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	rec->ttype = ttype;
+	rec->err = err;
+	rec->lineno = lineno;
+	rec->pid = getpid();
+	rec->variant = variant;
+	rec->tcase = tcase;
+	rec->time_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	copy_str(rec->file, basename_of(file), sizeof(rec->file));
+	copy_str(rec->fs_type, fs_type, sizeof(rec->fs_type));
+	copy_str(rec->msg, msg, sizeof(rec->msg));
+
+	__atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+static const char *ttype_name(int ttype)
+{
+	switch (TTYPE_RESULT(ttype)) {
+	case TPASS:
+		return "TPASS";
+	case TFAIL:
+		return "TFAIL";
+	case TBROK:
+		return "TBROK";
+	case TCONF:
+		return "TCONF";
+	case TWARN:
+		return "TWARN";
+	case TINFO:
+		return "TINFO";
+	case TDEBUG:
+		return "TDEBUG";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+static size_t json_str(char *buf, size_t size, const char *str)
+{
+	size_t pos = 0;
+
+	for (; *str && pos + 8 < size; str++) {
+		unsigned char c = *str;
+
+		switch (c) {
+		case '"':
+		case '\\':
+			buf[pos++] = '\\';
+			buf[pos++] = c;
+		break;
+		case '\n':
+			buf[pos++] = '\\';
+			buf[pos++] = 'n';
+		break;
+		case '\t':
+			buf[pos++] = '\\';
+			buf[pos++] = 't';
+		break;
+		default:
+			if (c < 0x20)
+				pos += snprintf(buf + pos, size - pos, "\\u%04x", c);
+			else
+				buf[pos++] = c;
+		}
+	}
+
+	buf[pos] = 0;
+
+	return pos;
+}
+
+static void write_rec(int fd, const struct tst_res_rec *rec, const char *tcid)
+{
+	char msg[2 * TST_RES_REC_MSG];
+	char fs_type[2 * sizeof(rec->fs_type)];
+	char file[2 * sizeof(rec->file)];
+
+	json_str(msg, sizeof(msg), rec->msg);
+	json_str(fs_type, sizeof(fs_type), rec->fs_type);
+	json_str(file, sizeof(file), rec->file);
+
+	dprintf(fd, "{\"test\": \"%s\", \"type\": \"%s\", \"errno\": %i, "
+		"\"file\": \"%s\", \"line\": %i, \"pid\": %i, "
+		"\"time\": %llu.%09llu, \"variant\": %u, \"tcase\": %i, "
+		"\"fs_type\": \"%s\", \"msg\": \"%s\"}\n",
+		tcid, ttype_name(rec->ttype), rec->err, file, rec->lineno,
+		rec->pid, (unsigned long long)rec->time_ns / 1000000000,
+		(unsigned long long)rec->time_ns % 1000000000, rec->variant,
+		rec->tcase, fs_type, msg);
+}
+
+unsigned int tst_res_ring_drain(struct tst_res_ring *ring, int fd,
+				const char *tcid, int final)
+{
+	struct tst_res_rec *rec;
+	unsigned int ret = 0;
+	uint32_t pos, seq;
+
+	for (;;) {
+		pos = ring->tail;
+		rec = &ring->recs[pos % ring->slots];
+		seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+
+		if (seq != pos + 1) {
+			/* Producer was killed between claiming and committing */
+			if (!final || pos == __atomic_load_n(&ring->head, __ATOMIC_RELAXED))
+				break;
+
+			__atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+		} else {
+			write_rec(fd, rec, tcid);
+			ret++;
+		}
+
+		ring->tail = pos + 1;
+		__atomic_store_n(&rec->seq, pos + ring->slots, __ATOMIC_RELEASE);
+	}
+
+	return ret;
+}
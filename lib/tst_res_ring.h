@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ *
+ * Multi-producer single-consumer ring of test results stored in the test
+ * library shared memory. Internal to the test library.
+ */
+
+#ifndef TST_RES_RING_H
+#define TST_RES_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TST_RES_REC_MSG 424
+
+struct tst_res_rec {
+	/* Slot sequence number, see tst_res_ring.c */
+	uint32_t seq;
+	int32_t ttype;
+	int32_t err;
+	int32_t lineno;
+	int32_t pid;
+	uint32_t variant;
+	int32_t tcase;
+	uint32_t pad;
+	uint64_t time_ns;
+	char file[32];
+	char fs_type[16];
+	char msg[TST_RES_REC_MSG];
+};
+
+struct tst_res_ring {
+	uint32_t slots;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t dropped;
+	struct tst_res_rec recs[];
+};
+
+static inline size_t tst_res_ring_size(unsigned int slots)
+{
+	return sizeof(struct tst_res_ring) + slots * sizeof(struct tst_res_rec);
+}
+
+void tst_res_ring_init(struct tst_res_ring *ring, unsigned int slots);
+
+/*
+ * Stores a result into the ring, the function is lock-free and async-signal
+ * safe. If the ring is full the result is dropped and accounted in the
+ * dropped counter.
+ */
+void tst_res_ring_push(struct tst_res_ring *ring, const char *file,
+		       int lineno, int ttype, int err,
+		       unsigned int variant, int tcase,
+		       const char *fs_type, const char *msg);
+
+/*
+ * Writes all committed results as JSON lines into fd. Must be called only
+ * from a single process. If final is set all producers have to be finished
+ * and slots that were claimed but never committed are skipped.
+ *
+ * Returns number of records written.
+ */
+unsigned int tst_res_ring_drain(struct tst_res_ring *ring, int fd,
+				const char *tcid, int final);
+
+#endif /* TST_RES_RING_H */
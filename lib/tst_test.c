@@ -39,6 +39,7 @@
 #include "tso_tmpdir.h"
 #include "ltp-version.h"
 #include "tst_hugepage.h"
+#include "tst_res_ring.h"
 
 /*
  * Hack to get TCID defined in newlib tests
@@ -54,6 +55,12 @@ const char *TCID __attribute__((weak));
 
 #define DEFAULT_TIMEOUT 30
 
+/* Number of slots in the result ring enabled by LTP_RESULTS_JSON */
+#define RES_RING_SLOTS 512
+
+/* Number of memory counter samples printed when the test fails */
+#define MEMSTAT_DUMP_SAMPLES 50
+
 /* Magic number is "LTPM" */
 #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
 # define LTP_MAGIC 0x4C54504D
@@ -83,6 +90,9 @@ struct context {
 	uint32_t mntpoint_mounted:1;
 	uint32_t ovl_mounted:1;
 	uint32_t tdebug;
+	/* Shared so that exec()'d children report the right test case */
+	uint32_t variant;
+	int32_t tcase;
 };
 
 struct results {
@@ -95,6 +105,9 @@ struct results {
 
 struct ipc_region {
 	int32_t magic;
+	/* Size of the whole shared memory including the result ring */
+	uint32_t size;
+	uint32_t ring_off;
 	struct context context;
 	struct results results;
 	futex_t futexes[];
@@ -103,6 +116,8 @@ struct ipc_region {
 static struct ipc_region *ipc;
 static struct context *context;
 static struct results *results;
+static struct tst_res_ring *res_ring;
+static int res_json_fd = -1;
 
 extern volatile void *tst_futexes;
 extern unsigned int tst_max_futexes;
@@ -122,6 +137,15 @@ static void do_exit(int ret) __attribute__ ((noreturn));
 static void setup_ipc(void)
 {
 	size_t size = getpagesize();
+	const char *res_json = getenv("LTP_RESULTS_JSON");
+
+	if (res_json) {
+		res_json_fd = open(res_json, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (res_json_fd < 0)
+			tst_brk(TBROK | TERRNO, "open(%s)", res_json);
+
+		size += tst_res_ring_size(RES_RING_SLOTS);
+	}
 
 	if (access("/dev/shm", F_OK) == 0) {
 		snprintf(shm_path, sizeof(shm_path), "/dev/shm/ltp_%s_%d",
@@ -152,13 +176,21 @@ static void setup_ipc(void)
 	memset(ipc, 0, size);
 
 	ipc->magic = LTP_MAGIC;
+	ipc->size = size;
 	context = &ipc->context;
 	results = &ipc->results;
 	context->lib_pid = getpid();
+	context->tcase = -1;
+
+	if (res_json_fd >= 0) {
+		ipc->ring_off = getpagesize();
+		res_ring = (void *)ipc + ipc->ring_off;
+		tst_res_ring_init(res_ring, RES_RING_SLOTS);
+	}
 
 	if (tst_test->needs_checkpoints) {
 		tst_futexes = ipc->futexes;
-		tst_max_futexes = (size - offsetof(struct ipc_region, futexes)) / sizeof(futex_t);
+		tst_max_futexes = (getpagesize() - offsetof(struct ipc_region, futexes)) / sizeof(futex_t);
 	}
 
 	/* Set environment variable for exec()'d children */
@@ -170,10 +202,21 @@ static void setup_ipc(void)
 	}
 }
 
-static void cleanup_ipc(void)
+static void drain_res_ring(int final)
 {
-	size_t size = getpagesize();
+	if (!res_ring || getpid() != context->lib_pid)
+		return;
+
+	tst_res_ring_drain(res_ring, res_json_fd, tcid, final);
+
+	if (final && res_ring->dropped) {
+		tst_res(TINFO, "%u results were not stored into LTP_RESULTS_JSON",
+			res_ring->dropped);
+	}
+}
 
+static void cleanup_ipc(void)
+{
 	if (ipc_fd > 0 && close(ipc_fd))
 		tst_res(TWARN | TERRNO, "close(ipc_fd) failed");
 
@@ -181,11 +224,19 @@ static void cleanup_ipc(void)
 		tst_res(TWARN | TERRNO, "unlink(%s) failed", shm_path);
 
 	if (ipc) {
+		size_t size = ipc->size;
+
 		msync((void *)ipc, size, MS_SYNC);
 		munmap((void *)ipc, size);
 		ipc = NULL;
 		context = NULL;
 		results = NULL;
+		res_ring = NULL;
+	}
+
+	if (res_json_fd >= 0) {
+		close(res_json_fd);
+		res_json_fd = -1;
 	}
 }
 
@@ -206,17 +257,30 @@ void tst_reinit(void)
 
 	fd = SAFE_OPEN(path, O_RDWR);
 	ipc = SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-	SAFE_CLOSE(fd);
 
 	if (ipc->magic != LTP_MAGIC)
 		tst_brk(TBROK, "Invalid shared memory region (bad magic)");
 
+	if (ipc->size > size) {
+		size = ipc->size;
+		SAFE_MUNMAP((void *)ipc, getpagesize());
+		ipc = SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+
+	SAFE_CLOSE(fd);
+
+	if (ipc->ring_off)
+		res_ring = (void *)ipc + ipc->ring_off;
+
 	/* Restore the parent context from IPC region */
 	context = &ipc->context;
 	results = &ipc->results;
 
+	tst_variant = context->variant;
+	tst_tcase = context->tcase;
+
 	tst_futexes = ipc->futexes;
-	tst_max_futexes = (size - offsetof(struct ipc_region, futexes)) / sizeof(futex_t);
+	tst_max_futexes = (getpagesize() - offsetof(struct ipc_region, futexes)) / sizeof(futex_t);
 
 	tst_res(TDEBUG, "Restored metadata for PID %d", getpid());
 }
@@ -293,8 +357,8 @@ static void print_result(const char *file, const int lineno, int ttype,
 			 const char *fmt, va_list va)
 {
 	char buf[1024];
-	char *str = buf;
-	int ret, size = sizeof(buf), ssize, int_errno, buflen;
+	char *str = buf, *msg;
+	int ret, size = sizeof(buf), ssize, int_errno = 0, buflen;
 	const char *str_errno = NULL;
 	const char *res;
 
@@ -355,6 +419,7 @@ static void print_result(const char *file, const int lineno, int ttype,
 		ret = snprintf(str, size, "%s: ", res);
 	str += ret;
 	size -= ret;
+	msg = str;
 
 	if (reproducible_output)
 		goto print;
@@ -379,6 +444,14 @@ static void print_result(const char *file, const int lineno, int ttype,
 print:
 	snprintf(str, size, "\n");
 
+	if (res_ring) {
+		*str = 0;
+		tst_res_ring_push(res_ring, file, lineno, ttype, int_errno,
+				  context->variant, context->tcase,
+				  tst_device ? tst_device->fs_type : NULL, msg);
+		*str = '\n';
+	}
+
 	/* we might be called from signal handler, so use write() */
 	buflen = str - buf + 1;
 	str = buf;
@@ -682,6 +755,7 @@ static void print_help(void)
 	fprintf(stderr, "LTP_FORCE_SINGLE_FS_TYPE Testing only. The same as LTP_SINGLE_FS_TYPE but ignores test skiplist.\n");
 	fprintf(stderr, "LTP_TIMEOUT_MUL          Timeout multiplier (must be a number >=1)\n");
 	fprintf(stderr, "LTP_RUNTIME_MUL          Runtime multiplier (must be a number >0)\n");
+	fprintf(stderr, "LTP_TMPDIR_PURGE         Remove test tmpdir in parallel (fast) or in background (async)\n");
 	fprintf(stderr, "LTP_VIRT_OVERRIDE        Overrides virtual machine detection (values: \"\"|kvm|microsoft|xen|zvm)\n");
 	fprintf(stderr, "TMPDIR                   Base directory for template directory (for .needs_tmpdir, default: %s)\n", TEMPDIR);
 	fprintf(stderr, "\n");
@@ -1022,6 +1096,8 @@ static void print_failure_hints(void)
  */
 static void do_exit(int ret)
 {
+	drain_res_ring(1);
+
 	if (results) {
 		if (results->passed && ret == TCONF)
 			ret = 0;
@@ -1044,6 +1120,11 @@ static void do_exit(int ret)
 				print_failure_hints();
 		}
 
+		if (results->failed || results->broken) {
+			tst_memstat_stop();
+			tst_memstat_dump(MEMSTAT_DUMP_SAMPLES);
+		}
+
 		fprintf(stderr, "\nSummary:\n");
 		fprintf(stderr, "passed   %d\n", results->passed);
 		fprintf(stderr, "failed   %d\n", results->failed);
@@ -1648,6 +1729,8 @@ static void do_test_setup(void)
 
 static void do_cleanup(void)
 {
+	tst_memstat_stop();
+
 	if (tst_test->needs_cgroup_ctrls)
 		tst_cg_cleanup();
 
@@ -1697,6 +1780,8 @@ static void run_tests(void)
 	unsigned int i;
 	struct results saved_results;
 
+	context->tcase = -1;
+
 	if (!tst_test->test) {
 		saved_results = *results;
 		heartbeat();
@@ -1715,6 +1800,8 @@ static void run_tests(void)
 
 	for (i = 0; i < tst_test->tcnt; i++) {
 		saved_results = *results;
+		tst_tcase = i;
+		context->tcase = i;
 		heartbeat();
 		tst_test->test(i);
 
@@ -1900,6 +1987,35 @@ void tst_set_runtime(int runtime)
 	heartbeat();
 }
 
+/*
+ * Drains the result ring while the test is running so that tests producing a
+ * lot of results do not overflow it.
+ */
+static void wait_testrun(int *status)
+{
+	pid_t ret;
+
+	if (!res_ring) {
+		SAFE_WAITPID(test_pid, status, 0);
+		return;
+	}
+
+	for (;;) {
+		ret = waitpid(test_pid, status, WNOHANG);
+
+		if (ret == test_pid)
+			break;
+
+		if (ret < 0 && errno != EINTR)
+			tst_brk(TBROK | TERRNO, "waitpid(%i)", test_pid);
+
+		drain_res_ring(0);
+		usleep(10000);
+	}
+
+	drain_res_ring(0);
+}
+
 static void fork_testrun(void)
 {
 	int status;
@@ -1925,7 +2041,7 @@ static void fork_testrun(void)
 		testrun();
 	}
 
-	SAFE_WAITPID(test_pid, &status, 0);
+	wait_testrun(&status);
 	alarm(0);
 	SAFE_SIGNAL(SIGTERM, SIG_DFL);
 	SAFE_SIGNAL(SIGINT, SIG_DFL);
@@ -2031,6 +2147,7 @@ static void run_tcases_per_fs(void)
 }
 
 unsigned int tst_variant;
+int tst_tcase = -1;
 
 void tst_run_tcases(int argc, char *argv[], struct tst_test *self)
 {
@@ -2042,6 +2159,9 @@ void tst_run_tcases(int argc, char *argv[], struct tst_test *self)
 	do_setup(argc, argv);
 	tst_enable_oom_protection(context->lib_pid);
 
+	if (tst_test->memstat)
+		tst_memstat_start(tst_test->memstat);
+
 	SAFE_SIGNAL(SIGALRM, alarm_handler);
 	SAFE_SIGNAL(SIGUSR1, heartbeat_handler);
 
@@ -2062,6 +2182,9 @@ void tst_run_tcases(int argc, char *argv[], struct tst_test *self)
 		test_variants = tst_test->test_variants;
 
 	for (tst_variant = 0; tst_variant < test_variants; tst_variant++) {
+		context->variant = tst_variant;
+		context->tcase = -1;
+
 		if (tst_test->all_filesystems || count_fs_descs() > 1)
 			run_tcases_per_fs();
 		else
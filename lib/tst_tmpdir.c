@@ -74,6 +74,7 @@
 #include "tst_buffers.h"
 #include "tso_safe_macros.h"
 #include "tst_tmpdir.h"
+#include "tst_private.h"
 #include "tso_priv.h"
 #include "lapi/futex.h"
 
@@ -311,6 +312,7 @@ void tst_tmpdir(void)
 
 void tst_rmdir(void)
 {
+	const char *purge = getenv("LTP_TMPDIR_PURGE");
 	char *errmsg;
 
 	/*
@@ -332,6 +334,35 @@ void tst_rmdir(void)
 		munmap((void *)tst_futexes, getpagesize());
 	}
 
+	if (purge && strcmp(purge, "fast") && strcmp(purge, "async")) {
+		tst_resm(TWARN, "Invalid LTP_TMPDIR_PURGE '%s'", purge);
+		purge = NULL;
+	}
+
+	/*
+	 * Rename the directory aside and remove it in background, fall back
+	 * to synchronous removal if that fails.
+	 */
+	if (purge && !strcmp(purge, "async")) {
+		if (!tst_purge_dir_async(TESTDIR, &errmsg))
+			return;
+
+		tst_resm(TINFO, "%s: async purge of %s failed: %s",
+			 __func__, TESTDIR, errmsg);
+	}
+
+	/*
+	 * Whatever the fast purge did not remove is removed by rmobj() below,
+	 * which also reports the error if the removal fails again.
+	 */
+	if (purge) {
+		if (!tst_purge_dir_fast(TESTDIR, 1, &errmsg))
+			return;
+
+		tst_resm(TINFO, "%s: fast purge of %s failed: %s",
+			 __func__, TESTDIR, errmsg);
+	}
+
 	/*
 	 * Attempt to remove the "TESTDIR" directory, using rmobj().
 	 */
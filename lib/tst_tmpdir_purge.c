@@ -0,0 +1,522 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Fast removal of large directory trees used by tst_rmdir().
+ *
+ * The entries of the top level directory are distributed between forked
+ * workers, each worker walks its subtrees and unlinks directory entries in
+ * batches. The batches are submitted via io_uring when there are spare CPUs
+ * for the io-wq threads, plain unlinkat() is used otherwise and when io_uring
+ * or IORING_OP_UNLINKAT is not available.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define TST_NO_DEFAULT_MAIN
+#include "tst_test.h"
+#include "tst_private.h"
+#include "tst_safe_io_uring.h"
+
+#define PURGE_BATCH 64
+#define PURGE_MAX_WORKERS 16
+#define PURGE_ERR_LEN (PATH_MAX + 256)
+
+struct purge_batch {
+	char names[PURGE_BATCH][NAME_MAX + 1];
+	int flags[PURGE_BATCH];
+	int res[PURGE_BATCH];
+	unsigned int cnt;
+};
+
+struct purge_ent {
+	char *name;
+	int is_dir;
+};
+
+static struct tst_io_uring ring = { .fd = -1 };
+static char err_msg[PURGE_ERR_LEN];
+static int failed;
+static int use_ring;
+
+static void purge_err(const char *op, const char *name, int err)
+{
+	if (failed++)
+		return;
+
+	snprintf(err_msg, sizeof(err_msg), "%s(%s) failed; errno=%d: %s",
+		 op, name, err, tst_strerrno(err));
+}
+
+static void ring_close(void)
+{
+	if (ring.fd < 0)
+		return;
+
+	munmap(ring.cqr_base, ring.cqr_mapsize);
+	munmap(ring.sqr_entries, ring.sqr_size * sizeof(struct io_uring_sqe));
+	munmap(ring.sqr_base, ring.sqr_mapsize);
+	close(ring.fd);
+	ring.fd = -1;
+}
+
+/*
+ * Non-fatal variant of SAFE_IO_URING_INIT(), cleanup must not fail just
+ * because io_uring is disabled or not supported.
+ */
+static void ring_init(void)
+{
+	struct io_uring_params params = {};
+
+	ring.fd = syscall(__NR_io_uring_setup, PURGE_BATCH, &params);
+	if (ring.fd < 0) {
+		ring.fd = -1;
+		return;
+	}
+
+	ring.sqr_size = params.sq_entries;
+	ring.cqr_size = params.cq_entries;
+	ring.sqr_mapsize = params.sq_off.array +
+		params.sq_entries * sizeof(__u32);
+	ring.cqr_mapsize = params.cq_off.cqes +
+		params.cq_entries * sizeof(struct io_uring_cqe);
+
+	ring.sqr_base = mmap(NULL, ring.sqr_mapsize, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring.fd,
+			     IORING_OFF_SQ_RING);
+	ring.sqr_entries = mmap(NULL,
+				params.sq_entries * sizeof(struct io_uring_sqe),
+				PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				ring.fd, IORING_OFF_SQES);
+	ring.cqr_base = mmap(NULL, ring.cqr_mapsize, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring.fd,
+			     IORING_OFF_CQ_RING);
+
+	if (ring.sqr_base == MAP_FAILED || ring.sqr_entries == MAP_FAILED ||
+	    ring.cqr_base == MAP_FAILED) {
+		if (ring.sqr_base != MAP_FAILED)
+			munmap(ring.sqr_base, ring.sqr_mapsize);
+		if (ring.sqr_entries != MAP_FAILED)
+			munmap(ring.sqr_entries, params.sq_entries * sizeof(struct io_uring_sqe));
+		if (ring.cqr_base != MAP_FAILED)
+			munmap(ring.cqr_base, ring.cqr_mapsize);
+		close(ring.fd);
+		ring.fd = -1;
+		return;
+	}
+
+	ring.sqr_tail = ring.sqr_base + params.sq_off.tail;
+	ring.sqr_mask = ring.sqr_base + params.sq_off.ring_mask;
+	ring.sqr_array = ring.sqr_base + params.sq_off.array;
+
+	ring.cqr_head = ring.cqr_base + params.cq_off.head;
+	ring.cqr_tail = ring.cqr_base + params.cq_off.tail;
+	ring.cqr_mask = ring.cqr_base + params.cq_off.ring_mask;
+	ring.cqr_entries = ring.cqr_base + params.cq_off.cqes;
+}
+
+static int ring_enter(unsigned int to_submit, unsigned int min_complete)
+{
+	return syscall(__NR_io_uring_enter, ring.fd, to_submit, min_complete,
+		       IORING_ENTER_GETEVENTS, NULL, _NSIG / 8);
+}
+
+/*
+ * Submits the whole batch and waits for all completions. Returns -1 if the
+ * batch could not be submitted at all.
+ */
+static int ring_unlink(int dir_fd, struct purge_batch *b)
+{
+	uint32_t tail = *ring.sqr_tail, head, mask = *ring.sqr_mask;
+	const struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	unsigned int i, reaped = 0;
+
+	for (i = 0; i < b->cnt; i++) {
+		sqe = &ring.sqr_entries[tail & mask];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_UNLINKAT;
+		sqe->fd = dir_fd;
+		sqe->addr = (uintptr_t)b->names[i];
+		sqe->rw_flags = b->flags[i];
+		sqe->user_data = i;
+		ring.sqr_array[tail & mask] = tail & mask;
+		tail++;
+	}
+
+	__atomic_store_n(ring.sqr_tail, tail, __ATOMIC_RELEASE);
+
+	if (ring_enter(b->cnt, b->cnt) != (int)b->cnt)
+		return -1;
+
+	mask = *ring.cqr_mask;
+	head = *ring.cqr_head;
+
+	while (reaped < b->cnt) {
+		while (head != __atomic_load_n(ring.cqr_tail, __ATOMIC_ACQUIRE)) {
+			cqe = &ring.cqr_entries[head & mask];
+			b->res[cqe->user_data] = cqe->res;
+			head++;
+			reaped++;
+		}
+
+		__atomic_store_n(ring.cqr_head, head, __ATOMIC_RELEASE);
+
+		if (reaped < b->cnt && ring_enter(0, b->cnt - reaped) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void purge_flush(int dir_fd, struct purge_batch *b)
+{
+	unsigned int i;
+
+	for (i = 0; i < b->cnt; i++)
+		b->res[i] = -EINVAL;
+
+	if (ring.fd >= 0 && ring_unlink(dir_fd, b))
+		ring_close();
+
+	for (i = 0; i < b->cnt; i++) {
+		if (!b->res[i])
+			continue;
+
+		/* IORING_OP_UNLINKAT is not supported before 5.11 */
+		if (b->res[i] == -EINVAL && ring.fd >= 0)
+			ring_close();
+
+		if (unlinkat(dir_fd, b->names[i], b->flags[i]) && errno != ENOENT)
+			purge_err("unlinkat", b->names[i], errno);
+	}
+
+	b->cnt = 0;
+}
+
+static void purge_queue(int dir_fd, struct purge_batch *b, const char *name,
+			int flags)
+{
+	strcpy(b->names[b->cnt], name);
+	b->flags[b->cnt++] = flags;
+
+	if (b->cnt == PURGE_BATCH)
+		purge_flush(dir_fd, b);
+}
+
+static int is_dir(int dir_fd, const struct dirent *ent)
+{
+	struct stat st;
+
+	if (ent->d_type != DT_UNKNOWN)
+		return ent->d_type == DT_DIR;
+
+	if (fstatat(dir_fd, ent->d_name, &st, AT_SYMLINK_NOFOLLOW))
+		return 0;
+
+	return S_ISDIR(st.st_mode);
+}
+
+static void purge_subdir(int dir_fd, const char *name);
+
+static void purge_contents(int dir_fd, const char *path)
+{
+	struct purge_batch *b;
+	struct dirent *ent;
+	DIR *dir;
+	int fd;
+
+	fd = dup(dir_fd);
+	if (fd < 0 || !(dir = fdopendir(fd))) {
+		purge_err("opendir", path, errno);
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+
+	b = malloc(sizeof(*b));
+	if (!b) {
+		purge_err("malloc", path, errno);
+		closedir(dir);
+		return;
+	}
+
+	b->cnt = 0;
+
+	while ((ent = readdir(dir))) {
+		if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+			continue;
+
+		if (is_dir(dir_fd, ent)) {
+			purge_subdir(dir_fd, ent->d_name);
+			purge_queue(dir_fd, b, ent->d_name, AT_REMOVEDIR);
+		} else {
+			purge_queue(dir_fd, b, ent->d_name, 0);
+		}
+	}
+
+	purge_flush(dir_fd, b);
+	free(b);
+	closedir(dir);
+}
+
+static void purge_subdir(int dir_fd, const char *name)
+{
+	int fd;
+
+	fd = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+	if (fd < 0) {
+		purge_err("openat", name, errno);
+		return;
+	}
+
+	purge_contents(fd, name);
+	close(fd);
+}
+
+static void purge_entries(int dir_fd, struct purge_ent *ents, unsigned int cnt,
+			  unsigned int first, unsigned int step)
+{
+	struct purge_batch *b;
+	unsigned int i;
+
+	b = malloc(sizeof(*b));
+	if (!b) {
+		purge_err("malloc", ents[first].name, errno);
+		return;
+	}
+
+	b->cnt = 0;
+	if (use_ring)
+		ring_init();
+
+	for (i = first; i < cnt; i += step) {
+		if (ents[i].is_dir)
+			purge_subdir(dir_fd, ents[i].name);
+
+		purge_queue(dir_fd, b, ents[i].name,
+			    ents[i].is_dir ? AT_REMOVEDIR : 0);
+	}
+
+	purge_flush(dir_fd, b);
+	ring_close();
+	free(b);
+}
+
+static unsigned int read_entries(int dir_fd, const char *path,
+				 struct purge_ent **ents)
+{
+	unsigned int cnt = 0, size = 0;
+	struct purge_ent *tmp;
+	struct dirent *ent;
+	DIR *dir;
+	int fd;
+
+	*ents = NULL;
+
+	fd = dup(dir_fd);
+	if (fd < 0 || !(dir = fdopendir(fd))) {
+		purge_err("opendir", path, errno);
+		if (fd >= 0)
+			close(fd);
+		return 0;
+	}
+
+	while ((ent = readdir(dir))) {
+		if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+			continue;
+
+		if (cnt == size) {
+			size = size ? 2 * size : 64;
+			tmp = realloc(*ents, size * sizeof(**ents));
+			if (!tmp) {
+				purge_err("realloc", path, errno);
+				break;
+			}
+			*ents = tmp;
+		}
+
+		(*ents)[cnt].name = strdup(ent->d_name);
+		if (!(*ents)[cnt].name) {
+			purge_err("strdup", path, errno);
+			break;
+		}
+
+		(*ents)[cnt++].is_dir = is_dir(dir_fd, ent);
+	}
+
+	closedir(dir);
+
+	return cnt;
+}
+
+int tst_purge_dir_fast(const char *path, int rm_path, char **errmsg)
+{
+	unsigned int i, cnt, workers, spawned;
+	struct purge_ent *ents;
+	pid_t pids[PURGE_MAX_WORKERS];
+	char msg[PIPE_BUF];
+	int dir_fd, status, res[2] = {-1, -1};
+	long ncpus;
+
+	failed = 0;
+
+	dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+	if (dir_fd < 0) {
+		purge_err("open", path, errno);
+		goto out;
+	}
+
+	cnt = read_entries(dir_fd, path, &ents);
+	if (failed)
+		goto free_ents;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	workers = MIN((unsigned int)MAX(ncpus, 1L), PURGE_MAX_WORKERS);
+	workers = MIN(workers, cnt);
+
+	/*
+	 * IORING_OP_UNLINKAT is always executed by io-wq kernel threads, which
+	 * only pays off when there are CPUs left that are not running workers.
+	 */
+	use_ring = ncpus > workers;
+
+	if (workers <= 1 || pipe(res)) {
+		purge_entries(dir_fd, ents, cnt, 0, 1);
+		goto free_ents;
+	}
+
+	for (i = 0; i < workers; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			break;
+
+		if (!pids[i]) {
+			close(res[0]);
+			purge_entries(dir_fd, ents, cnt, i, workers);
+
+			/* Writes up to PIPE_BUF are atomic */
+			err_msg[PIPE_BUF - 1] = 0;
+			if (failed && write(res[1], err_msg, PIPE_BUF) < 0)
+				_exit(2);
+
+			_exit(!!failed);
+		}
+	}
+
+	spawned = i;
+	close(res[1]);
+
+	while (read(res[0], msg, sizeof(msg)) == sizeof(msg)) {
+		if (!failed++)
+			memcpy(err_msg, msg, sizeof(msg));
+	}
+
+	close(res[0]);
+
+	for (i = 0; i < spawned; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			purge_err("waitpid", path, errno);
+			continue;
+		}
+
+		if ((!WIFEXITED(status) || WEXITSTATUS(status)) && !failed++) {
+			snprintf(err_msg, sizeof(err_msg), "purge worker %s",
+				 tst_strstatus(status));
+		}
+	}
+
+	/* Remove what the workers that failed to fork would have removed */
+	if (spawned < workers)
+		purge_contents(dir_fd, path);
+
+free_ents:
+	for (i = 0; i < cnt; i++)
+		free(ents[i].name);
+	free(ents);
+	close(dir_fd);
+
+	if (!failed && rm_path && rmdir(path))
+		purge_err("rmdir", path, errno);
+
+out:
+	if (failed && errmsg)
+		*errmsg = err_msg;
+
+	return failed ? -1 : 0;
+}
+
+int tst_purge_dir_async(const char *path, char **errmsg)
+{
+	static char aside[PATH_MAX];
+	int fd, status;
+	pid_t pid;
+
+	failed = 0;
+
+	snprintf(aside, sizeof(aside), "%s.purge", path);
+
+	if (rename(path, aside)) {
+		purge_err("rename", path, errno);
+		goto err;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		purge_err("fork", path, errno);
+
+		/* Put the directory back for the synchronous removal */
+		rename(aside, path);
+		goto err;
+	}
+
+	if (!pid) {
+		/*
+		 * Detach from the test session and output so that neither the
+		 * test runner nor the pipes it reads from wait for the purge.
+		 */
+		setsid();
+
+		if (fork())
+			_exit(0);
+
+		fd = open("/dev/null", O_RDWR);
+		if (fd >= 0) {
+			dup2(fd, STDIN_FILENO);
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+		}
+
+		for (fd = STDERR_FILENO + 1; fd < 1024; fd++)
+			close(fd);
+
+		tst_purge_dir_fast(aside, 1, NULL);
+		_exit(0);
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		purge_err("waitpid", aside, errno);
+		goto err;
+	}
+
+	return 0;
+err:
+	if (errmsg)
+		*errmsg = err_msg;
+
+	return -1;
+}
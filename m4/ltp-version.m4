@@ -0,0 +1 @@
+20260529])
@@ -13,6 +13,10 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "data_storage.h"
 
@@ -24,6 +28,10 @@ static char *cmdline_includepath[INCLUDE_PATH_MAX];
 static unsigned int cmdline_includepaths;
 static char *includepath;
 
+/* Files read while parsing, used to validate the cache */
+static char **deps;
+static unsigned int deps_used, deps_size;
+
 #define WARN(str) fprintf(stderr, "WARNING: " str "\n")
 
 static void remove_to_newline(FILE *f)
@@ -284,6 +292,27 @@ static char *next_token(FILE *f, struct data_node *doc, struct data_node *groups
 	return next_token2(f, buf, sizeof(buf), doc, groups);
 }
 
+static void add_dep(const char *path)
+{
+	unsigned int i;
+
+	for (i = 0; i < deps_used; i++) {
+		if (!strcmp(deps[i], path))
+			return;
+	}
+
+	if (deps_used >= deps_size) {
+		deps_size = deps_size ? 2 * deps_size : 32;
+		deps = realloc(deps, deps_size * sizeof(*deps));
+		if (!deps) {
+			fprintf(stderr, "Allocation failed!\n");
+			exit(1);
+		}
+	}
+
+	deps[deps_used++] = strdup(path);
+}
+
 static FILE *open_file(const char *dir, const char *fname)
 {
 	FILE *f;
@@ -294,6 +323,9 @@ static FILE *open_file(const char *dir, const char *fname)
 
 	f = fopen(path, "r");
 
+	if (f)
+		add_dep(path);
+
 	free(path);
 
 	return f;
@@ -1309,24 +1341,380 @@ const char *strip_name(char *path)
 
 static void print_help(const char *prgname)
 {
-	printf("usage: %s [-vh] input.c\n\n", prgname);
+	printf("usage: %s [-vh] [-j jobs] [-C cachedir] input.c...\n\n", prgname);
 	printf("-v sets verbose mode\n");
 	printf("-I add include path\n");
+	printf("-j number of files parsed in parallel\n");
+	printf("-C directory to cache the parsed files in\n");
 	printf("-h prints this help\n\n");
 	exit(0);
 }
 
-int main(int argc, char *argv[])
+static void process_file(const char *fname, FILE *out)
 {
 	unsigned int i, j;
 	struct data_node *res;
+	char *name;
+
+	res = parse_file(fname);
+	if (!res)
+		return;
+
+	/* Filter out useless data */
+	for (i = 0; filter_out[i]; i++)
+		data_node_hash_del(res, filter_out[i]);
+
+	/* Normalize the result */
+	for (i = 0; implies[i].flag; i++) {
+		if (data_node_hash_get(res, implies[i].flag)) {
+			for (j = 0; implies[i].implies[j]; j++) {
+				if (data_node_hash_get(res, implies[i].implies[j]))
+					fprintf(stderr, "%s: useless tag: %s\n",
+						fname, implies[i].implies[j]);
+			}
+		}
+	}
+
+	/* Normalize types */
+	check_normalize_types(res, "", tst_test_typemap);
+
+	for (i = 0; implies[i].flag; i++) {
+		if (data_node_hash_get(res, implies[i].flag)) {
+			for (j = 0; implies[i].implies[j]; j++) {
+				if (!data_node_hash_get(res, implies[i].implies[j]))
+					data_node_hash_add(res, implies[i].implies[j],
+							   data_node_bool(true));
+			}
+		}
+	}
+
+	data_node_hash_add(res, "fname", data_node_string(fname));
+
+	name = strdup(fname);
+	fprintf(out, "  \"%s\": ", strip_name(name));
+	data_to_json(res, out, 2);
+	data_node_free(res);
+	free(name);
+}
+
+/*
+ * The cache is content addressed, each entry is named by a hash of the
+ * metaparse binary, include paths, file name and file content. The entry
+ * lists all files read while parsing together with their content hashes
+ * followed by the JSON output for the file. An entry is used only if none
+ * of the files it depends on has changed.
+ */
+#define CACHE_MAGIC "LTPMETA1\n"
+#define FNV_INIT 0xcbf29ce484222325ULL
+
+static struct hsearch_data hash_memo;
+
+static uint64_t fnv1a(uint64_t hash, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static int hash_file(const char *path, uint64_t *hash)
+{
+	char buf[8192];
+	size_t len;
+	uint64_t h = FNV_INIT;
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+		return -1;
+
+	while ((len = fread(buf, 1, sizeof(buf), f)))
+		h = fnv1a(h, buf, len);
+
+	fclose(f);
+	*hash = h;
+
+	return 0;
+}
+
+/* Headers are shared by many tests, hash each of them only once */
+static int hash_file_memo(const char *path, uint64_t *hash)
+{
+	ENTRY e = {.key = (char *)path}, *r;
+	uint64_t *h = NULL, tmp;
+
+	if (hsearch_r(e, FIND, &r, &hash_memo)) {
+		if (!r->data)
+			return -1;
+
+		*hash = *(uint64_t *)r->data;
+		return 0;
+	}
+
+	if (!hash_file(path, &tmp)) {
+		h = malloc(sizeof(*h));
+		if (h)
+			*h = tmp;
+	}
+
+	e.key = strdup(path);
+	e.data = h;
+	hsearch_r(e, ENTER, &r, &hash_memo);
+
+	if (!h)
+		return -1;
+
+	*hash = *h;
+	return 0;
+}
+
+static uint64_t cache_key(uint64_t base, const char *fname)
+{
+	uint64_t hash = 0;
+
+	hash_file_memo(fname, &hash);
+
+	base = fnv1a(base, fname, strlen(fname) + 1);
+
+	return fnv1a(base, &hash, sizeof(hash));
+}
+
+/* Returns the entry positioned at the JSON output if it's valid */
+static FILE *cache_open(const char *path)
+{
+	char line[4096];
+	unsigned long long hash;
+	unsigned int i, n;
+	uint64_t cur;
+	FILE *f = fopen(path, "r");
+
+	if (!f)
+		return NULL;
+
+	if (!fgets(line, sizeof(line), f) || strcmp(line, CACHE_MAGIC))
+		goto invalid;
+
+	if (fscanf(f, "%u\n", &n) != 1)
+		goto invalid;
+
+	for (i = 0; i < n; i++) {
+		if (!fgets(line, sizeof(line), f) || strlen(line) < 18)
+			goto invalid;
+
+		if (sscanf(line, "%16llx ", &hash) != 1)
+			goto invalid;
+
+		line[strlen(line) - 1] = 0;
+
+		if (hash_file_memo(line + 17, &cur) || cur != hash)
+			goto invalid;
+	}
+
+	return f;
+invalid:
+	fclose(f);
+	return NULL;
+}
+
+static void cache_write(const char *path, const char *fname)
+{
+	char *out = NULL, *tmp;
+	size_t out_len = 0;
+	unsigned int i;
+	uint64_t hash;
+	FILE *f;
+
+	f = open_memstream(&out, &out_len);
+	if (!f) {
+		fprintf(stderr, "open_memstream() failed: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	process_file(fname, f);
+	fclose(f);
+
+	if (asprintf(&tmp, "%s.%i", path, getpid()) < 0) {
+		fprintf(stderr, "Allocation failed!\n");
+		exit(1);
+	}
+
+	f = fopen(tmp, "w");
+	if (!f) {
+		fprintf(stderr, "Failed to create %s: %s\n", tmp, strerror(errno));
+		exit(1);
+	}
+
+	add_dep(fname);
+
+	fprintf(f, CACHE_MAGIC "%u\n", deps_used);
+	for (i = 0; i < deps_used; i++) {
+		if (hash_file(deps[i], &hash))
+			hash = 0;
+		fprintf(f, "%016llx %s\n", (unsigned long long)hash, deps[i]);
+	}
+
+	fwrite(out, 1, out_len, f);
+
+	if (fclose(f) || rename(tmp, path)) {
+		fprintf(stderr, "Failed to write %s: %s\n", path, strerror(errno));
+		unlink(tmp);
+		exit(1);
+	}
+
+	free(tmp);
+	free(out);
+}
+
+static int wait_child(void)
+{
+	int status;
+
+	if (wait(&status) < 0) {
+		fprintf(stderr, "wait() failed: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	return !WIFEXITED(status) || WEXITSTATUS(status);
+}
+
+/*
+ * Each file is parsed in a forked child so that macros defined by one test
+ * do not leak into another, exactly as if metaparse was executed for each
+ * file separately. Files with a valid cache entry are not parsed at all.
+ */
+static int parse_files(char *files[], unsigned int nr, unsigned int jobs,
+		       const char *cachedir)
+{
+	char **entries, tmpdir[] = "/tmp/metaparse.XXXXXX", buf[8192];
+	unsigned int i, running = 0, parsed = 0;
+	int failed = 0, first = 1, empty;
+	uint64_t base = FNV_INIT, hash;
+	size_t len;
+	pid_t pid;
+	FILE *f;
+
+	if (!hcreate_r(8192, &hash_memo)) {
+		fprintf(stderr, "Failed to initialize hash table\n");
+		return 1;
+	}
+
+	if (!cachedir) {
+		cachedir = mkdtemp(tmpdir);
+		if (!cachedir) {
+			fprintf(stderr, "mkdtemp() failed: %s\n", strerror(errno));
+			return 1;
+		}
+	} else if (mkdir(cachedir, 0755) && errno != EEXIST) {
+		fprintf(stderr, "Failed to create %s: %s\n", cachedir, strerror(errno));
+		return 1;
+	}
+
+	if (!hash_file("/proc/self/exe", &hash))
+		base = fnv1a(base, &hash, sizeof(hash));
+
+	for (i = 0; i < cmdline_includepaths; i++) {
+		base = fnv1a(base, cmdline_includepath[i],
+			     strlen(cmdline_includepath[i]) + 1);
+	}
+
+	entries = calloc(nr, sizeof(*entries));
+	if (!entries) {
+		fprintf(stderr, "Allocation failed!\n");
+		return 1;
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (asprintf(&entries[i], "%s/%016llx", cachedir,
+			     (unsigned long long)cache_key(base, files[i])) < 0) {
+			fprintf(stderr, "Allocation failed!\n");
+			return 1;
+		}
+
+		f = cache_open(entries[i]);
+		if (f) {
+			fclose(f);
+			continue;
+		}
+
+		if (running >= jobs) {
+			failed |= wait_child();
+			running--;
+		}
+
+		fflush(stderr);
+
+		pid = fork();
+		if (pid < 0) {
+			fprintf(stderr, "fork() failed: %s\n", strerror(errno));
+			exit(1);
+		}
+
+		if (!pid) {
+			cache_write(entries[i], files[i]);
+			exit(0);
+		}
+
+		running++;
+		parsed++;
+	}
+
+	while (running--)
+		failed |= wait_child();
+
+	if (verbose)
+		fprintf(stderr, "PARSED %u of %u FILES\n", parsed, nr);
+
+	for (i = 0; i < nr && !failed; i++) {
+		f = cache_open(entries[i]);
+		if (!f) {
+			fprintf(stderr, "Invalid cache entry %s for %s\n",
+				entries[i], files[i]);
+			failed = 1;
+			break;
+		}
+
+		empty = 1;
+		while ((len = fread(buf, 1, sizeof(buf), f))) {
+			if (empty && !first)
+				printf("\n,\n");
+
+			fwrite(buf, 1, len, stdout);
+			empty = first = 0;
+		}
+
+		fclose(f);
+	}
+
+	if (cachedir == tmpdir) {
+		for (i = 0; i < nr; i++)
+			unlink(entries[i]);
+		rmdir(tmpdir);
+	}
+
+	for (i = 0; i < nr; i++)
+		free(entries[i]);
+	free(entries);
+
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *cachedir = NULL;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
 	int opt;
 
-	while ((opt = getopt(argc, argv, "hI:v")) != -1) {
+	while ((opt = getopt(argc, argv, "hC:I:j:v")) != -1) {
 		switch (opt) {
 		case 'h':
 			print_help(argv[0]);
 		break;
+		case 'C':
+			cachedir = optarg;
+		break;
 		case 'I':
 			if (cmdline_includepaths >= INCLUDE_PATH_MAX) {
 				fprintf(stderr, "Too much include paths!");
@@ -1335,6 +1723,9 @@ int main(int argc, char *argv[])
 
 			cmdline_includepath[cmdline_includepaths++] = optarg;
 		break;
+		case 'j':
+			jobs = atol(optarg);
+		break;
 		case 'v':
 			verbose = 1;
 		break;
@@ -1346,6 +1737,9 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	if (jobs < 1)
+		jobs = 1;
+
 	if (!hcreate(128)) {
 		fprintf(stderr, "Failed to initialize hash table\n");
 		return 1;
@@ -1353,43 +1747,10 @@ int main(int argc, char *argv[])
 
 	parse_must_files();
 
-	res = parse_file(argv[optind]);
-	if (!res)
+	if (optind + 1 == argc && !cachedir) {
+		process_file(argv[optind], stdout);
 		return 0;
-
-	/* Filter out useless data */
-	for (i = 0; filter_out[i]; i++)
-		data_node_hash_del(res, filter_out[i]);
-
-	/* Normalize the result */
-	for (i = 0; implies[i].flag; i++) {
-		if (data_node_hash_get(res, implies[i].flag)) {
-			for (j = 0; implies[i].implies[j]; j++) {
-				if (data_node_hash_get(res, implies[i].implies[j]))
-					fprintf(stderr, "%s: useless tag: %s\n",
-						argv[optind], implies[i].implies[j]);
-			}
-		}
-	}
-
-	/* Normalize types */
-	check_normalize_types(res, "", tst_test_typemap);
-
-	for (i = 0; implies[i].flag; i++) {
-		if (data_node_hash_get(res, implies[i].flag)) {
-			for (j = 0; implies[i].implies[j]; j++) {
-				if (!data_node_hash_get(res, implies[i].implies[j]))
-					data_node_hash_add(res, implies[i].implies[j],
-							   data_node_bool(true));
-			}
-		}
 	}
 
-	data_node_hash_add(res, "fname", data_node_string(argv[optind]));
-
-	printf("  \"%s\": ", strip_name(argv[optind]));
-	data_to_json(res, stdout, 2);
-	data_node_free(res);
-
-	return 0;
+	return parse_files(argv + optind, argc - optind, jobs, cachedir);
 }
@@ -29,18 +29,18 @@ echo ' "tests": {'
 
 first=1
 
-for test in `find testcases/ -name '*.c'|sort`; do
-	a=$($top_builddir/metadata/metaparse -Iinclude -Itestcases/kernel/syscalls/utils/ -Itestcases/kernel/include "$test")
-	if [ -n "$a" ]; then
-		if [ -z "$first" ]; then
-			echo ','
-		fi
-		first=
-		cat <<EOF
+jobs=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+
+# C sources are parsed in parallel, unchanged files are taken from the cache
+a=$($top_builddir/metadata/metaparse -j "$jobs" -C "$top_builddir/metadata/cache" \
+	-Iinclude -Itestcases/kernel/syscalls/utils/ -Itestcases/kernel/include \
+	$(find testcases/ -name '*.c'|sort))
+if [ -n "$a" ]; then
+	first=
+	cat <<EOF
 $a
 EOF
-	fi
-done
+fi
 
 for test in `find testcases/ -not -path "testcases/lib/*" -name '*.sh'|sort`; do
 	a=$($top_builddir/metadata/metaparse-sh "$test")
@@ -26,6 +26,28 @@ for i in *.c; do
 	fi
 done
 
-rm -f tmp.json
+# Files parsed in parallel and from the cache have to match the serial output
+rm -rf tmp_cache
+for pass in parse cache; do
+	printf '* parallel %s ' "$pass"
+	first=1
+	for i in *.c; do
+		a=$($METAPARSE $i)
+		[ -z "$a" ] && continue
+		[ -z "$first" ] && echo ','
+		first=
+		echo "$a"
+	done > tmp.json
+	a=$($METAPARSE -j 4 -C tmp_cache *.c)
+	if [ "$a" != "$(cat tmp.json)" ]; then
+		echo '[FAIL]'
+		echo "$a" | diff -u tmp.json -
+		fail=1
+	else
+		echo '[OK]'
+	fi
+done
+
+rm -rf tmp.json tmp_cache
 
 exit $fail
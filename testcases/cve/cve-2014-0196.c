@@ -109,6 +109,9 @@ static void run(void)
 		SAFE_WRITE(SAFE_WRITE_ANY, master_fd, "A", 1);
 		tst_fzsync_end_race_a(&fzsync_pair);
 
+		if (tst_fzsync_pair_overlap(&fzsync_pair))
+			tst_fzsync_pair_hit(&fzsync_pair);
+
 		for (j = 0; j < RUN_ALLOCS; j++) {
 			if (j == RUN_ALLOCS / 2)
 				continue;
@@ -140,6 +140,9 @@ static void run(void)
 				tst_fzsync_pair_add_bias(&fzsync_pair, 1);
 				too_early_count++;
 			}
+		} else if (tst_fzsync_pair_overlap(&fzsync_pair)) {
+			/* close() ran while recvmmsg() held the socket */
+			tst_fzsync_pair_hit(&fzsync_pair);
 		}
 	}
 
@@ -99,6 +99,9 @@ static void run(void)
 		tst_fzsync_start_race_a(&fzsync_pair);
 		connect(sockfd, (struct sockaddr *)&uaddr, sizeof(uaddr));
 		tst_fzsync_end_race_a(&fzsync_pair);
+
+		if (tst_fzsync_pair_overlap(&fzsync_pair))
+			tst_fzsync_pair_hit(&fzsync_pair);
 	}
 
 	tst_res(TPASS, "We didn't crash");
@@ -167,6 +167,9 @@ static void run(void)
 		SAFE_PWRITE(1, clone_fd, wbuf, blksize, 0);
 		tst_fzsync_end_race_a(&pair);
 
+		if (tst_fzsync_pair_overlap(&pair))
+			tst_fzsync_pair_hit(&pair);
+
 		SAFE_PREAD(1, target_dio_fd, rbuf, blksize, 0);
 		SAFE_CLOSE(clone_fd);
 
@@ -33,11 +33,16 @@
 #include "config.h"
 #include "global.h"
 #include "tst_common.h"
+#include "tst_hdr_hist.h"
 
 #ifdef HAVE_SYS_PRCTL_H
 # include <sys/prctl.h>
 #endif
 #include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <time.h>
 
 #define XFS_ERRTAG_MAX		17
 
@@ -92,6 +97,23 @@ typedef struct opdesc {
 	int isxfs;
 } opdesc_t;
 
+/*
+ * Per operation latency statistics, enabled by -t. Latencies go into a
+ * log-linear histogram, values below 16ns have their own bucket, larger
+ * values are split into 16 sub-buckets per power of two and anything above
+ * 2^36ns (~68s) ends up in the last bucket.
+ */
+#define LAT_SUB_BITS	4
+#define LAT_MAX_BITS	36
+#define LAT_BUCKETS	TST_HDR_BUCKETS(LAT_SUB_BITS, LAT_MAX_BITS)
+
+typedef struct opstat {
+	unsigned long long count;
+	unsigned long long sum_ns;
+	unsigned long long max_ns;
+	unsigned int hist[LAT_BUCKETS];
+} opstat_t;
+
 typedef struct fent {
 	int id;
 	int parent;
@@ -235,6 +257,14 @@ int no_xfs = 0;
 int no_xfs = 1;
 #endif
 sig_atomic_t should_stop = 0;
+int opstats;
+int opstats_interval;
+opstat_t *opstats_shm;
+opstat_t *opstats_cur;
+opstat_t *opstats_prev;
+struct timespec opstats_start;
+struct timespec opstats_last;
+volatile sig_atomic_t opstats_tick;
 
 void add_to_flist(int, int, int);
 void append_pathname(pathname_t *, char *);
@@ -265,6 +295,12 @@ void make_freq_table(void);
 int mkdir_path(pathname_t *, mode_t);
 int mknod_path(pathname_t *, mode_t, dev_t);
 void namerandpad(int, char *, int);
+void opstats_dump(void);
+void opstats_init(void);
+void opstats_record(int, struct timespec *);
+void opstats_report(void);
+void opstats_reset(void);
+void opstats_timer(int);
 int open_path(pathname_t *, int);
 DIR *opendir_path(pathname_t *);
 void process_freq(char *);
@@ -286,6 +322,11 @@ void sg_handler(int signum __attribute__((unused)))
 	should_stop = 1;
 }
 
+void tick_handler(int signum __attribute__((unused)))
+{
+	opstats_tick = 1;
+}
+
 int main(int argc, char **argv)
 {
 	char buf[10];
@@ -317,7 +358,7 @@ int main(int argc, char **argv)
 	nops = ARRAY_SIZE(ops);
 	ops_end = &ops[nops];
 	myprog = argv[0];
-	while ((c = getopt(argc, argv, "cd:e:f:i:l:n:p:rs:vwzHSX")) != -1) {
+	while ((c = getopt(argc, argv, "cd:e:f:i:l:n:p:rs:tT:vwzHSX")) != -1) {
 		switch (c) {
 		case 'c':
 			/*Don't cleanup */
@@ -362,6 +403,13 @@ int main(int argc, char **argv)
 		case 's':
 			seed = strtoul(optarg, NULL, 0);
 			break;
+		case 't':
+			opstats = 1;
+			break;
+		case 'T':
+			opstats = 1;
+			opstats_interval = atoi(optarg);
+			break;
 		case 'v':
 			verbose = 1;
 			break;
@@ -403,6 +451,9 @@ int main(int argc, char **argv)
 
 	make_freq_table();
 
+	if (opstats)
+		opstats_init();
+
 	while (((loopcntr <= loops) || (loops == 0)) && !should_stop) {
 		if (!dirname) {
 			/* no directory specified */
@@ -480,9 +531,12 @@ int main(int argc, char **argv)
 			close(fd);
 		unlink(buf);
 
+		if (opstats)
+			opstats_reset();
 
 		if (nproc == 1) {
 			procid = 0;
+			opstats_timer(SA_RESTART);
 			doproc();
 		} else {
 			setpgid(0, 0);
@@ -511,8 +565,17 @@ int main(int argc, char **argv)
 					return 0;
 				}
 			}
-			while (wait(&stat) > 0 && !should_stop) {
-				continue;
+			opstats_timer(0);
+			for (;;) {
+				if (wait(&stat) > 0) {
+					if (should_stop)
+						break;
+					continue;
+				}
+				if (errno != EINTR || should_stop)
+					break;
+				if (opstats_tick)
+					opstats_dump();
 			}
 			if (should_stop) {
 				action.sa_flags = SA_RESTART;
@@ -522,6 +585,8 @@ int main(int argc, char **argv)
 					continue;
 			}
 		}
+		if (opstats)
+			opstats_report();
 #ifndef NO_XFS
 		if (errtag != 0) {
 			memset(&err_inj, 0, sizeof(err_inj));
@@ -773,7 +838,18 @@ void doproc(void)
 		if ((unsigned long)p->func < 4096)
 			abort();
 
-		p->func(opno, random());
+		if (opstats) {
+			struct timespec start;
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			p->func(opno, random());
+			opstats_record(p - ops, &start);
+
+			if (opstats_tick)
+				opstats_dump();
+		} else {
+			p->func(opno, random());
+		}
 		/*
 		 * test for forced shutdown by stat'ing the test
 		 * directory.  If this stat returns EIO, assume
@@ -1080,6 +1156,199 @@ void namerandpad(int id, char *buf, int i)
 	}
 }
 
+static unsigned int lat_bucket(unsigned long long ns)
+{
+	unsigned int b = tst_hdr_bucket(ns, LAT_SUB_BITS);
+
+	return b < LAT_BUCKETS ? b : LAT_BUCKETS - 1;
+}
+
+/*
+ * The total is summed from the histogram since the periodic dump reads the
+ * counters while the processes are still updating them.
+ */
+static double lat_percentile_us(const opstat_t *st, double pct)
+{
+	unsigned long long total = 0, sum = 0, rank;
+	unsigned int b;
+
+	for (b = 0; b < LAT_BUCKETS; b++)
+		total += st->hist[b];
+
+	rank = total * pct / 100;
+
+	for (b = 0; b < LAT_BUCKETS; b++) {
+		sum += st->hist[b];
+		if (sum > rank)
+			return tst_hdr_bucket_low(b, LAT_SUB_BITS) / 1000.0;
+	}
+
+	return 0;
+}
+
+static double elapsed(const struct timespec *since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - since->tv_sec) +
+		(now.tv_nsec - since->tv_nsec) / 1000000000.0;
+}
+
+static void opstats_merge(opstat_t *sum)
+{
+	opstat_t *st;
+	int i, j;
+	unsigned int b;
+
+	memset(sum, 0, nops * sizeof(opstat_t));
+
+	for (i = 0; i < nproc; i++) {
+		for (j = 0; j < nops; j++) {
+			st = &opstats_shm[i * nops + j];
+			sum[j].count += st->count;
+			sum[j].sum_ns += st->sum_ns;
+			sum[j].max_ns = MAX(sum[j].max_ns, st->max_ns);
+			for (b = 0; b < LAT_BUCKETS; b++)
+				sum[j].hist[b] += st->hist[b];
+		}
+	}
+}
+
+void opstats_dump(void)
+{
+	opstat_t delta;
+	double t, dt;
+	int i;
+	unsigned int b;
+
+	opstats_tick = 0;
+	opstats_merge(opstats_cur);
+	t = elapsed(&opstats_start);
+	dt = elapsed(&opstats_last);
+	clock_gettime(CLOCK_MONOTONIC, &opstats_last);
+
+	for (i = 0; i < nops; i++) {
+		delta.count = opstats_cur[i].count - opstats_prev[i].count;
+		if (!delta.count)
+			continue;
+
+		for (b = 0; b < LAT_BUCKETS; b++)
+			delta.hist[b] = opstats_cur[i].hist[b] - opstats_prev[i].hist[b];
+
+		printf("%9.2fs %-12s %10llu ops %10.1f ops/s p50 %10.1fus p99 %10.1fus\n",
+		       t, ops[i].name, delta.count, delta.count / dt,
+		       lat_percentile_us(&delta, 50),
+		       lat_percentile_us(&delta, 99));
+	}
+
+	memcpy(opstats_prev, opstats_cur, nops * sizeof(opstat_t));
+}
+
+void opstats_init(void)
+{
+	opstats_shm = mmap(NULL, (size_t)nproc * nops * sizeof(opstat_t),
+			   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			   -1, 0);
+	if (opstats_shm == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+
+	opstats_cur = calloc(nops, sizeof(opstat_t));
+	opstats_prev = calloc(nops, sizeof(opstat_t));
+	if (!opstats_cur || !opstats_prev) {
+		perror("calloc");
+		exit(1);
+	}
+}
+
+void opstats_record(int op, struct timespec *start)
+{
+	opstat_t *st = &opstats_shm[procid * nops + op];
+	struct timespec now;
+	unsigned long long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (now.tv_sec - start->tv_sec) * 1000000000ULL +
+		now.tv_nsec - start->tv_nsec;
+
+	st->hist[lat_bucket(ns)]++;
+	st->sum_ns += ns;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+	st->count++;
+}
+
+void opstats_report(void)
+{
+	struct itimerval it;
+	opstat_t *st;
+	unsigned long long total = 0;
+	double t;
+	int i;
+
+	if (opstats_interval) {
+		memset(&it, 0, sizeof(it));
+		setitimer(ITIMER_REAL, &it, NULL);
+	}
+
+	opstats_merge(opstats_cur);
+	t = elapsed(&opstats_start);
+
+	printf("operation statistics, %d process(es), %.2fs:\n", nproc, t);
+	printf("%-12s %10s %10s %10s %10s %10s %10s\n", "op", "count",
+	       "ops/s", "avg(us)", "p50(us)", "p99(us)", "max(us)");
+
+	for (i = 0; i < nops; i++) {
+		st = &opstats_cur[i];
+		if (!st->count)
+			continue;
+
+		total += st->count;
+		printf("%-12s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+		       ops[i].name, st->count, st->count / t,
+		       st->sum_ns / 1000.0 / st->count,
+		       lat_percentile_us(st, 50), lat_percentile_us(st, 99),
+		       st->max_ns / 1000.0);
+	}
+
+	printf("%-12s %10llu %10.1f\n", "total", total, total / t);
+}
+
+void opstats_reset(void)
+{
+	memset(opstats_shm, 0, (size_t)nproc * nops * sizeof(opstat_t));
+	memset(opstats_prev, 0, nops * sizeof(opstat_t));
+	clock_gettime(CLOCK_MONOTONIC, &opstats_start);
+	opstats_last = opstats_start;
+	opstats_tick = 0;
+}
+
+void opstats_timer(int flags)
+{
+	struct sigaction action;
+	struct itimerval it;
+
+	if (!opstats_interval)
+		return;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = tick_handler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = flags;
+	if (sigaction(SIGALRM, &action, 0)) {
+		perror("sigaction failed");
+		exit(1);
+	}
+
+	memset(&it, 0, sizeof(it));
+	it.it_interval.tv_sec = opstats_interval;
+	it.it_value.tv_sec = opstats_interval;
+	setitimer(ITIMER_REAL, &it, NULL);
+}
+
 int open_path(pathname_t * name, int oflag)
 {
 	char buf[MAXNAMELEN];
@@ -1366,7 +1635,7 @@ void usage(void)
 	printf
 	    ("       %s [-c][-d dir][-e errtg][-f op_name=freq][-l loops][-n nops]\n",
 	     myprog);
-	printf("          [-p nproc][-r len][-s seed][-v][-w][-z][-S]\n");
+	printf("          [-p nproc][-r len][-s seed][-t][-T secs][-v][-w][-z][-S]\n");
 	printf("where\n");
 	printf
 	    ("   -c               specifies not to remove files(cleanup) after execution\n");
@@ -1387,6 +1656,10 @@ void usage(void)
 	printf("   -r               specifies random name padding\n");
 	printf
 	    ("   -s seed          specifies the seed for the random generator (default random)\n");
+	printf
+	    ("   -t               prints per operation count, throughput and latencies\n");
+	printf
+	    ("   -T secs          as -t and also prints the statistics every secs seconds\n");
 	printf("   -v               specifies verbose mode\n");
 	printf
 	    ("   -w               zeros frequencies of non-write operations\n");
@@ -17,10 +17,19 @@
  * The reads are preformed by worker processes which are given file paths by a
  * single parent process. The parent process recursively scans a given
  * directory and passes the file paths it finds to the child processes using a
- * queue structure stored in shared memory.
+ * queue structure stored in shared memory. A worker which runs out of work
+ * steals paths from the queues of the other workers, so that a few slow files
+ * do not hold back the paths queued behind them. Workers with nothing to do
+ * sleep until the parent queues more work.
+ *
+ * With the 'uring' parameter (-u) the workers batch the open, read and close
+ * calls for up to 32 paths into io_uring submissions instead of doing them one
+ * by one.
  *
  * This allows the file system and individual files to be accessed in
- * parallel. Passing the 'reads' parameter (-r) will encourage this. The
+ * parallel. Passing the 'reads' parameter (-r) will encourage this, each copy
+ * of a path is queued to a different worker and copies are never stolen, so
+ * that they are not read by the same worker one after another. The
  * number of worker processes is based on the number of available
  * processors. However this is limited by default to 15 to avoid this becoming
  * an IPC stress test on systems with large numbers of weak cores. This can be
@@ -30,6 +39,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
 #include <fnmatch.h>
 #include <lapi/fnmatch.h>
 #include <stdlib.h>
@@ -40,7 +50,6 @@
 #include <unistd.h>
 #include <string.h>
 #include <limits.h>
-#include <semaphore.h>
 #include <ctype.h>
 #include <pwd.h>
 #include <grp.h>
@@ -48,18 +57,32 @@
 #include "tst_atomic.h"
 #include "tst_safe_clocks.h"
 #include "tst_test.h"
-#include "tst_timer.h"
+#include "tst_safe_io_uring.h"
+#include "lapi/futex.h"
 
-#define QUEUE_SIZE 16384
+#define QUEUE_LEN 16
 #define BUFFER_SIZE 1024
 #define MAX_PATH 4096
 #define MAX_DISPLAY 40
+#define URING_BATCH 32
+#define IDLE_SLEEP_MAX 1000
 
+/*
+ * Bounded queue with a single producer, the parent, and multiple consumers,
+ * the owning worker and the workers stealing from it. The parent fills the
+ * slot at back and then advances back. Consumers copy the path at front and
+ * claim it by advancing front with compare and exchange, the slot is not
+ * overwritten before front moves past it. Pinned paths, i.e. the copies
+ * scheduled by -r, are popped only by the owner.
+ */
 struct queue {
-	sem_t sem;
-	tst_atomic_t front;
-	int back;
-	char data[QUEUE_SIZE];
+	uint32_t front;
+	uint32_t back;
+	tst_atomic_t stop;
+	tst_atomic_t done;
+	char data[QUEUE_LEN][BUFFER_SIZE];
+	uint32_t len[QUEUE_LEN];
+	uint8_t pinned[QUEUE_LEN];
 	char popped[BUFFER_SIZE];
 };
 
@@ -68,9 +91,20 @@ struct worker {
 	pid_t pid;
 	struct queue *q;
 	tst_atomic_t last_seen;
+	/* Set while the worker sleeps waiting for work */
+	tst_atomic_t idle;
 	unsigned int kill_sent:1;
 };
 
+/*
+ * Idle workers sleep on the seq futex, the parent increments it and wakes
+ * them up when it queues a path or stops the workers.
+ */
+struct work_seq {
+	futex_t seq;
+	tst_atomic_t waiters;
+};
+
 enum dent_action {
 	DA_UNKNOWN,
 	DA_IGNORE,
@@ -92,6 +126,9 @@ static char *drop_privs;
 static char *str_worker_timeout;
 static int worker_timeout;
 static int timeout_warnings_left = 15;
+static char *use_uring;
+static struct work_seq *work_seq;
+static char *sched_workers;
 
 static char *blacklist[] = {
 	"/reserved/", /* reserved for -e parameter */
@@ -110,56 +147,66 @@ static char *ratelimit_list[] = {
 
 static long long epoch;
 
+/*
+ * tst_timer.h is not used since its fallback kernel time types clash with
+ * linux/io_uring.h
+ */
+static long long timespec_to_us(struct timespec t)
+{
+	return t.tv_sec * 1000000LL + t.tv_nsec / 1000;
+}
+
 static int atomic_timestamp(void)
 {
 	struct timespec now;
 
 	SAFE_CLOCK_GETTIME(CLOCK_MONOTONIC_RAW, &now);
 
-	return tst_timespec_to_us(now) - epoch;
+	return timespec_to_us(now) - epoch;
 }
 
-static int queue_pop(struct queue *q)
+static int queue_pop(struct queue *q, char *buf, int steal)
 {
-	int i = q->front, j = 0;
-
-	sem_wait(&q->sem);
-
-	if (!q->data[i])
-		return 0;
+	uint32_t front = __atomic_load_n(&q->front, __ATOMIC_ACQUIRE);
+	uint32_t len;
 
-	while (q->data[i]) {
-		q->popped[j] = q->data[i];
+	for (;;) {
+		if (front == __atomic_load_n(&q->back, __ATOMIC_ACQUIRE))
+			return 0;
 
-		if (++j >= BUFFER_SIZE - 1)
-			tst_brk(TBROK, "Buffer is too small for path");
+		if (steal && q->pinned[front % QUEUE_LEN])
+			return 0;
 
-		 i = (i + 1) % QUEUE_SIZE;
+		/*
+		 * The slot may be rewritten by the owner once another worker
+		 * steals it, the compare and exchange below fails then, but
+		 * the copy must stay in bounds.
+		 */
+		len = MIN(q->len[front % QUEUE_LEN], BUFFER_SIZE - 1);
+		memcpy(buf, q->data[front % QUEUE_LEN], len);
+		buf[len] = '\0';
+
+		if (__atomic_compare_exchange_n(&q->front, &front, front + 1, 0,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return 1;
 	}
-
-	q->popped[j] = '\0';
-	tst_atomic_store((i + 1) % QUEUE_SIZE, &q->front);
-
-	return 1;
 }
 
-static int queue_push(struct queue *q, const char *buf)
+static int queue_push(struct queue *q, const char *buf, int pinned)
 {
-	int i = q->back, j = 0;
-	int front = tst_atomic_load(&q->front);
+	uint32_t back = q->back;
+	size_t len = strlen(buf);
 
-	do {
-		q->data[i] = buf[j];
-
-		i = (i + 1) % QUEUE_SIZE;
-
-		if (i == front)
-			return 0;
+	if (len >= BUFFER_SIZE)
+		tst_brk(TBROK, "Buffer is too small for path");
 
-	} while (buf[j++]);
+	if (back - __atomic_load_n(&q->front, __ATOMIC_ACQUIRE) >= QUEUE_LEN)
+		return 0;
 
-	q->back = i;
-	sem_post(&q->sem);
+	memcpy(q->data[back % QUEUE_LEN], buf, len);
+	q->len[back % QUEUE_LEN] = len;
+	q->pinned[back % QUEUE_LEN] = pinned;
+	__atomic_store_n(&q->back, back + 1, __ATOMIC_RELEASE);
 
 	return 1;
 }
@@ -171,18 +218,14 @@ static struct queue *queue_init(void)
 				    MAP_SHARED | MAP_ANONYMOUS,
 				    0, 0);
 
-	sem_init(&q->sem, 1, 0);
 	q->front = 0;
 	q->back = 0;
 
 	return q;
 }
 
-static void queue_destroy(struct queue *q, int is_worker)
+static void queue_destroy(struct queue *q)
 {
-	if (is_worker)
-		sem_destroy(&q->sem);
-
 	SAFE_MUNMAP(q, sizeof(*q));
 }
 
@@ -256,6 +299,35 @@ static int worker_ttl(const int worker)
 	return MAX(0, worker_timeout - worker_elapsed(worker));
 }
 
+static void report_open(const int worker, const char *const path)
+{
+	if (!quiet) {
+		tst_res(TINFO | TERRNO, "Worker %d (%d): open(%s)",
+			workers[worker].pid, worker, path);
+	}
+}
+
+static void report_read(const int worker, const char *const path,
+			char *buf, ssize_t count, int elapsed)
+{
+	const pid_t pid = workers[worker].pid;
+
+	if (count > 0 && verbose) {
+		sanitize_str(buf, count);
+		tst_res(TINFO,
+			"Worker %d (%d): read(%s, buf) = %zi, buf = %s, elapsed = %dus",
+			pid, worker, path, count, buf, elapsed);
+	} else if (!count && verbose) {
+		tst_res(TINFO,
+			"Worker %d (%d): read(%s) = EOF, elapsed = %dus",
+			pid, worker, path, elapsed);
+	} else if (count < 0 && !quiet) {
+		tst_res(TINFO | TERRNO,
+			"Worker %d (%d): read(%s), elapsed = %dus",
+			pid, worker, path, elapsed);
+	}
+}
+
 static void read_test(const int worker, const char *const path)
 {
 	char buf[BUFFER_SIZE];
@@ -272,10 +344,7 @@ static void read_test(const int worker, const char *const path)
 
 	fd = open(path, O_RDONLY | O_NONBLOCK);
 	if (fd < 0) {
-		if (!quiet) {
-			tst_res(TINFO | TERRNO, "Worker %d (%d): open(%s)",
-				pid, worker, path);
-		}
+		report_open(worker, path);
 		return;
 	}
 
@@ -283,24 +352,154 @@ static void read_test(const int worker, const char *const path)
 	count = read(fd, buf, sizeof(buf) - 1);
 	elapsed = worker_elapsed(worker);
 
-	if (count > 0 && verbose) {
-		sanitize_str(buf, count);
-		tst_res(TINFO,
-			"Worker %d (%d): read(%s, buf) = %zi, buf = %s, elapsed = %dus",
-			pid, worker, path, count, buf, elapsed);
-	} else if (!count && verbose) {
-		tst_res(TINFO,
-			"Worker %d (%d): read(%s) = EOF, elapsed = %dus",
-			pid, worker, path, elapsed);
-	} else if (count < 0 && !quiet) {
-		tst_res(TINFO | TERRNO,
-			"Worker %d (%d): read(%s), elapsed = %dus",
-			pid, worker, path, elapsed);
-	}
+	report_read(worker, path, buf, count, elapsed);
 
 	SAFE_CLOSE(fd);
 }
 
+struct uring_req {
+	char path[BUFFER_SIZE];
+	char buf[BUFFER_SIZE];
+	int fd;
+	int start;
+	int pending;
+};
+
+static struct tst_io_uring uring;
+static struct uring_req reqs[URING_BATCH];
+
+static void uring_submit(int op, unsigned int idx)
+{
+	struct uring_req *req = reqs + idx;
+	uint32_t tail = *uring.sqr_tail;
+	struct io_uring_sqe *sqe = uring.sqr_entries + (tail & *uring.sqr_mask);
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = op;
+	sqe->user_data = idx;
+
+	switch (op) {
+	case IORING_OP_OPENAT:
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (uintptr_t)req->path;
+		sqe->open_flags = O_RDONLY | O_NONBLOCK;
+	break;
+	case IORING_OP_READ:
+		sqe->fd = req->fd;
+		sqe->addr = (uintptr_t)req->buf;
+		sqe->len = BUFFER_SIZE - 1;
+		/* Use and update the file position like read() */
+		sqe->off = -1;
+	break;
+	case IORING_OP_CLOSE:
+		sqe->fd = req->fd;
+	break;
+	}
+
+	uring.sqr_array[tail & *uring.sqr_mask] = tail & *uring.sqr_mask;
+	__atomic_store_n(uring.sqr_tail, tail + 1, __ATOMIC_RELEASE);
+	req->pending = 1;
+}
+
+/*
+ * Submits the queued requests and reaps all completions. Heartbeat is
+ * updated on each completion so that only a batch which stopped making
+ * progress times out.
+ */
+static void uring_complete(const int worker, unsigned int cnt, int op)
+{
+	const struct io_uring_cqe *cqe;
+	struct uring_req *req;
+	uint32_t head, tail;
+	unsigned int i;
+
+	if (!cnt)
+		return;
+
+	SAFE_IO_URING_ENTER(1, uring.fd, cnt, 0, 0, NULL);
+	worker_heartbeat(worker);
+
+	while (cnt) {
+		for (i = 0; i < URING_BATCH; i++) {
+			if (reqs[i].pending) {
+				strcpy(workers[worker].q->popped, reqs[i].path);
+				break;
+			}
+		}
+
+		SAFE_IO_URING_ENTER(0, uring.fd, 0, 1, IORING_ENTER_GETEVENTS,
+				    NULL);
+
+		head = *uring.cqr_head;
+		tail = __atomic_load_n(uring.cqr_tail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; head++, cnt--) {
+			cqe = uring.cqr_entries + (head & *uring.cqr_mask);
+			req = reqs + cqe->user_data;
+			req->pending = 0;
+			errno = -cqe->res;
+
+			switch (op) {
+			case IORING_OP_OPENAT:
+				req->fd = cqe->res;
+				if (req->fd < 0)
+					report_open(worker, req->path);
+			break;
+			case IORING_OP_READ:
+				report_read(worker, req->path, req->buf,
+					    cqe->res < 0 ? -1 : cqe->res,
+					    atomic_timestamp() - req->start);
+			break;
+			case IORING_OP_CLOSE:
+				if (cqe->res < 0) {
+					tst_brk(TBROK | TERRNO,
+						"Worker %d (%d): close(%s)",
+						workers[worker].pid, worker,
+						req->path);
+				}
+			break;
+			}
+		}
+
+		__atomic_store_n(uring.cqr_head, head, __ATOMIC_RELEASE);
+		worker_heartbeat(worker);
+	}
+}
+
+static void uring_read_test(const int worker, unsigned int cnt)
+{
+	unsigned int i, opened = 0;
+
+	for (i = 0; i < cnt; i++) {
+		if (verbose) {
+			tst_res(TINFO, "Worker %d: %s(%s)",
+				workers[worker].pid, __func__, reqs[i].path);
+		}
+
+		uring_submit(IORING_OP_OPENAT, i);
+	}
+
+	uring_complete(worker, cnt, IORING_OP_OPENAT);
+
+	for (i = 0; i < cnt; i++) {
+		if (reqs[i].fd < 0)
+			continue;
+
+		reqs[i].start = atomic_timestamp();
+		uring_submit(IORING_OP_READ, i);
+		opened++;
+	}
+
+	uring_complete(worker, opened, IORING_OP_READ);
+
+	for (i = 0; i < cnt; i++) {
+		if (reqs[i].fd >= 0)
+			uring_submit(IORING_OP_CLOSE, i);
+	}
+
+	uring_complete(worker, opened, IORING_OP_CLOSE);
+}
+
 static void maybe_drop_privs(void)
 {
 	struct passwd *nobody;
@@ -325,6 +524,85 @@ static void maybe_drop_privs(void)
 		tst_brk(TBROK | TTERRNO, "Failed to use nobody uid");
 }
 
+static void wake_workers(void)
+{
+	__atomic_add_fetch(&work_seq->seq, 1, __ATOMIC_SEQ_CST);
+
+	if (tst_atomic_load(&work_seq->waiters))
+		syscall(SYS_futex, &work_seq->seq, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+/*
+ * Pops a path from our own queue or steals one from the other workers, sleeps
+ * until there is more work unless nowait is set. Returns 0 when there is no
+ * more work.
+ */
+static int worker_pop(const int worker, char *buf, int nowait)
+{
+	struct worker *const self = workers + worker;
+	struct queue *q = self->q;
+	uint32_t seq;
+	int i;
+
+	for (;;) {
+		seq = __atomic_load_n(&work_seq->seq, __ATOMIC_SEQ_CST);
+		worker_heartbeat(worker);
+
+		if (queue_pop(q, buf, 0))
+			return 1;
+
+		for (i = 1; i < worker_count; i++) {
+			if (queue_pop(workers[(worker + i) % worker_count].q, buf, 1))
+				return 1;
+		}
+
+		if (nowait || tst_atomic_load(&q->stop))
+			return 0;
+
+		tst_atomic_store(1, &self->idle);
+		tst_atomic_inc(&work_seq->waiters);
+
+		syscall(SYS_futex, &work_seq->seq, FUTEX_WAIT, seq, NULL);
+
+		tst_atomic_dec(&work_seq->waiters);
+		worker_heartbeat(worker);
+		tst_atomic_store(0, &self->idle);
+	}
+}
+
+static void worker_loop(const int worker)
+{
+	struct queue *q = workers[worker].q;
+
+	while (worker_pop(worker, q->popped, 0))
+		read_test(worker, q->popped);
+}
+
+static void worker_loop_uring(const int worker)
+{
+	struct io_uring_params params = {};
+	unsigned int cnt;
+
+	SAFE_IO_URING_INIT(URING_BATCH, &params, &uring);
+
+	for (;;) {
+		cnt = 0;
+
+		while (cnt < URING_BATCH &&
+		       worker_pop(worker, reqs[cnt].path, cnt > 0)) {
+			if (!is_blacklisted(reqs[cnt].path))
+				cnt++;
+		}
+
+		if (!cnt)
+			break;
+
+		uring_read_test(worker, cnt);
+	}
+
+	SAFE_IO_URING_CLOSE(&uring);
+}
+
 static int worker_run(int worker)
 {
 	struct sigaction term_sa = {
@@ -332,7 +610,6 @@ static int worker_run(int worker)
 		.sa_flags = 0,
 	};
 	struct worker *const self = workers + worker;
-	struct queue *q = self->q;
 
 	sigaction(SIGTTIN, &term_sa, NULL);
 	maybe_drop_privs();
@@ -344,16 +621,12 @@ static int worker_run(int worker)
 			worker_elapsed(self->i));
 	}
 
-	while (1) {
-		worker_heartbeat(worker);
-
-		if (!queue_pop(q))
-			break;
-
-		read_test(worker, q->popped);
-	}
+	if (use_uring)
+		worker_loop_uring(worker);
+	else
+		worker_loop(worker);
 
-	queue_destroy(q, 1);
+	tst_atomic_store(1, &self->q->done);
 	tst_flush();
 	return 0;
 }
@@ -365,10 +638,15 @@ static void spawn_workers(void)
 
 	memset(workers, 0, worker_count * sizeof(*workers));
 
+	/* All queues have to exist before the first worker starts stealing */
 	for (i = 0; i < worker_count; i++) {
 		wa[i].i = i;
 		wa[i].q = queue_init();
+	}
+
+	for (i = 0; i < worker_count; i++) {
 		wa[i].last_seen = atomic_timestamp();
+		wa[i].idle = 0;
 		wa[i].pid = SAFE_FORK();
 		if (!wa[i].pid)
 			exit(worker_run(i));
@@ -378,7 +656,7 @@ static void spawn_workers(void)
 static void restart_worker(const int worker)
 {
 	struct worker *const w = workers + worker;
-	int wstatus, ret, i, q_len;
+	int wstatus, ret;
 
 	if (!w->kill_sent) {
 		SAFE_KILL(w->pid, SIGKILL);
@@ -415,27 +693,8 @@ static void restart_worker(const int worker)
 			w->pid, worker, w->q->popped);
 	}
 
-	/* Make sure the queue length and semaphore match. Threre is a
-	 * race in qeue_pop where the semaphore can be decremented
-	 * then the worker killed before updating q->front
-	 */
-	q_len = 0;
-	i = w->q->front;
-	while (i != w->q->back) {
-		if (!w->q->data[i])
-			q_len++;
-
-		i = (i + 1) % QUEUE_SIZE;
-	}
-
-	ret = sem_destroy(&w->q->sem);
-	if (ret == -1)
-		tst_brk(TBROK | TERRNO, "sem_destroy");
-	ret = sem_init(&w->q->sem, 1, q_len);
-	if (ret == -1)
-		tst_brk(TBROK | TERRNO, "sem_init");
-
 	worker_heartbeat(worker);
+	w->idle = 0;
 	w->pid = SAFE_FORK();
 
 	if (!w->pid)
@@ -456,60 +715,85 @@ static void check_timeout_warnings_limit(void)
 		"Silencing timeout warnings; consider increasing LTP_RUNTIME_MUL or removing -q");
 }
 
-static int try_push_work(const int worker, const char *buf)
+/*
+ * Workers update their heartbeat whenever they take a path and idle workers
+ * are flagged, so a busy worker that has not updated it for worker_timeout is
+ * stuck on a file. Returns 1 if the worker is being restarted.
+ */
+static int check_worker(const int worker)
 {
-	int ret = 0;
 	int elapsed;
 	struct worker *const w = workers + worker;
 
 	if (w->kill_sent) {
 		restart_worker(worker);
-		return 0;
+		return 1;
 	}
 
-	ret = queue_push(w->q, buf);
-	if (ret)
-		return 1;
+	if (tst_atomic_load(&w->idle))
+		return 0;
 
 	elapsed = worker_elapsed(worker);
 
-	if (elapsed > worker_timeout) {
-		if (!quiet || timeout_warnings_left) {
-			tst_res(TINFO,
-				"Worker %d (%d): Stuck for %dus, restarting it",
-				w->pid, worker, elapsed);
-			check_timeout_warnings_limit();
-		}
-		restart_worker(worker);
+	if (elapsed <= worker_timeout)
+		return 0;
+
+	if (!quiet || timeout_warnings_left) {
+		tst_res(TINFO,
+			"Worker %d (%d): Stuck for %dus, restarting it",
+			w->pid, worker, elapsed);
+		check_timeout_warnings_limit();
 	}
+	restart_worker(worker);
 
-	return 0;
+	return 1;
 }
 
-static void push_work(const int worker, const char *buf)
+static int try_push_work(const int worker, const char *buf, int pinned)
 {
-	int sleep_time = 1;
+	if (check_worker(worker))
+		return 0;
 
-	while (!try_push_work(worker, buf)) {
-		const int ttl = worker_ttl(worker);
+	if (!queue_push(workers[worker].q, buf, pinned))
+		return 0;
 
-		sleep_time = MIN(2 * sleep_time, ttl);
-		usleep(sleep_time);
-	}
+	wake_workers();
+
+	return 1;
 }
 
+/*
+ * Workers finish the queued work, including the work stolen from a stuck
+ * worker, and exit. Stuck workers are restarted until they exit as well.
+ */
 static void stop_workers(void)
 {
-	const char stop_code[1] = { '\0' };
-	int i;
+	int i, running, sleep_time = 1;
 
 	if (!workers)
 		return;
 
 	for (i = 0; i < worker_count; i++) {
 		if (workers[i].q)
-			push_work(i, stop_code);
+			tst_atomic_store(1, &workers[i].q->stop);
 	}
+
+	wake_workers();
+
+	do {
+		running = 0;
+
+		for (i = 0; i < worker_count; i++) {
+			if (!workers[i].q || tst_atomic_load(&workers[i].q->done))
+				continue;
+
+			running++;
+			check_worker(i);
+		}
+
+		usleep(sleep_time);
+		sleep_time = MIN(2 * sleep_time, IDLE_SLEEP_MAX);
+	} while (running);
 }
 
 static void destroy_workers(void)
@@ -521,12 +805,16 @@ static void destroy_workers(void)
 
 	for (i = 0; i < worker_count; i++) {
 		if (workers[i].q) {
-			queue_destroy(workers[i].q, 0);
+			queue_destroy(workers[i].q);
 			workers[i].q = 0;
 		}
 	}
 }
 
+/*
+ * Queues the path to repetitions different workers, the reads option is
+ * limited to the worker count in setup.
+ */
 static int sched_work(const int first_worker,
 		      const char *path, int repetitions)
 {
@@ -537,6 +825,8 @@ static int sched_work(const int first_worker,
 	if (is_ratelimitted(path))
 		repetitions = 1;
 
+	memset(sched_workers, 0, worker_count);
+
 	for (i = 0, j = first_worker; i < repetitions; j++) {
 		if (j >= worker_count)
 			j = 0;
@@ -550,7 +840,11 @@ static int sched_work(const int first_worker,
 		if (j == first_worker)
 			workers_pushed = 0;
 
-		pushed = try_push_work(j, path);
+		if (sched_workers[j])
+			continue;
+
+		pushed = try_push_work(j, path, repetitions > 1);
+		sched_workers[j] = pushed;
 		i += pushed;
 		workers_pushed += pushed;
 
@@ -561,6 +855,38 @@ static int sched_work(const int first_worker,
 	return j;
 }
 
+static void check_uring(void)
+{
+	struct io_uring_params params = {};
+	struct io_uring_probe *probe;
+	const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+	size_t probe_size;
+	unsigned int i;
+	int fd;
+
+	fd = io_uring_setup(1, &params);
+	if (fd < 0)
+		tst_brk(TCONF | TERRNO, "io_uring_setup() failed");
+
+	probe_size = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+	probe = SAFE_MALLOC(probe_size);
+	memset(probe, 0, probe_size);
+
+	if (io_uring_register(fd, IORING_REGISTER_PROBE, probe, 256))
+		tst_brk(TCONF | TERRNO, "io_uring opcode probe failed");
+
+	for (i = 0; i < ARRAY_SIZE(ops); i++) {
+		if (ops[i] > probe->last_op ||
+		    !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+			tst_brk(TCONF, "io_uring opcode %d not supported", ops[i]);
+	}
+
+	free(probe);
+	SAFE_CLOSE(fd);
+
+	tst_res(TINFO, "Using io_uring with batches of %d files", URING_BATCH);
+}
+
 static void setup(void)
 {
 	struct timespec now;
@@ -586,7 +912,20 @@ static void setup(void)
 
 	if (!worker_count)
 		worker_count = MIN(MAX(tst_ncpus() - 1, 1L), max_workers);
-	workers = SAFE_MALLOC(worker_count * sizeof(*workers));
+	/* Shared so that the parent sees the worker heartbeats */
+	workers = SAFE_MMAP(NULL, worker_count * sizeof(*workers),
+			    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			    -1, 0);
+	work_seq = SAFE_MMAP(NULL, sizeof(*work_seq),
+			     PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			     -1, 0);
+	sched_workers = SAFE_MALLOC(worker_count);
+
+	if (reads > worker_count) {
+		tst_res(TINFO, "Limiting reads (-r) to the worker count %ld",
+			worker_count);
+		reads = worker_count;
+	}
 
 	if (tst_parse_int(str_worker_timeout, &worker_timeout, 1, INT_MAX)) {
 		tst_brk(TBROK,
@@ -605,7 +944,10 @@ static void setup(void)
 	worker_timeout *= 1000;
 
 	SAFE_CLOCK_GETTIME(CLOCK_MONOTONIC_RAW, &now);
-	epoch = tst_timespec_to_us(now);
+	epoch = timespec_to_us(now);
+
+	if (use_uring)
+		check_uring();
 }
 
 static void reap_children(void)
@@ -644,7 +986,14 @@ static void cleanup(void)
 	stop_workers();
 	reap_children();
 	destroy_workers();
-	free(workers);
+
+	if (workers)
+		SAFE_MUNMAP(workers, worker_count * sizeof(*workers));
+
+	if (work_seq)
+		SAFE_MUNMAP(work_seq, sizeof(*work_seq));
+
+	free(sched_workers);
 }
 
 static void visit_dir(const char *path)
@@ -732,7 +1081,7 @@ static struct tst_test test = {
 		{"e:", &blacklist[0],
 		 "Pattern Ignore files which match an 'extended' pattern, see fnmatch(3)."},
 		{"r:", &str_reads,
-		 "Count The number of times to schedule a file for reading."},
+		 "Count The number of workers to schedule a file for reading to."},
 		{"w:", &str_max_workers,
 		 "Count Set the worker count limit, the default is 15."},
 		{"W:", &str_worker_count,
@@ -741,6 +1090,8 @@ static struct tst_test test = {
 		 "Drop privileges; switch to the nobody user."},
 		{"t:", &str_worker_timeout,
 		 "Milliseconds a worker has to read a file before it is restarted"},
+		{"u", &use_uring,
+		 "Batch open, read and close calls with io_uring."},
 		{}
 	},
 	.setup = setup,
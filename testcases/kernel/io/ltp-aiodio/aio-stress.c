@@ -10,6 +10,11 @@
  * AIO is done in a rotating loop: first file1.bin gets 8 requests, then
  * file2.bin, then file3.bin etc. As each file finishes writing, test switches
  * to reads. IO buffers are aligned in case we want to do direct IO.
+ *
+ * The I/O is driven either through libaio (default) or through io_uring
+ * (-E io_uring). The io_uring engine can additionally use registered buffers
+ * (-B), registered files (-F) and a kernel submission queue polling thread
+ * (-P). Both engines submit and reap the I/O in the same batches.
  */
 
 #define _FILE_OFFSET_BITS 64
@@ -17,7 +22,6 @@
 #define _GNU_SOURCE
 #include "tst_test.h"
 
-#ifdef HAVE_LIBAIO
 #include <stdio.h>
 #include <errno.h>
 #include <assert.h>
@@ -32,9 +36,12 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <pthread.h>
+#ifdef HAVE_LIBAIO
 #include <libaio.h>
+#endif
 #include "tst_safe_pthread.h"
 #include "tst_safe_sysv_ipc.h"
+#include "tst_safe_io_uring.h"
 
 #define IO_FREE 0
 #define IO_PENDING 1
@@ -64,6 +71,7 @@ static char *str_o_flag;
 static char *str_stages;
 static char *str_use_shm;
 static char *str_num_threads;
+static char *str_engine;
 
 static int num_files = 1;
 static long long file_size = 1024 * 1024 * 1024;
@@ -89,6 +97,9 @@ static int padded_reclen;
 static char *verify;
 static char *verify_buf;
 static char *unlink_files;
+static char *uring_fixed_bufs;
+static char *uring_fixed_files;
+static char *uring_sqpoll;
 
 /*
  * latencies during io_submit are measured, these are the
@@ -154,12 +165,16 @@ struct io_oper {
 	struct timeval start_time;
 
 	char *file_name;
+
+	/* index into the registered files, -1 if not registered */
+	int file_index;
 };
 
 /* a single io, and all the tracking needed for it */
 struct io_unit {
-	/* note, iocb must go first! */
+#ifdef HAVE_LIBAIO
 	struct iocb iocb;
+#endif
 
 	/* pointer to parent io operation struct */
 	struct io_oper *io_oper;
@@ -170,6 +185,13 @@ struct io_unit {
 	/* size of the aligned buffer (record size) */
 	int buf_size;
 
+	/* index into the registered buffers */
+	int buf_index;
+
+	/* stage of the operation and file offset of the io */
+	int rw;
+	off_t offset;
+
 	/* state of this io unit (free, pending, done) */
 	int busy;
 
@@ -182,7 +204,16 @@ struct io_unit {
 };
 
 struct thread_info {
+#ifdef HAVE_LIBAIO
 	io_context_t io_ctx;
+
+	/* preallocated array of iocb pointers for io_submit */
+	struct iocb **iocbs;
+
+	/* preallocated array of events */
+	struct io_event *events;
+#endif
+	struct tst_io_uring uring;
 	pthread_t tid;
 
 	/* allocated array of io_unit structs */
@@ -197,11 +228,8 @@ struct thread_info {
 	/* number of io units in flight */
 	int num_global_pending;
 
-	/* preallocated array of iocb pointers, only used in run_active */
-	struct iocb **iocbs;
-
-	/* preallocated array of events */
-	struct io_event *events;
+	/* preallocated array of io unit pointers, only used in run_active */
+	struct io_unit **batch;
 
 	/* size of the events array */
 	int num_global_events;
@@ -223,6 +251,21 @@ struct thread_info {
 	struct io_latency io_completion_latency;
 };
 
+/*
+ * I/O engine, submit() returns the number of queued io units or negative
+ * errno, reap() waits for at least min_nr completions, passes at most max_nr
+ * of them to finish_io() and returns their number or negative errno.
+ */
+struct io_engine {
+	const char *name;
+	void (*setup)(struct thread_info *t);
+	void (*release)(struct thread_info *t);
+	int (*submit)(struct thread_info *t, struct io_unit **ios, int nr);
+	int (*reap)(struct thread_info *t, int min_nr, int max_nr);
+};
+
+static struct io_engine *engine;
+
 /* pthread mutexes and other globals for keeping the threads in sync */
 static pthread_barrier_t worker_barrier;
 static struct timeval global_stage_start_time;
@@ -320,6 +363,22 @@ static void oper_list_del(struct io_oper *oper, struct io_oper **list)
 		*list = oper->next;
 }
 
+static char *stage_name(int rw)
+{
+	switch (rw) {
+	case WRITE:
+		return "write";
+	case READ:
+		return "read";
+	case RWRITE:
+		return "random write";
+	case RREAD:
+		return "random read";
+	}
+
+	return "unknown";
+}
+
 /* worker func to check error fields in the io unit */
 static int check_finished_io(struct io_unit *io)
 {
@@ -335,11 +394,11 @@ static int check_finished_io(struct io_unit *io)
 		 * read is an error.
 		 */
 		if ((io->io_oper->rw == READ || io->io_oper->rw == RREAD) &&
-		    s.st_size > (io->iocb.u.c.offset + io->res)) {
+		    s.st_size > (io->offset + io->res)) {
 
-			tst_res(TINFO, "io err %lu (%s) op %d, off %llu size %d",
-				io->res, tst_strerrno(-io->res), io->iocb.aio_lio_opcode,
-				io->iocb.u.c.offset, io->buf_size);
+			tst_res(TINFO, "io err %lu (%s) op %s, off %llu size %d",
+				io->res, tst_strerrno(-io->res), stage_name(io->rw),
+				(unsigned long long)io->offset, io->buf_size);
 			io->io_oper->last_err = io->res;
 			io->io_oper->num_err++;
 			return -1;
@@ -349,7 +408,7 @@ static int check_finished_io(struct io_unit *io)
 	if (verify && io->io_oper->rw == READ) {
 		if (memcmp(io->buf, verify_buf, io->io_oper->reclen)) {
 			tst_res(TINFO, "verify error, file %s offset %llu contents (offset:bad:good):",
-				io->io_oper->file_name, io->iocb.u.c.offset);
+				io->io_oper->file_name, (unsigned long long)io->offset);
 
 			for (i = 0; i < io->io_oper->reclen; i++) {
 				if (io->buf[i] != verify_buf[i]) {
@@ -376,22 +435,6 @@ static int grab_iou(struct io_unit *io, struct io_oper *oper)
 	return 0;
 }
 
-static char *stage_name(int rw)
-{
-	switch (rw) {
-	case WRITE:
-		return "write";
-	case READ:
-		return "read";
-	case RWRITE:
-		return "random write";
-	case RREAD:
-		return "random read";
-	}
-
-	return "unknown";
-}
-
 static inline double oper_mb_trans(struct io_oper *oper)
 {
 	return ((double)oper->started_ios * (double)oper->reclen) / (double)(1024 * 1024);
@@ -474,29 +517,12 @@ static void finish_io(struct thread_info *t, struct io_unit *io, long result,
 
 static int read_some_events(struct thread_info *t)
 {
-	struct io_unit *event_io;
-	struct io_event *event;
-	int nr;
-	int i;
 	int min_nr = io_iter;
-	struct timeval stop_time;
 
 	if (t->num_global_pending < io_iter)
 		min_nr = t->num_global_pending;
 
-	nr = io_getevents(t->io_ctx, min_nr, t->num_global_events, t->events, NULL);
-	if (nr <= 0)
-		return nr;
-
-	gettimeofday(&stop_time, NULL);
-
-	for (i = 0; i < nr; i++) {
-		event = t->events + i;
-		event_io = (struct io_unit *)((unsigned long)event->obj);
-		finish_io(t, event_io, event->res, &stop_time);
-	}
-
-	return nr;
+	return engine->reap(t, min_nr, t->num_global_events);
 }
 
 /*
@@ -533,9 +559,6 @@ retry:
  */
 static int io_oper_wait(struct thread_info *t, struct io_oper *oper)
 {
-	struct io_event event;
-	struct io_unit *event_io;
-
 	if (!oper)
 		return 0;
 
@@ -545,14 +568,7 @@ static int io_oper_wait(struct thread_info *t, struct io_oper *oper)
 		/* this func is not speed sensitive, no need to go wild reading
 		 * more than one event at a time
 		 */
-	while (io_getevents(t->io_ctx, 1, 1, &event, NULL) > 0) {
-		struct timeval tv_now;
-
-		event_io = (struct io_unit *)((unsigned long)event.obj);
-
-		gettimeofday(&tv_now, NULL);
-		finish_io(t, event_io, event.res, &tv_now);
-
+	while (engine->reap(t, 1, 1) > 0) {
 		if (oper->num_pending == 0)
 			break;
 	}
@@ -598,47 +614,44 @@ static off_t random_byte_offset(struct io_oper *oper)
 }
 
 /*
- * build an aio iocb for an operation, based on oper->rw and the
- * last offset used.  This finds the struct io_unit that will be attached
- * to the iocb, and things are ready for submission to aio after this
+ * prepare an io unit for an operation, based on oper->rw and the
+ * last offset used.  This finds the struct io_unit that will carry the
+ * request, and things are ready for submission to the engine after this
  * is called.
  *
  * returns null on error
  */
-static struct io_unit *build_iocb(struct thread_info *t, struct io_oper *oper)
+static struct io_unit *build_iou(struct thread_info *t, struct io_oper *oper)
 {
 	struct io_unit *io;
-	off_t rand_byte;
 
 	io = find_iou(t, oper);
 	if (!io)
 		tst_brk(TBROK, "unable to find io unit");
 
+	io->rw = oper->rw;
+
 	switch (oper->rw) {
 	case WRITE:
-		io_prep_pwrite(&io->iocb, oper->fd, io->buf, oper->reclen, oper->last_offset);
-		oper->last_offset += oper->reclen;
-		break;
 	case READ:
-		io_prep_pread(&io->iocb, oper->fd, io->buf, oper->reclen, oper->last_offset);
+		io->offset = oper->last_offset;
 		oper->last_offset += oper->reclen;
 		break;
 	case RREAD:
-		rand_byte = random_byte_offset(oper);
-		oper->last_offset = rand_byte;
-		io_prep_pread(&io->iocb, oper->fd, io->buf, oper->reclen, rand_byte);
-		break;
 	case RWRITE:
-		rand_byte = random_byte_offset(oper);
-		oper->last_offset = rand_byte;
-		io_prep_pwrite(&io->iocb, oper->fd, io->buf, oper->reclen, rand_byte);
-
+		io->offset = random_byte_offset(oper);
+		oper->last_offset = io->offset;
 		break;
 	}
 
 	return io;
 }
 
+static int iou_is_write(struct io_unit *io)
+{
+	return io->rw == WRITE || io->rw == RWRITE;
+}
+
 /*
  * wait for any pending requests, and then free all ram associated with
  * an operation.  returns the last error the operation hit (zero means none)
@@ -681,16 +694,17 @@ static struct io_oper *create_oper(int fd, int rw, off_t start, off_t end,
 	oper->rw = rw;
 	oper->total_ios = (oper->end - oper->start) / oper->reclen;
 	oper->file_name = file_name;
+	oper->file_index = -1;
 
 	return oper;
 }
 
 /*
- * does setup on num_ios worth of iocbs, but does not actually
+ * does setup on num_ios worth of io units, but does not actually
  * start any io
  */
 static int build_oper(struct thread_info *t, struct io_oper *oper, int num_ios,
-		      struct iocb **my_iocbs)
+		      struct io_unit **my_ious)
 {
 	int i;
 	struct io_unit *io;
@@ -705,27 +719,27 @@ static int build_oper(struct thread_info *t, struct io_oper *oper, int num_ios,
 		num_ios = oper->total_ios - oper->started_ios;
 
 	for (i = 0; i < num_ios; i++) {
-		io = build_iocb(t, oper);
+		io = build_iou(t, oper);
 		if (!io)
 			return -1;
 
-		my_iocbs[i] = &io->iocb;
+		my_ious[i] = io;
 	}
 
 	return num_ios;
 }
 
 /*
- * runs through the iocbs in the array provided and updates
+ * runs through the io units in the array provided and updates
  * counters in the associated oper struct
  */
-static void update_iou_counters(struct iocb **my_iocbs, int nr, struct timeval *tv_now)
+static void update_iou_counters(struct io_unit **my_ious, int nr, struct timeval *tv_now)
 {
 	struct io_unit *io;
 	int i;
 
 	for (i = 0; i < nr; i++) {
-		io = (struct io_unit *)(my_iocbs[i]);
+		io = my_ious[i];
 		io->io_oper->num_pending++;
 		io->io_oper->started_ios++;
 		io->io_start_time = *tv_now; /* set time of io_submit */
@@ -733,7 +747,7 @@ static void update_iou_counters(struct iocb **my_iocbs, int nr, struct timeval *
 }
 
 /* starts some io for a given file, returns zero if all went well */
-static int run_built(struct thread_info *t, int num_ios, struct iocb **my_iocbs)
+static int run_built(struct thread_info *t, int num_ios, struct io_unit **my_ious)
 {
 	int ret;
 	struct timeval start_time;
@@ -741,7 +755,7 @@ static int run_built(struct thread_info *t, int num_ios, struct iocb **my_iocbs)
 
 resubmit:
 	gettimeofday(&start_time, NULL);
-	ret = io_submit(t->io_ctx, num_ios, my_iocbs);
+	ret = engine->submit(t, my_ious, num_ios);
 
 	gettimeofday(&stop_time, NULL);
 	calc_latency(&start_time, &stop_time, &t->io_submit_latency);
@@ -749,8 +763,8 @@ resubmit:
 	if (ret != num_ios) {
 		/* some I/O got through */
 		if (ret > 0) {
-			update_iou_counters(my_iocbs, ret, &stop_time);
-			my_iocbs += ret;
+			update_iou_counters(my_ious, ret, &stop_time);
+			my_ious += ret;
 			t->num_global_pending += ret;
 			num_ios -= ret;
 		}
@@ -768,11 +782,12 @@ resubmit:
 			goto resubmit;
 		}
 
-		tst_res(TINFO, "ret %d (%s) on io_submit", ret, tst_strerrno(-ret));
+		tst_res(TINFO, "ret %d (%s) on %s submit", ret,
+			tst_strerrno(-ret), engine->name);
 		return -1;
 	}
 
-	update_iou_counters(my_iocbs, ret, &stop_time);
+	update_iou_counters(my_ious, ret, &stop_time);
 	t->num_global_pending += ret;
 
 	return 0;
@@ -853,7 +868,7 @@ static int run_active_list(struct thread_info *t, int io_iter, int max_io_submit
 {
 	struct io_oper *oper;
 	struct io_oper *built_opers = NULL;
-	struct iocb **my_iocbs = t->iocbs;
+	struct io_unit **my_ious = t->batch;
 	int ret = 0;
 	int num_built = 0;
 
@@ -867,9 +882,9 @@ static int run_active_list(struct thread_info *t, int io_iter, int max_io_submit
 			continue;
 		}
 
-		ret = build_oper(t, oper, io_iter, my_iocbs);
+		ret = build_oper(t, oper, io_iter, my_ious);
 		if (ret >= 0) {
-			my_iocbs += ret;
+			my_ious += ret;
 			num_built += ret;
 			oper_list_del(oper, &t->active_opers);
 			oper_list_add(oper, &built_opers);
@@ -881,7 +896,7 @@ static int run_active_list(struct thread_info *t, int io_iter, int max_io_submit
 	}
 
 	if (num_built) {
-		ret = run_built(t, num_built, t->iocbs);
+		ret = run_built(t, num_built, t->batch);
 		if (ret < 0)
 			tst_brk(TBROK, "error %d on run_built", ret);
 
@@ -899,6 +914,7 @@ static int run_active_list(struct thread_info *t, int io_iter, int max_io_submit
 	return 0;
 }
 
+#ifdef HAVE_LIBAIO
 static void aio_setup(io_context_t *io_ctx, int n)
 {
 	int res = io_queue_init(n, io_ctx);
@@ -907,6 +923,265 @@ static void aio_setup(io_context_t *io_ctx, int n)
 		tst_brk(TBROK, "io_queue_setup(%d) returned %d (%s)", n, res, tst_strerrno(-res));
 }
 
+static void libaio_setup(struct thread_info *t)
+{
+	aio_setup(&t->io_ctx, 512);
+
+	t->iocbs = SAFE_MALLOC(sizeof(struct iocb *) * max_io_submit);
+	memset(t->iocbs, 0, max_io_submit * sizeof(struct iocb *));
+
+	t->events = SAFE_MALLOC(sizeof(struct io_event) * t->num_global_events);
+	memset(t->events, 0, sizeof(struct io_event) * t->num_global_events);
+}
+
+static void libaio_release(struct thread_info *t)
+{
+	io_queue_release(t->io_ctx);
+
+	free(t->iocbs);
+	free(t->events);
+}
+
+static int libaio_submit(struct thread_info *t, struct io_unit **ios, int nr)
+{
+	struct io_unit *io;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		io = ios[i];
+
+		if (iou_is_write(io)) {
+			io_prep_pwrite(&io->iocb, io->io_oper->fd, io->buf,
+				       io->io_oper->reclen, io->offset);
+		} else {
+			io_prep_pread(&io->iocb, io->io_oper->fd, io->buf,
+				      io->io_oper->reclen, io->offset);
+		}
+
+		io->iocb.data = io;
+		t->iocbs[i] = &io->iocb;
+	}
+
+	return io_submit(t->io_ctx, nr, t->iocbs);
+}
+
+static int libaio_reap(struct thread_info *t, int min_nr, int max_nr)
+{
+	struct timeval stop_time;
+	int nr;
+	int i;
+
+	nr = io_getevents(t->io_ctx, min_nr, max_nr, t->events, NULL);
+	if (nr <= 0)
+		return nr;
+
+	gettimeofday(&stop_time, NULL);
+
+	for (i = 0; i < nr; i++)
+		finish_io(t, t->events[i].data, t->events[i].res, &stop_time);
+
+	return nr;
+}
+
+static struct io_engine libaio_engine = {
+	.name = "libaio",
+	.setup = libaio_setup,
+	.release = libaio_release,
+	.submit = libaio_submit,
+	.reap = libaio_reap,
+};
+#endif
+
+/*
+ * Buffers of the io units are consecutive, they are registered in as few
+ * chunks as possible since the kernel limits a registered buffer to 1GB.
+ */
+static void uring_register_bufs(struct thread_info *t)
+{
+	int per_buf = MAX(1, (1 << 30) / padded_reclen);
+	int nr_bufs = (t->num_global_ios + per_buf - 1) / per_buf;
+	struct iovec *iov;
+	int i;
+
+	iov = SAFE_MALLOC(nr_bufs * sizeof(*iov));
+
+	for (i = 0; i < t->num_global_ios; i++) {
+		t->ios[i].buf_index = i / per_buf;
+
+		if (i % per_buf == 0) {
+			iov[i / per_buf].iov_base = t->ios[i].buf;
+			iov[i / per_buf].iov_len = 0;
+		}
+
+		iov[i / per_buf].iov_len += padded_reclen;
+	}
+
+	if (io_uring_register(t->uring.fd, IORING_REGISTER_BUFFERS, iov, nr_bufs))
+		tst_brk(TBROK | TERRNO, "io_uring_register(IORING_REGISTER_BUFFERS) failed");
+
+	free(iov);
+}
+
+static void uring_register_files(struct thread_info *t)
+{
+	struct io_oper *oper = t->active_opers;
+	int *fds;
+	int nr = 0;
+
+	if (!oper)
+		return;
+
+	fds = SAFE_MALLOC(t->num_files * sizeof(*fds));
+
+	do {
+		oper->file_index = nr;
+		fds[nr++] = oper->fd;
+		oper = oper->next;
+	} while (oper != t->active_opers);
+
+	if (io_uring_register(t->uring.fd, IORING_REGISTER_FILES, fds, nr))
+		tst_brk(TBROK | TERRNO, "io_uring_register(IORING_REGISTER_FILES) failed");
+
+	free(fds);
+}
+
+static void uring_setup(struct thread_info *t)
+{
+	struct io_uring_params params = {};
+
+	if (uring_sqpoll) {
+		params.flags |= IORING_SETUP_SQPOLL;
+		params.sq_thread_idle = 1000;
+	}
+
+	/*
+	 * The completion queue is twice the size of the submission queue and
+	 * there are never more than num_global_ios requests in flight.
+	 */
+	SAFE_IO_URING_INIT(MIN(t->num_global_ios, 32768), &params, &t->uring);
+
+	if (uring_fixed_bufs)
+		uring_register_bufs(t);
+
+	if (uring_fixed_files)
+		uring_register_files(t);
+}
+
+static void uring_release(struct thread_info *t)
+{
+	SAFE_IO_URING_CLOSE(&t->uring);
+}
+
+static int uring_submit(struct thread_info *t, struct io_unit **ios, int nr)
+{
+	struct tst_io_uring *r = &t->uring;
+	struct io_uring_sqe *sqe;
+	struct io_unit *io;
+	uint32_t tail = *r->sqr_tail;
+	uint32_t head = __atomic_load_n(r->sqr_head, __ATOMIC_ACQUIRE);
+	uint32_t idx;
+	int i, ret;
+
+	nr = MIN(nr, (int)(r->sqr_size - (tail - head)));
+	if (!nr)
+		return -EAGAIN;
+
+	for (i = 0; i < nr; i++, tail++) {
+		io = ios[i];
+		idx = tail & *r->sqr_mask;
+		sqe = r->sqr_entries + idx;
+		memset(sqe, 0, sizeof(*sqe));
+
+		if (uring_fixed_bufs) {
+			sqe->opcode = iou_is_write(io) ?
+				IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+			sqe->buf_index = io->buf_index;
+		} else {
+			sqe->opcode = iou_is_write(io) ?
+				IORING_OP_WRITE : IORING_OP_READ;
+		}
+
+		if (io->io_oper->file_index >= 0) {
+			sqe->fd = io->io_oper->file_index;
+			sqe->flags = IOSQE_FIXED_FILE;
+		} else {
+			sqe->fd = io->io_oper->fd;
+		}
+
+		sqe->addr = (uintptr_t)io->buf;
+		sqe->len = io->io_oper->reclen;
+		sqe->off = io->offset;
+		sqe->user_data = (uintptr_t)io;
+		r->sqr_array[idx] = idx;
+	}
+
+	__atomic_store_n(r->sqr_tail, tail, __ATOMIC_RELEASE);
+
+	/*
+	 * The SQEs are already in the ring, the kernel may consume only part
+	 * of them, e.g. when it fails to prepare one of them and posts the
+	 * error as its completion, so the rest has to be submitted again.
+	 */
+	if (!uring_sqpoll) {
+		for (i = 0; i < nr; i += ret) {
+			ret = SAFE_IO_URING_ENTER(0, r->fd, nr - i, 0, 0, NULL);
+			if (!ret)
+				tst_brk(TBROK, "io_uring_enter() submitted no SQEs");
+		}
+
+		return nr;
+	}
+
+	/*
+	 * The polling thread may have gone idle, the tail store has to be
+	 * ordered before the flags load, see io_uring_enter(2).
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(r->sqr_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+		SAFE_IO_URING_ENTER(0, r->fd, 0, 0, IORING_ENTER_SQ_WAKEUP, NULL);
+
+	return nr;
+}
+
+static int uring_reap(struct thread_info *t, int min_nr, int max_nr)
+{
+	struct tst_io_uring *r = &t->uring;
+	const struct io_uring_cqe *cqe;
+	struct timeval stop_time;
+	uint32_t head = *r->cqr_head;
+	uint32_t tail;
+	int nr = 0;
+
+	for (;;) {
+		tail = __atomic_load_n(r->cqr_tail, __ATOMIC_ACQUIRE);
+		if ((int)(tail - head) >= min_nr)
+			break;
+
+		SAFE_IO_URING_ENTER(0, r->fd, 0, min_nr, IORING_ENTER_GETEVENTS, NULL);
+	}
+
+	gettimeofday(&stop_time, NULL);
+
+	for (; head != tail && nr < max_nr; head++, nr++) {
+		cqe = r->cqr_entries + (head & *r->cqr_mask);
+		finish_io(t, (struct io_unit *)(uintptr_t)cqe->user_data,
+			  cqe->res, &stop_time);
+	}
+
+	__atomic_store_n(r->cqr_head, head, __ATOMIC_RELEASE);
+
+	return nr;
+}
+
+static struct io_engine uring_engine = {
+	.name = "io_uring",
+	.setup = uring_setup,
+	.release = uring_release,
+	.submit = uring_submit,
+	.reap = uring_reap,
+};
+
 /*
  * allocate io operation and event arrays for a given thread
  */
@@ -937,11 +1212,8 @@ static void setup_ious(struct thread_info *t, int num_files, int depth, int recl
 		memset(verify_buf, 'b', reclen);
 	}
 
-	t->iocbs = SAFE_MALLOC(sizeof(struct iocb *) * max_io_submit);
-	memset(t->iocbs, 0, max_io_submit * sizeof(struct iocb *));
-
-	t->events = SAFE_MALLOC(sizeof(struct io_event) * depth * num_files);
-	memset(t->events, 0, num_files * sizeof(struct io_event) * depth);
+	t->batch = SAFE_MALLOC(sizeof(struct io_unit *) * max_io_submit);
+	memset(t->batch, 0, max_io_submit * sizeof(struct io_unit *));
 
 	t->num_global_ios = num_files * depth;
 	t->num_global_events = t->num_global_ios;
@@ -1040,7 +1312,7 @@ static int *worker(struct thread_info *t)
 	int status = 0;
 	int cnt;
 
-	aio_setup(&t->io_ctx, 512);
+	engine->setup(t);
 
 restart:
 	if (num_threads > 1) {
@@ -1132,7 +1404,7 @@ restart:
 	if (t->num_global_pending)
 		tst_res(TINFO, "global num pending is %d", t->num_global_pending);
 
-	io_queue_release(t->io_ctx);
+	engine->release(t);
 
 	return (void *)(intptr_t)status;
 }
@@ -1161,13 +1433,32 @@ static int run_workers(struct thread_info *t, int num_threads)
 
 static void setup(void)
 {
-	int maxaio;
+	int maxaio = INT_MAX;
 	int stages_i;
 
 	page_size_mask = getpagesize() - 1;
 
-	SAFE_FILE_SCANF(PATH_FS_NR_AIO_MAX_NR, "%d", &maxaio);
-	tst_res(TINFO, "Maximum AIO blocks: %d", maxaio);
+	if (!str_engine || !strcmp(str_engine, "libaio")) {
+#ifdef HAVE_LIBAIO
+		engine = &libaio_engine;
+
+		SAFE_FILE_SCANF(PATH_FS_NR_AIO_MAX_NR, "%d", &maxaio);
+		tst_res(TINFO, "Maximum AIO blocks: %d", maxaio);
+#else
+		tst_brk(TCONF, "test requires libaio and its development packages");
+#endif
+	} else if (!strcmp(str_engine, "io_uring")) {
+		io_uring_setup_supported_by_kernel();
+		engine = &uring_engine;
+	} else {
+		tst_brk(TBROK, "Invalid I/O engine '%s'", str_engine);
+	}
+
+	if (engine != &uring_engine &&
+	    (uring_fixed_bufs || uring_fixed_files || uring_sqpoll))
+		tst_brk(TBROK, "-B, -F and -P require the io_uring engine");
+
+	tst_res(TINFO, "Using %s I/O engine", engine->name);
 
 	if (tst_parse_int(str_num_files, &num_files, 1, INT_MAX))
 		tst_brk(TBROK, "Invalid number of files to generate '%s'", str_num_files);
@@ -1343,8 +1634,7 @@ static void run(void)
 
 	for (i = 0; i < num_threads; i++) {
 		free(t[i].ios);
-		free(t[i].iocbs);
-		free(t[i].events);
+		free(t[i].batch);
 	}
 	free(t);
 
@@ -1363,10 +1653,13 @@ static struct tst_test test = {
 	.options = (struct tst_option[]){
 		{ "a:", &str_iterations, "Total number of ayncs I/O the program will run (default 500)" },
 		{ "b:", &str_max_io_submit, "Max number of iocbs to give io_submit at once" },
+		{ "B", &uring_fixed_bufs, "Use registered buffers with io_uring" },
 		{ "c:", &str_num_contexts, "Number of io contexts per file" },
 		{ "d:", &str_depth, "Number of pending aio requests for each file (default 64)" },
 		{ "e:", &str_io_iter, "Number of I/O per file sent before switching to the next file (default 8)" },
+		{ "E:", &str_engine, "I/O engine, libaio (default) or io_uring" },
 		{ "f:", &str_num_files, "Number of files to generate" },
+		{ "F", &uring_fixed_files, "Use registered files with io_uring" },
 		{ "g:", &str_context_offset, "Offset between contexts (default 2M)" },
 		{ "l", &latency_stats, "Print io_submit latencies after each stage" },
 		{ "L", &completion_latency_stats, "Print io completion latencies after each stage" },
@@ -1374,6 +1667,7 @@ static struct tst_test test = {
 		{ "n", &no_fsync_stages, "No fsyncs between write stage and read stage" },
 		{ "o:", &str_stages, "Add an operation to the list: write=0, read=1, random write=2, random read=3" },
 		{ "O", &str_o_flag, "Use O_DIRECT" },
+		{ "P", &uring_sqpoll, "Use kernel submission queue polling thread with io_uring" },
 		{ "r:", &str_rec_len, "Record size in KB used for each io (default 64K)" },
 		{ "s:", &str_file_size, "Size in MB of the test file(s) (default 1024M)" },
 		{ "t:", &str_num_threads, "Number of threads to run" },
@@ -1382,6 +1676,3 @@ static struct tst_test test = {
 		{},
 	},
 };
-#else
-TST_TEST_TCONF("test requires libaio and its development packages");
-#endif
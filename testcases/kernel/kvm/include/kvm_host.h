@@ -47,6 +47,8 @@
 #define DEFAULT_RAM_SIZE (16 * 1024 * 1024)
 #define MAX_KVM_MEMSLOTS 8
 
+#define MAX_KVM_VCPU_STATES 16
+
 struct tst_kvm_instance {
 	int vm_fd, vcpu_fd;
 	struct kvm_run *vcpu_info;
@@ -55,6 +57,23 @@ struct tst_kvm_instance {
 	struct tst_kvm_result *result;
 };
 
+/*
+ * Copy of guest memory and vCPU state taken by tst_kvm_snapshot_instance().
+ * Guest memory is restored page by page using KVM dirty page logging. The
+ * guest memory itself is moved to guest_ram, which is owned by the snapshot
+ * and survives tst_free_all().
+ */
+struct tst_kvm_snapshot {
+	void *ram[MAX_KVM_MEMSLOTS];
+	void *guest_ram[MAX_KVM_MEMSLOTS];
+	size_t guest_ram_size[MAX_KVM_MEMSLOTS];
+	unsigned long *dirty_bitmap[MAX_KVM_MEMSLOTS];
+	void *vcpu_state[MAX_KVM_VCPU_STATES];
+	struct kvm_msrs *msrs;
+	struct kvm_clock_data clock;
+	int has_clock;
+};
+
 /* Test binary to be installed into the VM at VM_KERNEL_BASEADDR */
 extern const char kvm_payload_start[], kvm_payload_end[];
 
@@ -66,6 +85,17 @@ void tst_kvm_setup(void);
 void tst_kvm_run(void);
 void tst_kvm_cleanup(void);
 
+/*
+ * Same as tst_kvm_run() but the VM is created only on the first iteration
+ * and reset from a snapshot on the following ones, which saves most of the
+ * setup time of short payloads run with -i. Tests have to opt in by using
+ * it as the test function. Not suitable for payloads that use nested
+ * virtualization, the nested hypervisor state is not fully restored and
+ * the following iterations start in a stale nested context. The kvm_svm*
+ * and kvm_vmx* tests stay on tst_kvm_run() for that reason.
+ */
+void tst_kvm_run_snapshot(void);
+
 /*
  * Validate KVM guest test result (usually passed via result->result) and
  * fail with TBROK if the value cannot be safely passed to tst_res() or
@@ -136,6 +166,38 @@ int tst_kvm_run_instance(struct tst_kvm_instance *inst, int exp_errno);
  */
 void tst_kvm_destroy_instance(struct tst_kvm_instance *inst);
 
+/*
+ * Save guest memory, vCPU registers, LAPIC, MSRs including the TSC and the
+ * kvmclock of the given KVM instance and enable dirty page logging on all
+ * its memory slots so that the instance can be cheaply reset by
+ * tst_kvm_reset_instance() instead of being recreated. Should be called
+ * before the instance is first run. Returns 0 on success and -1 if
+ * snapshots are not supported, in which case the instance has to be
+ * recreated.
+ *
+ * Guest memory is moved out of the guarded buffers so that tst_free_all()
+ * can be called between iterations, the snapshot has to be freed after the
+ * instance is destroyed.
+ *
+ * Host writes into guest memory are not tracked by dirty page logging, only
+ * small memory slots (such as the result page) are restored completely.
+ */
+int tst_kvm_snapshot_instance(struct tst_kvm_instance *inst,
+	struct tst_kvm_snapshot *snap);
+
+/*
+ * Restore the instance to the state saved by tst_kvm_snapshot_instance(),
+ * only guest memory pages written since the last reset are copied back.
+ */
+void tst_kvm_reset_instance(struct tst_kvm_instance *inst,
+	struct tst_kvm_snapshot *snap);
+
+/*
+ * Release memory allocated by tst_kvm_snapshot_instance(), including the
+ * guest memory. Call only after the instance has been destroyed.
+ */
+void tst_kvm_free_snapshot(struct tst_kvm_snapshot *snap);
+
 /*
  * Wait for given VM to call tst_signal_host() or tst_wait_host(). Timeout
  * value is in milliseconds. Zero means no wait, negative value means wait
@@ -161,7 +161,7 @@ static void setup(void)
 }
 
 static struct tst_test test = {
-	.test_all = tst_kvm_run,
+	.test_all = tst_kvm_run_snapshot,
 	.setup = setup,
 	.cleanup = tst_kvm_cleanup,
 	.needs_root = 1,
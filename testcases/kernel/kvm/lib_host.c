@@ -15,6 +15,43 @@
 #include "kvm_host.h"
 
 static struct tst_kvm_instance test_vm = { .vm_fd = -1 };
+static struct tst_kvm_snapshot test_snap;
+static int test_snap_valid;
+
+/* Memory slots up to this size are always restored completely on reset */
+#define SNAPSHOT_FULL_COPY_PAGES 16
+
+#define MSR_IA32_TSC 0x10
+
+struct kvm_vcpu_state {
+	const char *name;
+	unsigned long get_req, set_req;
+	size_t size;
+	int required;
+};
+
+/* vCPU state saved by snapshots, in the order it has to be restored */
+static const struct kvm_vcpu_state vcpu_states[] = {
+#if defined(__i386__) || defined(__x86_64__)
+# ifdef KVM_GET_NESTED_STATE
+	/* Leave nested guest mode before CR4 is restored, size is variable */
+	{"NESTED_STATE", KVM_GET_NESTED_STATE, KVM_SET_NESTED_STATE, 0, 0},
+# endif
+	{"SREGS", KVM_GET_SREGS, KVM_SET_SREGS, sizeof(struct kvm_sregs), 1},
+	/* Only available with in-kernel irqchip, restore after APIC base */
+	{"LAPIC", KVM_GET_LAPIC, KVM_SET_LAPIC, sizeof(struct kvm_lapic_state), 0},
+	{"REGS", KVM_GET_REGS, KVM_SET_REGS, sizeof(struct kvm_regs), 1},
+	{"FPU", KVM_GET_FPU, KVM_SET_FPU, sizeof(struct kvm_fpu), 0},
+	{"XSAVE", KVM_GET_XSAVE, KVM_SET_XSAVE, sizeof(struct kvm_xsave), 0},
+	{"XCRS", KVM_GET_XCRS, KVM_SET_XCRS, sizeof(struct kvm_xcrs), 0},
+	{"DEBUGREGS", KVM_GET_DEBUGREGS, KVM_SET_DEBUGREGS,
+		sizeof(struct kvm_debugregs), 0},
+	{"VCPU_EVENTS", KVM_GET_VCPU_EVENTS, KVM_SET_VCPU_EVENTS,
+		sizeof(struct kvm_vcpu_events), 0},
+	{"MP_STATE", KVM_GET_MP_STATE, KVM_SET_MP_STATE,
+		sizeof(struct kvm_mp_state), 0},
+#endif
+};
 
 const unsigned char tst_kvm_reset_code[VM_RESET_CODE_SIZE] = {
 	0xea, 0x00, 0x10, 0x00, 0x00	/* JMP 0x1000 */
@@ -290,6 +327,289 @@ void tst_kvm_destroy_instance(struct tst_kvm_instance *inst)
 	memset(inst->ram, 0, sizeof(inst->ram));
 }
 
+#if defined(__i386__) || defined(__x86_64__)
+/*
+ * Save all MSRs that can be both read and written back, KVM_SET_MSRS stops
+ * at the first MSR it fails to set. The guest TSC is restored by writing
+ * MSR_IA32_TSC, without it the reset guest would see the TSC of the previous
+ * iteration, so the snapshot fails when it cannot be saved.
+ */
+static struct kvm_msrs *snapshot_msrs(const struct tst_kvm_instance *inst)
+{
+	struct kvm_msr_list probe = { .nmsrs = 0 }, *list;
+	struct {
+		struct kvm_msrs hdr;
+		struct kvm_msr_entry entry;
+	} msr = { .hdr.nmsrs = 1 };
+	struct kvm_msrs *ret;
+	unsigned int i;
+	int sys_fd, has_tsc = 0;
+
+	sys_fd = SAFE_OPEN("/dev/kvm", O_RDWR);
+
+	if (ioctl(sys_fd, KVM_GET_MSR_INDEX_LIST, &probe) && errno != E2BIG) {
+		SAFE_CLOSE(sys_fd);
+		return NULL;
+	}
+
+	list = SAFE_MALLOC(sizeof(*list) + probe.nmsrs * sizeof(list->indices[0]));
+	list->nmsrs = probe.nmsrs;
+	SAFE_IOCTL(sys_fd, KVM_GET_MSR_INDEX_LIST, list);
+	SAFE_CLOSE(sys_fd);
+
+	ret = SAFE_MALLOC(sizeof(*ret) + list->nmsrs * sizeof(ret->entries[0]));
+	ret->nmsrs = 0;
+
+	for (i = 0; i < list->nmsrs; i++) {
+		msr.entry.index = list->indices[i];
+
+		if (ioctl(inst->vcpu_fd, KVM_GET_MSRS, &msr) != 1)
+			continue;
+
+		if (ioctl(inst->vcpu_fd, KVM_SET_MSRS, &msr) != 1)
+			continue;
+
+		ret->entries[ret->nmsrs++] = msr.entry;
+		has_tsc |= msr.entry.index == MSR_IA32_TSC;
+	}
+
+	free(list);
+
+	if (!has_tsc) {
+		tst_res(TINFO, "Cannot save MSR_IA32_TSC");
+		free(ret);
+		return NULL;
+	}
+
+	return ret;
+}
+
+static size_t vcpu_state_size(const struct tst_kvm_instance *inst,
+	const struct kvm_vcpu_state *state)
+{
+	if (state->size)
+		return state->size;
+
+#ifdef KVM_GET_NESTED_STATE
+	return MAX(ioctl(inst->vm_fd, KVM_CHECK_EXTENSION, KVM_CAP_NESTED_STATE), 0);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Move the memory slot out of the guarded buffers freed by tst_free_all()
+ * and enable dirty page logging on it. The slot has to be deleted first,
+ * KVM does not allow changing the address of an existing one.
+ */
+static void move_memslot(struct tst_kvm_instance *inst,
+	struct tst_kvm_snapshot *snap, unsigned int slot)
+{
+	struct kvm_userspace_memory_region *region = &inst->ram[slot];
+	char *old_ram = (char *)(uintptr_t)region->userspace_addr;
+	char *result = (char *)inst->result;
+	size_t size = region->memory_size;
+	char *ram;
+
+	ram = SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	memcpy(ram, old_ram, size);
+
+	region->memory_size = 0;
+	SAFE_IOCTL(inst->vm_fd, KVM_SET_USER_MEMORY_REGION, region);
+
+	region->memory_size = size;
+	region->userspace_addr = (uintptr_t)ram;
+	region->flags |= KVM_MEM_LOG_DIRTY_PAGES;
+	SAFE_IOCTL(inst->vm_fd, KVM_SET_USER_MEMORY_REGION, region);
+
+	if (result >= old_ram && result < old_ram + size) {
+		inst->result = (struct tst_kvm_result *)(ram +
+			(result - old_ram));
+	}
+
+	snap->guest_ram[slot] = ram;
+	snap->guest_ram_size[slot] = size;
+}
+
+int tst_kvm_snapshot_instance(struct tst_kvm_instance *inst,
+	struct tst_kvm_snapshot *snap)
+{
+	struct kvm_dirty_log log = {};
+	size_t i, size, pagesize, pages;
+	void *buf;
+
+	memset(snap, 0, sizeof(*snap));
+	pagesize = SAFE_SYSCONF(_SC_PAGESIZE);
+
+	for (i = 0; i < ARRAY_SIZE(vcpu_states); i++) {
+		size = vcpu_state_size(inst, &vcpu_states[i]);
+
+		if (!size)
+			continue;
+
+		buf = SAFE_MALLOC(size);
+		memset(buf, 0, size);
+
+#ifdef KVM_GET_NESTED_STATE
+		if (vcpu_states[i].get_req == KVM_GET_NESTED_STATE)
+			((struct kvm_nested_state *)buf)->size = size;
+#endif
+
+		if (ioctl(inst->vcpu_fd, vcpu_states[i].get_req, buf)) {
+			free(buf);
+
+			if (vcpu_states[i].required) {
+				tst_res(TINFO | TERRNO, "ioctl(KVM_GET_%s) failed",
+					vcpu_states[i].name);
+				goto err;
+			}
+
+			continue;
+		}
+
+		snap->vcpu_state[i] = buf;
+	}
+
+	snap->msrs = snapshot_msrs(inst);
+
+	if (!snap->msrs)
+		goto err;
+
+	if (ioctl(inst->vm_fd, KVM_CHECK_EXTENSION, KVM_CAP_ADJUST_CLOCK) > 0) {
+		SAFE_IOCTL(inst->vm_fd, KVM_GET_CLOCK, &snap->clock);
+		snap->has_clock = 1;
+	}
+
+	/* No fallback from here on, the guest memory is being moved */
+	for (i = 0; i < MAX_KVM_MEMSLOTS; i++) {
+		if (!inst->ram[i].userspace_addr)
+			continue;
+
+		size = inst->ram[i].memory_size;
+		pages = size / pagesize;
+
+		move_memslot(inst, snap, i);
+
+		snap->ram[i] = SAFE_MALLOC(size);
+		memcpy(snap->ram[i], snap->guest_ram[i], size);
+
+		/* The bitmap is accessed in 64bit words */
+		snap->dirty_bitmap[i] = SAFE_MALLOC(LTP_ALIGN(pages, 64) / 8);
+		log.slot = i;
+		log.dirty_bitmap = snap->dirty_bitmap[i];
+		SAFE_IOCTL(inst->vm_fd, KVM_GET_DIRTY_LOG, &log);
+	}
+
+	return 0;
+err:
+	tst_kvm_free_snapshot(snap);
+	return -1;
+}
+
+void tst_kvm_reset_instance(struct tst_kvm_instance *inst,
+	struct tst_kvm_snapshot *snap)
+{
+	struct kvm_dirty_log log = {};
+	struct kvm_msrs *msrs = snap->msrs;
+	struct kvm_clock_data clock;
+	size_t i, page, pages, pagesize;
+	unsigned long *bitmap;
+	char *ram, *copy;
+	int ret;
+
+	pagesize = SAFE_SYSCONF(_SC_PAGESIZE);
+
+	for (i = 0; i < MAX_KVM_MEMSLOTS; i++) {
+		if (!snap->ram[i])
+			continue;
+
+		log.slot = i;
+		log.dirty_bitmap = bitmap = snap->dirty_bitmap[i];
+		SAFE_IOCTL(inst->vm_fd, KVM_GET_DIRTY_LOG, &log);
+
+		ram = (char *)(uintptr_t)inst->ram[i].userspace_addr;
+		copy = snap->ram[i];
+		pages = inst->ram[i].memory_size / pagesize;
+
+		/* Small slots such as the result page are written by host too */
+		if (pages <= SNAPSHOT_FULL_COPY_PAGES) {
+			memcpy(ram, copy, inst->ram[i].memory_size);
+			continue;
+		}
+
+		for (page = 0; page < pages; page++) {
+			if (!(bitmap[page / (8 * sizeof(long))] &
+			      (1UL << (page % (8 * sizeof(long))))))
+				continue;
+
+			memcpy(ram + page * pagesize, copy + page * pagesize,
+				pagesize);
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(vcpu_states); i++) {
+		if (!snap->vcpu_state[i])
+			continue;
+
+		if (ioctl(inst->vcpu_fd, vcpu_states[i].set_req,
+			snap->vcpu_state[i])) {
+			tst_brk(TBROK | TERRNO, "ioctl(KVM_SET_%s) failed",
+				vcpu_states[i].name);
+		}
+	}
+
+	if (msrs) {
+		ret = SAFE_IOCTL(inst->vcpu_fd, KVM_SET_MSRS, msrs);
+
+		if (ret != (int)msrs->nmsrs) {
+			tst_brk(TBROK, "ioctl(KVM_SET_MSRS) failed to set MSR 0x%x",
+				msrs->entries[ret].index);
+		}
+	}
+
+	if (snap->has_clock) {
+		clock = snap->clock;
+		clock.flags = 0;
+		SAFE_IOCTL(inst->vm_fd, KVM_SET_CLOCK, &clock);
+	}
+}
+#else /* defined(__i386__) || defined(__x86_64__) */
+int tst_kvm_snapshot_instance(struct tst_kvm_instance *inst,
+	struct tst_kvm_snapshot *snap)
+{
+	memset(snap, 0, sizeof(*snap));
+	return -1;
+}
+
+void tst_kvm_reset_instance(struct tst_kvm_instance *inst,
+	struct tst_kvm_snapshot *snap)
+{
+	tst_brk(TBROK, "KVM snapshots are not supported on this architecture");
+}
+#endif /* defined(__i386__) || defined(__x86_64__) */
+
+void tst_kvm_free_snapshot(struct tst_kvm_snapshot *snap)
+{
+	size_t i;
+
+	for (i = 0; i < MAX_KVM_MEMSLOTS; i++) {
+		free(snap->ram[i]);
+		free(snap->dirty_bitmap[i]);
+
+		if (snap->guest_ram[i]) {
+			SAFE_MUNMAP(snap->guest_ram[i],
+				snap->guest_ram_size[i]);
+		}
+	}
+
+	for (i = 0; i < MAX_KVM_VCPU_STATES; i++)
+		free(snap->vcpu_state[i]);
+
+	free(snap->msrs);
+	memset(snap, 0, sizeof(*snap));
+}
+
 int tst_kvm_wait_guest(struct tst_kvm_instance *inst, int timeout_ms)
 {
 	volatile struct tst_kvm_result *result = inst->result;
@@ -334,7 +654,33 @@ void tst_kvm_run(void)
 	tst_free_all();
 }
 
+void tst_kvm_run_snapshot(void)
+{
+	/*
+	 * Create the VM on the first iteration and reset it from a snapshot
+	 * on the following ones, fall back to recreating it if the snapshot
+	 * failed. The guest memory of a snapshot VM is not a guarded buffer,
+	 * so tst_free_all() is called either way.
+	 */
+	if (test_snap_valid) {
+		tst_kvm_reset_instance(&test_vm, &test_snap);
+	} else {
+		tst_kvm_create_instance(&test_vm, DEFAULT_RAM_SIZE);
+		test_snap_valid = !tst_kvm_snapshot_instance(&test_vm,
+			&test_snap);
+	}
+
+	tst_kvm_run_instance(&test_vm, 0);
+
+	if (!test_snap_valid)
+		tst_kvm_destroy_instance(&test_vm);
+
+	tst_free_all();
+}
+
 void tst_kvm_cleanup(void)
 {
 	tst_kvm_destroy_instance(&test_vm);
+	tst_kvm_free_snapshot(&test_snap);
+	test_snap_valid = 0;
 }
@@ -15,6 +15,10 @@
  * number of processes have same memory contents so it is possible to
  * test more advanced things like KSM + OOM etc.
  *
+ * With the -r option the KSM merge rate is measured for each given
+ * pages_to_scan:sleep_millisecs pair (e.g. -r 100:20,1000:0) before
+ * the checks start.
+ *
  * [Prerequisites]
  *
  * ksm and ksmtuned daemons need to be disabled. Otherwise, it could
@@ -55,7 +59,7 @@
 
 static void verify_ksm(void)
 {
-	create_same_memory(size, num, unit);
+	create_same_memory(size, num, unit, opt_ratestr);
 }
 
 static void setup(void)
@@ -70,6 +74,7 @@ static struct tst_test test = {
 		{"n:", &opt_numstr,  "Number of processes"},
 		{"s:", &opt_sizestr, "Memory allocation size in MB"},
 		{"u:", &opt_unitstr, "Memory allocation unit in MB"},
+		{"r:", &opt_ratestr, "Measure merge rate for pages_to_scan:sleep_millisecs[,...]"},
 		{}
 	},
 	.setup = setup,
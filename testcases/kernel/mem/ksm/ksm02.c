@@ -70,11 +70,11 @@ static void verify_ksm(void)
 			tst_brk(TCONF, "set_mempolicy syscall is not "
 				 "implemented on your system.");
 	}
-	create_same_memory(size, num, unit);
+	create_same_memory(size, num, unit, opt_ratestr);
 
 	write_node_cpusets(tst_cg, node);
 	SAFE_CG_PRINTF(tst_cg, "cgroup.procs", "%d", getpid());
-	create_same_memory(size, num, unit);
+	create_same_memory(size, num, unit, opt_ratestr);
 	SAFE_CG_PRINTF(tst_cg_drain, "cgroup.procs", "%d", getpid());
 }
 
@@ -93,6 +93,7 @@ static struct tst_test test = {
 		{"n:", &opt_numstr,  "Number of processes"},
 		{"s:", &opt_sizestr, "Memory allocation size in MB"},
 		{"u:", &opt_unitstr, "Memory allocation unit in MB"},
+		{"r:", &opt_ratestr, "Measure merge rate for pages_to_scan:sleep_millisecs[,...]"},
 		{}
 	},
 	.setup = setup,
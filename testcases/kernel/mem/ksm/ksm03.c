@@ -57,7 +57,7 @@
 
 static void verify_ksm(void)
 {
-	create_same_memory(size, num, unit);
+	create_same_memory(size, num, unit, opt_ratestr);
 }
 
 static void setup(void)
@@ -75,6 +75,7 @@ static struct tst_test test = {
 		{"n:", &opt_numstr,  "Number of processes"},
 		{"s:", &opt_sizestr, "Memory allocation size in MB"},
 		{"u:", &opt_unitstr, "Memory allocation unit in MB"},
+		{"r:", &opt_ratestr, "Measure merge rate for pages_to_scan:sleep_millisecs[,...]"},
 		{}
 	},
 	.setup = setup,
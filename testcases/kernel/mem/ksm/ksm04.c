@@ -59,10 +59,10 @@ static void verify_ksm(void)
 			tst_brk(TCONF, "set_mempolicy syscall is not "
 					"implemented on your system.");
 	}
-	create_same_memory(size, num, unit);
+	create_same_memory(size, num, unit, opt_ratestr);
 
 	write_node_cpusets(tst_cg, node);
-	create_same_memory(size, num, unit);
+	create_same_memory(size, num, unit, opt_ratestr);
 }
 
 static void setup(void)
@@ -82,6 +82,7 @@ static struct tst_test test = {
 		{"n:", &opt_numstr,  "Number of processes"},
 		{"s:", &opt_sizestr, "Memory allocation size in MB"},
 		{"u:", &opt_unitstr, "Memory allocation unit in MB"},
+		{"r:", &opt_ratestr, "Measure merge rate for pages_to_scan:sleep_millisecs[,...]"},
 		{}
 	},
 	.setup = setup,
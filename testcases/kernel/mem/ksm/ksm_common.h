@@ -18,7 +18,7 @@
 #define DEFAULT_MEMSIZE 128
 
 static int size = DEFAULT_MEMSIZE, num = 3, unit = 1;
-static char *opt_sizestr, *opt_numstr, *opt_unitstr;
+static char *opt_sizestr, *opt_numstr, *opt_unitstr, *opt_ratestr;
 
 static inline void parse_ksm_options(char *str_size, int *size,
 		char *str_num, int *num, char *str_unit, int *unit)
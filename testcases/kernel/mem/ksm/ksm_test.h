@@ -7,6 +7,8 @@
 #define KSM_TEST_
 
 #include <sys/wait.h>
+#include "tst_safe_clocks.h"
+#include "tst_timer.h"
 
 static inline void check(char *path, long int value)
 {
@@ -70,19 +72,64 @@ static inline void ksm_group_check(int run, int pages_shared, int pages_sharing,
 			  sleep_millisecs, pages_to_scan);
 }
 
+/*
+ * Counts bytes in buf that differ from value, the offset of the first one is
+ * stored into first.
+ */
+static inline unsigned long ksm_count_mismatch(const char *buf, char value,
+					       size_t len, size_t *first)
+{
+	unsigned long cnt = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (buf[i] == value)
+			continue;
+
+		if (!cnt)
+			*first = i;
+
+		cnt++;
+	}
+
+	return cnt;
+}
+
 static inline void verify(char **memory, char value, int proc,
 		    int start, int end, int start2, int end2)
 {
-	int i, j;
+	unsigned long cnt, mismatches = 0;
+	int i, j, first_i = 0, first_j = 0;
+	char ref[4096];
+	size_t len, first = 0;
 
 	tst_res(TINFO, "child %d verifies memory content.", proc);
 
-	for (j = start; j < end; j++)
-		for (i = start2; i < end2; i++)
-			if (memory[j][i] != value)
-				tst_res(TFAIL, "child %d has %c at "
-					"%d,%d,%d.",
-					proc, memory[j][i], proc, j, i);
+	memset(ref, value, sizeof(ref));
+
+	for (j = start; j < end; j++) {
+		for (i = start2; i < end2; i += len) {
+			len = MIN(sizeof(ref), (size_t)(end2 - i));
+
+			if (!memcmp(memory[j] + i, ref, len))
+				continue;
+
+			cnt = ksm_count_mismatch(memory[j] + i, value, len, &first);
+
+			if (!mismatches) {
+				first_j = j;
+				first_i = i + first;
+			}
+
+			mismatches += cnt;
+		}
+	}
+
+	if (mismatches) {
+		tst_res(TFAIL, "child %d has %lu bytes not equal to '%c', "
+			"first %c at %d,%d,%d.", proc, mismatches, value,
+			memory[first_j][first_i], proc, first_j, first_i);
+	}
 }
 
 struct ksm_merge_data {
@@ -95,7 +142,7 @@ static inline void ksm_child_memset(int child_num, unsigned int size,
 				    struct ksm_merge_data ksm_merge_data,
 				    char **memory)
 {
-	unsigned int i = 0, j;
+	unsigned int j;
 	unsigned int unit = size / total_unit;
 
 	tst_res(TINFO, "child %d continues...", child_num);
@@ -110,16 +157,14 @@ static inline void ksm_child_memset(int child_num, unsigned int size,
 				child_num, size, ksm_merge_data.data);
 	}
 
-	for (j = 0; j < total_unit; j++) {
-		for (i = 0; (unsigned int)i < unit * TST_MB; i++)
-			memory[j][i] = ksm_merge_data.data;
-	}
+	for (j = 0; j < total_unit; j++)
+		memset(memory[j], ksm_merge_data.data, unit * TST_MB);
 
 	/* if it contains unshared page, then set 'e' char
 	 * at the end of the last page
 	 */
 	if (ksm_merge_data.mergeable_size < size * TST_MB)
-		memory[j-1][i-1] = 'e';
+		memory[total_unit - 1][unit * TST_MB - 1] = 'e';
 }
 
 static inline void create_ksm_child(int child_num, unsigned int size,
@@ -196,7 +241,97 @@ static inline void resume_ksm_children(int *child, int num)
 	fflush(stdout);
 }
 
-static inline void create_same_memory(unsigned int size, int num, unsigned int unit)
+static inline unsigned long ksm_merged_pages(void)
+{
+	unsigned long shared, sharing;
+
+	SAFE_FILE_SCANF(PATH_MM_KSM "/pages_shared", "%lu", &shared);
+	SAFE_FILE_SCANF(PATH_MM_KSM "/pages_sharing", "%lu", &sharing);
+
+	return shared + sharing;
+}
+
+#define KSM_RATE_SAMPLE_US 10000
+#define KSM_RATE_TIMEOUT_MS 60000
+
+/*
+ * Unmerges everything and lets ksmd merge the expected number of pages again
+ * with given pages_to_scan and sleep_millisecs, sampling the KSM counters to
+ * report the merge rate.
+ */
+static inline void ksm_merge_rate(unsigned long pages_to_scan,
+				  unsigned long sleep_ms,
+				  unsigned long expected)
+{
+	unsigned long merged = 0, prev = 0, scans_start, scans;
+	struct timespec start, now;
+	double rate, peak = 0;
+	long long elapsed_ms = 0, prev_ms = 0;
+
+	SAFE_FILE_PRINTF(PATH_MM_KSM_RUN, "2");
+	SAFE_FILE_PRINTF(PATH_MM_KSM_PAGES_TO_SCAN, "%lu", pages_to_scan);
+	SAFE_FILE_PRINTF(PATH_MM_KSM_SLEEP_MILLISECS, "%lu", sleep_ms);
+	SAFE_FILE_SCANF(PATH_MM_KSM_FULL_SCANS, "%lu", &scans_start);
+
+	SAFE_CLOCK_GETTIME(CLOCK_MONOTONIC, &start);
+	SAFE_FILE_PRINTF(PATH_MM_KSM_RUN, "1");
+
+	while (merged < expected && elapsed_ms < KSM_RATE_TIMEOUT_MS) {
+		usleep(KSM_RATE_SAMPLE_US);
+
+		merged = ksm_merged_pages();
+		SAFE_CLOCK_GETTIME(CLOCK_MONOTONIC, &now);
+		elapsed_ms = tst_timespec_diff_ms(now, start);
+
+		if (elapsed_ms > prev_ms) {
+			rate = 1000.0 * (merged - MIN(prev, merged)) /
+			       (elapsed_ms - prev_ms);
+			peak = MAX(peak, rate);
+		}
+
+		prev = merged;
+		prev_ms = elapsed_ms;
+	}
+
+	SAFE_FILE_SCANF(PATH_MM_KSM_FULL_SCANS, "%lu", &scans);
+
+	tst_res(TINFO, "pages_to_scan %lu sleep_millisecs %lu: merged %lu/%lu "
+		"pages in %.2fs, %.0f pages/s (peak %.0f pages/s), %lu full scans",
+		pages_to_scan, sleep_ms, merged, expected, elapsed_ms / 1000.0,
+		elapsed_ms ? 1000.0 * merged / elapsed_ms : 0, peak,
+		scans - scans_start);
+
+	if (merged < expected)
+		tst_res(TINFO, "Merging did not finish in %ims", KSM_RATE_TIMEOUT_MS);
+}
+
+/*
+ * Measures the merge rate for each pages_to_scan:sleep_millisecs pair from a
+ * comma separated list.
+ */
+static inline void ksm_measure_merge_rate(const char *settings,
+					  unsigned long expected)
+{
+	unsigned long pages_to_scan, sleep_ms;
+	const char *str = settings;
+	int len;
+
+	for (;;) {
+		if (sscanf(str, "%lu:%lu%n", &pages_to_scan, &sleep_ms, &len) != 2 ||
+		    !pages_to_scan || (str[len] && str[len] != ','))
+			tst_brk(TBROK, "Invalid merge rate settings '%s'", settings);
+
+		ksm_merge_rate(pages_to_scan, sleep_ms, expected);
+
+		if (!str[len])
+			break;
+
+		str += len + 1;
+	}
+}
+
+static inline void create_same_memory(unsigned int size, int num, unsigned int unit,
+				      const char *rate_settings)
 {
 	int i, j, status, *child;
 	unsigned long ps, pages;
@@ -262,6 +397,13 @@ static inline void create_same_memory(unsigned int size, int num, unsigned int u
 
 	resume_ksm_children(child, num);
 	stop_ksm_children(child, num);
+
+	if (rate_settings) {
+		ksm_measure_merge_rate(rate_settings, size * pages * num);
+		SAFE_FILE_PRINTF(PATH_MM_KSM_PAGES_TO_SCAN, "%ld", size * pages * num);
+		SAFE_FILE_PRINTF(PATH_MM_KSM_SLEEP_MILLISECS, "0");
+	}
+
 	ksm_group_check(1, 2, size * num * pages - 2, 0, 0, 0, size * pages * num);
 
 	resume_ksm_children(child, num);
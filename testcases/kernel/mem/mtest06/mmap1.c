@@ -20,7 +20,17 @@
  * Can trigger "still mapped when deleted" BUG at mm/filemap.c:171, on aarch64 since 4.20
  *   e1b98fa31664 ("locking/rwsem: Add missing ACQUIRE to read_slowpath exit when queue is empty")
  *   99143f82a255 ("lcoking/rwsem: Add missing ACQUIRE to read_slowpath sleep loop")
+ *
+ * With -t N the test runs a contention mode instead. N mapper threads mmap,
+ * write and munmap small areas while N faulter threads keep faulting pages
+ * into their own areas of the same process, all threads are pinned across
+ * the allowed CPUs. This is repeated for 1, 2, 4, ... N thread pairs and for
+ * anonymous, file and shmem mappings (select one with -m) and the page fault
+ * and mmap/munmap throughput is reported for each step together with the
+ * scaling relative to a single pair. It exercises the mmap_lock and per-VMA
+ * locking in the page fault path.
  */
+#define _GNU_SOURCE
 #include <errno.h>
 #include <float.h>
 #include <pthread.h>
@@ -28,9 +38,11 @@
 #include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/resource.h>
 #include "lapi/abisize.h"
 #include "tst_test.h"
 #include "tst_safe_pthread.h"
+#include "tst_timer.h"
 
 #define GIGABYTE (1L*1024*1024*1024)
 #define TEST_FILENAME "ashfile"
@@ -40,9 +52,48 @@
 
 #define PROGRESS_SEC 3
 
+/* areas used by the contention mode threads, in pages */
+#define MAPPER_PAGES 16
+#define FAULTER_PAGES 256
+
 static int file_size = 1024;
 static int num_iter = 5000;
 
+static char *str_threads;
+static char *str_map_type;
+static int max_pairs;
+
+enum map_type {
+	MAP_TYPE_ANON,
+	MAP_TYPE_FILE,
+	MAP_TYPE_SHMEM,
+	MAP_TYPE_CNT,
+};
+
+static const char *const map_type_names[MAP_TYPE_CNT] = {
+	[MAP_TYPE_ANON] = "anon",
+	[MAP_TYPE_FILE] = "file",
+	[MAP_TYPE_SHMEM] = "shmem",
+};
+
+static int map_type = -1;
+
+struct worker {
+	pthread_t thread;
+	int cpu;
+	int fd;
+	enum map_type type;
+	unsigned long ops;
+	unsigned long faults;
+} __attribute__((aligned(64)));
+
+static struct worker *workers;
+static tst_atomic_t stop_workers;
+/* Releases the workers when run_pairs() starts the timer */
+static pthread_barrier_t start_barrier;
+static int *cpus;
+static int cpu_cnt;
+
 static void *distant_area;
 static jmp_buf jmpbuf;
 static volatile unsigned char *map_address;
@@ -180,6 +231,248 @@ int mkfile(int size)
 	return fd;
 }
 
+static void *mmap_area(struct worker *w, size_t size)
+{
+	switch (w->type) {
+	case MAP_TYPE_ANON:
+		return SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	case MAP_TYPE_FILE:
+		return SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED, w->fd, 0);
+	case MAP_TYPE_SHMEM:
+		return SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	default:
+		tst_brk(TBROK, "Invalid mapping type %i", w->type);
+	}
+
+	return NULL;
+}
+
+static void pin_worker(struct worker *w)
+{
+	cpu_set_t set;
+	int ret;
+
+	CPU_ZERO(&set);
+	CPU_SET(w->cpu, &set);
+
+	ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (ret)
+		tst_brk(TBROK, "pthread_setaffinity_np(): %s", tst_strerrno(ret));
+}
+
+static void *mapper(void *ptr)
+{
+	struct worker *w = ptr;
+	size_t size = MAPPER_PAGES * page_sz;
+	char *area;
+
+	pin_worker(w);
+	SAFE_PTHREAD_BARRIER_WAIT(&start_barrier);
+
+	while (!tst_atomic_load(&stop_workers)) {
+		area = mmap_area(w, size);
+		area[0] = 'b';
+		area[size - 1] = 'b';
+		SAFE_MUNMAP(area, size);
+		w->ops++;
+	}
+
+	return NULL;
+}
+
+static void *faulter(void *ptr)
+{
+	struct worker *w = ptr;
+	size_t size = FAULTER_PAGES * page_sz;
+	struct rusage start, end;
+	unsigned char val = 0;
+	char *area;
+	size_t i;
+
+	pin_worker(w);
+
+	area = mmap_area(w, size);
+	SAFE_PTHREAD_BARRIER_WAIT(&start_barrier);
+	getrusage(RUSAGE_THREAD, &start);
+
+	while (!tst_atomic_load(&stop_workers)) {
+		val++;
+
+		for (i = 0; i < size; i += page_sz)
+			area[i] = val;
+
+		for (i = 0; i < size; i += page_sz) {
+			if ((unsigned char)area[i] != val) {
+				tst_res(TFAIL, "%s page %zu: %u, expected %u",
+					map_type_names[w->type], i / page_sz,
+					(unsigned char)area[i], val);
+				tst_atomic_store(1, &stop_workers);
+				break;
+			}
+		}
+
+		if (madvise(area, size, MADV_DONTNEED))
+			tst_brk(TBROK | TERRNO, "madvise(MADV_DONTNEED)");
+	}
+
+	getrusage(RUSAGE_THREAD, &end);
+	w->faults = (end.ru_minflt - start.ru_minflt) +
+		    (end.ru_majflt - start.ru_majflt);
+
+	SAFE_MUNMAP(area, size);
+
+	return NULL;
+}
+
+static int open_worker_file(unsigned int i, size_t size)
+{
+	char path[32];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s_%u", TEST_FILENAME, i);
+	fd = SAFE_OPEN(path, O_RDWR | O_CREAT, 0600);
+	SAFE_UNLINK(path);
+	SAFE_FTRUNCATE(fd, size);
+
+	return fd;
+}
+
+static void run_pairs(enum map_type type, int pairs, int step_ms,
+		      double *faults_sec, double *ops_sec)
+{
+	size_t size = MAX(MAPPER_PAGES, FAULTER_PAGES) * page_sz;
+	unsigned long faults = 0, ops = 0;
+	struct worker *w;
+	long long us;
+	int i;
+
+	tst_atomic_store(0, &stop_workers);
+
+	for (i = 0; i < 2 * pairs; i++) {
+		w = &workers[i];
+		memset(w, 0, sizeof(*w));
+		w->type = type;
+		w->cpu = cpus[i % cpu_cnt];
+		w->fd = type == MAP_TYPE_FILE ? open_worker_file(i, size) : -1;
+	}
+
+	SAFE_PTHREAD_BARRIER_INIT(&start_barrier, NULL, 2 * pairs + 1);
+
+	for (i = 0; i < pairs; i++) {
+		SAFE_PTHREAD_CREATE(&workers[2 * i].thread, NULL, mapper,
+				    &workers[2 * i]);
+		SAFE_PTHREAD_CREATE(&workers[2 * i + 1].thread, NULL, faulter,
+				    &workers[2 * i + 1]);
+	}
+
+	SAFE_PTHREAD_BARRIER_WAIT(&start_barrier);
+	tst_timer_start(CLOCK_MONOTONIC);
+
+	usleep(step_ms * 1000);
+	tst_atomic_store(1, &stop_workers);
+	tst_timer_stop();
+
+	for (i = 0; i < 2 * pairs; i++) {
+		SAFE_PTHREAD_JOIN(workers[i].thread, NULL);
+		ops += workers[i].ops;
+		faults += workers[i].faults;
+
+		if (workers[i].fd >= 0)
+			SAFE_CLOSE(workers[i].fd);
+	}
+
+	SAFE_PTHREAD_BARRIER_DESTROY(&start_barrier);
+	us = tst_timer_elapsed_us();
+
+	*faults_sec = faults * 1000000.0 / us;
+	*ops_sec = ops * 1000000.0 / us;
+}
+
+static void run_contention(void)
+{
+	int types[MAP_TYPE_CNT], ntypes = 0, nsteps = 0, step_ms, pairs, t;
+	double faults_sec, ops_sec, base_faults = 0, base_ops = 0;
+
+	if (map_type >= 0) {
+		types[ntypes++] = map_type;
+	} else {
+		for (t = 0; t < MAP_TYPE_CNT; t++)
+			types[ntypes++] = t;
+	}
+
+	for (pairs = 1; pairs < max_pairs; pairs *= 2)
+		nsteps++;
+	nsteps++;
+
+	step_ms = tst_remaining_runtime() * 1000 / (ntypes * nsteps + 1);
+
+	for (t = 0; t < ntypes; t++) {
+		tst_res(TINFO, "%s mappings, %i ms per step",
+			map_type_names[types[t]], step_ms);
+
+		for (pairs = 1; ; pairs = MIN(pairs * 2, max_pairs)) {
+			run_pairs(types[t], pairs, step_ms, &faults_sec, &ops_sec);
+
+			if (pairs == 1) {
+				base_faults = faults_sec;
+				base_ops = ops_sec;
+			}
+
+			tst_res(TINFO,
+				"%-5s %3i pairs: faults %9.0f/s (%8.0f/s/thread, scaling %5.2f), "
+				"mmap+munmap %9.0f/s (%8.0f/s/thread, scaling %5.2f)",
+				map_type_names[types[t]], pairs,
+				faults_sec, faults_sec / pairs,
+				base_faults ? faults_sec / base_faults : 0,
+				ops_sec, ops_sec / pairs,
+				base_ops ? ops_sec / base_ops : 0);
+
+			if (pairs == max_pairs)
+				break;
+		}
+	}
+
+	tst_res(TPASS, "System survived.");
+}
+
+static void setup_contention(void)
+{
+	cpu_set_t set;
+	int i;
+
+	if (tst_parse_int(str_threads, &max_pairs, 1, 4096))
+		tst_brk(TBROK, "Invalid number of thread pairs '%s'", str_threads);
+
+	if (str_map_type) {
+		for (i = 0; i < MAP_TYPE_CNT; i++) {
+			if (!strcmp(str_map_type, map_type_names[i]))
+				map_type = i;
+		}
+
+		if (map_type < 0)
+			tst_brk(TBROK, "Invalid mapping type '%s'", str_map_type);
+	}
+
+	if (sched_getaffinity(0, sizeof(set), &set))
+		tst_brk(TBROK | TERRNO, "sched_getaffinity()");
+
+	cpus = SAFE_MALLOC(CPU_COUNT(&set) * sizeof(*cpus));
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		if (CPU_ISSET(i, &set))
+			cpus[cpu_cnt++] = i;
+	}
+
+	workers = SAFE_MMAP(NULL, 2 * max_pairs * sizeof(*workers),
+			    PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	tst_res(TINFO, "Up to %i mapper/faulter pairs on %i CPUs",
+		max_pairs, cpu_cnt);
+}
+
 static void setup(void)
 {
 	struct sigaction sigptr;
@@ -187,6 +480,12 @@ static void setup(void)
 	size_t mem_total;
 
 	page_sz = getpagesize();
+
+	if (str_threads) {
+		setup_contention();
+		return;
+	}
+
 	mem_total = SAFE_READ_MEMINFO("MemTotal:");
 	mem_total *= 1024;
 
@@ -215,6 +514,11 @@ static void run(void)
 	pthread_t thid[2];
 	int start, last_update;
 
+	if (str_threads) {
+		run_contention();
+		return;
+	}
+
 	start = last_update = tst_remaining_runtime();
 	while (tst_remaining_runtime()) {
 		int fd = mkfile(file_size);
@@ -246,9 +550,23 @@ static void run(void)
 	tst_res(TPASS, "System survived.");
 }
 
+static void cleanup(void)
+{
+	if (workers)
+		SAFE_MUNMAP(workers, 2 * max_pairs * sizeof(*workers));
+
+	free(cpus);
+}
+
 static struct tst_test test = {
 	.test_all = run,
 	.setup = setup,
+	.cleanup = cleanup,
 	.runtime = 180,
 	.needs_tmpdir = 1,
+	.options = (struct tst_option[]) {
+		{"t:", &str_threads, "Contention mode with up to N mapper/faulter thread pairs"},
+		{"m:", &str_map_type, "Mapping type in contention mode: anon, file or shmem (default all)"},
+		{}
+	},
 };
@@ -40,6 +40,8 @@
 #include <unistd.h>
 #include "tst_test.h"
 #include "tst_safe_stdio.h"
+#include "tst_safe_clocks.h"
+#include "tst_timer.h"
 
 /* allow swapping 1 * phy_mem in maximum */
 #define COE_DELTA       1
@@ -57,6 +59,7 @@ static long mem_over;
 static long mem_over_max;
 static pid_t pid;
 static unsigned int start_runtime;
+static struct timespec alloc_start;
 
 static void test_swapping(void)
 {
@@ -76,6 +79,8 @@ static void test_swapping(void)
 
 	init_meminfo();
 
+	SAFE_CLOCK_GETTIME(CLOCK_MONOTONIC, &alloc_start);
+
 	switch (pid = SAFE_FORK()) {
 	case 0:
 		TST_PRINT_MEMINFO();
@@ -133,6 +138,8 @@ static void do_alloc(int allow_raise)
 
 static void check_swapping(void)
 {
+	struct timespec alloc_end;
+	unsigned int alloc_ms;
 	int status;
 	long swap_free_now, swapped;
 
@@ -141,6 +148,14 @@ static void check_swapping(void)
 	if (!WIFSTOPPED(status))
 		tst_brk(TBROK, "child was not stopped.");
 
+	/* Rates over the allocation only, not the settle loop that follows */
+	SAFE_CLOCK_GETTIME(CLOCK_MONOTONIC, &alloc_end);
+	alloc_ms = tst_timespec_diff_ms(alloc_end, alloc_start);
+
+	tst_res(TINFO, "swap out rate %.0f pages/s, swap in rate %.0f pages/s "
+		"while allocating", tst_memstat_rate("vmstat:pswpout", alloc_ms),
+		tst_memstat_rate("vmstat:pswpin", alloc_ms));
+
 	/* Still occupying memory, loop for a while */
 	while (tst_remaining_runtime() > start_runtime/2) {
 		swap_free_now = SAFE_READ_MEMINFO("SwapFree:");
@@ -175,6 +190,16 @@ static struct tst_test test = {
 	.runtime = 600,
 	.test_all = test_swapping,
 	.needs_abi_bits = 64,
+	.memstat = &(const struct tst_memstat_conf) {
+		.interval_ms = 500,
+		.counters = (const char *const []) {
+			"vmstat:pswpout",
+			"vmstat:pswpin",
+			"meminfo:SwapFree",
+			"meminfo:MemAvailable",
+			NULL
+		},
+	},
 	.needs_kconfigs = (const char *[]) {
 		"CONFIG_SWAP=y",
 		NULL
@@ -70,7 +70,7 @@ static void run(void)
 		tst_brk(TBROK | TTERRNO, "fallocate(fd, 0, 0, %ld)", bufsize);
 	}
 
-	tst_fill_fs(MNTPOINT, 1, TST_FILL_RANDOM);
+	tst_fill_fs(MNTPOINT, 1, TST_FILL_PARALLEL);
 
 	TEST(write(fd, buf, bufsize));
 
@@ -176,6 +176,7 @@ static void cleanup(void)
 static struct tst_test test = {
 	.timeout = 42,
 	.needs_root = 1,
+	.forks_child = 1,
 	.mount_device = 1,
 	.mntpoint = MNTPOINT,
 	.all_filesystems = 1,
@@ -84,7 +84,7 @@ static void *thread_run(void *arg)
 
 static void run(void)
 {
-	int total_read;
+	int total_read, ret, partial;
 	unsigned char readbuf[BUF_SIZE + 1];
 
 	tst_fzsync_pair_reset(&fzsync_pair, thread_run);
@@ -92,16 +92,25 @@ static void run(void)
 	while (tst_fzsync_run_a(&fzsync_pair)) {
 		tst_fzsync_wait_a(&fzsync_pair);
 		readfd = SAFE_OPEN(TEMPFILE, O_RDONLY);
+		partial = 0;
 		tst_fzsync_start_race_a(&fzsync_pair);
 
 		for (total_read = 0; total_read < tst_atomic_load(&written);) {
-			total_read += SAFE_READ(0, readfd, readbuf+total_read,
+			ret = SAFE_READ(0, readfd, readbuf+total_read,
 				BUF_SIZE + 1 - total_read);
+			total_read += ret;
+
+			/* Read the file while writev() was in progress */
+			if (ret && total_read < BUF_SIZE)
+				partial = 1;
 		}
 
 		tst_fzsync_end_race_a(&fzsync_pair);
 		SAFE_CLOSE(readfd);
 
+		if (partial)
+			tst_fzsync_pair_hit(&fzsync_pair);
+
 		if (total_read > BUF_SIZE)
 			tst_brk(TBROK, "writev() wrote too much data");
 
@@ -42,6 +42,13 @@ static int acquire_device(int argc, char *argv[])
 		}
 	}
 
+	/*
+	 * The pool device is owned for as long as the flock() is held, which
+	 * would be released when this process exits. Shell tests have to
+	 * attach their own loop device instead.
+	 */
+	unsetenv("LTP_DEV_POOL");
+
 	if (argc >= 4)
 		device = tst_acquire_loop_device(size, argv[3]);
 	else
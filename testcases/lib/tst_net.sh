@@ -62,6 +62,11 @@ LTP_NET_FEATURES_IGNORE_PERFORMANCE_FAILURE=1
 Ignore performance failure and test only the network functionality in tests
 which use tst_netload_compare().
 
+TST_NETLOAD_CI=5
+Stop repeating netstress runs (at least TST_NETLOAD_MIN_RUN_COUNT, at most
+TST_NETLOAD_RUN_COUNT times) once the 95% confidence interval of the mean
+time is within given percentage, 0 always runs TST_NETLOAD_RUN_COUNT times.
+
 OPTIONS
 -------
 EOF
@@ -821,24 +826,45 @@ tst_netload()
 	[ "$expect_res" != "pass" ] && expect_ret=3
 
 	local was_failure=0
+	local min_cnt="$TST_NETLOAD_MIN_RUN_COUNT"
+	local max_cnt
+	local ci="$TST_NETLOAD_CI"
+
 	if [ "$run_cnt" -lt 2 ]; then
 		run_cnt=1
 		was_failure=1
 	fi
 
+	# adaptive sampling can only stop early, it never exceeds run_cnt runs
+	max_cnt=$run_cnt
+	if [ "$ci" = 0 -o "$run_cnt" -eq 1 ]; then
+		min_cnt=$run_cnt
+	else
+		[ "$min_cnt" -lt 2 ] && min_cnt=2
+		[ "$min_cnt" -gt "$max_cnt" ] && min_cnt=$max_cnt
+	fi
+
 	s_opts="${cs_opts}${s_opts}-R $s_replies -B $TST_TMPDIR"
-	c_opts="${cs_opts}${c_opts}-a $c_num -r $((c_requests / run_cnt)) -c $PWD/$rfile"
+	c_opts="${cs_opts}${c_opts}-a $c_num -r $((c_requests / run_cnt)) -c $PWD/$rfile -s $PWD/$rfile.stats"
 
 	tst_res_ TINFO "run server 'netstress $s_opts'"
-	tst_res_ TINFO "run client 'netstress -l $c_opts' $run_cnt times"
+	if [ "$max_cnt" -gt "$min_cnt" ]; then
+		tst_res_ TINFO "run client 'netstress -l $c_opts' $min_cnt-$max_cnt times until 95% CI is within ${ci}%"
+	else
+		tst_res_ TINFO "run client 'netstress -l $c_opts' $max_cnt times"
+	fi
 
 	tst_rhost_run -c "pkill -9 netstress\$"
-	rm -f tst_netload.log
+	rm -f tst_netload.log $rfile.samples
 
 	local results
 	local passed=0
+	local ci_res
+	local converged=0
+	local i=0
 
-	for i in $(seq 1 $run_cnt); do
+	while [ $i -lt $max_cnt ]; do
+		i=$((i + 1))
 		tst_rhost_run -c "netstress $s_opts" > tst_netload.log 2>&1
 		if [ $? -ne 0 ]; then
 			cat tst_netload.log
@@ -878,6 +904,19 @@ tst_netload()
 
 		results="$results $(cat $rfile)"
 		passed=$((passed + 1))
+
+		if [ -f $rfile.stats ]; then
+			local rps=$(sed -n 's/^req_per_sec=//p' $rfile.stats)
+			local p99=$(sed -n 's/^lat_p99_ns=//p' $rfile.stats)
+			tst_res_ TINFO "run $i: $(cat $rfile) ms, $rps req/s, p99 latency $p99 ns"
+		fi
+
+		[ $passed -lt $min_cnt -o $max_cnt -eq $min_cnt ] && continue
+
+		if ci_res=$(tst_net_stats ci $ci $results); then
+			converged=1
+			break
+		fi
 	done
 
 	if [ "$ret" -ne 0 ]; then
@@ -886,8 +925,15 @@ tst_netload()
 		tst_netload_brk TFAIL "expected '$expect_res' but ret: '$ret'"
 	fi
 
+	if [ "$converged" -eq 1 ]; then
+		tst_res_ TINFO "95% CI of the mean time is +-${ci_res}% after $passed runs"
+	elif [ -n "$ci_res" ]; then
+		tst_res_ TINFO "95% CI of the mean time is +-${ci_res}% after $passed runs, not converged to ${ci}%"
+	fi
+
 	local median=$(tst_get_median $results)
 	echo "$median" > $rfile
+	echo $results > $rfile.samples
 
 	tst_res_ TPASS "netstress passed, median time $median ms, data:$results"
 
@@ -901,6 +947,11 @@ tst_netload()
 # THRESHOD_LOW: lower limit for TFAIL
 # THRESHOD_HIGH: upper limit for TWARN
 #
+# TIME_BASE and TIME can also be result files saved by tst_netload -c, in that
+# case all runs are compared with Welch's t-test and the thresholds are only
+# considered exceeded when the whole 95% confidence interval of the result
+# lies beyond them.
+#
 # Slow performance can be ignored with setting environment variable
 # LTP_NET_FEATURES_IGNORE_PERFORMANCE_FAILURE=1
 tst_netload_compare()
@@ -910,16 +961,36 @@ tst_netload_compare()
 	local threshold_low=$3
 	local threshold_hi=$4
 	local ttype='TFAIL'
-	local msg res
+	local msg res res_lo res_hi
+
+	if [ -f "$base_time" -a -f "$new_time" -a \
+	     -f "$base_time.samples" -a -f "$new_time.samples" ]; then
+		set -- $(tst_net_stats cmp $(cat $base_time.samples) -- \
+			$(cat $new_time.samples) 2>/dev/null)
+		res=$1
+		res_lo=$2
+		res_hi=$3
+		base_time=$(cat $base_time)
+		new_time=$(cat $new_time)
+	elif [ -f "$base_time" -a -f "$new_time" ]; then
+		base_time=$(cat $base_time)
+		new_time=$(cat $new_time)
+	fi
 
 	if [ -z "$base_time" -o -z "$new_time" -o -z "$threshold_low" ]; then
 		tst_brk_ TBROK "tst_netload_compare: invalid argument(s)"
 	fi
 
-	res=$(((base_time - new_time) * 100 / base_time))
-	msg="performance result is ${res}%"
+	if [ -z "$res" ]; then
+		res=$(((base_time - new_time) * 100 / base_time))
+		res_lo=$res
+		res_hi=$res
+		msg="performance result is ${res}%"
+	else
+		msg="performance result is ${res}% (95% CI [${res_lo}:${res_hi}]%)"
+	fi
 
-	if [ "$res" -lt "$threshold_low" ]; then
+	if [ "$res_hi" -lt "$threshold_low" ]; then
 		if [ "$LTP_NET_FEATURES_IGNORE_PERFORMANCE_FAILURE" = 1 ]; then
 			ttype='TINFO';
 			tst_res_ TINFO "WARNING: slow performance is not treated as error due LTP_NET_FEATURES_IGNORE_PERFORMANCE_FAILURE=1"
@@ -930,7 +1001,7 @@ tst_netload_compare()
 		return
 	fi
 
-	[ "$threshold_hi" ] && [ "$res" -gt "$threshold_hi" ] && \
+	[ "$threshold_hi" ] && [ "$res_lo" -gt "$threshold_hi" ] && \
 		tst_res_ TWARN "$msg > threshold ${threshold_hi}%"
 
 	tst_res_ TPASS "$msg, in range [${threshold_low}:${threshold_hi}]%"
@@ -1169,6 +1240,8 @@ export TST_NETLOAD_CLN_REQUESTS="${TST_NETLOAD_CLN_REQUESTS:-10000}"
 export TST_NETLOAD_CLN_NUMBER="${TST_NETLOAD_CLN_NUMBER:-2}"
 export TST_NETLOAD_BINDTODEVICE="${TST_NETLOAD_BINDTODEVICE-1}"
 export TST_NETLOAD_RUN_COUNT="${TST_NETLOAD_RUN_COUNT:-5}"
+export TST_NETLOAD_MIN_RUN_COUNT="${TST_NETLOAD_MIN_RUN_COUNT:-5}"
+export TST_NETLOAD_CI="${TST_NETLOAD_CI:-5}"
 export HTTP_DOWNLOAD_DIR="${HTTP_DOWNLOAD_DIR:-/var/www/html}"
 export FTP_DOWNLOAD_DIR="${FTP_DOWNLOAD_DIR:-/var/ftp}"
 export FTP_UPLOAD_DIR="${FTP_UPLOAD_DIR:-/var/ftp/pub}"
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Statistics helper for tst_netload(), all intervals are 95% two-sided.
+ *
+ * tst_net_stats ci TARGET SAMPLE...
+ *   Prints the half-width of the confidence interval of the mean relative to
+ *   the mean in percent. Exits with 0 if it is not larger than TARGET, with 1
+ *   otherwise.
+ *
+ * tst_net_stats cmp BASE_SAMPLE... -- SAMPLE...
+ *   Welch's t-test, prints the relative difference of the means
+ *   (BASE - SAMPLE) * 100 / BASE and the bounds of its confidence interval
+ *   as three integers.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Student's t-distribution 0.975 quantiles for 1-30 degrees of freedom */
+static const double t975[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+struct sample {
+	size_t n;
+	double mean;
+	double var;
+};
+
+static double t_quantile(double df)
+{
+	size_t i = df;
+
+	/* Round the degrees of freedom down to stay on the safe side */
+	if (i < 1)
+		i = 1;
+
+	if (i > sizeof(t975) / sizeof(t975[0]))
+		return 1.960;
+
+	return t975[i - 1];
+}
+
+static int parse_sample(int argc, char *argv[], struct sample *s)
+{
+	double sum = 0, x;
+	char *end;
+	int i;
+
+	memset(s, 0, sizeof(*s));
+
+	for (i = 0; i < argc; i++) {
+		x = strtod(argv[i], &end);
+
+		if (end == argv[i] || *end) {
+			fprintf(stderr, "Invalid number '%s'\n", argv[i]);
+			return 1;
+		}
+
+		sum += x;
+	}
+
+	if (argc < 2) {
+		fprintf(stderr, "At least two samples are required\n");
+		return 1;
+	}
+
+	s->n = argc;
+	s->mean = sum / argc;
+
+	for (i = 0; i < argc; i++) {
+		x = strtod(argv[i], NULL) - s->mean;
+		s->var += x * x;
+	}
+
+	s->var /= argc - 1;
+
+	return 0;
+}
+
+static int do_ci(int argc, char *argv[])
+{
+	struct sample s;
+	double target, half;
+
+	if (argc < 1)
+		return 2;
+
+	target = atof(argv[0]);
+
+	if (parse_sample(argc - 1, argv + 1, &s))
+		return 2;
+
+	if (s.mean == 0) {
+		fprintf(stderr, "Mean of the samples is zero\n");
+		return 2;
+	}
+
+	half = t_quantile(s.n - 1) * sqrt(s.var / s.n) * 100 / fabs(s.mean);
+	printf("%.1f", half);
+
+	return half > target;
+}
+
+static int do_cmp(int argc, char *argv[])
+{
+	struct sample b, s;
+	double vb, vs, se, df, diff, half;
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		if (!strcmp(argv[i], "--"))
+			break;
+	}
+
+	if (i == argc)
+		return 2;
+
+	if (parse_sample(i, argv, &b) || parse_sample(argc - i - 1, argv + i + 1, &s))
+		return 2;
+
+	if (b.mean == 0) {
+		fprintf(stderr, "Mean of the base samples is zero\n");
+		return 2;
+	}
+
+	vb = b.var / b.n;
+	vs = s.var / s.n;
+	se = sqrt(vb + vs);
+
+	/* Welch-Satterthwaite equation */
+	if (vb + vs > 0)
+		df = (vb + vs) * (vb + vs) /
+			(vb * vb / (b.n - 1) + vs * vs / (s.n - 1));
+	else
+		df = b.n + s.n - 2;
+
+	diff = (b.mean - s.mean) * 100 / b.mean;
+	half = t_quantile(df) * se * 100 / fabs(b.mean);
+
+	printf("%.0f %.0f %.0f", diff, floor(diff - half), ceil(diff + half));
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret = 2;
+
+	if (argc > 1 && !strcmp(argv[1], "ci"))
+		ret = do_ci(argc - 2, argv + 2);
+	else if (argc > 1 && !strcmp(argv[1], "cmp"))
+		ret = do_cmp(argc - 2, argv + 2);
+
+	if (ret == 2) {
+		fprintf(stderr, "Usage: %s ci TARGET SAMPLE...\n", argv[0]);
+		fprintf(stderr, "       %s cmp BASE_SAMPLE... -- SAMPLE...\n",
+			argv[0]);
+	}
+
+	return ret;
+}
@@ -34,7 +34,7 @@ test()
 		tst_netload -H $(tst_ipaddr rhost) -n 10 -N 10 -c res_$x -b $x
 	done
 
-	tst_netload_compare $(cat res_0) $(cat res_50) 1
+	tst_netload_compare res_0 res_50 1
 }
 
 . busy_poll_lib.sh
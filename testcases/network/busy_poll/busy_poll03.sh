@@ -37,7 +37,7 @@ test()
 			    -b $x -T $2
 	done
 
-	tst_netload_compare $(cat res_0) $(cat res_50) 1
+	tst_netload_compare res_0 res_50 1
 }
 
 . busy_poll_lib.sh
@@ -11,22 +11,19 @@ TST_NEEDS_ROOT=1
 test1()
 {
 	tst_res TINFO "run UDP"
-	tst_netload -H $(tst_ipaddr rhost) -T udp
-	res0="$(cat tst_netload.res)"
+	tst_netload -H $(tst_ipaddr rhost) -T udp -c res0
 }
 test2()
 {
 	tst_res TINFO "compare UDP/DCCP performance"
-	tst_netload -H $(tst_ipaddr rhost) -T dccp
-	res1="$(cat tst_netload.res)"
-	tst_netload_compare $res0 $res1 -100 100
+	tst_netload -H $(tst_ipaddr rhost) -T dccp -c res1
+	tst_netload_compare res0 res1 -100 100
 }
 test3()
 {
 	tst_res TINFO "compare UDP/UDP-Lite performance"
-	tst_netload -H $(tst_ipaddr rhost) -T udp_lite
-	res1="$(cat tst_netload.res)"
-	tst_netload_compare $res0 $res1 -100 100
+	tst_netload -H $(tst_ipaddr rhost) -T udp_lite -c res1
+	tst_netload_compare res0 res1 -100 100
 }
 
 . tst_net.sh
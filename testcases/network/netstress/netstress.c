@@ -5,7 +5,9 @@
  * Author: Alexey Kodanev <alexey.kodanev@oracle.com>
  */
 
+#define _GNU_SOURCE
 #include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <linux/dccp.h>
@@ -16,6 +18,7 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <poll.h>
+#include <sys/eventfd.h>
 #include <time.h>
 #include <string.h>
 #include <unistd.h>
@@ -31,6 +34,8 @@
 #include "tst_safe_pthread.h"
 #include "tst_test.h"
 #include "tst_safe_net.h"
+#include "tst_epoll.h"
+#include "tst_hdr_hist.h"
 
 #if !defined(HAVE_RAND_R)
 static int rand_r(LTP_ATTRIBUTE_UNUSED unsigned int *seed)
@@ -112,11 +117,19 @@ static int wait_timeout = 60000;
 
 /* in the end test will save time result in this file */
 static char *rpath;
+static char *spath;
 static char *port_path = "netstress_port";
 static char *log_path = "netstress.log";
 
 static char *narg, *Narg, *qarg, *rarg, *Rarg, *aarg, *Targ, *barg, *targ,
-	    *Aarg;
+	    *Aarg, *parg, *earg;
+
+/* number of requests a client keeps in flight on a connection */
+#define MAX_PIPELINE	256
+static int pipeline_depth = 1;
+
+/* number of server event loops, -1 when thread per connection is used */
+static int ev_loops = -1;
 
 /* common structure for TCP/UDP server and TCP/UDP client */
 struct net_func {
@@ -372,11 +385,120 @@ static void make_client_request(char client_msg[], int *cln_len, int *srv_len,
 	client_msg[*cln_len - 1] = end_byte;
 }
 
+/*
+ * Log-linear latency histogram with 16 sub-buckets per power of two, which
+ * keeps the relative error of the reported percentiles below 6.25%.
+ */
+#define LAT_SUB_BITS	4
+#define LAT_BUCKETS	TST_HDR_BUCKETS(LAT_SUB_BITS, 64)
+
+struct lat_hist {
+	uint64_t cnt[LAT_BUCKETS];
+	uint64_t total;
+	uint64_t max;
+};
+static struct lat_hist *lat_hists;
+
+static void lat_hist_add(struct lat_hist *h, const struct timespec *start)
+{
+	struct timespec now;
+	uint64_t ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (now.tv_sec - start->tv_sec) * 1000000000LL +
+		now.tv_nsec - start->tv_nsec;
+
+	h->cnt[tst_hdr_bucket(ns, LAT_SUB_BITS)]++;
+	h->total++;
+	if (ns > h->max)
+		h->max = ns;
+}
+
+static uint64_t lat_hist_percentile(const struct lat_hist *h, double pct)
+{
+	uint64_t rank = h->total * pct / 100, sum = 0;
+	unsigned int b;
+
+	for (b = 0; b < LAT_BUCKETS; b++) {
+		sum += h->cnt[b];
+		if (sum > rank)
+			return tst_hdr_bucket_low(b, LAT_SUB_BITS);
+	}
+
+	return h->max;
+}
+
+static void lat_report(long clnt_time)
+{
+	struct lat_hist sum;
+	int i;
+	unsigned int b;
+	FILE *f;
+
+	memset(&sum, 0, sizeof(sum));
+
+	for (i = 0; i < clients_num; i++) {
+		for (b = 0; b < LAT_BUCKETS; b++)
+			sum.cnt[b] += lat_hists[i].cnt[b];
+		sum.total += lat_hists[i].total;
+		sum.max = MAX(sum.max, lat_hists[i].max);
+	}
+
+	if (!sum.total)
+		return;
+
+	tst_res(TINFO, "requests %llu, %.0f req/s",
+		(unsigned long long)sum.total,
+		clnt_time ? sum.total * 1000.0 / clnt_time : 0.0);
+	tst_res(TINFO, "latency p50 %.1fus p99 %.1fus p999 %.1fus max %.1fus",
+		lat_hist_percentile(&sum, 50) / 1000.0,
+		lat_hist_percentile(&sum, 99) / 1000.0,
+		lat_hist_percentile(&sum, 99.9) / 1000.0,
+		sum.max / 1000.0);
+
+	if (!spath)
+		return;
+
+	/*
+	 * One 'key=value' per line so that the file can be easily parsed by
+	 * shell scripts, latencies are in nanoseconds, the histogram is a list
+	 * of 'bucket_value:count' pairs of the non-empty buckets.
+	 */
+	f = SAFE_FOPEN(spath, "w");
+	fprintf(f, "time_ms=%ld\n", clnt_time);
+	fprintf(f, "requests=%llu\n", (unsigned long long)sum.total);
+	fprintf(f, "req_per_sec=%.0f\n",
+		clnt_time ? sum.total * 1000.0 / clnt_time : 0.0);
+	fprintf(f, "lat_p50_ns=%llu\n",
+		(unsigned long long)lat_hist_percentile(&sum, 50));
+	fprintf(f, "lat_p90_ns=%llu\n",
+		(unsigned long long)lat_hist_percentile(&sum, 90));
+	fprintf(f, "lat_p99_ns=%llu\n",
+		(unsigned long long)lat_hist_percentile(&sum, 99));
+	fprintf(f, "lat_p999_ns=%llu\n",
+		(unsigned long long)lat_hist_percentile(&sum, 99.9));
+	fprintf(f, "lat_max_ns=%llu\n", (unsigned long long)sum.max);
+	fprintf(f, "lat_hist=");
+
+	for (b = 0; b < LAT_BUCKETS; b++) {
+		if (sum.cnt[b]) {
+			fprintf(f, "%llu:%llu ",
+				(unsigned long long)tst_hdr_bucket_low(b, LAT_SUB_BITS),
+				(unsigned long long)sum.cnt[b]);
+		}
+	}
+
+	fprintf(f, "\n");
+	SAFE_FCLOSE(f);
+}
+
 void *client_fn(void *id)
 {
 	int cln_len = init_cln_msg_len,
 	    srv_len = init_srv_msg_len;
 	struct sock_info inf;
+	struct lat_hist *hist = &lat_hists[(intptr_t)id];
+	struct timespec ts;
 	char buf[max_msg_len];
 	char client_msg[max_msg_len];
 	int i = 0;
@@ -392,6 +514,7 @@ void *client_fn(void *id)
 	make_client_request(client_msg, &cln_len, &srv_len, &seed);
 
 	/* connect & send requests */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 	inf.fd = client_connect_send(client_msg, cln_len);
 	if (inf.fd == -1) {
 		err = errno;
@@ -402,9 +525,11 @@ void *client_fn(void *id)
 		err = errno;
 		goto out;
 	}
+	lat_hist_add(hist, &ts);
 
 	for (i = 1; i < client_max_requests; ++i) {
 		if (inf.fd == -1) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
 			inf.fd = client_connect_send(client_msg, cln_len);
 			if (inf.fd == -1) {
 				err = errno;
@@ -415,18 +540,21 @@ void *client_fn(void *id)
 				err = errno;
 				break;
 			}
+			lat_hist_add(hist, &ts);
 			continue;
 		}
 
 		if (max_rand_msg_len)
 			make_client_request(client_msg, &cln_len, &srv_len, &seed);
 
+		clock_gettime(CLOCK_MONOTONIC, &ts);
 		SAFE_SEND(1, inf.fd, client_msg, cln_len, send_flags);
 
 		if (client_recv(buf, srv_len, &inf)) {
 			err = errno;
 			break;
 		}
+		lat_hist_add(hist, &ts);
 	}
 
 	if (inf.fd != -1)
@@ -439,6 +567,91 @@ out:
 	return (void *) err;
 }
 
+/*
+ * Keeps up to pipeline_depth requests in flight on a TCP connection, replies
+ * arrive in order so the oldest outstanding request is always completed
+ * first. When the server closes the connection after its max requests the
+ * requests that were still in flight are lost and sent again on a new one,
+ * the connection may also be reset by the server while they are sent.
+ */
+void *client_fn_pipe(void *id)
+{
+	int cln_len = init_cln_msg_len,
+	    srv_len = init_srv_msg_len;
+	int srv_lens[MAX_PIPELINE];
+	struct timespec ts[MAX_PIPELINE];
+	struct sock_info inf;
+	struct lat_hist *hist = &lat_hists[(intptr_t)id];
+	char buf[max_msg_len];
+	char client_msg[max_msg_len];
+	int sent = 0, done = 0, slot;
+	intptr_t err = 0;
+	unsigned int seed = init_seed ^ (intptr_t)id;
+
+	inf.fd = -1;
+	inf.raddr_len = sizeof(inf.raddr);
+	inf.etime_cnt = 0;
+	inf.eshutdown_cnt = 0;
+	inf.timeout = wait_timeout;
+	inf.pmtu_err_cnt = 0;
+
+	make_client_request(client_msg, &cln_len, &srv_len, &seed);
+
+	while (done < client_max_requests) {
+		if (inf.fd == -1)
+			sent = done;
+
+		while (sent - done < pipeline_depth &&
+		       sent < client_max_requests) {
+			slot = sent % MAX_PIPELINE;
+
+			if (max_rand_msg_len && sent)
+				make_client_request(client_msg, &cln_len, &srv_len, &seed);
+
+			srv_lens[slot] = srv_len;
+			clock_gettime(CLOCK_MONOTONIC, &ts[slot]);
+
+			if (inf.fd == -1) {
+				inf.fd = client_connect_send(client_msg, cln_len);
+				if (inf.fd == -1) {
+					err = errno;
+					goto out;
+				}
+			} else if (send(inf.fd, client_msg, cln_len, send_flags) != cln_len) {
+				if (errno != EPIPE && errno != ECONNRESET)
+					tst_brk(TBROK | TERRNO, "send() failed");
+
+				SAFE_CLOSE(inf.fd);
+				break;
+			}
+			sent++;
+		}
+
+		if (inf.fd == -1)
+			continue;
+
+		slot = done % MAX_PIPELINE;
+		if (client_recv(buf, srv_lens[slot], &inf)) {
+			if (errno == ECONNRESET)
+				continue;
+
+			err = errno;
+			break;
+		}
+		lat_hist_add(hist, &ts[slot]);
+		done++;
+	}
+
+	if (inf.fd != -1)
+		SAFE_CLOSE(inf.fd);
+
+out:
+	if (done != client_max_requests)
+		tst_res(TWARN, "client exit on '%d' request", done);
+
+	return (void *) err;
+}
+
 static int parse_client_request(const char *msg)
 {
 	union net_size_field net_size;
@@ -462,6 +675,7 @@ static void client_init(void)
 	}
 
 	thread_ids = SAFE_MALLOC(sizeof(pthread_t) * clients_num);
+	lat_hists = SAFE_CALLOC(clients_num, sizeof(*lat_hists));
 
 	struct addrinfo hints;
 	memset(&hints, 0, sizeof(struct addrinfo));
@@ -481,8 +695,11 @@ static void client_init(void)
 
 	clock_gettime(CLOCK_MONOTONIC_RAW, &tv_client_start);
 	intptr_t i;
-	for (i = 0; i < clients_num; ++i)
-		SAFE_PTHREAD_CREATE(&thread_ids[i], &attr, client_fn, (void *)i);
+	for (i = 0; i < clients_num; ++i) {
+		SAFE_PTHREAD_CREATE(&thread_ids[i], &attr,
+				    pipeline_depth > 1 ? client_fn_pipe : client_fn,
+				    (void *)i);
+	}
 }
 
 static void client_run(void)
@@ -503,6 +720,7 @@ static void client_run(void)
 		(tv_client_end.tv_nsec - tv_client_start.tv_nsec) / 1000000;
 
 	tst_res(TINFO, "total time '%ld' ms", clnt_time);
+	lat_report(clnt_time);
 
 	char client_msg[min_msg_len];
 	int msg_len = min_msg_len;
@@ -526,6 +744,7 @@ static void client_run(void)
 static void client_cleanup(void)
 {
 	free(thread_ids);
+	free(lat_hists);
 
 	if (remote_addrinfo)
 		freeaddrinfo(remote_addrinfo);
@@ -538,9 +757,25 @@ static void make_server_reply(char *send_msg, int size)
 	send_msg[size - 1] = end_byte;
 }
 
+/*
+ * Returns the length of the first complete request in the buffer or 0, the
+ * end byte is looked for after the request header.
+ */
+static int server_msg_len(const char *msg, int len)
+{
+	int i;
+
+	for (i = 3; i < len; i++) {
+		if (msg[i] == end_byte)
+			return i + 1;
+	}
+
+	return 0;
+}
+
 void *server_fn(void *cfd)
 {
-	int num_requests = 0, offset = 0;
+	int num_requests = 0, offset = 0, msg_len;
 	char send_msg[max_msg_len], end[] = { end_byte };
 	int start_send_type = (sock_type == SOCK_DGRAM) ? 1 : 0;
 	int send_msg_len, send_type = start_send_type;
@@ -580,62 +815,77 @@ void *server_fn(void *cfd)
 
 		offset += recv_len;
 
-		if (recv_msg[offset - 1] != end_byte) {
-			/* msg is not complete, continue recv */
-			continue;
-		}
+		/*
+		 * A TCP client may pipeline requests, reply to each complete
+		 * request in the buffer.
+		 */
+		while ((msg_len = server_msg_len(recv_msg, offset))) {
+			/* client asks to terminate */
+			if (recv_msg[0] == start_fin_byte)
+				goto out;
 
-		/* client asks to terminate */
-		if (recv_msg[0] == start_fin_byte)
-			goto out;
+			send_msg_len = parse_client_request(recv_msg);
+			if (send_msg_len < 0) {
+				tst_res(TFAIL, "wrong msg size '%d'",
+					send_msg_len);
+				goto out;
+			}
+			make_server_reply(send_msg, send_msg_len);
 
-		send_msg_len = parse_client_request(recv_msg);
-		if (send_msg_len < 0) {
-			tst_res(TFAIL, "wrong msg size '%d'",
-				send_msg_len);
-			goto out;
-		}
-		make_server_reply(send_msg, send_msg_len);
+			offset -= msg_len;
+			memmove(recv_msg, recv_msg + msg_len, offset);
 
-		offset = 0;
+			if (offset && recv_msg[0] != start_byte &&
+			    recv_msg[0] != start_fin_byte) {
+				tst_res(TFAIL, "wrong msg start, sock '%d'",
+					inf.fd);
+				goto out;
+			}
 
-		/*
-		 * It will tell client that server is going
-		 * to close this connection.
-		 */
-		if (sock_type == SOCK_STREAM &&
-		    ++num_requests >= server_max_requests)
-			send_msg[0] = start_fin_byte;
-
-		switch (send_type) {
-		case 0:
-			SAFE_SEND(1, inf.fd, send_msg, send_msg_len,
-				  send_flags);
-			if (proto_type != TYPE_SCTP)
+			/*
+			 * It will tell client that server is going
+			 * to close this connection.
+			 */
+			if (sock_type == SOCK_STREAM &&
+			    ++num_requests >= server_max_requests)
+				send_msg[0] = start_fin_byte;
+
+			switch (send_type) {
+			case 0:
+				SAFE_SEND(1, inf.fd, send_msg, send_msg_len,
+					  send_flags);
+				if (proto_type != TYPE_SCTP)
+					++send_type;
+				break;
+			case 1:
+				SAFE_SENDTO(1, inf.fd, send_msg, send_msg_len,
+					    send_flags, (struct sockaddr *)&inf.raddr,
+					    inf.raddr_len);
 				++send_type;
-			break;
-		case 1:
-			SAFE_SENDTO(1, inf.fd, send_msg, send_msg_len,
-				    send_flags, (struct sockaddr *)&inf.raddr,
-				    inf.raddr_len);
-			++send_type;
-			break;
-		default:
-			iov[0].iov_len = send_msg_len - 1;
-			msg.msg_namelen = inf.raddr_len;
-			SAFE_SENDMSG(send_msg_len, inf.fd, &msg, send_flags);
-			send_type = start_send_type;
-			break;
+				break;
+			default:
+				iov[0].iov_len = send_msg_len - 1;
+				msg.msg_namelen = inf.raddr_len;
+				SAFE_SENDMSG(send_msg_len, inf.fd, &msg, send_flags);
+				send_type = start_send_type;
+				break;
+			}
+
+			if (sock_type == SOCK_STREAM &&
+			    num_requests >= server_max_requests) {
+				/* max reqs, close socket */
+				shutdown(inf.fd, SHUT_WR);
+				goto done;
+			}
 		}
 
-		if (sock_type == SOCK_STREAM &&
-		    num_requests >= server_max_requests) {
-			/* max reqs, close socket */
-			shutdown(inf.fd, SHUT_WR);
-			break;
+		if (offset == max_msg_len) {
+			tst_res(TFAIL, "msg too long, sock '%d'", inf.fd);
+			goto out;
 		}
 	}
 
+done:
 	SAFE_CLOSE(inf.fd);
 	return NULL;
 
@@ -652,6 +902,401 @@ static pthread_t server_thread_add(intptr_t client_fd)
 	return id;
 }
 
+/*
+ * Event loop server, each loop runs in a thread pinned to a CPU and owns
+ * its SO_REUSEPORT listener, so the kernel shards new connections between
+ * the loops. Requests are parsed as a stream which allows clients to
+ * pipeline them, replies for all requests read at once are sent together.
+ */
+#define EV_BUF_LEN	(1 << 18)
+#define EV_MAX_EVENTS	64
+
+struct ev_reply {
+	int size;
+	int fin;
+};
+
+struct ev_conn {
+	int fd;
+	/* position in the request being parsed and its header */
+	int pos;
+	char hdr[3];
+	int num_requests;
+	int closing;
+	int shut;
+	int want_out;
+	/* replies waiting to be sent, q_off is offset in the first one */
+	struct ev_reply *q;
+	unsigned int q_head, q_tail, q_size;
+	int q_off;
+};
+
+struct ev_loop {
+	pthread_t thread;
+	int cpu;
+	int lfd;
+	int epfd;
+	unsigned long long conns;
+	unsigned long long requests;
+	char *buf;
+};
+
+static struct ev_loop *loops;
+static int ev_stop_fd = -1;
+
+static void ev_queue_reply(struct ev_conn *c, int size, int fin)
+{
+	if (c->q_tail == c->q_size) {
+		if (c->q_head) {
+			memmove(c->q, c->q + c->q_head,
+				(c->q_tail - c->q_head) * sizeof(*c->q));
+			c->q_tail -= c->q_head;
+			c->q_head = 0;
+		} else {
+			c->q_size = c->q_size ? 2 * c->q_size : 16;
+			c->q = SAFE_REALLOC(c->q, c->q_size * sizeof(*c->q));
+		}
+	}
+
+	c->q[c->q_tail].size = size;
+	c->q[c->q_tail].fin = fin;
+	c->q_tail++;
+}
+
+/* Returns 1 if client asks to terminate the server */
+static int ev_conn_parse(struct ev_loop *l, struct ev_conn *c,
+			 const char *buf, int len)
+{
+	int i, size;
+
+	for (i = 0; i < len && !c->closing; i++) {
+		if (c->pos < 3) {
+			if (!c->pos && buf[i] != start_byte &&
+			    buf[i] != start_fin_byte) {
+				tst_brk(TBROK, "wrong msg start byte 0x%x, sock '%d'",
+					(unsigned char)buf[i], c->fd);
+			}
+			c->hdr[c->pos++] = buf[i];
+			continue;
+		}
+
+		if (++c->pos > max_msg_len)
+			tst_brk(TBROK, "msg too long, sock '%d'", c->fd);
+
+		if (buf[i] != end_byte)
+			continue;
+
+		c->pos = 0;
+
+		/* client asks to terminate */
+		if (c->hdr[0] == start_fin_byte)
+			return 1;
+
+		size = parse_client_request(c->hdr);
+		if (size < 0)
+			tst_brk(TBROK, "wrong msg size '%d'", size);
+
+		/*
+		 * The last reply tells client that server is going to close
+		 * this connection, the rest of the input is ignored.
+		 */
+		if (++c->num_requests >= server_max_requests)
+			c->closing = 1;
+
+		ev_queue_reply(c, size, c->closing);
+		l->requests++;
+	}
+
+	return 0;
+}
+
+static void ev_conn_events(struct ev_loop *l, struct ev_conn *c, int out)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN | (out ? EPOLLOUT : 0),
+		.data.ptr = c,
+	};
+
+	if (c->want_out == out)
+		return;
+
+	SAFE_EPOLL_CTL(l->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+	c->want_out = out;
+}
+
+static void ev_conn_consume(struct ev_conn *c, int len)
+{
+	struct ev_reply *r;
+	int n;
+
+	while (len > 0) {
+		r = &c->q[c->q_head];
+		n = MIN(r->size - c->q_off, len);
+		len -= n;
+		c->q_off += n;
+
+		if (c->q_off == r->size) {
+			c->q_head++;
+			c->q_off = 0;
+		}
+	}
+}
+
+static void ev_conn_flush(struct ev_loop *l, struct ev_conn *c)
+{
+	unsigned int i;
+	int len, off, n;
+	ssize_t ret;
+	char *dst;
+
+	while (c->q_head != c->q_tail) {
+		len = 0;
+		off = c->q_off;
+
+		for (i = c->q_head; i != c->q_tail && len < EV_BUF_LEN; ) {
+			n = MIN(c->q[i].size - off, EV_BUF_LEN - len);
+			dst = l->buf + len;
+			memset(dst, server_byte, n);
+
+			if (!off)
+				dst[0] = c->q[i].fin ? start_fin_byte : start_byte;
+
+			if (off + n == c->q[i].size) {
+				dst[n - 1] = end_byte;
+				off = 0;
+				i++;
+			} else {
+				off += n;
+			}
+
+			len += n;
+		}
+
+		ret = send(c->fd, l->buf, len, send_flags | MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				ev_conn_events(l, c, 1);
+				return;
+			}
+
+			tst_brk(TBROK | TERRNO, "send failed, sock '%d'", c->fd);
+		}
+
+		ev_conn_consume(c, ret);
+	}
+
+	c->q_head = c->q_tail = 0;
+	ev_conn_events(l, c, 0);
+
+	/* max reqs, wait for the client to close the connection */
+	if (c->closing && !c->shut) {
+		shutdown(c->fd, SHUT_WR);
+		c->shut = 1;
+	}
+}
+
+/*
+ * Returns -1 if the connection was closed by client, 1 if client asks to
+ * terminate the server.
+ */
+static int ev_conn_read(struct ev_loop *l, struct ev_conn *c)
+{
+	ssize_t len;
+
+	for (;;) {
+		len = recv(c->fd, l->buf, EV_BUF_LEN, MSG_DONTWAIT);
+
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			tst_brk(TBROK | TERRNO, "recv failed, sock '%d'", c->fd);
+		}
+
+		if (!len)
+			return -1;
+
+		if (!c->closing && ev_conn_parse(l, c, l->buf, len))
+			return 1;
+
+		if (len < EV_BUF_LEN)
+			break;
+	}
+
+	ev_conn_flush(l, c);
+
+	return 0;
+}
+
+static void ev_accept(struct ev_loop *l)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct ev_conn *c;
+	int fd;
+
+	for (;;) {
+		fd = accept4(l->lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+		if (fd == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			tst_brk(TBROK | TERRNO, "Can't create client socket");
+		}
+
+		init_socket_opts(fd);
+
+		c = SAFE_CALLOC(1, sizeof(*c));
+		c->fd = fd;
+		ev.data.ptr = c;
+		SAFE_EPOLL_CTL(l->epfd, EPOLL_CTL_ADD, fd, &ev);
+		l->conns++;
+	}
+}
+
+static void ev_conn_close(struct ev_conn *c)
+{
+	SAFE_CLOSE(c->fd);
+	free(c->q);
+	free(c);
+}
+
+static void *ev_loop_fn(void *arg)
+{
+	struct ev_loop *l = arg;
+	struct epoll_event evs[EV_MAX_EVENTS];
+	struct ev_conn *c;
+	cpu_set_t mask;
+	uint64_t val = 1;
+	int i, n, ret;
+
+	CPU_ZERO(&mask);
+	CPU_SET(l->cpu, &mask);
+	if ((errno = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask)))
+		tst_res(TINFO | TERRNO, "Can't pin event loop to CPU %d", l->cpu);
+
+	for (;;) {
+		n = epoll_wait(l->epfd, evs, EV_MAX_EVENTS, -1);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			tst_brk(TBROK | TERRNO, "epoll_wait() failed");
+		}
+
+		for (i = 0; i < n; i++) {
+			/* other loop got request to terminate */
+			if (!evs[i].data.ptr)
+				return NULL;
+
+			if (evs[i].data.ptr == l) {
+				ev_accept(l);
+				continue;
+			}
+
+			c = evs[i].data.ptr;
+
+			if (evs[i].events & EPOLLOUT)
+				ev_conn_flush(l, c);
+
+			if (!(evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+				continue;
+
+			ret = ev_conn_read(l, c);
+			if (ret < 0)
+				ev_conn_close(c);
+
+			if (ret > 0) {
+				ev_conn_close(c);
+				SAFE_WRITE(SAFE_WRITE_ALL, ev_stop_fd, &val,
+					   sizeof(val));
+				return NULL;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void server_listen(int fd)
+{
+	init_socket_opts(fd);
+
+	if (fastopen_api || fastopen_sapi) {
+		SAFE_SETSOCKOPT_INT(fd, IPPROTO_TCP, TCP_FASTOPEN,
+			tfo_queue_size);
+	}
+
+	if (zcopy)
+		SAFE_SETSOCKOPT_INT(fd, SOL_SOCKET, SO_ZEROCOPY, 1);
+
+	SAFE_LISTEN(fd, max_queue_len);
+}
+
+static void ev_init(void)
+{
+	struct sockaddr_storage addr;
+	socklen_t addr_len = sizeof(addr);
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct ev_loop *l;
+	cpu_set_t mask;
+	int cpus[CPU_SETSIZE];
+	int i, nr_cpus = 0;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		tst_brk(TBROK | TERRNO, "sched_getaffinity() failed");
+
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		if (CPU_ISSET(i, &mask))
+			cpus[nr_cpus++] = i;
+	}
+
+	if (!ev_loops)
+		ev_loops = nr_cpus;
+
+	SAFE_GETSOCKNAME(sfd, (struct sockaddr *)&addr, &addr_len);
+
+	ev_stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (ev_stop_fd == -1)
+		tst_brk(TBROK | TERRNO, "eventfd() failed");
+
+	loops = SAFE_CALLOC(ev_loops, sizeof(*loops));
+
+	for (i = 0; i < ev_loops; i++) {
+		l = &loops[i];
+		l->cpu = cpus[i % nr_cpus];
+
+		if (i) {
+			l->lfd = SAFE_SOCKET(family, sock_type, protocol);
+			SAFE_SETSOCKOPT_INT(l->lfd, SOL_SOCKET, SO_REUSEADDR, 1);
+			SAFE_SETSOCKOPT_INT(l->lfd, SOL_SOCKET, SO_REUSEPORT, 1);
+			SAFE_BIND(l->lfd, (struct sockaddr *)&addr, addr_len);
+			server_listen(l->lfd);
+		} else {
+			l->lfd = sfd;
+		}
+
+		/* Prefer the listener on the CPU which processed the SYN */
+		setsockopt(l->lfd, SOL_SOCKET, SO_INCOMING_CPU, &l->cpu,
+			   sizeof(l->cpu));
+		SAFE_FCNTL(l->lfd, F_SETFL, O_NONBLOCK);
+
+		l->epfd = SAFE_EPOLL_CREATE1(EPOLL_CLOEXEC);
+		ev.data.ptr = l;
+		SAFE_EPOLL_CTL(l->epfd, EPOLL_CTL_ADD, l->lfd, &ev);
+		ev.data.ptr = NULL;
+		SAFE_EPOLL_CTL(l->epfd, EPOLL_CTL_ADD, ev_stop_fd, &ev);
+
+		l->buf = SAFE_MALLOC(EV_BUF_LEN);
+	}
+
+	tst_res(TINFO, "Running %d event loops on %d CPUs", ev_loops, nr_cpus);
+}
+
 static void server_init(void)
 {
 	char *src_addr = NULL;
@@ -674,7 +1319,7 @@ static void server_init(void)
 	/* IPv6 socket is also able to access IPv4 protocol stack */
 	sfd = SAFE_SOCKET(family, sock_type, protocol);
 	SAFE_SETSOCKOPT_INT(sfd, SOL_SOCKET, SO_REUSEADDR, 1);
-	if (reuse_port)
+	if (reuse_port || ev_loops >= 0)
 		SAFE_SETSOCKOPT_INT(sfd, SOL_SOCKET, SO_REUSEPORT, 1);
 
 	tst_res(TINFO, "assigning a name to the server socket...");
@@ -693,24 +1338,32 @@ static void server_init(void)
 	if (sock_type == SOCK_DGRAM)
 		return;
 
-	init_socket_opts(sfd);
-
-	if (fastopen_api || fastopen_sapi) {
-		SAFE_SETSOCKOPT_INT(sfd, IPPROTO_TCP, TCP_FASTOPEN,
-			tfo_queue_size);
-	}
-
-	if (zcopy)
-		SAFE_SETSOCKOPT_INT(sfd, SOL_SOCKET, SO_ZEROCOPY, 1);
-
-	SAFE_LISTEN(sfd, max_queue_len);
+	server_listen(sfd);
 
 	tst_res(TINFO, "Listen on the socket '%d'", sfd);
+
+	if (ev_loops >= 0)
+		ev_init();
 }
 
 static void server_cleanup(void)
 {
+	int i;
+
 	SAFE_CLOSE(sfd);
+
+	for (i = 0; loops && i < ev_loops; i++) {
+		if (i && loops[i].lfd > 0)
+			SAFE_CLOSE(loops[i].lfd);
+		if (loops[i].epfd > 0)
+			SAFE_CLOSE(loops[i].epfd);
+		free(loops[i].buf);
+	}
+
+	free(loops);
+
+	if (ev_stop_fd != -1)
+		SAFE_CLOSE(ev_stop_fd);
 }
 
 static void move_to_background(void)
@@ -771,6 +1424,29 @@ static void server_run(void)
 	}
 }
 
+static void server_run_ev(void)
+{
+	unsigned long long conns = 0, requests = 0;
+	int i;
+
+	if (server_bg)
+		move_to_background();
+
+	for (i = 0; i < ev_loops; i++)
+		SAFE_PTHREAD_CREATE(&loops[i].thread, &attr, ev_loop_fn, &loops[i]);
+
+	for (i = 0; i < ev_loops; i++) {
+		SAFE_PTHREAD_JOIN(loops[i].thread, NULL);
+		tst_res(TINFO, "loop %d (CPU %d): %llu connections, %llu requests",
+			i, loops[i].cpu, loops[i].conns, loops[i].requests);
+		conns += loops[i].conns;
+		requests += loops[i].requests;
+	}
+
+	tst_res(TPASS, "server handled %llu connections, %llu requests",
+		conns, requests);
+}
+
 static void require_root(const char *file)
 {
 	if (!geteuid())
@@ -869,6 +1545,10 @@ static void setup(void)
 		tst_brk(TBROK, "Invalid net.ipv4.tcp_fastopen '%s'", targ);
 	if (tst_parse_int(Aarg, &max_rand_msg_len, 10, max_msg_len))
 		tst_brk(TBROK, "Invalid max random payload size '%s'", Aarg);
+	if (tst_parse_int(parg, &pipeline_depth, 1, MAX_PIPELINE))
+		tst_brk(TBROK, "Invalid pipelined requests number '%s'", parg);
+	if (tst_parse_int(earg, &ev_loops, 0, INT_MAX))
+		tst_brk(TBROK, "Invalid event loops number '%s'", earg);
 
 	if (!server_addr)
 		server_addr = "localhost";
@@ -886,6 +1566,9 @@ static void setup(void)
 
 	set_protocol_type();
 
+	if ((pipeline_depth > 1 || ev_loops >= 0) && proto_type != TYPE_TCP)
+		tst_brk(TBROK, "Pipelining and event loops require TCP");
+
 	if (client_mode) {
 		if (source_addr && tst_kvercmp(4, 2, 0) >= 0) {
 			bind_no_port = 1;
@@ -895,6 +1578,8 @@ static void setup(void)
 			server_addr, tcp_port);
 		tst_res(TINFO, "client max req: %d", client_max_requests);
 		tst_res(TINFO, "clients num: %d", clients_num);
+		if (pipeline_depth > 1)
+			tst_res(TINFO, "pipelined requests: %d", pipeline_depth);
 		if (max_rand_msg_len) {
 			tst_res(TINFO, "random msg size [%d %d]",
 				min_msg_len, max_rand_msg_len);
@@ -926,7 +1611,7 @@ static void setup(void)
 		case TYPE_TCP:
 		case TYPE_DCCP:
 		case TYPE_SCTP:
-			net.run		= server_run;
+			net.run		= ev_loops >= 0 ? server_run_ev : server_run;
 			net.cleanup	= server_cleanup;
 		break;
 		case TYPE_UDP:
@@ -1017,10 +1702,13 @@ static struct tst_test test = {
 		{"N:", &Narg, "Server message size"},
 		{"m:", &Targ, "Receive timeout in milliseconds (not used by UDP/DCCP client)"},
 		{"c:", &rpath, "Path to file where result is saved"},
+		{"s:", &spath, "Path to file where throughput and latency statistics are saved"},
 		{"A:", &Aarg, "Max payload length (generated randomly)"},
+		{"p:", &parg, "Number of pipelined requests per connection (TCP)"},
 
 		{"R:", &Rarg, "Server requests after which conn.closed"},
 		{"q:", &qarg, "TFO queue"},
+		{"e:", &earg, "Use epoll event loops with SO_REUSEPORT listeners, 0 is one per CPU (TCP)"},
 		{"B:", &server_bg, "Run in background, arg is the process directory"},
 		{}
 	},
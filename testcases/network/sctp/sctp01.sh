@@ -16,13 +16,11 @@ test()
 
 	tst_res TINFO "compare TCP/SCTP performance"
 
-	tst_netload -H $(tst_ipaddr rhost) -T tcp -R 3 $opts
-	local res0="$(cat tst_netload.res)"
+	tst_netload -H $(tst_ipaddr rhost) -T tcp -R 3 $opts -c res0
 
-	tst_netload -S $(tst_ipaddr) -H $(tst_ipaddr rhost) -T sctp -R 3 $opts
-	local res1="$(cat tst_netload.res)"
+	tst_netload -S $(tst_ipaddr) -H $(tst_ipaddr rhost) -T sctp -R 3 $opts -c res1
 
-	tst_netload_compare $res0 $res1 -200 200
+	tst_netload_compare res0 res1 -200 200
 }
 
 . tst_net.sh
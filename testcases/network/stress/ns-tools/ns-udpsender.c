@@ -30,16 +30,21 @@
  *
  * History:
  *	Mar 17 2006 - Created (Mitsuru Chinen)
+ *	2026 - Added high rate mode with sendmmsg(), UDP GSO, MSG_ZEROCOPY and
+ *	       one sender thread per CPU, added recvmmsg()/UDP GRO receiver mode
  *---------------------------------------------------------------------------*/
 
 /*
  * Header Files
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <netdb.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <time.h>
 #include <unistd.h>
@@ -47,8 +52,19 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include "lapi/socket.h"
+#include "lapi/udp.h"
 #include "ns-traffic.h"
 
+/*
+ * Fixed Values
+ */
+#define UDP_GSO_MAXSEGS		64	/* UDP_MAX_SEGMENTS in older kernels */
+#define UDP_BUF_MAXSIZE		65507	/* max UDP payload over IPv4 */
+#define UDP_BATCH_MAXSIZE	1024	/* UIO_MAXIOV */
+#define UDP_RECV_BUFSIZE	65535	/* per message, fits a GRO super-packet */
+#define ZEROCOPY_DRAIN_INTERVAL	64	/* sendmmsg() calls between draining */
+
 /*
  * Structure Definitions
  */
@@ -61,9 +77,24 @@ struct udp_info {
 	char *dst_name;
 	char *dst_port;
 	struct addrinfo addr_info;
+	struct sockaddr_storage addr;
 	unsigned char *msg;
 	size_t msgsize;
 	double timeout;
+	int batch;		/* messages per sendmmsg()/recvmmsg() */
+	int gso_segs;		/* segments per UDP GSO send, GRO if receiver */
+	int zerocopy;		/* send with MSG_ZEROCOPY */
+	int threads;		/* number of threads, 0 means one per CPU */
+	int receiver;		/* receive datagrams instead of sending */
+	int high_rate;		/* use the threaded high rate mode */
+};
+
+struct udp_thread {
+	pthread_t id;
+	struct udp_info *udp_p;
+	int cpu;		/* CPU the thread is bound to, -1 if none */
+	unsigned long long packets;
+	unsigned long long bytes;
 };
 
 /*
@@ -72,6 +103,7 @@ struct udp_info {
 char *program_name;		/* program name */
 struct sigaction handler;	/* Behavior for a signal */
 int catch_sighup;		/* When catch the SIGHUP, set to non-zero */
+volatile int stop_threads;	/* When non-zero, threads should exit */
 
 /*
  * Function: usage()
@@ -108,7 +140,16 @@ void usage(char *program_name, int exit_value)
 		"\n"
 		"\t[options for multicast]\n"
 		"\t  -m\t\tsend multicast datagrams\n"
-		"\t  -I if_name\tinterface name of the source host\n",
+		"\t  -I if_name\tinterface name of the source host\n"
+		"\n"
+		"\t[options for high rate mode, rate is reported at exit]\n"
+		"\t  -B num\tdatagrams per sendmmsg()/recvmmsg() call\n"
+		"\t  -G num\tsegments per send with UDP GSO (UDP_SEGMENT),\n"
+		"\t\t\tvalue above 1 enables UDP GRO with -r\n"
+		"\t  -z\t\tsend with MSG_ZEROCOPY\n"
+		"\t  -T num\tnumber of threads with own sockets,\n"
+		"\t\t\t0 means one thread bound to each CPU\n"
+		"\t  -r\t\treceive datagrams on the port of the -D address\n",
 		program_name);
 	exit(exit_value);
 }
@@ -168,7 +209,7 @@ void parse_options(int argc, char *argv[], struct udp_info *udp_p, int *bg_p)
 	int is_specified_daddr = 0;
 	int is_specified_port = 0;
 
-	while ((optc = getopt(argc, argv, "f:D:p:s:t:obdhmI:")) != EOF) {
+	while ((optc = getopt(argc, argv, "f:D:p:s:t:obdhmI:B:G:zT:r")) != EOF) {
 		switch (optc) {
 		case 'f':
 			if (optarg[0] == '4')
@@ -244,6 +285,46 @@ void parse_options(int argc, char *argv[], struct udp_info *udp_p, int *bg_p)
 				fatal_error("strdup() failed.");
 			break;
 
+			/* Options for high rate mode */
+		case 'B':
+			opt_ul = strtoul(optarg, NULL, 0);
+			if (opt_ul < 1 || UDP_BATCH_MAXSIZE < opt_ul) {
+				fprintf(stderr,
+					"The range of batch is from 1 to %u\n",
+					UDP_BATCH_MAXSIZE);
+				usage(program_name, EXIT_FAILURE);
+			}
+			udp_p->batch = opt_ul;
+			udp_p->high_rate = 1;
+			break;
+
+		case 'G':
+			opt_ul = strtoul(optarg, NULL, 0);
+			if (opt_ul < 1 || UDP_GSO_MAXSEGS < opt_ul) {
+				fprintf(stderr,
+					"The range of GSO segments is from 1 to %u\n",
+					UDP_GSO_MAXSEGS);
+				usage(program_name, EXIT_FAILURE);
+			}
+			udp_p->gso_segs = opt_ul;
+			udp_p->high_rate = 1;
+			break;
+
+		case 'z':
+			udp_p->zerocopy = 1;
+			udp_p->high_rate = 1;
+			break;
+
+		case 'T':
+			udp_p->threads = strtoul(optarg, NULL, 0);
+			udp_p->high_rate = 1;
+			break;
+
+		case 'r':
+			udp_p->receiver = 1;
+			udp_p->high_rate = 1;
+			break;
+
 		default:
 			usage(program_name, EXIT_FAILURE);
 		}
@@ -271,6 +352,18 @@ void parse_options(int argc, char *argv[], struct udp_info *udp_p, int *bg_p)
 			usage(program_name, EXIT_FAILURE);
 		}
 	}
+
+	if (udp_p->receiver && udp_p->is_multicast) {
+		fprintf(stderr,
+			"use ns-mcast_receiver to receive multicast datagrams\n");
+		usage(program_name, EXIT_FAILURE);
+	}
+
+	if (udp_p->msgsize * udp_p->gso_segs > UDP_BUF_MAXSIZE) {
+		fprintf(stderr, "data size multiplied by GSO segments "
+			"should not exceed %u\n", UDP_BUF_MAXSIZE);
+		usage(program_name, EXIT_FAILURE);
+	}
 }
 
 /*
@@ -285,47 +378,50 @@ void parse_options(int argc, char *argv[], struct udp_info *udp_p, int *bg_p)
  * Return value:
  *  None
  */
-void create_udp_datagram(struct udp_info *udp_p)
+/*
+ * Function: open_udp_socket()
+ *
+ * Description:
+ *  This function creates a socket for sending to the destination or, in
+ *  the receiver mode, a socket bound to the destination address
+ *
+ * Argument:
+ *  udp_p: pointer to data of udp data structure
+ *
+ * Return value:
+ *  socket descriptor
+ */
+int open_udp_socket(struct udp_info *udp_p)
 {
-	struct addrinfo hints;	/* hints for getaddrinfo() */
-	struct addrinfo *res;	/* pointer to addrinfo structure */
+	struct addrinfo *res = &udp_p->addr_info;
 	struct ifreq ifinfo;	/* Interface information */
-	int err;		/* return value of getaddrinfo */
+	int sd;			/* socket descriptor */
 	int on;			/* variable for socket option */
 
-	/* Set the hints to addrinfo() */
-	memset(&hints, '\0', sizeof(struct addrinfo));
-	hints.ai_family = udp_p->family;
-	hints.ai_socktype = SOCK_DGRAM;
-	hints.ai_protocol = IPPROTO_UDP;
-
-	/* Get the address information */
-	err = getaddrinfo(udp_p->dst_name, udp_p->dst_port, &hints, &res);
-	if (err) {
-		fprintf(stderr, "getaddrinfo(): %s\n", gai_strerror(err));
-		exit(EXIT_FAILURE);
-	}
-	if (res->ai_next) {
-		fprintf(stderr, "getaddrinfo(): multiple address is found.");
-		exit(EXIT_FAILURE);
-	}
-
 	/* Create a socket */
-	udp_p->sd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-	if (udp_p->sd < 0)
+	sd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (sd < 0)
 		fatal_error("socket()");
 
 	/* Enable to reuse the socket */
 	on = 1;
-	if (setsockopt(udp_p->sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(int)))
+	if (setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(int)))
 		fatal_error("setsockopt()");
 
+	/* In receiver mode, each thread receives on its own socket */
+	if (udp_p->receiver) {
+		if (setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(int)))
+			fatal_error("setsockopt()");
+		if (bind(sd, res->ai_addr, res->ai_addrlen))
+			fatal_error("bind()");
+	}
+
 	/* In multicast case, specify the interface for outgoing datagrams */
 	if (udp_p->is_multicast) {
 		struct ip_mreqn mcast_req, *req_p = &mcast_req;
 		int ifindex, *id_p = &ifindex;
 
-		get_ifinfo(&ifinfo, udp_p->sd, udp_p->ifname, SIOCGIFINDEX);
+		get_ifinfo(&ifinfo, sd, udp_p->ifname, SIOCGIFINDEX);
 		ifindex = ifinfo.ifr_ifindex;
 
 		switch (udp_p->family) {
@@ -334,7 +430,7 @@ void create_udp_datagram(struct udp_info *udp_p)
 			    ((struct sockaddr_in *)(res->ai_addr))->sin_addr;
 			req_p->imr_address.s_addr = htonl(INADDR_ANY);
 			req_p->imr_ifindex = ifindex;
-			if (setsockopt(udp_p->sd, IPPROTO_IP, IP_MULTICAST_IF,
+			if (setsockopt(sd, IPPROTO_IP, IP_MULTICAST_IF,
 				       req_p, sizeof(struct ip_mreqn))) {
 				fatal_error("setsockopt()");
 			}
@@ -342,7 +438,7 @@ void create_udp_datagram(struct udp_info *udp_p)
 
 		case PF_INET6:	/* IPv6 */
 			if (setsockopt
-			    (udp_p->sd, IPPROTO_IPV6, IPV6_MULTICAST_IF, id_p,
+			    (sd, IPPROTO_IPV6, IPV6_MULTICAST_IF, id_p,
 			     sizeof(int))) {
 				fatal_error("setsockopt()");
 			}
@@ -350,6 +446,58 @@ void create_udp_datagram(struct udp_info *udp_p)
 		}
 	}
 
+	return sd;
+}
+
+/*
+ * Function: create_udp_datagram()
+ *
+ * Description:
+ *  This function creates udp datagram
+ *
+ * Argument:
+ *  udp_p: pointer to data of udp data structure
+ *
+ * Return value:
+ *  None
+ */
+void create_udp_datagram(struct udp_info *udp_p)
+{
+	struct addrinfo hints;	/* hints for getaddrinfo() */
+	struct addrinfo *res;	/* pointer to addrinfo structure */
+	int err;		/* return value of getaddrinfo */
+
+	/* Set the hints to addrinfo() */
+	memset(&hints, '\0', sizeof(struct addrinfo));
+	hints.ai_family = udp_p->family;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_protocol = IPPROTO_UDP;
+
+	/* Get the address information */
+	err = getaddrinfo(udp_p->dst_name, udp_p->dst_port, &hints, &res);
+	if (err) {
+		fprintf(stderr, "getaddrinfo(): %s\n", gai_strerror(err));
+		exit(EXIT_FAILURE);
+	}
+	if (res->ai_next) {
+		fprintf(stderr, "getaddrinfo(): multiple address is found.");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Store addrinfo, the address is owned by res */
+	memcpy(&(udp_p->addr_info), res, sizeof(struct addrinfo));
+	memcpy(&(udp_p->addr), res->ai_addr, res->ai_addrlen);
+	udp_p->addr_info.ai_addr = (struct sockaddr *)&(udp_p->addr);
+	udp_p->addr_info.ai_canonname = NULL;
+	udp_p->addr_info.ai_next = NULL;
+	freeaddrinfo(res);
+
+	/* Threads open their own sockets */
+	if (udp_p->high_rate)
+		return;
+
+	udp_p->sd = open_udp_socket(udp_p);
+
 	/* Make the payload */
 	udp_p->msg = malloc(udp_p->msgsize);
 	if (udp_p->msg == NULL) {
@@ -357,10 +505,29 @@ void create_udp_datagram(struct udp_info *udp_p)
 		exit(EXIT_FAILURE);
 	}
 	fill_payload(udp_p->msg, udp_p->msgsize);
+}
 
-	/* Store addrinfo */
-	memcpy(&(udp_p->addr_info), res, sizeof(struct addrinfo));
-	freeaddrinfo(res);
+/*
+ * Function: set_sighup_handler()
+ *
+ * Description:
+ *  This function sets the signal handler for SIGHUP
+ *
+ * Argument:
+ *  None
+ *
+ * Return value:
+ *  None
+ */
+void set_sighup_handler(void)
+{
+	/* Set singal hander for SIGHUP */
+	handler.sa_handler = set_signal_flag;
+	handler.sa_flags = 0;
+	if (sigfillset(&handler.sa_mask) < 0)
+		fatal_error("sigfillset()");
+	if (sigaction(SIGHUP, &handler, NULL) < 0)
+		fatal_error("sigaction()");
 }
 
 /*
@@ -380,13 +547,7 @@ void send_udp_datagram(struct udp_info *udp_p)
 	int retval;
 	double start_time;
 
-	/* Set singal hander for SIGHUP */
-	handler.sa_handler = set_signal_flag;
-	handler.sa_flags = 0;
-	if (sigfillset(&handler.sa_mask) < 0)
-		fatal_error("sigfillset()");
-	if (sigaction(SIGHUP, &handler, NULL) < 0)
-		fatal_error("sigaction()");
+	set_sighup_handler();
 
 	/*
 	 * loop for sending packets
@@ -418,6 +579,327 @@ void send_udp_datagram(struct udp_info *udp_p)
 	close(udp_p->sd);
 }
 
+/*
+ * Function: bind_thread_to_cpu()
+ *
+ * Description:
+ *  This function binds the calling thread to the specified CPU
+ *
+ * Argument:
+ *  cpu: CPU number, negative value means no binding
+ *
+ * Return value:
+ *  None
+ */
+void bind_thread_to_cpu(int cpu)
+{
+	cpu_set_t mask;
+
+	if (cpu < 0)
+		return;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	errno = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+	if (errno)
+		fatal_error("pthread_setaffinity_np()");
+}
+
+/*
+ * Function: drain_zerocopy_completions()
+ *
+ * Description:
+ *  This function reads MSG_ZEROCOPY completion notifications from the
+ *  socket error queue. The payload is never modified, so the completions
+ *  are only read to release the socket option memory they hold.
+ *
+ * Argument:
+ *  sd: socket descriptor
+ *
+ * Return value:
+ *  None
+ */
+void drain_zerocopy_completions(int sd)
+{
+	char control[128];
+	struct msghdr msg;
+
+	do {
+		memset(&msg, '\0', sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+	} while (recvmsg(sd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0);
+}
+
+/*
+ * Function: udp_sender_thread()
+ *
+ * Description:
+ *  This function sends batches of datagrams with sendmmsg() on its own
+ *  socket until stop_threads is set, each message is split into gso_segs
+ *  datagrams by UDP GSO.
+ *
+ * Argument:
+ *  arg: pointer to the udp_thread structure
+ *
+ * Return value:
+ *  NULL
+ */
+void *udp_sender_thread(void *arg)
+{
+	struct udp_thread *t = arg;
+	struct udp_info *udp_p = t->udp_p;
+	size_t bufsize = udp_p->msgsize * udp_p->gso_segs;
+	struct mmsghdr *msgs;
+	struct iovec iov;
+	unsigned char *buf;
+	unsigned int calls = 0;
+	int flags = 0;
+	int sd, on = 1, i, ret;
+
+	bind_thread_to_cpu(t->cpu);
+	sd = open_udp_socket(udp_p);
+
+	if (udp_p->gso_segs > 1) {
+		int segsize = udp_p->msgsize;
+
+		if (setsockopt(sd, SOL_UDP, UDP_SEGMENT, &segsize, sizeof(int)))
+			fatal_error("setsockopt(UDP_SEGMENT)");
+	}
+
+	if (udp_p->zerocopy) {
+		if (setsockopt(sd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(int)))
+			fatal_error("setsockopt(SO_ZEROCOPY)");
+		flags |= MSG_ZEROCOPY;
+	}
+
+	buf = malloc(bufsize);
+	msgs = calloc(udp_p->batch, sizeof(struct mmsghdr));
+	if (buf == NULL || msgs == NULL)
+		fatal_error("malloc()");
+	fill_payload(buf, bufsize);
+
+	iov.iov_base = buf;
+	iov.iov_len = bufsize;
+
+	for (i = 0; i < udp_p->batch; i++) {
+		msgs[i].msg_hdr.msg_name = udp_p->addr_info.ai_addr;
+		msgs[i].msg_hdr.msg_namelen = udp_p->addr_info.ai_addrlen;
+		msgs[i].msg_hdr.msg_iov = &iov;
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do {
+		ret = sendmmsg(sd, msgs, udp_p->batch, flags);
+		if (ret < 0) {
+			if (errno == ENOBUFS && udp_p->zerocopy)
+				drain_zerocopy_completions(sd);
+			else if (errno != EINTR && errno != ENOBUFS &&
+				 errno != EAGAIN && errno != ECONNREFUSED)
+				fatal_error("sendmmsg()");
+			continue;
+		}
+
+		t->packets += (unsigned long long)ret * udp_p->gso_segs;
+		t->bytes += (unsigned long long)ret * bufsize;
+
+		if (udp_p->zerocopy && !(++calls % ZEROCOPY_DRAIN_INTERVAL))
+			drain_zerocopy_completions(sd);
+	} while (!stop_threads && udp_p->timeout >= 0);
+
+	if (udp_p->zerocopy)
+		drain_zerocopy_completions(sd);
+
+	close(sd);
+	free(msgs);
+	free(buf);
+
+	return NULL;
+}
+
+/*
+ * Function: udp_receiver_thread()
+ *
+ * Description:
+ *  This function receives batches of datagrams with recvmmsg() on its own
+ *  SO_REUSEPORT socket until stop_threads is set. With UDP GRO enabled
+ *  the number of datagrams is computed from the segment size reported by
+ *  the kernel.
+ *
+ * Argument:
+ *  arg: pointer to the udp_thread structure
+ *
+ * Return value:
+ *  NULL
+ */
+void *udp_receiver_thread(void *arg)
+{
+	struct udp_thread *t = arg;
+	struct udp_info *udp_p = t->udp_p;
+	struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+	struct cmsghdr *cmsg;
+	unsigned char *buf;
+	char *control;
+	size_t ctlsize = CMSG_SPACE(sizeof(int));
+	int sd, on = 1, i, ret, gso_size;
+
+	bind_thread_to_cpu(t->cpu);
+	sd = open_udp_socket(udp_p);
+
+	/* Wake up periodically to check stop_threads */
+	if (setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)))
+		fatal_error("setsockopt(SO_RCVTIMEO)");
+
+	if (udp_p->gso_segs > 1) {
+		if (setsockopt(sd, SOL_UDP, UDP_GRO, &on, sizeof(int)))
+			fatal_error("setsockopt(UDP_GRO)");
+	}
+
+	buf = malloc((size_t)udp_p->batch * UDP_RECV_BUFSIZE);
+	control = calloc(udp_p->batch, ctlsize);
+	iov = calloc(udp_p->batch, sizeof(struct iovec));
+	msgs = calloc(udp_p->batch, sizeof(struct mmsghdr));
+	if (buf == NULL || control == NULL || iov == NULL || msgs == NULL)
+		fatal_error("malloc()");
+
+	for (i = 0; i < udp_p->batch; i++) {
+		iov[i].iov_base = buf + (size_t)i * UDP_RECV_BUFSIZE;
+		iov[i].iov_len = UDP_RECV_BUFSIZE;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	while (!stop_threads) {
+		for (i = 0; i < udp_p->batch; i++) {
+			msgs[i].msg_hdr.msg_control = control + i * ctlsize;
+			msgs[i].msg_hdr.msg_controllen = ctlsize;
+		}
+
+		ret = recvmmsg(sd, msgs, udp_p->batch, MSG_WAITFORONE, NULL);
+		if (ret < 0) {
+			if (errno != EINTR && errno != EAGAIN)
+				fatal_error("recvmmsg()");
+			continue;
+		}
+
+		for (i = 0; i < ret; i++) {
+			gso_size = 0;
+
+			for (cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg;
+			     cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+				if (cmsg->cmsg_level == SOL_UDP &&
+				    cmsg->cmsg_type == UDP_GRO)
+					memcpy(&gso_size, CMSG_DATA(cmsg),
+					       sizeof(int));
+			}
+
+			if (gso_size > 0)
+				t->packets += (msgs[i].msg_len + gso_size - 1)
+					/ gso_size;
+			else
+				t->packets++;
+
+			t->bytes += msgs[i].msg_len;
+		}
+	}
+
+	close(sd);
+	free(msgs);
+	free(iov);
+	free(control);
+	free(buf);
+
+	return NULL;
+}
+
+/*
+ * Function: run_udp_threads()
+ *
+ * Description:
+ *  This function runs the sender (or receiver) threads until the timeout
+ *  expires or SIGHUP is caught, then reports the achieved rate.
+ *
+ * Argument:
+ *  udp_p: pointer to the udp data structure
+ *
+ * Return value:
+ *  None
+ */
+void run_udp_threads(struct udp_info *udp_p)
+{
+	struct udp_thread *threads;
+	struct timespec start, now, tick = { 0, 100000000 };
+	unsigned long long packets = 0, bytes = 0;
+	cpu_set_t mask;
+	double elapsed;
+	int nthreads = udp_p->threads;
+	int cpu = -1, i;
+
+	set_sighup_handler();
+
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		fatal_error("sched_getaffinity()");
+
+	/* Zero threads means one thread bound to each CPU */
+	if (nthreads == 0)
+		nthreads = CPU_COUNT(&mask);
+
+	threads = calloc(nthreads, sizeof(struct udp_thread));
+	if (threads == NULL)
+		fatal_error("calloc()");
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < nthreads; i++) {
+		threads[i].udp_p = udp_p;
+		threads[i].cpu = -1;
+
+		if (udp_p->threads == 0) {
+			while (!CPU_ISSET(++cpu, &mask))
+				;
+			threads[i].cpu = cpu;
+		}
+
+		errno = pthread_create(&threads[i].id, NULL,
+				       udp_p->receiver ? udp_receiver_thread
+				       : udp_sender_thread, &threads[i]);
+		if (errno)
+			fatal_error("pthread_create()");
+	}
+
+	/* Negative timeout means that each sender sends only one batch */
+	do {
+		if (udp_p->timeout < 0 || catch_sighup)
+			break;
+
+		nanosleep(&tick, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (now.tv_sec - start.tv_sec) +
+			(now.tv_nsec - start.tv_nsec) / 1e9;
+	} while (!udp_p->timeout || elapsed < udp_p->timeout);
+
+	stop_threads = 1;
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i].id, NULL);
+		packets += threads[i].packets;
+		bytes += threads[i].bytes;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed = (now.tv_sec - start.tv_sec) +
+		(now.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%s %llu datagrams (%llu bytes) in %.3f sec with %d threads: "
+	       "%.0f pps, %.2f Mbit/s\n",
+	       udp_p->receiver ? "received" : "sent", packets, bytes, elapsed,
+	       nthreads, packets / elapsed, bytes * 8 / elapsed / 1e6);
+
+	free(threads);
+}
+
 /*
  *
  *  Function: main()
@@ -432,6 +914,9 @@ int main(int argc, char *argv[])
 	program_name = strdup(argv[0]);
 
 	memset(&udp_data, '\0', sizeof(struct udp_info));
+	udp_data.batch = 1;
+	udp_data.gso_segs = 1;
+	udp_data.threads = 1;
 	parse_options(argc, argv, &udp_data, &background);
 
 	create_udp_datagram(&udp_data);
@@ -440,7 +925,10 @@ int main(int argc, char *argv[])
 		if (daemon(0, 0) < 0)
 			fatal_error("daemon()");
 
-	send_udp_datagram(&udp_data);
+	if (udp_data.high_rate)
+		run_udp_threads(&udp_data);
+	else
+		send_udp_datagram(&udp_data);
 
 	exit(EXIT_SUCCESS);
 }
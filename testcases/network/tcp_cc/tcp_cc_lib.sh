@@ -93,15 +93,13 @@ tcp_cc_test01()
 
 	set_cong_alg "$def_alg"
 
-	tst_netload -H $(tst_ipaddr rhost) -A $TST_NET_MAX_PKT
-	local res0="$(cat tst_netload.res)"
+	tst_netload -H $(tst_ipaddr rhost) -A $TST_NET_MAX_PKT -c res0
 
 	set_cong_alg "$alg"
 
-	tst_netload -H $(tst_ipaddr rhost) -A $TST_NET_MAX_PKT
-	local res1="$(cat tst_netload.res)"
+	tst_netload -H $(tst_ipaddr rhost) -A $TST_NET_MAX_PKT -c res1
 
-	tst_netload_compare $res0 $res1 $threshold
+	tst_netload_compare res0 res1 $threshold
 }
 
 . tst_net.sh
@@ -43,14 +43,12 @@ setup()
 test1()
 {
 	tst_res TINFO "using old TCP API and set tcp_fastopen to '0'"
-	tst_netload -H $(tst_ipaddr rhost) -t 0 -R $srv_replies
-	time_tfo_off=$(cat tst_netload.res)
+	tst_netload -H $(tst_ipaddr rhost) -t 0 -R $srv_replies -c res_tfo_off
 
 	tst_res TINFO "using new TCP API and set tcp_fastopen to '3'"
-	tst_netload -H $(tst_ipaddr rhost) -f -t 3 -R $srv_replies
-	time_tfo_on=$(cat tst_netload.res)
+	tst_netload -H $(tst_ipaddr rhost) -f -t 3 -R $srv_replies -c res_tfo_on
 
-	tst_netload_compare $time_tfo_off $time_tfo_on 3
+	tst_netload_compare res_tfo_off res_tfo_on 3
 }
 
 test2()
@@ -59,10 +57,9 @@ test2()
 		tst_brk TCONF "next test must be run with kernel 4.11 or newer"
 
 	tst_res TINFO "using connect() and TCP_FASTOPEN_CONNECT socket option"
-	tst_netload -H $(tst_ipaddr rhost) -F -t 3 -R $srv_replies
-	time_tfo_on=$(cat tst_netload.res)
+	tst_netload -H $(tst_ipaddr rhost) -F -t 3 -R $srv_replies -c res_tfo_on
 
-	tst_netload_compare $time_tfo_off $time_tfo_on 3
+	tst_netload_compare res_tfo_off res_tfo_on 3
 }
 
 . tst_net.sh
@@ -296,8 +296,8 @@ virt_compare_netperf()
 	local lt="$(cat res_lan)"
 	tst_res TINFO "time lan IPv${TST_IPVER}($lt) $virt_type IPv4($vt) and IPv6($vt6) ms"
 
-	tst_netload_compare $lt $vt "-$VIRT_PERF_THRESHOLD"
-	tst_netload_compare $lt $vt6 "-$VIRT_PERF_THRESHOLD"
+	tst_netload_compare res_lan res_ipv4 "-$VIRT_PERF_THRESHOLD"
+	tst_netload_compare res_lan res_ipv6 "-$VIRT_PERF_THRESHOLD"
 }
 
 virt_check_cmd()
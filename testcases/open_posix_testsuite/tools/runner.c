@@ -0,0 +1,771 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ *
+ * Parallel replacement for bin/run-tests.sh and bin/t0.
+ *
+ * The syntax is:
+ * $ ./runner [-j jobs] [-t timeout] [-l logfile] [-o results] [dir...]
+ *  where jobs is the number of tests executed in parallel (number of CPUs
+ *        by default),
+ *        timeout is the timeout for a single test in seconds ($TIMEOUT_VAL
+ *        or 300 by default),
+ *        logfile is the file the output of failed tests is appended to
+ *        ($LOGFILE or logfile by default),
+ *        results is the file the JSON results are written to
+ *        (results.json by default),
+ *        dir are the directories searched for built tests (conformance,
+ *        functional and stress by default).
+ *
+ * Tests are the INSTALL_TARGETS of the generated Makefiles or the tests
+ * listed in run.sh in an installed tree, each of them is executed in its
+ * directory with arguments read from the <test>.args file, after sourcing
+ * test_defs if present, and the exit codes are interpreted the same way as
+ * in run-tests.sh.
+ * Tests from the same directory exercise the same interface and may use
+ * the same resources (queue and semaphore names, signals, files), so they
+ * are never executed concurrently. Tests from directories that change
+ * process-wide or system-wide state (the realtime clock, scheduling
+ * policies, locked memory, signals sent to the whole process group) and the
+ * stress tests are executed alone, nothing else runs while they do.
+ * Timeouts are detected by polling the
+ * pidfds of the running tests, a test which times out is killed together
+ * with its process group.
+ */
+
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <ftw.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef __NR_pidfd_open
+# define __NR_pidfd_open 434
+#endif
+
+#define MAX_ARGS 64
+
+enum result {
+	RES_PASS,
+	RES_FAILED,
+	RES_UNRESOLVED,
+	RES_UNSUPPORTED,
+	RES_UNTESTED,
+	RES_HUNG,
+	RES_SIGNALED,
+	RES_ABNORMAL,
+	RES_MAX,
+};
+
+static const char *const result_names[RES_MAX] = {
+	[RES_PASS] = "PASS",
+	[RES_FAILED] = "FAILED",
+	[RES_UNRESOLVED] = "UNRESOLVED",
+	[RES_UNSUPPORTED] = "UNSUPPORTED",
+	[RES_UNTESTED] = "UNTESTED",
+	[RES_HUNG] = "HUNG",
+	[RES_SIGNALED] = "SIGNALED",
+	[RES_ABNORMAL] = "EXITED ABNORMALLY",
+};
+
+struct test_dir {
+	char *path;
+	int busy;
+	int exclusive;
+};
+
+struct test {
+	char *path;
+	struct test_dir *dir;
+	pid_t pid;
+	int pidfd;
+	FILE *out;
+	int done;
+	int ret;
+	enum result res;
+	struct timespec start;
+	double duration;
+};
+
+static struct test *tests;
+static unsigned int tests_used, tests_size;
+
+static struct test_dir *dirs;
+static unsigned int dirs_used;
+
+/*
+ * Directories whose tests must not overlap with any other test. The
+ * clock_settime tests move CLOCK_REALTIME under the timer_*, nanosleep,
+ * clock_nanosleep and timed wait tests. The sched_* tests switch to
+ * SCHED_FIFO or SCHED_RR and starve the other tests. The mlockall tests pin
+ * all their memory. The killpg tests signal their process group, which is
+ * shared with the runner. The stress tests use up resources by design.
+ */
+static const char *const exclusive_dirs[] = {
+	"*/interfaces/clock_settime*",
+	"*/functional/timers/clocks",
+	"*/interfaces/sched_rr_get_interval",
+	"*/interfaces/sched_setparam",
+	"*/interfaces/sched_setscheduler",
+	"*/interfaces/sched_yield",
+	"*/interfaces/mlockall*",
+	"*/interfaces/killpg",
+	"stress/*",
+	"*/stress/*",
+	NULL,
+};
+
+static int is_exclusive(const char *path)
+{
+	unsigned int i;
+
+	for (i = 0; exclusive_dirs[i]; i++) {
+		if (!fnmatch(exclusive_dirs[i], path, 0))
+			return 1;
+	}
+
+	return 0;
+}
+
+static int timeout = 300;
+
+/*
+ * Exit value of a hung test, the same as TIMEOUT_RET in run-tests.sh, tests
+ * that exit with this value are reported as hung as well.
+ */
+static int timeout_ret = SIGALRM + 128;
+
+static void *xrealloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size);
+	if (!ptr) {
+		perror("realloc failed");
+		exit(1);
+	}
+
+	return ptr;
+}
+
+static void add_test(const char *dir, const char *name)
+{
+	struct stat st;
+	char *path;
+
+	if (asprintf(&path, "%s/%s", dir, name) < 0) {
+		perror("asprintf failed");
+		exit(1);
+	}
+
+	/* Tests that failed to build are listed as well */
+	if (stat(path, &st) || !S_ISREG(st.st_mode) || !(st.st_mode & S_IXUSR)) {
+		free(path);
+		return;
+	}
+
+	if (tests_used >= tests_size) {
+		tests_size = tests_size ? 2 * tests_size : 1024;
+		tests = xrealloc(tests, tests_size * sizeof(*tests));
+	}
+
+	memset(&tests[tests_used], 0, sizeof(*tests));
+	tests[tests_used].path = path;
+	tests[tests_used].pidfd = -1;
+	tests_used++;
+}
+
+/*
+ * Adds the tests listed after the prefix on the matching lines of the file.
+ * In run.sh the list follows the run-tests.sh path and the directory name,
+ * in the Makefile it is the INSTALL_TARGETS variable.
+ */
+static void read_test_list(const char *dir, const char *file,
+			   const char *prefix, int skip)
+{
+	char *path, *line = NULL, *tok;
+	size_t size = 0;
+	FILE *f;
+	int i;
+
+	if (asprintf(&path, "%s/%s", dir, file) < 0) {
+		perror("asprintf failed");
+		exit(1);
+	}
+
+	f = fopen(path, "r");
+	free(path);
+	if (!f)
+		return;
+
+	while (getline(&line, &size, f) > 0) {
+		if (line[0] == '#' || strncmp(line, prefix, strlen(prefix)))
+			continue;
+
+		tok = strtok(line + strlen(prefix), " \t\n");
+		for (i = 0; tok; tok = strtok(NULL, " \t\n"), i++) {
+			if (i >= skip && !strchr(tok, '$'))
+				add_test(dir, tok);
+		}
+	}
+
+	free(line);
+	fclose(f);
+}
+
+/*
+ * The tests are the INSTALL_TARGETS of the generated Makefiles. These are
+ * written into run.sh on install, which is used when there is no Makefile.
+ * Helper scripts such as run.sh itself are never picked up this way.
+ */
+static int add_dir(const char *path, const struct stat *st, int flag,
+		   struct FTW *ftw)
+{
+	char *makefile;
+	int has_makefile;
+
+	(void)st;
+	(void)ftw;
+
+	if (flag != FTW_D)
+		return 0;
+
+	if (asprintf(&makefile, "%s/Makefile", path) < 0) {
+		perror("asprintf failed");
+		exit(1);
+	}
+
+	has_makefile = !access(makefile, R_OK);
+	free(makefile);
+
+	if (has_makefile)
+		read_test_list(path, "Makefile", "INSTALL_TARGETS+=", 0);
+	else
+		read_test_list(path, "run.sh", "", 2);
+
+	return 0;
+}
+
+static int test_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct test *)a)->path,
+		      ((const struct test *)b)->path);
+}
+
+/* Tests are sorted, tests from one directory are next to each other */
+static void assign_dirs(void)
+{
+	unsigned int i;
+	size_t len;
+	char *path;
+
+	dirs = xrealloc(NULL, (tests_used + 1) * sizeof(*dirs));
+
+	for (i = 0; i < tests_used; i++) {
+		path = strdup(tests[i].path);
+		len = strrchr(path, '/') - path;
+		path[len] = 0;
+
+		if (!dirs_used || strcmp(dirs[dirs_used - 1].path, path)) {
+			dirs[dirs_used].path = path;
+			dirs[dirs_used].busy = 0;
+			dirs[dirs_used].exclusive = is_exclusive(path);
+			dirs_used++;
+		} else {
+			free(path);
+		}
+
+		tests[i].dir = &dirs[dirs_used - 1];
+	}
+}
+
+/* Reads <test>.args, the name is the file name up to the first dot */
+static void read_args(const char *name, char *argv[], char *buf, size_t size)
+{
+	char *args_path, *tok;
+	size_t len;
+	int argc = 1;
+	FILE *f;
+
+	argv[1] = NULL;
+
+	len = strcspn(name, ".");
+	if (asprintf(&args_path, "%.*s.args", (int)len, name) < 0)
+		return;
+
+	f = fopen(args_path, "r");
+	free(args_path);
+	if (!f)
+		return;
+
+	len = fread(buf, 1, size - 1, f);
+	buf[len] = 0;
+	fclose(f);
+
+	for (tok = strtok(buf, " \t\n"); tok && argc < MAX_ARGS - 1;
+	     tok = strtok(NULL, " \t\n"))
+		argv[argc++] = tok;
+
+	argv[argc] = NULL;
+}
+
+static void exec_test(struct test *t)
+{
+	char *argv[MAX_ARGS + 3], buf[4096], *name, *test;
+	int fd = fileno(t->out);
+
+	setpgid(0, 0);
+
+	if (chdir(t->dir->path)) {
+		fprintf(stderr, "chdir(%s) failed: %s\n", t->dir->path,
+			strerror(errno));
+		exit(1);
+	}
+
+	dup2(fd, STDOUT_FILENO);
+	dup2(fd, STDERR_FILENO);
+	close(fd);
+
+	name = strrchr(t->path, '/') + 1;
+	if (asprintf(&test, "./%s", name) < 0)
+		exit(1);
+
+	read_args(name, argv + 3, buf, sizeof(buf));
+	argv[3] = test;
+
+	/*
+	 * SIGINT stays ignored as with trap '' INT in run-tests.sh, ^C must
+	 * not kill the tests (and the process group) behind the runner's back.
+	 */
+	/* Same as in run-tests.sh the environment may be set in test_defs */
+	if (!access("test_defs", F_OK)) {
+		argv[0] = "sh";
+		argv[1] = "-c";
+		argv[2] = ". ./test_defs || exit $?; exec \"$0\" \"$@\"";
+		execv("/bin/sh", argv);
+	} else {
+		execv(test, argv + 3);
+	}
+
+	perror("execv failed");
+	exit(1);
+}
+
+static void start_test(struct test *t)
+{
+	t->out = tmpfile();
+	if (!t->out) {
+		perror("tmpfile failed");
+		exit(1);
+	}
+
+	fcntl(fileno(t->out), F_SETFD, FD_CLOEXEC);
+
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &t->start);
+
+	t->pid = fork();
+	if (t->pid < 0) {
+		perror("fork failed");
+		exit(1);
+	}
+
+	if (!t->pid)
+		exec_test(t);
+
+	/* Avoid race with the child calling setpgid() */
+	setpgid(t->pid, t->pid);
+
+	t->pidfd = syscall(__NR_pidfd_open, t->pid, 0);
+	t->dir->busy = 1;
+}
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) +
+		(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Reads bin/t0.val or measures the value by running 't0 0', which emulates a
+ * timeout, the same way as run-tests.sh does.
+ */
+static void init_timeout_ret(void)
+{
+	char dir[PATH_MAX], path[PATH_MAX + 8];
+	ssize_t len;
+	pid_t pid;
+	int status, fd;
+	FILE *f;
+
+	len = readlink("/proc/self/exe", dir, sizeof(dir) - 1);
+	if (len < 0)
+		return;
+
+	dir[len] = 0;
+	*strrchr(dir, '/') = 0;
+
+	snprintf(path, sizeof(path), "%s/t0.val", dir);
+	f = fopen(path, "r");
+	if (f) {
+		if (fscanf(f, "%i", &timeout_ret) != 1)
+			timeout_ret = SIGALRM + 128;
+		fclose(f);
+		return;
+	}
+
+	snprintf(path, sizeof(path), "%s/t0", dir);
+	if (access(path, X_OK))
+		return;
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork failed");
+		exit(1);
+	}
+
+	if (!pid) {
+		fd = open("/dev/null", O_WRONLY);
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		execl(path, path, "0", NULL);
+		exit(1);
+	}
+
+	if (waitpid(pid, &status, 0) != pid)
+		return;
+
+	if (WIFEXITED(status))
+		timeout_ret = WEXITSTATUS(status);
+	else if (WIFSIGNALED(status))
+		timeout_ret = WTERMSIG(status) + 128;
+}
+
+static enum result map_result(int ret)
+{
+
+	switch (ret) {
+	case 0:
+		return RES_PASS;
+	case 1:
+		return RES_FAILED;
+	case 2:
+		return RES_UNRESOLVED;
+	case 4:
+		return RES_UNSUPPORTED;
+	case 5:
+		return RES_UNTESTED;
+	default:
+		if (ret == timeout_ret)
+			return RES_HUNG;
+
+		return ret > 128 ? RES_SIGNALED : RES_ABNORMAL;
+	}
+}
+
+static void log_output(FILE *log, struct test *t)
+{
+	char buf[4096];
+	size_t len;
+
+	rewind(t->out);
+
+	while ((len = fread(buf, 1, sizeof(buf), t->out)))
+		fwrite(buf, 1, len, log);
+}
+
+static void finish_test(struct test *t, int status, int hung, FILE *log)
+{
+	if (hung) {
+		t->ret = timeout_ret;
+		t->res = RES_HUNG;
+	} else {
+		if (WIFEXITED(status))
+			t->ret = WEXITSTATUS(status);
+		else
+			t->ret = WTERMSIG(status) + 128;
+
+		t->res = map_result(t->ret);
+	}
+
+	t->duration = elapsed(&t->start);
+	t->done = 1;
+	t->dir->busy = 0;
+
+	if (t->pidfd != -1)
+		close(t->pidfd);
+
+	if (t->res == RES_PASS) {
+		fprintf(log, "%.*s: execution: PASS\n",
+			(int)(strrchr(t->path, '.') - t->path), t->path);
+	} else {
+		fprintf(log, "%.*s: execution: %s: Output: \n",
+			(int)(strrchr(t->path, '.') - t->path), t->path,
+			result_names[t->res]);
+		log_output(log, t);
+		printf("%.*s: execution: %s \n",
+		       (int)(strrchr(t->path, '.') - t->path), t->path,
+		       result_names[t->res]);
+	}
+
+	fflush(log);
+	fclose(t->out);
+}
+
+/*
+ * Waits for at least one of the running tests to finish or to time out.
+ * Without pidfd support the tests are polled every 100ms.
+ */
+static void reap_tests(struct test **running, unsigned int *nr_running,
+		       FILE *log)
+{
+	struct pollfd pfds[*nr_running];
+	unsigned int i, n = 0;
+	int status, wait_ms = -1, left, use_pidfd = 1;
+	struct test *t;
+
+	for (i = 0; i < *nr_running; i++) {
+		t = running[i];
+		left = (timeout - elapsed(&t->start)) * 1000;
+
+		if (left < 0)
+			left = 0;
+
+		if (wait_ms < 0 || left < wait_ms)
+			wait_ms = left;
+
+		if (t->pidfd == -1)
+			use_pidfd = 0;
+
+		pfds[n].fd = t->pidfd;
+		pfds[n].events = POLLIN;
+		n++;
+	}
+
+	if (!use_pidfd && wait_ms > 100)
+		wait_ms = 100;
+
+	if (use_pidfd && poll(pfds, n, wait_ms) < 0 && errno != EINTR) {
+		perror("poll failed");
+		exit(1);
+	} else if (!use_pidfd) {
+		usleep(wait_ms * 1000);
+	}
+
+	for (i = 0; i < *nr_running; ) {
+		t = running[i];
+
+		if (waitpid(t->pid, &status, WNOHANG) == t->pid) {
+			finish_test(t, status, 0, log);
+		} else if (elapsed(&t->start) >= timeout) {
+			kill(-t->pid, SIGKILL);
+			waitpid(t->pid, &status, 0);
+			finish_test(t, status, 1, log);
+		} else {
+			i++;
+			continue;
+		}
+
+		running[i] = running[--(*nr_running)];
+	}
+}
+
+static void run_tests(unsigned int jobs, FILE *log)
+{
+	struct test *running[jobs];
+	unsigned int nr_running = 0, next = 0, i;
+
+	for (;;) {
+		/*
+		 * Start tests whose directory is idle, in order. An exclusive
+		 * test waits until all running tests finish and nothing is
+		 * started past it, so that it is not starved.
+		 */
+		for (i = next; i < tests_used && nr_running < jobs; i++) {
+			if (tests[i].done || tests[i].pid || tests[i].dir->busy)
+				continue;
+
+			if (nr_running && (tests[i].dir->exclusive ||
+			    running[0]->dir->exclusive))
+				break;
+
+			start_test(&tests[i]);
+			running[nr_running++] = &tests[i];
+		}
+
+		while (next < tests_used && tests[next].pid)
+			next++;
+
+		if (!nr_running)
+			break;
+
+		reap_tests(running, &nr_running, log);
+	}
+}
+
+static void json_str(FILE *f, const char *str)
+{
+	fputc('"', f);
+
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fputc('\\', f);
+
+		if ((unsigned char)*str < 0x20)
+			fprintf(f, "\\u%04x", *str);
+		else
+			fputc(*str, f);
+	}
+
+	fputc('"', f);
+}
+
+static void write_results(const char *path, double duration,
+			  unsigned int counts[RES_MAX])
+{
+	FILE *f = fopen(path, "w");
+	unsigned int i;
+
+	if (!f) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return;
+	}
+
+	fprintf(f, "{\n \"duration\": %.3f,\n \"summary\": {", duration);
+	for (i = 0; i < RES_MAX; i++) {
+		fprintf(f, "%s\n  ", i ? "," : "");
+		json_str(f, result_names[i]);
+		fprintf(f, ": %u", counts[i]);
+	}
+	fprintf(f, "\n },\n \"tests\": [");
+
+	for (i = 0; i < tests_used; i++) {
+		fprintf(f, "%s\n  {\"test\": ", i ? "," : "");
+		json_str(f, tests[i].path);
+		fprintf(f, ", \"result\": ");
+		json_str(f, result_names[tests[i].res]);
+		fprintf(f, ", \"exit\": %i, \"duration\": %.3f}",
+			tests[i].ret, tests[i].duration);
+	}
+
+	fprintf(f, "\n ]\n}\n");
+	fclose(f);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-j jobs] [-t timeout] [-l logfile] "
+		"[-o results] [dir...]\n", name);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	static char *default_dirs[] = {"conformance", "functional", "stress", NULL};
+	const char *logfile = getenv("LOGFILE"), *results = "results.json";
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int counts[RES_MAX] = {0}, i;
+	char **search_dirs;
+	struct timespec start;
+	int opt;
+	FILE *log;
+
+	if (getenv("TIMEOUT_VAL"))
+		timeout = atoi(getenv("TIMEOUT_VAL"));
+
+	if (!logfile)
+		logfile = "logfile";
+
+	while ((opt = getopt(argc, argv, "j:l:o:t:")) != -1) {
+		switch (opt) {
+		case 'j':
+			jobs = atol(optarg);
+		break;
+		case 'l':
+			logfile = optarg;
+		break;
+		case 'o':
+			results = optarg;
+		break;
+		case 't':
+			timeout = atoi(optarg);
+		break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (jobs < 1)
+		jobs = 1;
+
+	if (timeout < 1) {
+		fprintf(stderr, "Invalid timeout value %i, timeout must be a positive integer.\n",
+			timeout);
+		exit(1);
+	}
+
+	search_dirs = optind < argc ? argv + optind : default_dirs;
+
+	init_timeout_ret();
+
+	for (i = 0; search_dirs[i]; i++) {
+		if (nftw(search_dirs[i], add_dir, 64, FTW_PHYS) && errno != ENOENT) {
+			fprintf(stderr, "Failed to walk %s: %s\n", search_dirs[i],
+				strerror(errno));
+			exit(1);
+		}
+	}
+
+	if (!tests_used) {
+		fprintf(stderr, "No tests found, have been the tests compiled?\n");
+		exit(1);
+	}
+
+	qsort(tests, tests_used, sizeof(*tests), test_cmp);
+	assign_dirs();
+
+	log = fopen(logfile, "ae");
+	if (!log) {
+		fprintf(stderr, "ERROR: %s not writable\n", logfile);
+		exit(1);
+	}
+
+	signal(SIGINT, SIG_IGN);
+
+	printf("Running %u tests in %u directories, %li jobs\n",
+	       tests_used, dirs_used, jobs);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	run_tests(jobs, log);
+	fclose(log);
+
+	for (i = 0; i < tests_used; i++)
+		counts[tests[i].res]++;
+
+	write_results(results, elapsed(&start), counts);
+
+	printf("*******************\n");
+	for (i = 0; i < RES_MAX; i++) {
+		if (i == RES_PASS || counts[i])
+			printf("%-16s%3u\n", result_names[i], counts[i]);
+	}
+	printf("*******************\n");
+	printf("%-16s%3u\n", "TOTAL", tests_used);
+	printf("*******************\n");
+
+	return counts[RES_PASS] != tests_used;
+}
@@ -114,15 +114,18 @@ void *signal_thread(void *arg)
 {
 
 	int i;
-	long delta, max, min;
-	stats_container_t dat;
+	long delta;
+	stats_container_t dat = {};
 	stats_container_t hist;
+	stats_hdr_t lat;
 	stats_record_t rec;
 
-	stats_container_init(&dat, iterations);
+	/* raw samples are only needed for the scatter plot */
+	if (save_stats)
+		stats_container_init(&dat, iterations);
 	stats_container_init(&hist, HIST_BUCKETS);
+	stats_hdr_init(&lat);
 
-	min = max = 0;
 	for (i = 0; i < iterations; i++) {
 		/* wait for child to wait on cond, then signal the event */
 		while (atomic_get(&step) != CHILD_WAIT)
@@ -142,30 +145,30 @@ void *signal_thread(void *arg)
 		delta = (long)((end - start) / NS_PER_US);
 		if (delta > pass_criteria)
 			ret = 1;
-		rec.x = i;
-		rec.y = delta;
-		stats_container_append(&dat, rec);
-		if (i == 0)
-			min = max = delta;
-		else {
-			min = MIN(min, delta);
-			max = MAX(max, delta);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = delta;
+			stats_container_append(&dat, rec);
 		}
+		stats_hdr_record(&lat, delta);
 		atomic_set((i == iterations - 1) ? CHILD_QUIT : CHILD_START,
 			   &step);
 	}
 	printf("recording statistics...\n");
-	printf("Min: %ld us\n", min);
-	printf("Max: %ld us\n", max);
-	printf("Avg: %.4f us\n", stats_avg(&dat));
-	printf("StdDev: %.4f us\n", stats_stddev(&dat));
-	stats_hist(&hist, &dat);
+	printf("Min: %ld us\n", stats_hdr_min(&lat));
+	printf("Max: %ld us\n", stats_hdr_max(&lat));
+	printf("Avg: %.4f us\n", stats_hdr_avg(&lat));
+	printf("StdDev: %.4f us\n", stats_hdr_stddev(&lat));
+	stats_hdr_hist(&hist, &lat);
 	stats_container_save("samples",
 			     "Asynchronous Event Handling Latency Scatter Plot",
 			     "Iteration", "Latency (us)", &dat, "points");
 	stats_container_save("hist",
 			     "Asynchronous Event Handling Latency Histogram",
 			     "Latency (us)", "Samples", &hist, "steps");
+	stats_container_free(&dat);
+	stats_container_free(&hist);
+	stats_hdr_free(&lat);
 	printf("signal thread exiting\n");
 
 	return NULL;
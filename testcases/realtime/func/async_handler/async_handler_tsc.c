@@ -130,15 +130,18 @@ void *handler_thread(void *arg)
 void *signal_thread(void *arg)
 {
 	int i;
-	long delta, max, min;
-	stats_container_t dat;
+	long delta;
+	stats_container_t dat = {};
 	stats_container_t hist;
+	stats_hdr_t lat;
 	stats_record_t rec;
 
-	stats_container_init(&dat, ITERATIONS);
+	/* raw samples are only needed for the scatter plot */
+	if (save_stats)
+		stats_container_init(&dat, ITERATIONS);
 	stats_container_init(&hist, HIST_BUCKETS);
+	stats_hdr_init(&lat);
 
-	min = max = 0;
 	for (i = 0; i < ITERATIONS; i++) {
 		/* wait for child to wait on cond, then signal the event */
 		while (atomic_get(&step) != CHILD_WAIT)
@@ -163,30 +166,30 @@ void *signal_thread(void *arg)
 		} else if (delta > 20) {
 			over_20++;
 		}
-		rec.x = i;
-		rec.y = delta;
-		stats_container_append(&dat, rec);
-		if (i == 0)
-			min = max = delta;
-		else {
-			min = MIN(min, delta);
-			max = MAX(max, delta);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = delta;
+			stats_container_append(&dat, rec);
 		}
+		stats_hdr_record(&lat, delta);
 		atomic_set((i == ITERATIONS - 1) ? CHILD_QUIT : CHILD_START,
 			   &step);
 	}
 	printf("recording statistics...\n");
-	printf("Minimum: %ld\n", min);
-	printf("Maximum: %ld\n", max);
-	printf("Average: %f\n", stats_avg(&dat));
-	printf("Standard Deviation: %f\n", stats_stddev(&dat));
-	stats_hist(&hist, &dat);
+	printf("Minimum: %ld\n", stats_hdr_min(&lat));
+	printf("Maximum: %ld\n", stats_hdr_max(&lat));
+	printf("Average: %f\n", stats_hdr_avg(&lat));
+	printf("Standard Deviation: %f\n", stats_hdr_stddev(&lat));
+	stats_hdr_hist(&hist, &lat);
 	stats_container_save("samples",
 			     "Asynchronous Event Handling Latency (TSC) Scatter Plot",
 			     "Iteration", "Latency (us)", &dat, "points");
 	stats_container_save("hist",
 			     "Asynchronous Event Handling Latency (TSC) Histogram",
 			     "Latency (us)", "Samples", &hist, "steps");
+	stats_container_free(&dat);
+	stats_container_free(&hist);
+	stats_hdr_free(&lat);
 	printf("signal thread exiting\n");
 
 	return NULL;
@@ -232,6 +232,7 @@ int main(int argc, char *argv[])
 	struct sched_param param;
 	stats_container_t dat;
 	stats_container_t hist;
+	stats_hdr_t lat;
 	stats_quantiles_t quantiles;
 	stats_record_t rec;
 	struct timespec *start_data;
@@ -248,7 +249,12 @@ int main(int argc, char *argv[])
 		       iterations);
 	}
 
-	stats_container_init(&dat, iterations);
+	/* raw samples are only needed for the scatter plot */
+	if (save_stats)
+		stats_container_init(&dat, iterations);
+	else
+		memset(&dat, 0, sizeof(dat));
+	stats_hdr_init(&lat);
 	stats_container_init(&hist, HIST_BUCKETS);
 	stats_quantiles_init(&quantiles, (int)log10(iterations));
 	setup();
@@ -311,9 +317,12 @@ int main(int argc, char *argv[])
 	}
 	for (i = 0; i < iterations; i++) {
 		delta = timespec_subtract(&start_data[i], &stop_data[i]);
-		rec.x = i;
-		rec.y = delta;
-		stats_container_append(&dat, rec);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = delta;
+			stats_container_append(&dat, rec);
+		}
+		stats_hdr_record(&lat, delta);
 		if (i == 0 || delta < min)
 			min = delta;
 		if (delta > max)
@@ -328,11 +337,12 @@ int main(int argc, char *argv[])
 			    ("Latency threshold (%lluus) exceeded at iteration %d\n",
 			     latency_threshold, i);
 			latency_trace_print();
-			stats_container_resize(&dat, i + 1);
+			if (save_stats)
+				stats_container_resize(&dat, i + 1);
 		}
 	}
 
-	stats_hist(&hist, &dat);
+	stats_hdr_hist(&hist, &lat);
 	stats_container_save(filenames[SCATTER_FILENAME], titles[SCATTER_TITLE],
 			     labels[SCATTER_LABELX], labels[SCATTER_LABELY],
 			     &dat, "points");
@@ -343,13 +353,14 @@ int main(int argc, char *argv[])
 	/* report on deltas */
 	printf("Min: %llu ns\n", min);
 	printf("Max: %llu ns\n", max);
-	printf("Avg: %.4f ns\n", stats_avg(&dat));
-	printf("StdDev: %.4f ns\n", stats_stddev(&dat));
+	printf("Avg: %.4f ns\n", stats_hdr_avg(&lat));
+	printf("StdDev: %.4f ns\n", stats_hdr_stddev(&lat));
 	printf("Quantiles:\n");
-	stats_quantiles_calc(&dat, &quantiles);
+	stats_hdr_quantiles_calc(&lat, &quantiles);
 	stats_quantiles_print(&quantiles);
 
 	stats_container_free(&dat);
+	stats_hdr_free(&lat);
 	stats_container_free(&hist);
 	stats_quantiles_free(&quantiles);
 
@@ -59,6 +59,7 @@ static int iterations = DEF_ITERATIONS;
 static int busy_threads;
 
 static stats_container_t dat;
+static stats_hdr_t lat;
 static stats_record_t rec;
 static atomic_t busy_threads_started;
 static unsigned long min_delta;
@@ -136,9 +137,12 @@ void *timer_thread(void *thread)
 		end = rt_gettime();
 		delta_us =
 		    ((unsigned long)(end - start) - DEF_SLEEP_TIME) / NS_PER_US;
-		rec.x = i;
-		rec.y = delta_us;
-		stats_container_append(&dat, rec);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = delta_us;
+			stats_container_append(&dat, rec);
+		}
+		stats_hdr_record(&lat, delta_us);
 		max_delta = MAX(max_delta, delta_us);
 		min_delta = (i == 0) ? delta_us : MIN(min_delta, delta_us);
 	}
@@ -176,10 +180,15 @@ int main(int argc, char *argv[])
 
 	stats_container_t hist;
 	stats_quantiles_t quantiles;
-	if (stats_container_init(&dat, iterations)) {
+	/* raw samples are only needed for the scatter plot */
+	if (save_stats && stats_container_init(&dat, iterations)) {
 		printf("Cannot init stat containers for dat\n");
 		exit(1);
 	}
+	if (stats_hdr_init(&lat)) {
+		printf("Cannot init stat histogram\n");
+		exit(1);
+	}
 	if (stats_container_init(&hist, HIST_BUCKETS)) {
 		printf("Cannot init stat containers for hist\n");
 		exit(1);
@@ -202,8 +211,8 @@ int main(int argc, char *argv[])
 	}
 	join_thread(t_id);
 
-	avg_delta = stats_avg(&dat);
-	stats_hist(&hist, &dat);
+	avg_delta = stats_hdr_avg(&lat);
+	stats_hdr_hist(&hist, &lat);
 	stats_container_save("samples",
 			     "High Resolution Timer Latency Scatter Plot",
 			     "Iteration", "Latency (us)", &dat, "points");
@@ -216,9 +225,9 @@ int main(int argc, char *argv[])
 	printf("Minimum: %ld us\n", min_delta);
 	printf("Maximum: %ld us\n", max_delta);
 	printf("Average: %f us\n", avg_delta);
-	printf("Standard Deviation: %f\n", stats_stddev(&dat));
+	printf("Standard Deviation: %f\n", stats_hdr_stddev(&lat));
 	printf("Quantiles:\n");
-	stats_quantiles_calc(&dat, &quantiles);
+	stats_hdr_quantiles_calc(&lat, &quantiles);
 	stats_quantiles_print(&quantiles);
 	printf("\nCriteria: Maximum wakeup latency < %lu us\n",
 	       (unsigned long)pass_criteria);
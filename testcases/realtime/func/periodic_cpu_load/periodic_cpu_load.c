@@ -63,8 +63,8 @@
 //#define PASS_US 100
 
 int fail[THREADS_PER_GROUP * NUM_GROUPS];
-stats_container_t dat[THREADS_PER_GROUP * NUM_GROUPS];
-stats_record_t rec;
+/* each thread records into its own histogram, merged per group at the end */
+stats_hdr_t dat[THREADS_PER_GROUP * NUM_GROUPS];
 stats_quantiles_t quantiles[THREADS_PER_GROUP * NUM_GROUPS];
 static const char groupname[NUM_GROUPS] = "ABC";
 
@@ -141,9 +141,7 @@ void *periodic_thread(void *thread)
 		func(parg->arg);
 		exe_end = rt_gettime();
 		exe_time = exe_end - exe_start;
-		rec.x = i;
-		rec.y = exe_time / NS_PER_US;
-		stats_container_append(&dat[t->id], rec);
+		stats_hdr_record(&dat[t->id], exe_time / NS_PER_US);
 
 		i++;
 
@@ -165,7 +163,9 @@ void *periodic_thread(void *thread)
 
 int main(int argc, char *argv[])
 {
-	int i;
+	stats_hdr_t group;
+	stats_quantiles_t group_quantiles;
+	int i, j;
 	setup();
 
 	rt_init("hi:", parse_args, argc, argv);
@@ -195,9 +195,11 @@ int main(int argc, char *argv[])
 	printf("\n");
 
 	for (i = 0; i < (THREADS_PER_GROUP * NUM_GROUPS); i++) {
-		stats_container_init(&dat[i], iterations);
+		stats_hdr_init(&dat[i]);
 		stats_quantiles_init(&quantiles[i], (int)log10(iterations));
 	}
+	stats_quantiles_init(&group_quantiles,
+			     (int)log10(iterations * THREADS_PER_GROUP));
 
 	struct periodic_arg parg_a =
 	    { PERIOD_A, iterations, calc, (void *)CALC_LOOPS_A };
@@ -219,12 +221,12 @@ int main(int argc, char *argv[])
 
 	for (i = 0; i < (THREADS_PER_GROUP * NUM_GROUPS); i++) {
 		printf("TID %d (%c)\n", i, groupname[i >> 2]);
-		printf("  Min: %ld us\n", stats_min(&dat[i]));
-		printf("  Max: %ld us\n", stats_max(&dat[i]));
-		printf("  Avg: %f us\n", stats_avg(&dat[i]));
-		printf("  StdDev: %f us\n\n", stats_stddev(&dat[i]));
+		printf("  Min: %ld us\n", stats_hdr_min(&dat[i]));
+		printf("  Max: %ld us\n", stats_hdr_max(&dat[i]));
+		printf("  Avg: %f us\n", stats_hdr_avg(&dat[i]));
+		printf("  StdDev: %f us\n\n", stats_hdr_stddev(&dat[i]));
 		printf("  Quantiles:\n");
-		stats_quantiles_calc(&dat[i], &quantiles[i]);
+		stats_hdr_quantiles_calc(&dat[i], &quantiles[i]);
 		stats_quantiles_print(&quantiles[i]);
 		printf("Criteria: TID %d did not miss a period\n", i);
 		printf("Result: %s\n", fail[i] ? "FAIL" : "PASS");
@@ -234,14 +236,33 @@ int main(int argc, char *argv[])
 			ret = 1;
 	}
 
+	for (i = 0; i < NUM_GROUPS; i++) {
+		stats_hdr_init(&group);
+		for (j = 0; j < THREADS_PER_GROUP; j++)
+			stats_hdr_merge(&group, &dat[i * THREADS_PER_GROUP + j]);
+
+		printf("Group %c\n", groupname[i]);
+		printf("  Min: %ld us\n", stats_hdr_min(&group));
+		printf("  Max: %ld us\n", stats_hdr_max(&group));
+		printf("  Avg: %f us\n", stats_hdr_avg(&group));
+		printf("  StdDev: %f us\n\n", stats_hdr_stddev(&group));
+		printf("  Quantiles:\n");
+		stats_hdr_quantiles_calc(&group, &group_quantiles);
+		stats_quantiles_print(&group_quantiles);
+		printf("\n");
+
+		stats_hdr_free(&group);
+	}
+
 	// FIXME: define pass criteria
 	// printf("\nCriteria: latencies < %d us\n", PASS_US);
 	// printf("Result: %s\n", ret ? "FAIL" : "PASS");
 
 	for (i = 0; i < (THREADS_PER_GROUP * NUM_GROUPS); i++) {
-		stats_container_free(&dat[i]);
+		stats_hdr_free(&dat[i]);
 		stats_quantiles_free(&quantiles[i]);
 	}
+	stats_quantiles_free(&group_quantiles);
 
 	return ret;
 }
@@ -85,8 +85,9 @@ void *calc(int loops)
 
 int periodic_thread(nsec_t period, int iterations, int loops)
 {
-	stats_container_t dat;
+	stats_container_t dat = {};
 	stats_container_t hist;
+	stats_hdr_t exe;
 	stats_quantiles_t quantiles;
 	stats_record_t rec;
 
@@ -97,8 +98,11 @@ int periodic_thread(nsec_t period, int iterations, int loops)
 	char *samples_filename;
 	char *hist_filename;
 
-	stats_container_init(&dat, iterations);
+	/* raw samples are only needed for the scatter plot */
+	if (save_stats)
+		stats_container_init(&dat, iterations);
 	stats_container_init(&hist, HIST_BUCKETS);
+	stats_hdr_init(&exe);
 	stats_quantiles_init(&quantiles, (int)log10(iterations));
 	if (asprintf(&samples_filename, "%s-samples", filename_prefix) == -1) {
 		fprintf(stderr,
@@ -125,9 +129,12 @@ int periodic_thread(nsec_t period, int iterations, int loops)
 		calc(loops);
 		exe_end = rt_gettime();
 		exe_time = exe_end - exe_start;
-		rec.x = i;
-		rec.y = exe_time / NS_PER_US;
-		stats_container_append(&dat, rec);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = exe_time / NS_PER_US;
+			stats_container_append(&dat, rec);
+		}
+		stats_hdr_record(&exe, exe_time / NS_PER_US);
 
 		i++;
 
@@ -141,22 +148,27 @@ int periodic_thread(nsec_t period, int iterations, int loops)
 		rt_nanosleep(next - now);
 	}
 
+	stats_hdr_hist(&hist, &exe);
 	stats_container_save(samples_filename, "Periodic CPU Load Scatter Plot",
 			     "Iteration", "Runtime (us)", &dat, "points");
 	stats_container_save(hist_filename, "Periodic CPU Load Histogram",
 			     "Runtime (us)", "Samples", &hist, "steps");
 
 	printf("  Execution Time Statistics:\n");
-	printf("Min: %ld us\n", stats_min(&dat));
-	printf("Max: %ld us\n", stats_max(&dat));
-	printf("Avg: %.4f us\n", stats_avg(&dat));
-	printf("StdDev: %.4f us\n", stats_stddev(&dat));
+	printf("Min: %ld us\n", stats_hdr_min(&exe));
+	printf("Max: %ld us\n", stats_hdr_max(&exe));
+	printf("Avg: %.4f us\n", stats_hdr_avg(&exe));
+	printf("StdDev: %.4f us\n", stats_hdr_stddev(&exe));
 	printf("Quantiles:\n");
-	stats_quantiles_calc(&dat, &quantiles);
+	stats_hdr_quantiles_calc(&exe, &quantiles);
 	stats_quantiles_print(&quantiles);
 	printf("Criteria: no missed periods\n");
 	printf("Result: %s\n", fail ? "FAIL" : "PASS");
 
+	stats_container_free(&dat);
+	stats_container_free(&hist);
+	stats_hdr_free(&exe);
+	stats_quantiles_free(&quantiles);
 	free(samples_filename);
 	free(hist_filename);
 
@@ -75,7 +75,8 @@ static int num_busy = -1;
 
 nsec_t low_unlock, max_pi_delay;
 
-stats_container_t low_dat, cpu_delay_dat;
+stats_container_t cpu_delay_dat;
+stats_hdr_t cpu_delay_hdr;
 stats_container_t cpu_delay_hist;
 stats_quantiles_t cpu_delay_quantiles;
 stats_record_t rec;
@@ -132,11 +133,8 @@ void *busy_thread(void *arg)
 
 void *low_prio_thread(void *arg)
 {
-	nsec_t low_start, low_hold;
 	unsigned int i;
 
-	stats_container_init(&low_dat, iterations);
-
 	printf("Low prio thread started\n");
 
 	for (i = 0; i < iterations; i++) {
@@ -147,17 +145,11 @@ void *low_prio_thread(void *arg)
 		 */
 		pthread_barrier_wait(&bar1);
 
-		low_start = rt_gettime();
 		busy_work_ms(low_work_time);
 		low_unlock = rt_gettime();
-		low_hold = low_unlock - low_start;
 
 		pthread_mutex_unlock(&lock);
 
-		rec.x = i;
-		rec.y = low_hold / NS_PER_US;
-		stats_container_append(&low_dat, rec);
-
 		if (i == iterations - 1)
 			end = 1;
 
@@ -173,7 +165,10 @@ void *high_prio_thread(void *arg)
 	nsec_t high_start, high_end, high_get_lock;
 	unsigned int i;
 
-	stats_container_init(&cpu_delay_dat, iterations);
+	/* raw samples are only needed for the scatter plot */
+	if (save_stats)
+		stats_container_init(&cpu_delay_dat, iterations);
+	stats_hdr_init(&cpu_delay_hdr);
 	stats_container_init(&cpu_delay_hist, HIST_BUCKETS);
 	stats_quantiles_init(&cpu_delay_quantiles, (int)log10(iterations));
 
@@ -193,15 +188,18 @@ void *high_prio_thread(void *arg)
 		busy_work_ms(high_work_time);
 		pthread_mutex_unlock(&lock);
 
-		rec.x = i;
-		rec.y = high_get_lock / NS_PER_US;
-		stats_container_append(&cpu_delay_dat, rec);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = high_get_lock / NS_PER_US;
+			stats_container_append(&cpu_delay_dat, rec);
+		}
+		stats_hdr_record(&cpu_delay_hdr, high_get_lock / NS_PER_US);
 
 		/* Wait for all threads to finish this iteration */
 		pthread_barrier_wait(&bar2);
 	}
 
-	stats_hist(&cpu_delay_hist, &cpu_delay_dat);
+	stats_hdr_hist(&cpu_delay_hist, &cpu_delay_hdr);
 	stats_container_save("samples", "pi_perf Latency Scatter Plot",
 			     "Iteration", "Latency (us)", &cpu_delay_dat,
 			     "points");
@@ -211,15 +209,16 @@ void *high_prio_thread(void *arg)
 
 	printf
 	    ("Time taken for high prio thread to get the lock once released by low prio thread\n");
-	printf("Min delay = %ld us\n", stats_min(&cpu_delay_dat));
-	printf("Max delay = %ld us\n", stats_max(&cpu_delay_dat));
-	printf("Average delay = %4.2f us\n", stats_avg(&cpu_delay_dat));
-	printf("Standard Deviation = %4.2f us\n", stats_stddev(&cpu_delay_dat));
+	printf("Min delay = %ld us\n", stats_hdr_min(&cpu_delay_hdr));
+	printf("Max delay = %ld us\n", stats_hdr_max(&cpu_delay_hdr));
+	printf("Average delay = %4.2f us\n", stats_hdr_avg(&cpu_delay_hdr));
+	printf("Standard Deviation = %4.2f us\n", stats_hdr_stddev(&cpu_delay_hdr));
 	printf("Quantiles:\n");
-	stats_quantiles_calc(&cpu_delay_dat, &cpu_delay_quantiles);
+	stats_hdr_quantiles_calc(&cpu_delay_hdr, &cpu_delay_quantiles);
 	stats_quantiles_print(&cpu_delay_quantiles);
 
-	max_pi_delay = stats_max(&cpu_delay_dat);
+	max_pi_delay = stats_hdr_max(&cpu_delay_hdr);
+	stats_hdr_free(&cpu_delay_hdr);
 
 	return NULL;
 }
@@ -118,10 +118,14 @@ void *signal_receiving_thread(void *arg)
 
 	stats_container_t dat;
 	stats_container_t hist;
+	stats_hdr_t lat;
 	stats_quantiles_t quantiles;
 	stats_record_t rec;
 
-	stats_container_init(&dat, ITERATIONS);
+	/* raw samples are only needed for the scatter plot */
+	if (save_stats)
+		stats_container_init(&dat, ITERATIONS);
+	stats_hdr_init(&lat);
 	stats_container_init(&hist, HIST_BUCKETS);
 	stats_quantiles_init(&quantiles, (int)log10(ITERATIONS));
 
@@ -160,9 +164,12 @@ void *signal_receiving_thread(void *arg)
 		sigwait(&set, &sig);
 		end = rt_gettime();
 		delta = (end - begin) / NS_PER_US;
-		rec.x = i;
-		rec.y = delta;
-		stats_container_append(&dat, rec);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = delta;
+			stats_container_append(&dat, rec);
+		}
+		stats_hdr_record(&lat, delta);
 
 		if (i == 0 || delta < min)
 			min = delta;
@@ -197,23 +204,24 @@ void *signal_receiving_thread(void *arg)
 			fflush(stdout);
 			buffer_print();
 			latency_trace_print();
-			stats_container_resize(&dat, i + 1);
+			if (save_stats)
+				stats_container_resize(&dat, i + 1);
 		}
 	}
 
-	stats_hist(&hist, &dat);
+	stats_hdr_hist(&hist, &lat);
 	stats_container_save("samples", "pthread_kill Latency Scatter Plot",
 			     "Iteration", "Latency (us)", &dat, "points");
 	stats_container_save("hist", "pthread_kill Latency Histogram",
 			     "Latency (us)", "Samples", &hist, "steps");
 
 	printf("\n");
-	printf("Min: %lu us\n", stats_min(&dat));
-	printf("Max: %lu us\n", stats_max(&dat));
-	printf("Avg: %.4f us\n", stats_avg(&dat));
-	printf("StdDev: %.4f us\n", stats_stddev(&dat));
+	printf("Min: %lu us\n", stats_hdr_min(&lat));
+	printf("Max: %lu us\n", stats_hdr_max(&lat));
+	printf("Avg: %.4f us\n", stats_hdr_avg(&lat));
+	printf("StdDev: %.4f us\n", stats_hdr_stddev(&lat));
 	printf("Quantiles:\n");
-	stats_quantiles_calc(&dat, &quantiles);
+	stats_hdr_quantiles_calc(&lat, &quantiles);
 	stats_quantiles_print(&quantiles);
 	printf("Failures: %d\n", fail);
 	printf("Criteria: Time < %d us\n", (int)pass_criteria);
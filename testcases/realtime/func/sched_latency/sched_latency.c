@@ -73,6 +73,7 @@ static unsigned int load_ms = DEF_LOAD_MS;
 
 stats_container_t dat;
 stats_container_t hist;
+stats_hdr_t lat;
 stats_quantiles_t quantiles;
 stats_record_t rec;
 
@@ -177,9 +178,12 @@ void *periodic_thread(void *arg)
 		/* start of period */
 		delay =
 		    (now - iter_start - (nsec_t) (i + 1) * period) / NS_PER_US;
-		rec.x = i;
-		rec.y = delay;
-		stats_container_append(&dat, rec);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = delay;
+			stats_container_append(&dat, rec);
+		}
+		stats_hdr_record(&lat, delay);
 
 		if (delay < min_delay)
 			min_delay = delay;
@@ -207,12 +211,12 @@ void *periodic_thread(void *arg)
 			    ("Latency threshold (%lluus) exceeded at iteration %d\n",
 			     latency_threshold, i);
 			latency_trace_print();
-			stats_container_resize(&dat, i + 1);
+			if (save_stats)
+				stats_container_resize(&dat, i + 1);
 		}
 	}
 
-	/* save samples before the quantile calculation messes things up! */
-	stats_hist(&hist, &dat);
+	stats_hdr_hist(&hist, &lat);
 	stats_container_save("samples",
 			     "Periodic Scheduling Latency Scatter Plot",
 			     "Iteration", "Latency (us)", &dat, "points");
@@ -229,9 +233,9 @@ void *periodic_thread(void *arg)
 	       max_delay < pass_criteria ? "PASS" : "FAIL");
 	printf("Avg:   %4llu us: %s\n", avg_delay,
 	       avg_delay < pass_criteria ? "PASS" : "FAIL");
-	printf("StdDev: %.4f us\n", stats_stddev(&dat));
+	printf("StdDev: %.4f us\n", stats_hdr_stddev(&lat));
 	printf("Quantiles:\n");
-	stats_quantiles_calc(&dat, &quantiles);
+	stats_hdr_quantiles_calc(&lat, &quantiles);
 	stats_quantiles_print(&quantiles);
 	printf("Failed Iterations: %d\n", failures);
 
@@ -271,10 +275,17 @@ int main(int argc, char *argv[])
 	printf("Expected running time: %d s\n",
 	       (int)(iterations * ((float)period / NS_PER_SEC)));
 
-	if (stats_container_init(&dat, iterations))
+	/* raw samples are only needed for the scatter plot */
+	if (save_stats && stats_container_init(&dat, iterations))
 		exit(1);
 
+	if (stats_hdr_init(&lat)) {
+		stats_container_free(&dat);
+		exit(1);
+	}
+
 	if (stats_container_init(&hist, HIST_BUCKETS)) {
+		stats_hdr_free(&lat);
 		stats_container_free(&dat);
 		exit(1);
 	}
@@ -282,6 +293,7 @@ int main(int argc, char *argv[])
 	/* use the highest value for the quantiles */
 	if (stats_quantiles_init(&quantiles, (int)log10(iterations))) {
 		stats_container_free(&hist);
+		stats_hdr_free(&lat);
 		stats_container_free(&dat);
 		exit(1);
 	}
@@ -297,6 +309,7 @@ int main(int argc, char *argv[])
 	printf("Result: %s\n", ret ? "FAIL" : "PASS");
 
 	stats_container_free(&dat);
+	stats_hdr_free(&lat);
 	stats_container_free(&hist);
 	stats_quantiles_free(&quantiles);
 
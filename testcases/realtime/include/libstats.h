@@ -45,6 +45,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include "tst_hdr_hist.h"
 
 #define MIN(A,B) ((A)<(B)?(A):(B))
 #define MAX(A,B) ((A)>(B)?(A):(B))
@@ -72,6 +73,30 @@ typedef struct stats_quantiles {
 	long *quantiles;
 } stats_quantiles_t;
 
+/*
+ * Log-linear (HDR style) histogram with constant memory. Values below
+ * STATS_HDR_SUB are counted exactly, larger values are split into
+ * STATS_HDR_SUB buckets per power of two, so a reported value differs from
+ * the recorded one by less than 1/STATS_HDR_SUB. Negative values are
+ * counted as zero.
+ *
+ * A histogram has a single writer, the counters are updated with relaxed
+ * atomic stores so that other threads can take a snapshot with
+ * stats_hdr_merge() while it is being recorded into.
+ */
+#define STATS_HDR_SUB_BITS	8
+#define STATS_HDR_SUB		(1 << STATS_HDR_SUB_BITS)
+#define STATS_HDR_BUCKETS	TST_HDR_BUCKETS(STATS_HDR_SUB_BITS, 64)
+
+typedef struct stats_hdr {
+	unsigned long long total;
+	long min;
+	long max;
+	double sum;
+	double sumsq;
+	unsigned long long *counts;
+} stats_hdr_t;
+
 extern int save_stats;
 
 /* function prototypes */
@@ -170,4 +195,53 @@ int stats_container_save(char *filename, char *title, char *labelx, char *labely
  * Returns the index of the appended record on success and -1 on error
  */
 int stats_container_append(stats_container_t *data, stats_record_t rec);
+
+/* stats_hdr_init - allocate memory for a new empty histogram
+ * hdr: stats_hdr_t destination pointer
+ */
+int stats_hdr_init(stats_hdr_t *hdr);
+
+/* stats_hdr_free - free the histogram counters
+ * hdr: stats_hdr_t to free
+ */
+int stats_hdr_free(stats_hdr_t *hdr);
+
+/* stats_hdr_record - count value in the histogram, lock-free
+ * hdr: stats_hdr_t owned by the calling thread
+ * value: the value to record
+ */
+void stats_hdr_record(stats_hdr_t *hdr, long value);
+
+/* stats_hdr_merge - add all values recorded in src to dst
+ * dst: stats_hdr_t to merge into, owned by the calling thread
+ * src: stats_hdr_t to merge from, may be concurrently recorded into
+ */
+int stats_hdr_merge(stats_hdr_t *dst, stats_hdr_t *src);
+
+/* stats_hdr_value_at - return the value at the given quantile
+ * hdr: stats_hdr_t with recorded values
+ * quantile: the quantile in the range [0, 1]
+ * Returns the highest value equivalent to the value at the quantile
+ */
+long stats_hdr_value_at(stats_hdr_t *hdr, double quantile);
+
+/* stats_hdr_avg, stats_hdr_stddev, stats_hdr_min, stats_hdr_max - same as
+ * the stats_container_t variants for the values recorded in hdr
+ */
+float stats_hdr_avg(stats_hdr_t *hdr);
+float stats_hdr_stddev(stats_hdr_t *hdr);
+long stats_hdr_min(stats_hdr_t *hdr);
+long stats_hdr_max(stats_hdr_t *hdr);
+
+/* stats_hdr_quantiles_calc - calculate the quantiles of the recorded values
+ * hdr: stats_hdr_t with recorded values
+ * quantiles: stats_quantiles_t structure for storing the results
+ */
+int stats_hdr_quantiles_calc(stats_hdr_t *hdr, stats_quantiles_t *quantiles);
+
+/* stats_hdr_hist - calculate a histogram with hist->size divisions from hdr
+ * hist: the destination of the histogram data
+ * hdr: the source from which to calculate the histogram
+ */
+int stats_hdr_hist(stats_container_t *hist, stats_hdr_t *hdr);
 #endif /* LIBSTAT_H */
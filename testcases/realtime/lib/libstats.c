@@ -365,3 +365,200 @@ int stats_container_save(char *filename, char *title, char *xlabel,
 
 	return 0;
 }
+
+static unsigned int stats_hdr_bucket(long value)
+{
+	return tst_hdr_bucket(value < 0 ? 0 : value, STATS_HDR_SUB_BITS);
+}
+
+static long stats_hdr_bucket_low(unsigned int b)
+{
+	return tst_hdr_bucket_low(b, STATS_HDR_SUB_BITS);
+}
+
+static long stats_hdr_bucket_high(unsigned int b)
+{
+	return tst_hdr_bucket_high(b, STATS_HDR_SUB_BITS);
+}
+
+int stats_hdr_init(stats_hdr_t * hdr)
+{
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->counts = calloc(STATS_HDR_BUCKETS, sizeof(*hdr->counts));
+	if (!hdr->counts)
+		return -1;
+	return 0;
+}
+
+int stats_hdr_free(stats_hdr_t * hdr)
+{
+	free(hdr->counts);
+	return 0;
+}
+
+void stats_hdr_record(stats_hdr_t * hdr, long value)
+{
+	unsigned int b = stats_hdr_bucket(value);
+	double sum = hdr->sum + value;
+	double sumsq = hdr->sumsq + (double)value * value;
+
+	__atomic_store_n(&hdr->counts[b], hdr->counts[b] + 1,
+			 __ATOMIC_RELAXED);
+
+	if (!hdr->total || value < hdr->min)
+		__atomic_store_n(&hdr->min, value, __ATOMIC_RELAXED);
+	if (!hdr->total || value > hdr->max)
+		__atomic_store_n(&hdr->max, value, __ATOMIC_RELAXED);
+
+	__atomic_store(&hdr->sum, &sum, __ATOMIC_RELAXED);
+	__atomic_store(&hdr->sumsq, &sumsq, __ATOMIC_RELAXED);
+
+	/* publish the sample after everything above is visible */
+	__atomic_store_n(&hdr->total, hdr->total + 1, __ATOMIC_RELEASE);
+}
+
+int stats_hdr_merge(stats_hdr_t * dst, stats_hdr_t * src)
+{
+	unsigned long long total, prev = dst->total;
+	double sum, sumsq;
+	long min, max;
+	int i;
+
+	total = __atomic_load_n(&src->total, __ATOMIC_ACQUIRE);
+	if (!total)
+		return 0;
+
+	min = __atomic_load_n(&src->min, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+	__atomic_load(&src->sum, &sum, __ATOMIC_RELAXED);
+	__atomic_load(&src->sumsq, &sumsq, __ATOMIC_RELAXED);
+
+	/*
+	 * Counters may be a few samples ahead of total when src is being
+	 * recorded into, total is recomputed from the counters.
+	 */
+	dst->total = 0;
+	for (i = 0; i < STATS_HDR_BUCKETS; i++) {
+		dst->counts[i] += __atomic_load_n(&src->counts[i],
+						  __ATOMIC_RELAXED);
+		dst->total += dst->counts[i];
+	}
+
+	if (!prev || min < dst->min)
+		dst->min = min;
+	if (!prev || max > dst->max)
+		dst->max = max;
+	dst->sum += sum;
+	dst->sumsq += sumsq;
+
+	return 0;
+}
+
+static long stats_hdr_value_at_rank(stats_hdr_t * hdr,
+				    unsigned long long rank)
+{
+	unsigned long long cnt = 0;
+	int i;
+
+	for (i = 0; i < STATS_HDR_BUCKETS; i++) {
+		cnt += hdr->counts[i];
+		if (cnt > rank)
+			return MAX(MIN(stats_hdr_bucket_high(i), hdr->max),
+				   hdr->min);
+	}
+
+	return hdr->max;
+}
+
+long stats_hdr_value_at(stats_hdr_t * hdr, double quantile)
+{
+	unsigned long long rank;
+
+	if (!hdr->total)
+		return 0;
+
+	rank = quantile * hdr->total;
+	if (rank >= hdr->total)
+		rank = hdr->total - 1;
+
+	return stats_hdr_value_at_rank(hdr, rank);
+}
+
+float stats_hdr_avg(stats_hdr_t * hdr)
+{
+	if (!hdr->total)
+		return 0;
+
+	return hdr->sum / hdr->total;
+}
+
+float stats_hdr_stddev(stats_hdr_t * hdr)
+{
+	double avg, var;
+
+	if (!hdr->total)
+		return 0;
+
+	avg = hdr->sum / hdr->total;
+	var = hdr->sumsq / hdr->total - avg * avg;
+
+	return var > 0 ? sqrt(var) : 0;
+}
+
+long stats_hdr_min(stats_hdr_t * hdr)
+{
+	return hdr->min;
+}
+
+long stats_hdr_max(stats_hdr_t * hdr)
+{
+	return hdr->max;
+}
+
+int stats_hdr_quantiles_calc(stats_hdr_t * hdr,
+			     stats_quantiles_t * quantiles)
+{
+	unsigned long long index;
+	int i;
+
+	// check for sufficient data size of accurate calculation
+	if (!hdr->total || hdr->total < (unsigned long long)exp10(quantiles->nines))
+		return -1;
+
+	for (i = 2; i <= quantiles->nines; i++) {
+		index = hdr->total - hdr->total / exp10(i);
+		quantiles->quantiles[i - 2] =
+		    stats_hdr_value_at_rank(hdr, index);
+	}
+	return 0;
+}
+
+int stats_hdr_hist(stats_container_t * hist, stats_hdr_t * hdr)
+{
+	long min, max, width, y, b;
+	int i;
+
+	if (hist->size <= 0 || !hdr->total)
+		return -1;
+
+	min = hdr->min;
+	max = hdr->max;
+
+	/* define the bucket ranges */
+	width = MAX((max - min) / hist->size, 1);
+	hist->records[0].x = min;
+	for (i = 1; i < (hist->size); i++) {
+		hist->records[i].x = min + i * width;
+	}
+
+	/* fill in the counts, each bucket is represented by its low value */
+	for (i = 0; i < STATS_HDR_BUCKETS; i++) {
+		if (!hdr->counts[i])
+			continue;
+		y = MAX(MIN(stats_hdr_bucket_low(i), max), min);
+		b = MIN((y - min) / width, hist->size - 1);
+		hist->records[b].y += hdr->counts[i];
+	}
+
+	return 0;
+}
@@ -0,0 +1,822 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (c) Linux Test Project, 2026
+ */
+
+/*
+ * Parallel executor for runtest files.
+ *
+ * The test requirements exported by metaparse into ltp.json are mapped onto a
+ * set of named system resources, e.g. a block device, a /proc or /sys file
+ * from .save_restore, a cgroup controller, hugepages or the wall clock. Two
+ * tests conflict if they share a resource and such tests are never executed
+ * concurrently. Tests with .needs_root share the "root" resource unless -C is
+ * passed, since most of them change global state such as sysctls, mounts or
+ * cgroups. Tests that are not described in the metadata (shell tests, tests
+ * written against the old library), tests that check the kernel taint flags
+ * and tests in the system wide groups below, e.g. OOM or swapping tests, are
+ * executed exclusively, i.e. with nothing else running.
+ *
+ * The memory requirements (.min_mem_avail) are accounted against the memory
+ * available at the start of the run so that memory hungry tests do not starve
+ * each other.
+ *
+ * Output of each test is redirected into a separate log file in the output
+ * directory, the results are summarized in the results file there.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ujson.h"
+
+#define RES_MAX 16
+
+/* Exit status bits as used by the test library */
+#define TFAIL 1
+#define TBROK 2
+#define TWARN 4
+#define TCONF 32
+
+struct meta {
+	char *name;
+	const char *res[RES_MAX];
+	unsigned int res_cnt;
+	unsigned long mem_mb;
+	int exclusive;
+};
+
+enum test_state {
+	TEST_PENDING,
+	TEST_RUNNING,
+	TEST_DONE,
+};
+
+struct test {
+	char *tag;
+	char *cmd;
+	const struct meta *meta;
+	enum test_state state;
+	pid_t pid;
+	int status;
+	int timed_out;
+	struct timespec start;
+	double duration;
+};
+
+static struct meta *metas;
+static size_t meta_cnt;
+
+static struct test *tests;
+static size_t test_cnt;
+static size_t test_size;
+
+static const char **held_res;
+static unsigned int held_cnt;
+
+static unsigned int jobs;
+static unsigned int running;
+static int excl_running;
+static unsigned long mem_used;
+static unsigned long mem_budget;
+static unsigned int timeout;
+static int serialize_root = 1;
+static const char *outdir;
+static FILE *results;
+
+/*
+ * Test groups that stress the whole system or change system wide settings,
+ * running anything next to them would make both results unreliable.
+ */
+static const char *const exclusive_groups[] = {
+	"oom",
+	"swapping",
+	"ksm",
+	"thp",
+	"tunable",
+	"mtest01",
+	"mtest06",
+	"mmapstress",
+	"msgstress",
+	"stress",
+	"sched",
+	"power_management",
+	"crash",
+	"zram",
+	"swapon",
+	NULL
+};
+
+static void *xmalloc(size_t size)
+{
+	void *ret = malloc(size);
+
+	if (!ret) {
+		fprintf(stderr, "malloc() failed\n");
+		exit(1);
+	}
+
+	return ret;
+}
+
+static char *xstrdup(const char *str)
+{
+	char *ret = strdup(str);
+
+	if (!ret) {
+		fprintf(stderr, "strdup() failed\n");
+		exit(1);
+	}
+
+	return ret;
+}
+
+static void meta_add_res(struct meta *meta, const char *fmt, const char *arg)
+{
+	char buf[PATH_MAX];
+
+	if (meta->res_cnt >= RES_MAX) {
+		meta->exclusive = 1;
+		return;
+	}
+
+	snprintf(buf, sizeof(buf), fmt, arg);
+	meta->res[meta->res_cnt++] = xstrdup(buf);
+}
+
+/*
+ * Booleans are exported as true, integer values are exported as strings by
+ * metaparse, we accept both just to be sure.
+ */
+static unsigned long val_to_ulong(ujson_val *val)
+{
+	switch (val->type) {
+	case UJSON_BOOL:
+		return val->val_bool;
+	case UJSON_INT:
+		return val->val_int > 0 ? val->val_int : 0;
+	case UJSON_STR:
+		return strtoul(val->val_str, NULL, 10);
+	default:
+		return 0;
+	}
+}
+
+static void parse_strarr_res(ujson_reader *reader, ujson_val *val,
+			     struct meta *meta, const char *fmt)
+{
+	UJSON_ARR_FOREACH(reader, val) {
+		if (val->type != UJSON_STR) {
+			ujson_err(reader, "Expected string!");
+			return;
+		}
+
+		meta_add_res(meta, fmt, val->val_str);
+	}
+}
+
+static void parse_save_restore(ujson_reader *reader, ujson_val *val,
+			       struct meta *meta)
+{
+	UJSON_ARR_FOREACH(reader, val) {
+		int first = 1;
+
+		if (val->type != UJSON_ARR) {
+			ujson_err(reader, "Expected array!");
+			return;
+		}
+
+		UJSON_ARR_FOREACH(reader, val) {
+			if (first && val->type == UJSON_STR)
+				meta_add_res(meta, "file:%s", val->val_str);
+
+			first = 0;
+		}
+	}
+}
+
+static void parse_groups(ujson_reader *reader, ujson_val *val,
+			 struct meta *meta)
+{
+	unsigned int i;
+
+	UJSON_ARR_FOREACH(reader, val) {
+		if (val->type != UJSON_STR) {
+			ujson_err(reader, "Expected string!");
+			return;
+		}
+
+		for (i = 0; exclusive_groups[i]; i++) {
+			if (!strcmp(val->val_str, exclusive_groups[i]))
+				meta->exclusive = 1;
+		}
+	}
+}
+
+static void skip_val(ujson_reader *reader, ujson_val *val)
+{
+	if (val->type == UJSON_OBJ)
+		ujson_obj_skip(reader);
+	else if (val->type == UJSON_ARR)
+		ujson_arr_skip(reader);
+}
+
+static void parse_test(ujson_reader *reader, ujson_val *val, struct meta *meta)
+{
+	UJSON_OBJ_FOREACH(reader, val) {
+		const char *id = val->id;
+
+		if (!strcmp(id, "needs_device") || !strcmp(id, "format_device") ||
+		    !strcmp(id, "mount_device") || !strcmp(id, "all_filesystems")) {
+			/*
+			 * Loop devices are acquired without locking and
+			 * LTP_DEV is shared by all tests.
+			 */
+			if (val_to_ulong(val))
+				meta_add_res(meta, "%s", "device");
+		} else if (!strcmp(id, "needs_hugetlbfs")) {
+			if (val_to_ulong(val))
+				meta_add_res(meta, "%s", "hugepages");
+		} else if (!strcmp(id, "hugepages")) {
+			meta_add_res(meta, "%s", "hugepages");
+			skip_val(reader, val);
+		} else if (!strcmp(id, "restore_wallclock")) {
+			if (val_to_ulong(val))
+				meta_add_res(meta, "%s", "wallclock");
+		} else if (!strcmp(id, "min_swap_avail")) {
+			meta_add_res(meta, "%s", "swap");
+		} else if (!strcmp(id, "needs_root")) {
+			if (serialize_root && val_to_ulong(val))
+				meta_add_res(meta, "%s", "root");
+		} else if (!strcmp(id, "taint_check")) {
+			meta->exclusive = 1;
+		} else if (!strcmp(id, "min_mem_avail")) {
+			meta->mem_mb = val_to_ulong(val);
+		} else if (!strcmp(id, "save_restore")) {
+			parse_save_restore(reader, val, meta);
+		} else if (!strcmp(id, "needs_cgroup_ctrls")) {
+			parse_strarr_res(reader, val, meta, "cgroup:%s");
+		} else if (!strcmp(id, "groups")) {
+			parse_groups(reader, val, meta);
+		} else {
+			skip_val(reader, val);
+		}
+	}
+}
+
+static int meta_cmp(const void *a, const void *b)
+{
+	const struct meta *ma = a, *mb = b;
+
+	return strcmp(ma->name, mb->name);
+}
+
+static void parse_tests(ujson_reader *reader, ujson_val *val)
+{
+	size_t size = 0;
+
+	UJSON_OBJ_FOREACH(reader, val) {
+		if (val->type != UJSON_OBJ) {
+			ujson_err(reader, "Expected object!");
+			return;
+		}
+
+		if (meta_cnt >= size) {
+			size = size ? 2 * size : 1024;
+			metas = realloc(metas, size * sizeof(*metas));
+			if (!metas) {
+				fprintf(stderr, "realloc() failed\n");
+				exit(1);
+			}
+		}
+
+		memset(&metas[meta_cnt], 0, sizeof(*metas));
+		metas[meta_cnt].name = xstrdup(val->id);
+		parse_test(reader, val, &metas[meta_cnt]);
+		meta_cnt++;
+	}
+}
+
+static void load_metadata(const char *path)
+{
+	ujson_reader *reader = ujson_reader_load(path);
+	ujson_val *val = ujson_val_alloc(0);
+
+	if (!reader || !val) {
+		fprintf(stderr, "Failed to load '%s'\n", path);
+		exit(1);
+	}
+
+	UJSON_OBJ_FOREACH(reader, val) {
+		if (!strcmp(val->id, "tests") && val->type == UJSON_OBJ)
+			parse_tests(reader, val);
+		else
+			skip_val(reader, val);
+	}
+
+	ujson_reader_finish(reader);
+
+	if (ujson_reader_err(reader))
+		exit(1);
+
+	ujson_reader_free(reader);
+	ujson_val_free(val);
+
+	qsort(metas, meta_cnt, sizeof(*metas), meta_cmp);
+}
+
+static const struct meta *lookup_meta(const char *cmd)
+{
+	struct meta key;
+	char name[256];
+	size_t len = strcspn(cmd, " \t");
+	const char *base;
+
+	if (len >= sizeof(name))
+		return NULL;
+
+	memcpy(name, cmd, len);
+	name[len] = 0;
+
+	base = strrchr(name, '/');
+	key.name = base ? (char *)base + 1 : name;
+
+	return bsearch(&key, metas, meta_cnt, sizeof(*metas), meta_cmp);
+}
+
+static void load_runtest(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char *line = NULL;
+	size_t line_size = 0;
+
+	if (!f) {
+		fprintf(stderr, "Failed to open '%s': %s\n", path, strerror(errno));
+		exit(1);
+	}
+
+	while (getline(&line, &line_size, f) > 0) {
+		char *tag = line + strspn(line, " \t");
+		char *cmd;
+
+		tag[strcspn(tag, "\n")] = 0;
+
+		if (!tag[0] || tag[0] == '#')
+			continue;
+
+		cmd = tag + strcspn(tag, " \t");
+		if (!*cmd)
+			continue;
+
+		*cmd++ = 0;
+		cmd += strspn(cmd, " \t");
+
+		if (test_cnt >= test_size) {
+			test_size = test_size ? 2 * test_size : 1024;
+			tests = realloc(tests, test_size * sizeof(*tests));
+			if (!tests) {
+				fprintf(stderr, "realloc() failed\n");
+				exit(1);
+			}
+		}
+
+		memset(&tests[test_cnt], 0, sizeof(*tests));
+		tests[test_cnt].tag = xstrdup(tag);
+		tests[test_cnt].cmd = xstrdup(cmd);
+		tests[test_cnt].meta = lookup_meta(cmd);
+		test_cnt++;
+	}
+
+	free(line);
+	fclose(f);
+}
+
+static unsigned long read_mem_avail_mb(void)
+{
+	FILE *f = fopen("/proc/meminfo", "r");
+	char line[128];
+	unsigned long val = 0;
+
+	if (!f)
+		return ULONG_MAX;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "MemAvailable: %lu kB", &val) == 1)
+			break;
+	}
+
+	fclose(f);
+
+	return val ? val / 1024 : ULONG_MAX;
+}
+
+static int res_held(const char *res)
+{
+	unsigned int i;
+
+	for (i = 0; i < held_cnt; i++) {
+		if (!strcmp(held_res[i], res))
+			return 1;
+	}
+
+	return 0;
+}
+
+static void res_release(const char *res)
+{
+	unsigned int i;
+
+	for (i = 0; i < held_cnt; i++) {
+		if (!strcmp(held_res[i], res)) {
+			held_res[i] = held_res[--held_cnt];
+			return;
+		}
+	}
+}
+
+static int is_exclusive(const struct test *test)
+{
+	return !test->meta || test->meta->exclusive;
+}
+
+static int can_run(const struct test *test)
+{
+	const struct meta *meta = test->meta;
+	unsigned int i;
+
+	if (excl_running)
+		return 0;
+
+	if (is_exclusive(test))
+		return !running;
+
+	if (running && mem_used + meta->mem_mb > mem_budget)
+		return 0;
+
+	for (i = 0; i < meta->res_cnt; i++) {
+		if (res_held(meta->res[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+static struct test *pick_next(void)
+{
+	size_t i;
+
+	for (i = 0; i < test_cnt; i++) {
+		if (tests[i].state == TEST_PENDING && can_run(&tests[i]))
+			return &tests[i];
+	}
+
+	return NULL;
+}
+
+static void start_test(struct test *test)
+{
+	const struct meta *meta = test->meta;
+	char path[PATH_MAX];
+	unsigned int i;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s.log", outdir, test->tag);
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open '%s': %s\n", path, strerror(errno));
+		exit(1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &test->start);
+
+	test->pid = fork();
+	if (test->pid < 0) {
+		fprintf(stderr, "fork() failed: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	if (!test->pid) {
+		sigset_t mask;
+
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, NULL);
+		setpgid(0, 0);
+
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+
+		fd = open("/dev/null", O_RDONLY);
+		if (fd >= 0)
+			dup2(fd, STDIN_FILENO);
+
+		execl("/bin/sh", "sh", "-c", test->cmd, (char *)NULL);
+		fprintf(stderr, "execl() failed: %s\n", strerror(errno));
+		_exit(127);
+	}
+
+	close(fd);
+
+	test->state = TEST_RUNNING;
+	running++;
+
+	if (is_exclusive(test)) {
+		excl_running = 1;
+		return;
+	}
+
+	mem_used += meta->mem_mb;
+
+	for (i = 0; i < meta->res_cnt; i++)
+		held_res[held_cnt++] = meta->res[i];
+}
+
+static const char *result_str(const struct test *test)
+{
+	int ret;
+
+	if (test->timed_out)
+		return "TIMEOUT";
+
+	if (WIFSIGNALED(test->status))
+		return "KILLED";
+
+	ret = WEXITSTATUS(test->status);
+
+	if (ret & TBROK)
+		return "BROK";
+
+	if (ret & TFAIL)
+		return "FAIL";
+
+	if (ret & TWARN)
+		return "WARN";
+
+	if (ret == TCONF)
+		return "CONF";
+
+	if (ret)
+		return "BROK";
+
+	return "PASS";
+}
+
+static unsigned int done_cnt;
+static unsigned int fail_cnt;
+
+static void finish_test(struct test *test, int status)
+{
+	const struct meta *meta = test->meta;
+	const char *res;
+	struct timespec now;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	test->duration = (now.tv_sec - test->start.tv_sec) +
+			 (now.tv_nsec - test->start.tv_nsec) / 1e9;
+	test->status = status;
+	test->state = TEST_DONE;
+	running--;
+
+	if (is_exclusive(test)) {
+		excl_running = 0;
+	} else {
+		mem_used -= meta->mem_mb;
+
+		for (i = 0; i < meta->res_cnt; i++)
+			res_release(meta->res[i]);
+	}
+
+	res = result_str(test);
+
+	if (strcmp(res, "PASS") && strcmp(res, "CONF"))
+		fail_cnt++;
+
+	printf("[%u/%zu] %-30s %-7s %8.2fs\n", ++done_cnt, test_cnt,
+	       test->tag, res, test->duration);
+	fflush(stdout);
+
+	fprintf(results, "%s %s %i %.2f\n", test->tag, res,
+		WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status),
+		test->duration);
+	fflush(results);
+}
+
+static struct test *lookup_pid(pid_t pid)
+{
+	size_t i;
+
+	for (i = 0; i < test_cnt; i++) {
+		if (tests[i].state == TEST_RUNNING && tests[i].pid == pid)
+			return &tests[i];
+	}
+
+	return NULL;
+}
+
+static void check_timeouts(void)
+{
+	struct timespec now;
+	size_t i;
+
+	if (!timeout)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	for (i = 0; i < test_cnt; i++) {
+		struct test *test = &tests[i];
+
+		if (test->state != TEST_RUNNING || test->timed_out)
+			continue;
+
+		if (now.tv_sec - test->start.tv_sec < (time_t)timeout)
+			continue;
+
+		fprintf(stderr, "Test '%s' timed out, killing it\n", test->tag);
+		test->timed_out = 1;
+		kill(-test->pid, SIGKILL);
+	}
+}
+
+static void wait_children(const sigset_t *mask)
+{
+	struct timespec tout = {.tv_sec = 1};
+	struct test *test;
+	int status;
+	pid_t pid;
+
+	sigtimedwait(mask, NULL, &tout);
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		test = lookup_pid(pid);
+		if (test)
+			finish_test(test, status);
+	}
+
+	check_timeouts();
+}
+
+static void setup_path(const char *bindir)
+{
+	const char *path = getenv("PATH");
+	char *new_path;
+
+	if (!bindir)
+		return;
+
+	new_path = xmalloc(strlen(bindir) + (path ? strlen(path) : 0) + 2);
+	sprintf(new_path, "%s%s%s", bindir, path ? ":" : "", path ? path : "");
+	setenv("PATH", new_path, 1);
+	free(new_path);
+}
+
+static void print_help(const char *name)
+{
+	printf("Usage: %s -f runtest [-f runtest ...] [options]\n\n", name);
+	printf("-f path   Runtest file to execute\n");
+	printf("-m path   Path to ltp.json (default $LTPROOT/metadata/ltp.json)\n");
+	printf("-j jobs   Maximal number of parallel tests (default nproc)\n");
+	printf("-o dir    Output directory for logs and results\n");
+	printf("-b dir    Directory with test binaries (default $LTPROOT/testcases/bin)\n");
+	printf("-t secs   Kill tests running longer than secs\n");
+	printf("-C        Run tests with .needs_root concurrently\n");
+	printf("-h        Prints this help\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *runtests[64];
+	unsigned int runtest_cnt = 0, i;
+	const char *ltproot = getenv("LTPROOT");
+	const char *meta_path = NULL;
+	const char *bindir = NULL;
+	char buf[PATH_MAX], bin_buf[PATH_MAX];
+	sigset_t mask;
+	int opt;
+
+	if (!ltproot)
+		ltproot = "/opt/ltp";
+
+	while ((opt = getopt(argc, argv, "b:Cf:hj:m:o:t:")) != -1) {
+		switch (opt) {
+		case 'b':
+			bindir = optarg;
+		break;
+		case 'C':
+			serialize_root = 0;
+		break;
+		case 'f':
+			if (runtest_cnt >= sizeof(runtests)/sizeof(*runtests)) {
+				fprintf(stderr, "Too many runtest files\n");
+				return 1;
+			}
+			runtests[runtest_cnt++] = optarg;
+		break;
+		case 'h':
+			print_help(argv[0]);
+			return 0;
+		case 'j':
+			jobs = atoi(optarg);
+		break;
+		case 'm':
+			meta_path = optarg;
+		break;
+		case 'o':
+			outdir = optarg;
+		break;
+		case 't':
+			timeout = atoi(optarg);
+		break;
+		default:
+			print_help(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!runtest_cnt) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	if (!jobs) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		jobs = ncpus > 0 ? ncpus : 1;
+	}
+
+	if (!meta_path) {
+		snprintf(buf, sizeof(buf), "%s/metadata/ltp.json", ltproot);
+		meta_path = buf;
+	}
+
+	if (!bindir) {
+		snprintf(bin_buf, sizeof(bin_buf), "%s/testcases/bin", ltproot);
+		bindir = bin_buf;
+	}
+
+	if (!outdir) {
+		static char tmpl[] = "/tmp/ltp-parallel.XXXXXX";
+
+		outdir = mkdtemp(tmpl);
+		if (!outdir) {
+			fprintf(stderr, "mkdtemp() failed: %s\n", strerror(errno));
+			return 1;
+		}
+	} else if (mkdir(outdir, 0755) && errno != EEXIST) {
+		fprintf(stderr, "mkdir('%s') failed: %s\n", outdir, strerror(errno));
+		return 1;
+	}
+
+	load_metadata(meta_path);
+
+	for (i = 0; i < runtest_cnt; i++)
+		load_runtest(runtests[i]);
+
+	setup_path(bindir);
+
+	mem_budget = read_mem_avail_mb();
+	held_res = xmalloc(jobs * RES_MAX * sizeof(*held_res));
+
+	snprintf(buf, sizeof(buf), "%s/results", outdir);
+	results = fopen(buf, "w");
+	if (!results) {
+		fprintf(stderr, "Failed to open '%s': %s\n", buf, strerror(errno));
+		return 1;
+	}
+
+	printf("Running %zu tests with %u jobs, logs in '%s'\n",
+	       test_cnt, jobs, outdir);
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+
+	while (done_cnt < test_cnt) {
+		struct test *test;
+
+		while (running < jobs && (test = pick_next()))
+			start_test(test);
+
+		wait_children(&mask);
+	}
+
+	fclose(results);
+
+	printf("Finished %zu tests, %u failed\n", test_cnt, fail_cnt);
+
+	return !!fail_cnt;
+}